@@ -1437,7 +1437,7 @@ CGAffineTransformMakeRigid(CGPoint translate, CGFloat radians)
 		{
 			CGPoint scaleToParent = NodeToPhysicsScale(self.parent);
 			CGAffineTransform nodeToPhysics = NodeToPhysicsTransform(self.parent);
-			rigidTransform = CGAffineTransformConcat(physicsBody.absoluteTransform, CGAffineTransformInvert(nodeToPhysics));
+			rigidTransform = CGAffineTransformConcat(physicsBody.interpolatedTransform, CGAffineTransformInvert(nodeToPhysics));
 			rigidTransform = CGAffineTransformConcat(CGAffineTransformMakeScale(scaleToParent.x, scaleToParent.y), rigidTransform);
 		}
 
@@ -88,6 +88,9 @@ static inline cpTransform CGAFFINETRANSFORM_TO_CPTRANSFORM(CGAffineTransform t){
 /** The transform of the body relative to the space. */
 @property(nonatomic, readonly) CGAffineTransform absoluteTransform;
 
+/** The transform to draw the body with. Blended between the last two steps when the physics node interpolates. */
+@property(nonatomic, readonly) CGAffineTransform interpolatedTransform;
+
 /** Chipmunk Body. */
 @property(nonatomic, readonly) ChipmunkBody *body;
 
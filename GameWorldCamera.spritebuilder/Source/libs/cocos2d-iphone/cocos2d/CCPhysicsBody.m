@@ -434,6 +434,16 @@ CCPhysicsBodyUpdatePosition(cpBody *body, cpFloat dt)
 	return CPTRANSFORM_TO_CGAFFINETRANSFORM(_body.transform);
 }
 
+-(CGAffineTransform)interpolatedTransform {
+	CCPhysicsNode *physicsNode = self.physicsNode;
+	if(physicsNode.interpolate){
+		cpFloat alpha = cpSpaceGetStepAlpha(physicsNode.space.space);
+		return CPTRANSFORM_TO_CGAFFINETRANSFORM(cpBodyGetInterpolatedTransform(_body.body, alpha));
+	} else {
+		return self.absoluteTransform;
+	}
+}
+
 
 -(BOOL)isKinematicTransformDirty
 {
@@ -241,6 +241,23 @@ Mass has no particular units. I personally find it intuitive to use 1.0 as the m
  */
 @property(nonatomic, assign) CCTime sleepTimeThreshold;
 
+/**
+ *  When YES the physics is stepped from update: at fixedTimeStep intervals instead of by the scheduler's fixedUpdate:,
+ *  and physics bodies are drawn between their last two steps so motion stays smooth when the frame rate doesn't match the time step.
+ *  Defaults to NO.
+ */
+@property(nonatomic, assign) BOOL interpolate;
+
+/** The time step used when interpolate is YES. Defaults to 1/60 of a second. */
+@property(nonatomic, assign) CCTime fixedTimeStep;
+
+/**
+ *  The most physics steps taken for a single frame when interpolate is YES.
+ *  Time beyond this is dropped so a slow frame can't cause a spiral of ever longer frames.
+ *  Defaults to 8.
+ */
+@property(nonatomic, assign) int maxSubsteps;
+
 /** The delegate that is called when two physics bodies collide. */
 @property(nonatomic, assign) NSObject<CCPhysicsCollisionDelegate> *collisionDelegate;
 
@@ -312,6 +312,12 @@ static void PhysicsSeparate(cpArbiter *arb, cpSpace *space, CCPhysicsCollisionHa
 -(CCTime)sleepTimeThreshold {return _space.sleepTimeThreshold;}
 -(void)setSleepTimeThreshold:(CCTime)sleepTimeThreshold {_space.sleepTimeThreshold = sleepTimeThreshold;}
 
+-(CCTime)fixedTimeStep {return cpSpaceGetFixedTimeStep(_space.space);}
+-(void)setFixedTimeStep:(CCTime)fixedTimeStep {cpSpaceSetFixedTimeStep(_space.space, fixedTimeStep);}
+
+-(int)maxSubsteps {return cpSpaceGetMaxSubsteps(_space.space);}
+-(void)setMaxSubsteps:(int)maxSubsteps {cpSpaceSetMaxSubsteps(_space.space, maxSubsteps);}
+
 -(NSMutableSet*)kineticNodes
 {
     return _kineticNodes;
@@ -429,7 +435,7 @@ static void PhysicsSeparate(cpArbiter *arb, cpSpace *space, CCPhysicsCollisionHa
 	return NSIntegerMax;
 }
 
--(void)fixedUpdate:(CCTime)delta
+-(void)updateKineticNodes:(CCTime)delta
 {
     NSSet * tempKinetics = [_kineticNodes copy];
     for(CCNode * node in tempKinetics)
@@ -443,13 +449,35 @@ static void PhysicsSeparate(cpArbiter *arb, cpSpace *space, CCPhysicsCollisionHa
             [_kineticNodes removeObject:node];
         }
     }
-    
+}
+
+-(void)fixedUpdate:(CCTime)delta
+{
+	if(_interpolate) return;
+	
+	[self updateKineticNodes:delta];
 	[_space step:delta];
 	
 	// Null out the arbiter just in case somebody retained a pair.
 	_collisionPairSingleton->_arbiter = NULL;
 }
 
+-(void)update:(CCTime)delta
+{
+	if(!_interpolate) return;
+	
+	// Kinematic bodies need a velocity that covers their motion over the steps actually taken this frame.
+	// When no step is taken their transforms stay dirty and the motion is picked up by the next frame that steps.
+	cpSpace *space = _space.space;
+	int steps = cpSpaceGetFixedStepCount(space, delta);
+	if(steps > 0) [self updateKineticNodes:steps*cpSpaceGetFixedTimeStep(space)];
+	
+	cpSpaceStepFixed(space, delta);
+	
+	// Null out the arbiter just in case somebody retained a pair.
+	_collisionPairSingleton->_arbiter = NULL;
+}
+
 //MARK: Debug Drawing:
 const cpSpaceDebugColor CC_PHYSICS_SHAPE_DEBUG_FILL_COLOR_STATIC = {0.0, 0.0, 1.0, 0.8};
 const cpSpaceDebugColor CC_PHYSICS_SHAPE_DEBUG_FILL_COLOR_KINEMATIC = {1.0, 1.0, 0.0, 0.8};
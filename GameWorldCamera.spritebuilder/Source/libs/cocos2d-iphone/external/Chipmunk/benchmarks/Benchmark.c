@@ -0,0 +1,1233 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Headless benchmark scenes for cpSpaceStep() and the space queries.
+// Every scene is built from a fixed seed so runs on different machines and commits can be compared.
+//
+// Usage: chipmunk_benchmark [--steps N] [--threads N] [--contact-reuse DIST] [--sleep TIME] [--index TYPE] [--solver TYPE] [--scene NAME]...
+//                           [--save-positions PATH] [--compare-positions PATH] [--check-accuracy] [--tolerance DIST]
+//                           [--check-snapshots] [--check-queries] [--check-bulk-add] [--json PATH|-] [--list]
+// Configure with -DENABLE_STEP_STATS=ON to break the step times down by phase.
+//
+// To compare a float build against a double build, save the positions from one and compare them in the other:
+//   double/chipmunk_benchmark --save-positions double.txt
+//   float/chipmunk_benchmark --compare-positions double.txt
+// Pass --check-accuracy to both to run the steps the scenes' tolerances are measured for, and to fail when a scene drifts further.
+// The float_accuracy test run by ctest does this. The batched_solver test does the same with
+// --solver scalar and --solver batched to check the batched solver against the scalar one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+	#include <windows.h>
+#elif defined(__APPLE__)
+	#include <mach/mach_time.h>
+#else
+	#include <time.h>
+#endif
+
+#include "chipmunk/chipmunk.h"
+#include "chipmunk/cpHastySpace.h"
+#include "chipmunk/cpSpaceSnapshot.h"
+
+//MARK: Timing
+
+static double
+Nanoseconds(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return 1e9*(double)counter.QuadPart/(double)frequency.QuadPart;
+#elif defined(__APPLE__)
+	static mach_timebase_info_data_t timebase;
+	if(timebase.denom == 0) mach_timebase_info(&timebase);
+	return (double)mach_absolute_time()*timebase.numer/timebase.denom;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return 1e9*(double)now.tv_sec + (double)now.tv_nsec;
+#endif
+}
+
+//MARK: Random Numbers
+
+// rand() differs between C libraries, so use a fixed generator to build the same scenes everywhere.
+static unsigned int seed;
+
+static void
+SeedRandom(unsigned int value)
+{
+	seed = value;
+}
+
+static cpFloat
+Random(cpFloat min, cpFloat max)
+{
+	seed = seed*1664525u + 1013904223u;
+	return min + (max - min)*(cpFloat)(seed >> 8)/(cpFloat)(1u << 24);
+}
+
+//MARK: Scenes
+
+typedef struct Benchmark Benchmark;
+
+struct Benchmark {
+	const char *name;
+	// Builds the scene in an empty space.
+	void (*init)(Benchmark *benchmark, cpSpace *space);
+	// Optional work done after each step and timed as queries, such as raycasts.
+	void (*query)(Benchmark *benchmark, cpSpace *space);
+	int steps;
+	cpFloat dt;
+	
+	int queryCount;
+	
+	// Largest RMS distance a float build's bodies may drift from a double build's in ACCURACY_STEPS steps.
+	// Scenes with fast bouncing bodies diverge quickly, so theirs only catch bodies escaping the scene.
+	double accuracyTolerance;
+};
+
+// Steps run by --check-accuracy. The tolerances are measured for this many steps.
+#define ACCURACY_STEPS 120
+
+static const cpFloat dt60 = 1.0/60.0;
+
+static void
+AddGround(cpSpace *space, cpFloat width)
+{
+	cpShape *ground = cpSpaceAddShape(space, cpSegmentShapeNew(cpSpaceGetStaticBody(space), cpv(-width, 0), cpv(width, 0), 0.0f));
+	cpShapeSetFriction(ground, 1.0f);
+	cpShapeSetElasticity(ground, 0.0f);
+}
+
+static cpBody *
+AddBox(cpSpace *space, cpVect pos, cpFloat width, cpFloat height)
+{
+	cpFloat mass = 1.0f;
+	cpBody *body = cpSpaceAddBody(space, cpBodyNew(mass, cpMomentForBox(mass, width, height)));
+	cpBodySetPosition(body, pos);
+	
+	cpShape *shape = cpSpaceAddShape(space, cpBoxShapeNew(body, width, height, 0.0f));
+	cpShapeSetFriction(shape, 0.8f);
+	
+	return body;
+}
+
+static cpBody *
+AddCircle(cpSpace *space, cpVect pos, cpFloat radius)
+{
+	cpFloat mass = radius*radius/25.0f;
+	cpBody *body = cpSpaceAddBody(space, cpBodyNew(mass, cpMomentForCircle(mass, 0.0f, radius, cpvzero)));
+	cpBodySetPosition(body, pos);
+	
+	cpShape *shape = cpSpaceAddShape(space, cpCircleShapeNew(body, radius, cpvzero));
+	cpShapeSetFriction(shape, 0.7f);
+	cpShapeSetElasticity(shape, 0.1f);
+	
+	return body;
+}
+
+// A pyramid of boxes 40 wide, 820 boxes in all.
+static void
+InitPyramid(Benchmark *benchmark, cpSpace *space)
+{
+	cpSpaceSetIterations(space, 10);
+	cpSpaceSetGravity(space, cpv(0, -100));
+	AddGround(space, 1000.0f);
+	
+	int base = 40;
+	cpFloat size = 10.0f;
+	for(int row=0; row<base; row++){
+		for(int i=0; i<base - row; i++){
+			cpVect pos = cpv((i - (base - row - 1)*0.5f)*size*1.05f, size*0.5f + row*size);
+			AddBox(space, pos, size, size);
+		}
+	}
+}
+
+// 2000 circles of mixed sizes dropped into a bin.
+static void
+InitCirclePile(Benchmark *benchmark, cpSpace *space)
+{
+	cpSpaceSetIterations(space, 10);
+	cpSpaceSetGravity(space, cpv(0, -100));
+	
+	cpBody *staticBody = cpSpaceGetStaticBody(space);
+	cpVect bin[] = {cpv(-300, 600), cpv(-300, 0), cpv(300, 0), cpv(300, 600)};
+	for(int i=0; i<3; i++){
+		cpShape *wall = cpSpaceAddShape(space, cpSegmentShapeNew(staticBody, bin[i], bin[i + 1], 0.0f));
+		cpShapeSetFriction(wall, 1.0f);
+	}
+	
+	for(int i=0; i<2000; i++){
+		cpVect pos = cpv(Random(-280, 280), Random(20, 2000));
+		AddCircle(space, pos, Random(4, 8));
+	}
+}
+
+// 50 chains of 40 links joined with pivot joints, hanging from a ceiling and swinging into each other.
+static void
+InitPivotChains(Benchmark *benchmark, cpSpace *space)
+{
+	cpSpaceSetIterations(space, 30);
+	cpSpaceSetGravity(space, cpv(0, -100));
+	
+	cpBody *staticBody = cpSpaceGetStaticBody(space);
+	cpFloat length = 12.0f;
+	
+	for(int chain=0; chain<50; chain++){
+		cpVect anchor = cpv(chain*30.0f, 0.0f);
+		cpBody *prev = staticBody;
+		cpVect prevAnchor = anchor;
+		
+		// Alternate the swing direction so neighboring chains tangle.
+		cpFloat swing = (chain%2 ? 40.0f : -40.0f);
+		
+		for(int link=0; link<40; link++){
+			cpVect pos = cpvadd(anchor, cpv(0.0f, -(link + 0.5f)*length));
+			
+			cpFloat mass = 1.0f;
+			cpBody *body = cpSpaceAddBody(space, cpBodyNew(mass, cpMomentForBox(mass, 4.0f, length)));
+			cpBodySetPosition(body, pos);
+			cpBodySetVelocity(body, cpv(swing*link/40.0f, 0.0f));
+			
+			cpShape *shape = cpSpaceAddShape(space, cpBoxShapeNew(body, 4.0f, length, 0.0f));
+			cpShapeSetFriction(shape, 0.5f);
+			// Links of one chain don't collide with each other.
+			cpShapeSetFilter(shape, cpShapeFilterNew((cpGroup)(chain + 1), CP_ALL_CATEGORIES, CP_ALL_CATEGORIES));
+			
+			cpSpaceAddConstraint(space, cpPivotJointNew(prev, body, prevAnchor));
+			
+			prev = body;
+			prevAnchor = cpvadd(pos, cpv(0.0f, -length*0.5f));
+		}
+	}
+}
+
+// A 256x256 tile map with 40% of the tiles filled, and 1000 bodies bouncing around in it.
+// With bulk set the tiles are added in one cpSpaceAddShapes() call instead of one at a time.
+static void
+BuildTileMap(cpSpace *space, cpBool bulk)
+{
+	cpSpaceSetIterations(space, 10);
+	cpSpaceSetGravity(space, cpv(0, -100));
+	
+	cpBody *staticBody = cpSpaceGetStaticBody(space);
+	int tiles = 256;
+	cpFloat size = 16.0f;
+	
+	cpShape **shapes = (cpShape **)calloc(tiles*tiles, sizeof(cpShape *));
+	int count = 0;
+	
+	for(int y=0; y<tiles; y++){
+		for(int x=0; x<tiles; x++){
+			// Keep the border solid so nothing escapes.
+			cpBool border = (x == 0 || y == 0 || x == tiles - 1 || y == tiles - 1);
+			if(border || Random(0, 1) < 0.4f){
+				cpBB bb = cpBBNew(x*size, y*size, (x + 1)*size, (y + 1)*size);
+				cpShape *tile = cpBoxShapeNew2(staticBody, bb, 0.0f);
+				cpShapeSetFriction(tile, 1.0f);
+				cpShapeSetElasticity(tile, 0.5f);
+				
+				if(bulk){
+					shapes[count++] = tile;
+				} else {
+					cpSpaceAddShape(space, tile);
+				}
+			}
+		}
+	}
+	
+	if(bulk){
+		cpSpaceAddShapes(space, shapes, count);
+	} else {
+		cpSpaceOptimizeStatic(space);
+	}
+	
+	free(shapes);
+	
+	for(int i=0; i<1000; i++){
+		cpVect pos = cpv(Random(size, (tiles - 1)*size), Random(size, (tiles - 1)*size));
+		cpBody *body = (i%2 ? AddCircle(space, pos, 3.0f) : AddBox(space, pos, 5.0f, 5.0f));
+		cpBodySetVelocity(body, cpv(Random(-200, 200), Random(-200, 200)));
+	}
+}
+
+static void
+InitTileMap(Benchmark *benchmark, cpSpace *space)
+{
+	BuildTileMap(space, cpFalse);
+}
+
+static void
+InitTileMapBulk(Benchmark *benchmark, cpSpace *space)
+{
+	BuildTileMap(space, cpTrue);
+}
+
+// A random ray 400 units long inside the tile map.
+static void
+RandomRay(cpVect *start, cpVect *end)
+{
+	cpFloat extent = 256*16.0f;
+	(*start) = cpv(Random(0, extent), Random(0, extent));
+	(*end) = cpvadd(*start, cpvmult(cpvforangle(Random(0, 2.0f*(cpFloat)M_PI)), 400.0f));
+}
+
+// Casts a burst of rays through the tile map after every step.
+static void
+QueryRaycastStorm(Benchmark *benchmark, cpSpace *space)
+{
+	cpFloat hits = 0.0f;
+	
+	for(int i=0; i<benchmark->queryCount; i++){
+		cpVect start, end;
+		RandomRay(&start, &end);
+		
+		cpSegmentQueryInfo info;
+		if(cpSpaceSegmentQueryFirst(space, start, end, 0.0f, CP_SHAPE_FILTER_ALL, &info)) hits += info.alpha;
+	}
+	
+	// Keep the compiler from dropping the queries.
+	if(hits < 0.0f) printf("%f\n", hits);
+}
+
+// Set by --check-queries. Batched queries are repeated one at a time with cpSpaceSegmentQueryFirst(), and differences counted.
+static cpBool checkQueries = cpFalse;
+static int queryMismatches = 0;
+
+static void
+CheckSegmentQueryBatch(cpSpace *space, const cpSegmentQueryRequest *requests, int count, const cpSegmentQueryInfo *results)
+{
+	for(int i=0; i<count; i++){
+		const cpSegmentQueryRequest *request = requests + i;
+		cpSegmentQueryInfo info;
+		cpSpaceSegmentQueryFirst(space, request->start, request->end, request->radius, request->filter, &info);
+		
+		// Shapes hit at the same alpha may come back in either order, so only a hit and its alpha need to match.
+		if((info.shape == NULL) != (results[i].shape == NULL) || info.alpha != results[i].alpha) queryMismatches++;
+	}
+}
+
+// The same rays as raycast_storm, cast with cpSpaceSegmentQueryBatch().
+static void
+QueryRaycastBatch(Benchmark *benchmark, cpSpace *space)
+{
+	int count = benchmark->queryCount;
+	cpSegmentQueryRequest *requests = (cpSegmentQueryRequest *)calloc(count, sizeof(cpSegmentQueryRequest));
+	cpSegmentQueryInfo *results = (cpSegmentQueryInfo *)calloc(count, sizeof(cpSegmentQueryInfo));
+	
+	for(int i=0; i<count; i++){
+		cpSegmentQueryRequest *request = requests + i;
+		RandomRay(&request->start, &request->end);
+		request->radius = 0.0f;
+		request->filter = CP_SHAPE_FILTER_ALL;
+	}
+	
+	cpSpaceSegmentQueryBatch(space, requests, count, results);
+	
+	cpFloat hits = 0.0f;
+	for(int i=0; i<count; i++){
+		if(results[i].shape) hits += results[i].alpha;
+	}
+	
+	if(checkQueries){
+		CheckSegmentQueryBatch(space, requests, count, results);
+		
+		// Check segments with a radius too.
+		for(int i=0; i<count; i++) requests[i].radius = 4.0f;
+		cpSpaceSegmentQueryBatch(space, requests, count, results);
+		CheckSegmentQueryBatch(space, requests, count, results);
+	}
+	
+	free(requests);
+	free(results);
+	
+	// Keep the compiler from dropping the queries.
+	if(hits < 0.0f) printf("%f\n", hits);
+}
+
+// 200 fast bullets with continuous collision detection bouncing between thin walls.
+static void
+InitBullets(Benchmark *benchmark, cpSpace *space)
+{
+	cpSpaceSetIterations(space, 10);
+	
+	cpBody *staticBody = cpSpaceGetStaticBody(space);
+	cpFloat extent = 1000.0f;
+	
+	for(int i=0; i<=10; i++){
+		cpFloat x = i*extent/10.0f;
+		cpShape *vertical = cpSpaceAddShape(space, cpSegmentShapeNew(staticBody, cpv(x, 0.0f), cpv(x, extent), 0.0f));
+		cpShape *horizontal = cpSpaceAddShape(space, cpSegmentShapeNew(staticBody, cpv(0.0f, x), cpv(extent, x), 0.0f));
+		cpShapeSetElasticity(vertical, 1.0f);
+		cpShapeSetElasticity(horizontal, 1.0f);
+	}
+	
+	for(int i=0; i<200; i++){
+		cpFloat radius = 1.0f;
+		cpBody *body = cpSpaceAddBody(space, cpBodyNew(0.1f, cpMomentForCircle(0.1f, 0.0f, radius, cpvzero)));
+		cpBodySetPosition(body, cpv(Random(radius, extent - radius), Random(radius, extent - radius)));
+		// Fast enough to cross a whole cell of the grid in one step.
+		cpBodySetVelocity(body, cpvmult(cpvforangle(Random(0, 2.0f*(cpFloat)M_PI)), 6000.0f));
+		cpBodySetCCD(body, cpTrue);
+		
+		cpShape *shape = cpSpaceAddShape(space, cpCircleShapeNew(body, radius, cpvzero));
+		cpShapeSetElasticity(shape, 1.0f);
+		// Bullets pass through each other.
+		cpShapeSetFilter(shape, cpShapeFilterNew((cpGroup)1, CP_ALL_CATEGORIES, CP_ALL_CATEGORIES));
+	}
+}
+
+// Kinematic paddles stirring 600 boxes and circles in a bin, under wheels driven by motors against the static body.
+// The threaded solver shares the static and kinematic bodies between its threads.
+static void
+InitMixer(Benchmark *benchmark, cpSpace *space)
+{
+	cpSpaceSetIterations(space, 10);
+	cpSpaceSetGravity(space, cpv(0, -100));
+	
+	cpBody *staticBody = cpSpaceGetStaticBody(space);
+	cpVect bin[] = {cpv(-400, 1000), cpv(-400, 0), cpv(400, 0), cpv(400, 1000)};
+	for(int i=0; i<3; i++){
+		cpShape *wall = cpSpaceAddShape(space, cpSegmentShapeNew(staticBody, bin[i], bin[i + 1], 0.0f));
+		cpShapeSetFriction(wall, 1.0f);
+	}
+	
+	for(int i=0; i<4; i++){
+		cpBody *paddle = cpSpaceAddBody(space, cpBodyNewKinematic());
+		cpBodySetPosition(paddle, cpv(-300.0f + i*200.0f, 100.0f));
+		cpBodySetAngularVelocity(paddle, (i%2 ? 1.0f : -1.0f));
+		
+		cpShape *shape = cpSpaceAddShape(space, cpBoxShapeNew(paddle, 160.0f, 10.0f, 0.0f));
+		cpShapeSetFriction(shape, 0.8f);
+	}
+	
+	for(int i=0; i<4; i++){
+		cpVect pos = cpv(-300.0f + i*200.0f, 300.0f);
+		cpFloat mass = 10.0f, radius = 40.0f;
+		cpBody *wheel = cpSpaceAddBody(space, cpBodyNew(mass, cpMomentForCircle(mass, 0.0f, radius, cpvzero)));
+		cpBodySetPosition(wheel, pos);
+		
+		cpShape *shape = cpSpaceAddShape(space, cpCircleShapeNew(wheel, radius, cpvzero));
+		cpShapeSetFriction(shape, 0.8f);
+		
+		cpSpaceAddConstraint(space, cpPivotJointNew(staticBody, wheel, pos));
+		cpSpaceAddConstraint(space, cpSimpleMotorNew(staticBody, wheel, (i%2 ? 2.0f : -2.0f)));
+	}
+	
+	for(int i=0; i<600; i++){
+		cpVect pos = cpv(Random(-380, 380), Random(400, 900));
+		if(i%2) AddCircle(space, pos, 6.0f); else AddBox(space, pos, 10.0f, 10.0f);
+	}
+}
+
+static Benchmark benchmarks[] = {
+	{"pyramid", InitPyramid, NULL, 1000, dt60, 0, 1.0},
+	{"circle_pile", InitCirclePile, NULL, 1000, dt60, 0, 1.0},
+	{"pivot_chains", InitPivotChains, NULL, 1000, dt60, 0, 0.6},
+	{"tile_map", InitTileMap, NULL, 1000, dt60, 0, 4.0},
+	{"tile_map_bulk", InitTileMapBulk, NULL, 1000, dt60, 0, 4.0},
+	{"raycast_storm", InitTileMap, QueryRaycastStorm, 500, dt60, 2000, 4.0},
+	{"raycast_batch", InitTileMap, QueryRaycastBatch, 500, dt60, 2000, 4.0},
+	{"bullets", InitBullets, NULL, 1000, dt60, 0, 100.0},
+	{"mixer", InitMixer, NULL, 1000, dt60, 0, 1.0},
+};
+
+static const int benchmarkCount = sizeof(benchmarks)/sizeof(*benchmarks);
+
+//MARK: Running
+
+// Applied to every space, from the command line.
+static cpFloat contactReuseThreshold = 0.0f;
+static cpFloat sleepTimeThreshold = INFINITY;
+
+typedef enum IndexType {
+	INDEX_BBTREE,
+	INDEX_SWEEP_AND_PRUNE,
+	INDEX_HASH,
+} IndexType;
+
+static const char *indexNames[] = {"bbtree", "sap", "hash"};
+static const int indexCount = sizeof(indexNames)/sizeof(*indexNames);
+
+static IndexType indexType = INDEX_BBTREE;
+
+typedef enum SolverType {
+	SOLVER_HASTY,
+	SOLVER_SCALAR,
+	SOLVER_BATCHED,
+} SolverType;
+
+static const char *solverNames[] = {"hasty", "scalar", "batched"};
+static const int solverCount = sizeof(solverNames)/sizeof(*solverNames);
+
+static SolverType solverType = SOLVER_HASTY;
+
+#ifdef CP_SPACE_ENABLE_STEP_STATS
+// Apply a macro to every field of cpSpaceStepStats.
+#define STEP_STATS_FIELDS(__macro__) \
+	__macro__(integratePositions) __macro__(collide) __macro__(components) __macro__(filterArbiters) \
+	__macro__(preStep) __macro__(integrateVelocities) __macro__(solve) __macro__(callbacks) \
+	__macro__(pairsTested) __macro__(falsePairs) __macro__(leavesReinserted) __macro__(narrowPhaseHits) __macro__(pairsReused) __macro__(arbiters) __macro__(contacts) __macro__(constraints) \
+	__macro__(islandsWoken) __macro__(islandsSlept)
+#endif
+
+typedef struct Result {
+	Benchmark *benchmark;
+	int steps;
+	int bodies, shapes, constraints;
+	
+	double setupNS;
+	// Per step timings, sorted once the run is finished.
+	double *stepNS;
+	double queryNS;
+	
+	// Sum of the final body positions. Changes when the simulation does.
+	cpVect positionSum;
+	// cpSpaceGetChecksum() of the final body states.
+	uint64_t checksum;
+	
+	// Shape of the dynamic tree at the end of the run. Zeroed for other indexes.
+	cpBBTreeQuality tree;
+	// Sizes the dynamic hash settled on at the end of the run. Zeroed for other indexes.
+	cpSpaceHashSizing hash;
+	
+	// Final body positions in the order the scene created the bodies.
+	int positionCount;
+	cpVect *positions;
+	
+	// Distance from the positions loaded by --compare-positions. Negative when there was nothing to compare to.
+	double maxError, rmsError;
+	
+#ifdef CP_SPACE_ENABLE_STEP_STATS
+	// Sums of cpSpaceGetStepStats() over every step.
+	#define DECLARE_SUM(__field__) double __field__;
+	struct {STEP_STATS_FIELDS(DECLARE_SUM)} statsSum;
+#endif
+} Result;
+
+static void
+CountBody(cpBody *body, Result *result){result->bodies++;}
+static void
+CountShape(cpShape *shape, Result *result){result->shapes++;}
+static void
+CountConstraint(cpConstraint *constraint, Result *result){result->constraints++;}
+
+static void
+SumPosition(cpBody *body, Result *result)
+{
+	result->positionSum = cpvadd(result->positionSum, cpBodyGetPosition(body));
+}
+
+// Bodies are numbered once the scene is built since the iteration order changes as they fall asleep.
+static void
+NumberBody(cpBody *body, Result *result)
+{
+	cpBodySetUserData(body, (cpDataPointer)(intptr_t)++result->positionCount);
+}
+
+static void
+RecordPosition(cpBody *body, Result *result)
+{
+	intptr_t number = (intptr_t)cpBodyGetUserData(body);
+	if(number > 0) result->positions[number - 1] = cpBodyGetPosition(body);
+}
+
+static void ShapeFreeWrap(cpSpace *space, cpShape *shape, void *unused){cpSpaceRemoveShape(space, shape); cpShapeFree(shape);}
+static void PostShapeFree(cpShape *shape, cpSpace *space){cpSpaceAddPostStepCallback(space, (cpPostStepFunc)ShapeFreeWrap, shape, NULL);}
+
+static void ConstraintFreeWrap(cpSpace *space, cpConstraint *constraint, void *unused){cpSpaceRemoveConstraint(space, constraint); cpConstraintFree(constraint);}
+static void PostConstraintFree(cpConstraint *constraint, cpSpace *space){cpSpaceAddPostStepCallback(space, (cpPostStepFunc)ConstraintFreeWrap, constraint, NULL);}
+
+static void BodyFreeWrap(cpSpace *space, cpBody *body, void *unused){cpSpaceRemoveBody(space, body); cpBodyFree(body);}
+static void PostBodyFree(cpBody *body, cpSpace *space){cpSpaceAddPostStepCallback(space, (cpPostStepFunc)BodyFreeWrap, body, NULL);}
+
+static void
+FreeSpaceChildren(cpSpace *space)
+{
+	cpSpaceEachShape(space, (cpSpaceShapeIteratorFunc)PostShapeFree, space);
+	cpSpaceEachConstraint(space, (cpSpaceConstraintIteratorFunc)PostConstraintFree, space);
+	cpSpaceEachBody(space, (cpSpaceBodyIteratorFunc)PostBodyFree, space);
+}
+
+static int
+CompareDoubles(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// An empty space set up from the command line options.
+static cpSpace *
+NewSpace(unsigned long threads)
+{
+	cpSpace *space;
+	if(solverType == SOLVER_HASTY){
+		space = cpHastySpaceNew();
+		cpHastySpaceSetThreads(space, threads);
+	} else {
+		space = cpSpaceNew();
+		if(solverType == SOLVER_BATCHED) cpSpaceSetSolverType(space, CP_SPACE_SOLVER_BATCHED);
+	}
+	
+	cpSpaceSetContactReuseThreshold(space, contactReuseThreshold);
+	cpSpaceSetSleepTimeThreshold(space, sleepTimeThreshold);
+	if(indexType == INDEX_SWEEP_AND_PRUNE) cpSpaceUseSweepAndPrune(space);
+	// Let the hash pick its own sizes, starting from a small table.
+	if(indexType == INDEX_HASH) cpSpaceUseSpatialHash(space, 0.0f, 1000);
+	
+	return space;
+}
+
+static void
+StepSpace(cpSpace *space, cpFloat dt)
+{
+	if(solverType == SOLVER_HASTY){
+		cpHastySpaceStep(space, dt);
+	} else {
+		cpSpaceStep(space, dt);
+	}
+}
+
+// Free a space from NewSpace() along with everything in it.
+static void
+FreeSpace(cpSpace *space)
+{
+	FreeSpaceChildren(space);
+	if(solverType == SOLVER_HASTY){
+		cpHastySpaceFree(space);
+	} else {
+		cpSpaceFree(space);
+	}
+}
+
+static void
+RunBenchmark(Benchmark *benchmark, int steps, unsigned long threads, Result *result)
+{
+	memset(result, 0, sizeof(Result));
+	result->benchmark = benchmark;
+	result->steps = steps;
+	result->stepNS = (double *)calloc(steps, sizeof(double));
+	
+	SeedRandom(5489u);
+	
+	double start = Nanoseconds();
+	cpSpace *space = NewSpace(threads);
+	benchmark->init(benchmark, space);
+	result->setupNS = Nanoseconds() - start;
+	
+	cpSpaceEachBody(space, (cpSpaceBodyIteratorFunc)NumberBody, result);
+	result->positions = (cpVect *)calloc(result->positionCount, sizeof(cpVect));
+	result->maxError = result->rmsError = -1.0;
+	
+	for(int i=0; i<steps; i++){
+		start = Nanoseconds();
+		StepSpace(space, benchmark->dt);
+		result->stepNS[i] = Nanoseconds() - start;
+		
+#ifdef CP_SPACE_ENABLE_STEP_STATS
+		cpSpaceStepStats stats;
+		cpSpaceGetStepStats(space, &stats);
+		
+		#define ADD_STAT(__field__) result->statsSum.__field__ += stats.__field__;
+		STEP_STATS_FIELDS(ADD_STAT)
+#endif
+		
+		if(benchmark->query){
+			start = Nanoseconds();
+			benchmark->query(benchmark, space);
+			result->queryNS += Nanoseconds() - start;
+		}
+	}
+	
+	cpSpaceEachBody(space, (cpSpaceBodyIteratorFunc)CountBody, result);
+	cpSpaceEachShape(space, (cpSpaceShapeIteratorFunc)CountShape, result);
+	cpSpaceEachConstraint(space, (cpSpaceConstraintIteratorFunc)CountConstraint, result);
+	cpSpaceEachBody(space, (cpSpaceBodyIteratorFunc)SumPosition, result);
+	result->checksum = cpSpaceGetChecksum(space);
+	cpSpaceEachBody(space, (cpSpaceBodyIteratorFunc)RecordPosition, result);
+	if(indexType == INDEX_BBTREE) cpSpaceGetTreeQuality(space, &result->tree);
+	if(indexType == INDEX_HASH) cpSpaceGetHashSizing(space, &result->hash);
+	
+	FreeSpace(space);
+	
+	qsort(result->stepNS, steps, sizeof(double), CompareDoubles);
+}
+
+//MARK: Snapshots
+
+static cpBool
+WriteAndRestore(cpSpace *space, cpSpace *copy, void **buffer, size_t *capacity)
+{
+	size_t size = cpSpaceWriteSnapshot(space, NULL, 0);
+	if(size > *capacity){
+		(*capacity) = size;
+		(*buffer) = realloc(*buffer, size);
+	}
+	
+	cpSpaceWriteSnapshot(space, *buffer, size);
+	return cpSpaceRestoreSnapshot(copy, *buffer, size);
+}
+
+// Snapshot the scene before its first step and again halfway through, restore each snapshot into a new space,
+// and step it alongside the original. Returns false if a restore fails or the checksums ever differ.
+static cpBool
+CheckSnapshots(Benchmark *benchmark, int steps, unsigned long threads)
+{
+	SeedRandom(5489u);
+	cpSpace *space = NewSpace(threads);
+	benchmark->init(benchmark, space);
+	
+	cpSpace *copy = NULL;
+	void *buffer = NULL;
+	size_t capacity = 0;
+	cpBool ok = cpTrue;
+	
+	for(int i=0; i<steps && ok; i++){
+		if(i == 0 || i == steps/2){
+			if(copy) FreeSpace(copy);
+			copy = NewSpace(threads);
+			
+			if(!WriteAndRestore(space, copy, &buffer, &capacity)){
+				fprintf(stderr, "Could not restore the snapshot of '%s' written before step %d.\n", benchmark->name, i + 1);
+				ok = cpFalse;
+				break;
+			}
+		}
+		
+		StepSpace(space, benchmark->dt);
+		StepSpace(copy, benchmark->dt);
+		
+		if(cpSpaceGetChecksum(space) != cpSpaceGetChecksum(copy)){
+			fprintf(stderr, "The space restored from a snapshot of '%s' diverged on step %d.\n", benchmark->name, i + 1);
+			ok = cpFalse;
+		}
+	}
+	
+	if(copy) FreeSpace(copy);
+	FreeSpace(space);
+	free(buffer);
+	
+	return ok;
+}
+
+//MARK: Bulk Adding
+
+// Build the tile map one shape at a time and with cpSpaceAddShapes(), step both, and cast the same rays through both.
+// Returns false if the checksums or ray hits ever differ.
+static cpBool
+CheckBulkAdd(Benchmark *single, Benchmark *bulk, int steps, unsigned long threads)
+{
+	SeedRandom(5489u);
+	cpSpace *space = NewSpace(threads);
+	single->init(single, space);
+	
+	SeedRandom(5489u);
+	cpSpace *copy = NewSpace(threads);
+	bulk->init(bulk, copy);
+	
+	cpBool ok = cpTrue;
+	
+	for(int i=0; i<steps && ok; i++){
+		StepSpace(space, single->dt);
+		StepSpace(copy, bulk->dt);
+		
+		if(cpSpaceGetChecksum(space) != cpSpaceGetChecksum(copy)){
+			fprintf(stderr, "The bulk added tile map diverged on step %d.\n", i + 1);
+			ok = cpFalse;
+		}
+		
+		for(int j=0; j<100; j++){
+			cpVect start, end;
+			RandomRay(&start, &end);
+			
+			cpSegmentQueryInfo a, b;
+			cpShape *hitA = cpSpaceSegmentQueryFirst(space, start, end, 0.0f, CP_SHAPE_FILTER_ALL, &a);
+			cpShape *hitB = cpSpaceSegmentQueryFirst(copy, start, end, 0.0f, CP_SHAPE_FILTER_ALL, &b);
+			
+			if(!hitA != !hitB || a.alpha != b.alpha || !cpveql(a.point, b.point)){
+				fprintf(stderr, "A ray through the bulk added tile map hit something else on step %d.\n", i + 1);
+				ok = cpFalse;
+				break;
+			}
+		}
+	}
+	
+	FreeSpace(copy);
+	FreeSpace(space);
+	
+	return ok;
+}
+
+static double
+MeanStep(Result *result)
+{
+	double sum = 0.0;
+	for(int i=0; i<result->steps; i++) sum += result->stepNS[i];
+	return sum/result->steps;
+}
+
+static double
+Percentile(Result *result, double percent)
+{
+	int index = (int)(percent/100.0*(result->steps - 1) + 0.5);
+	return result->stepNS[index];
+}
+
+static double
+QueryNSPerRay(Result *result)
+{
+	int rays = result->steps*result->benchmark->queryCount;
+	return (rays ? result->queryNS/rays : 0.0);
+}
+
+//MARK: Positions
+
+// One block per scene: a "scene NAME COUNT" line followed by COUNT "x y" lines.
+static cpBool
+SavePositions(const char *path, Result *results, int count)
+{
+	FILE *file = fopen(path, "w");
+	if(!file) return cpFalse;
+	
+	for(int i=0; i<count; i++){
+		Result *r = results + i;
+		fprintf(file, "scene %s %d\n", r->benchmark->name, r->positionCount);
+		for(int j=0; j<r->positionCount; j++) fprintf(file, "%.17g %.17g\n", (double)r->positions[j].x, (double)r->positions[j].y);
+	}
+	
+	fclose(file);
+	return cpTrue;
+}
+
+// Fill in the errors of the results that have a matching scene in the file.
+static cpBool
+ComparePositions(const char *path, Result *results, int count)
+{
+	FILE *file = fopen(path, "r");
+	if(!file) return cpFalse;
+	
+	char name[64];
+	int positionCount;
+	while(fscanf(file, " scene %63s %d", name, &positionCount) == 2){
+		Result *match = NULL;
+		for(int i=0; i<count; i++){
+			Result *r = results + i;
+			if(strcmp(name, r->benchmark->name) == 0 && positionCount == r->positionCount) match = r;
+		}
+		
+		double maxError = 0.0, sumSq = 0.0;
+		for(int j=0; j<positionCount; j++){
+			double x, y;
+			if(fscanf(file, " %lf %lf", &x, &y) != 2){
+				fclose(file);
+				return cpFalse;
+			}
+			
+			if(match){
+				double dx = x - match->positions[j].x, dy = y - match->positions[j].y;
+				double distSq = dx*dx + dy*dy;
+				
+				sumSq += distSq;
+				if(distSq > maxError*maxError) maxError = sqrt(distSq);
+			}
+		}
+		
+		if(match){
+			match->maxError = maxError;
+			match->rmsError = (positionCount ? sqrt(sumSq/positionCount) : 0.0);
+		}
+	}
+	
+	cpBool ok = feof(file);
+	fclose(file);
+	return ok;
+}
+
+// Returns false if a scene drifted further than its tolerance, or had nothing to compare to.
+// A positive tolerance replaces the scenes' own.
+static cpBool
+CheckAccuracy(Result *results, int count, double tolerance)
+{
+	cpBool ok = cpTrue;
+	
+	for(int i=0; i<count; i++){
+		Result *r = results + i;
+		double allowed = (tolerance > 0.0 ? tolerance : r->benchmark->accuracyTolerance);
+		
+		if(r->maxError < 0.0){
+			fprintf(stderr, "No positions to compare '%s' to.\n", r->benchmark->name);
+			ok = cpFalse;
+		} else if(r->rmsError > allowed){
+			fprintf(stderr, "'%s' drifted %g RMS from the compared positions, more than its tolerance of %g.\n",
+				r->benchmark->name, r->rmsError, allowed
+			);
+			ok = cpFalse;
+		}
+	}
+	
+	return ok;
+}
+
+//MARK: Output
+
+static const char *
+FloatTypeName(void)
+{
+	return (sizeof(cpFloat) == sizeof(float) ? "float" : "double");
+}
+
+static void
+PrintTable(Result *results, int count, cpBool compared)
+{
+	printf("cpFloat is %s, shapes are in a %s index, contacts use the %s solver.\n", FloatTypeName(), indexNames[indexType], solverNames[solverType]);
+	printf("%-14s %6s %6s %12s %12s %12s %12s\n", "scene", "bodies", "steps", "mean ns", "p50 ns", "p95 ns", "ns/query");
+	for(int i=0; i<count; i++){
+		Result *r = results + i;
+		printf("%-14s %6d %6d %12.0f %12.0f %12.0f %12.1f\n",
+			r->benchmark->name, r->bodies, r->steps,
+			MeanStep(r), Percentile(r, 50), Percentile(r, 95), QueryNSPerRay(r)
+		);
+	}
+	
+#ifdef CP_SPACE_ENABLE_STEP_STATS
+	printf("\nMean ns per step by phase:\n");
+	printf("%-14s %10s %10s %10s %10s %10s %10s %10s %10s\n", "scene", "integrate", "collide", "components", "filter", "prestep", "velocity", "solve", "callbacks");
+	for(int i=0; i<count; i++){
+		Result *r = results + i;
+		double ns = 1e9/r->steps;
+		printf("%-14s %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f\n", r->benchmark->name,
+			ns*r->statsSum.integratePositions, ns*r->statsSum.collide, ns*r->statsSum.components, ns*r->statsSum.filterArbiters,
+			ns*r->statsSum.preStep, ns*r->statsSum.integrateVelocities, ns*r->statsSum.solve, ns*r->statsSum.callbacks
+		);
+	}
+#endif
+	
+	if(indexType == INDEX_HASH){
+		printf("\nSizes the dynamic hash settled on:\n");
+		printf("%-14s %12s %12s %12s\n", "scene", "cell dim", "cells", "resizes");
+		for(int i=0; i<count; i++){
+			Result *r = results + i;
+			printf("%-14s %12.4g %12d %12d\n", r->benchmark->name, (double)r->hash.celldim, r->hash.numcells, r->hash.resizes);
+		}
+	}
+	
+	if(compared){
+		printf("\nDistance from the compared positions:\n");
+		printf("%-14s %12s %12s\n", "scene", "max", "rms");
+		for(int i=0; i<count; i++){
+			Result *r = results + i;
+			if(r->maxError < 0.0){
+				printf("%-14s %12s %12s\n", r->benchmark->name, "-", "-");
+			} else {
+				printf("%-14s %12.6g %12.6g\n", r->benchmark->name, r->maxError, r->rmsError);
+			}
+		}
+	}
+}
+
+static void
+WriteJSON(FILE *file, Result *results, int count, unsigned long threads)
+{
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"version\": \"%s\",\n", cpVersionString);
+	fprintf(file, "\t\"float_type\": \"%s\",\n", FloatTypeName());
+	fprintf(file, "\t\"threads\": %lu,\n", threads);
+	fprintf(file, "\t\"index\": \"%s\",\n", indexNames[indexType]);
+	fprintf(file, "\t\"solver\": \"%s\",\n", solverNames[solverType]);
+	fprintf(file, "\t\"contact_reuse_threshold\": %.17g,\n", (double)contactReuseThreshold);
+	fprintf(file, "\t\"scenes\": [\n");
+	
+	for(int i=0; i<count; i++){
+		Result *r = results + i;
+		fprintf(file, "\t\t{\n");
+		fprintf(file, "\t\t\t\"name\": \"%s\",\n", r->benchmark->name);
+		fprintf(file, "\t\t\t\"steps\": %d,\n", r->steps);
+		fprintf(file, "\t\t\t\"dt\": %.17g,\n", (double)r->benchmark->dt);
+		fprintf(file, "\t\t\t\"bodies\": %d,\n", r->bodies);
+		fprintf(file, "\t\t\t\"shapes\": %d,\n", r->shapes);
+		fprintf(file, "\t\t\t\"constraints\": %d,\n", r->constraints);
+		fprintf(file, "\t\t\t\"setup_ns\": %.0f,\n", r->setupNS);
+		fprintf(file, "\t\t\t\"step_ns\": {\"mean\": %.0f, \"min\": %.0f, \"p50\": %.0f, \"p95\": %.0f, \"max\": %.0f},\n",
+			MeanStep(r), r->stepNS[0], Percentile(r, 50), Percentile(r, 95), r->stepNS[r->steps - 1]
+		);
+		fprintf(file, "\t\t\t\"queries_per_step\": %d,\n", r->benchmark->queryCount);
+		fprintf(file, "\t\t\t\"query_ns\": %.1f,\n", QueryNSPerRay(r));
+#ifdef CP_SPACE_ENABLE_STEP_STATS
+		// Means per step. Phases are in nanoseconds.
+		double ns = 1e9/r->steps;
+		fprintf(file, "\t\t\t\"phase_ns\": {\"integrate_positions\": %.0f, \"collide\": %.0f, \"components\": %.0f, \"filter_arbiters\": %.0f, "
+			"\"prestep\": %.0f, \"integrate_velocities\": %.0f, \"solve\": %.0f, \"callbacks\": %.0f},\n",
+			ns*r->statsSum.integratePositions, ns*r->statsSum.collide, ns*r->statsSum.components, ns*r->statsSum.filterArbiters,
+			ns*r->statsSum.preStep, ns*r->statsSum.integrateVelocities, ns*r->statsSum.solve, ns*r->statsSum.callbacks
+		);
+		
+		double n = 1.0/r->steps;
+		fprintf(file, "\t\t\t\"counters\": {\"pairs_tested\": %.1f, \"false_pairs\": %.1f, \"leaves_reinserted\": %.1f, \"narrow_phase_hits\": %.1f, "
+			"\"pairs_reused\": %.1f, \"arbiters\": %.1f, \"contacts\": %.1f, \"constraints\": %.1f, \"islands_woken\": %.3f, \"islands_slept\": %.3f},\n",
+			n*r->statsSum.pairsTested, n*r->statsSum.falsePairs, n*r->statsSum.leavesReinserted, n*r->statsSum.narrowPhaseHits, n*r->statsSum.pairsReused, n*r->statsSum.arbiters, n*r->statsSum.contacts,
+			n*r->statsSum.constraints, n*r->statsSum.islandsWoken, n*r->statsSum.islandsSlept
+		);
+#endif
+		if(r->maxError >= 0.0){
+			fprintf(file, "\t\t\t\"position_error\": {\"max\": %.17g, \"rms\": %.17g},\n", r->maxError, r->rmsError);
+		}
+		if(indexType == INDEX_BBTREE){
+			fprintf(file, "\t\t\t\"tree\": {\"leaves\": %d, \"area_ratio\": %.3f, \"average_depth\": %.3f, \"max_depth\": %d},\n",
+				r->tree.leaves, (r->tree.rootArea > 0.0f ? (double)(r->tree.internalArea/r->tree.rootArea) : 0.0), (double)r->tree.averageDepth, r->tree.maxDepth
+			);
+		}
+		if(indexType == INDEX_HASH){
+			fprintf(file, "\t\t\t\"hash\": {\"cell_dim\": %.17g, \"cells\": %d, \"resizes\": %d},\n",
+				(double)r->hash.celldim, r->hash.numcells, r->hash.resizes
+			);
+		}
+		fprintf(file, "\t\t\t\"checksum\": \"%016llx\",\n", (unsigned long long)r->checksum);
+		fprintf(file, "\t\t\t\"position_sum\": [%.17g, %.17g]\n", (double)r->positionSum.x, (double)r->positionSum.y);
+		fprintf(file, "\t\t}%s\n", (i < count - 1 ? "," : ""));
+	}
+	
+	fprintf(file, "\t]\n");
+	fprintf(file, "}\n");
+}
+
+static void
+PrintUsage(const char *program)
+{
+	fprintf(stderr, "Usage: %s [--steps N] [--threads N] [--contact-reuse DIST] [--sleep TIME] [--index TYPE] [--solver TYPE] [--scene NAME]...\n", program);
+	fprintf(stderr, "       [--save-positions PATH] [--compare-positions PATH] [--check-accuracy] [--tolerance DIST] [--check-snapshots] [--check-queries]\n");
+	fprintf(stderr, "       [--check-bulk-add] [--json PATH|-] [--list]\n");
+	fprintf(stderr, "  --steps N    Run N steps of every scene instead of the scene's default.\n");
+	fprintf(stderr, "  --threads N  Step the spaces with N threads. Defaults to 1. Only the hasty solver uses threads.\n");
+	fprintf(stderr, "  --contact-reuse DIST\n");
+	fprintf(stderr, "               Reuse resting contacts that drifted less than DIST. See cpSpaceSetContactReuseThreshold().\n");
+	fprintf(stderr, "  --sleep TIME Let bodies sleep after resting for TIME seconds. See cpSpaceSetSleepTimeThreshold().\n");
+	fprintf(stderr, "  --index TYPE Put the shapes of every scene in a 'bbtree' (the default) or 'sap' (cpSpaceUseSweepAndPrune()) index,\n");
+	fprintf(stderr, "               or a 'hash' that picks its own sizes (cpSpaceUseSpatialHash() with a cell size of 0).\n");
+	fprintf(stderr, "  --solver TYPE\n");
+	fprintf(stderr, "               Step the scenes in a cpHastySpace ('hasty', the default), or in a cpSpace with\n");
+	fprintf(stderr, "               the 'scalar' or 'batched' solver (cpSpaceSetSolverType()).\n");
+	fprintf(stderr, "  --scene NAME Only run the named scene. Can be repeated.\n");
+	fprintf(stderr, "  --save-positions PATH\n");
+	fprintf(stderr, "               Write the final body positions to PATH.\n");
+	fprintf(stderr, "  --compare-positions PATH\n");
+	fprintf(stderr, "               Report how far the final body positions are from the ones saved in PATH, such as by a double build.\n");
+	fprintf(stderr, "  --check-accuracy\n");
+	fprintf(stderr, "               Run %d steps of every scene, which the scenes' tolerances are measured for.\n", ACCURACY_STEPS);
+	fprintf(stderr, "               Exit with an error if a scene drifted further from the compared positions than it allows.\n");
+	fprintf(stderr, "  --tolerance DIST\n");
+	fprintf(stderr, "               Allow every scene to drift DIST RMS with --check-accuracy instead of its own tolerance.\n");
+	fprintf(stderr, "  --check-snapshots\n");
+	fprintf(stderr, "               Instead of timing the scenes, restore snapshots of them taken before the first step and halfway through\n");
+	fprintf(stderr, "               and exit with an error if the restored spaces don't step identically to the originals.\n");
+	fprintf(stderr, "  --check-queries\n");
+	fprintf(stderr, "               Repeat batched queries with cpSpaceSegmentQueryFirst() and exit with an error if any result differs.\n");
+	fprintf(stderr, "  --check-bulk-add\n");
+	fprintf(stderr, "               Instead of timing the scenes, step tile_map alongside tile_map_bulk, which adds its tiles with cpSpaceAddShapes(),\n");
+	fprintf(stderr, "               and exit with an error if their checksums or ray hits ever differ.\n");
+	fprintf(stderr, "  --json PATH  Write the results as JSON to PATH, or to stdout for '-'.\n");
+	fprintf(stderr, "  --list       List the scenes and exit.\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	int steps = 0;
+	unsigned long threads = 1;
+	const char *jsonPath = NULL;
+	const char *savePath = NULL, *comparePath = NULL;
+	cpBool checkAccuracy = cpFalse;
+	double tolerance = 0.0;
+	cpBool checkSnapshots = cpFalse;
+	cpBool checkBulkAdd = cpFalse;
+	
+	cpBool selected[sizeof(benchmarks)/sizeof(*benchmarks)] = {};
+	cpBool anySelected = cpFalse;
+	
+	for(int i=1; i<argc; i++){
+		const char *arg = argv[i];
+		const char *value = (i + 1 < argc ? argv[i + 1] : NULL);
+		
+		if(strcmp(arg, "--list") == 0){
+			for(int j=0; j<benchmarkCount; j++) printf("%s\n", benchmarks[j].name);
+			return 0;
+		} else if(value && strcmp(arg, "--steps") == 0){
+			steps = atoi(value); i++;
+		} else if(value && strcmp(arg, "--threads") == 0){
+			threads = strtoul(value, NULL, 10); i++;
+		} else if(value && strcmp(arg, "--contact-reuse") == 0){
+			contactReuseThreshold = atof(value); i++;
+		} else if(value && strcmp(arg, "--index") == 0){
+			cpBool found = cpFalse;
+			for(int j=0; j<indexCount; j++){
+				if(strcmp(value, indexNames[j]) == 0){
+					indexType = (IndexType)j;
+					found = cpTrue;
+				}
+			}
+			
+			if(!found){
+				fprintf(stderr, "Unknown index '%s'.\n", value);
+				PrintUsage(argv[0]);
+				return 1;
+			}
+			
+			i++;
+		} else if(value && strcmp(arg, "--solver") == 0){
+			cpBool found = cpFalse;
+			for(int j=0; j<solverCount; j++){
+				if(strcmp(value, solverNames[j]) == 0){
+					solverType = (SolverType)j;
+					found = cpTrue;
+				}
+			}
+			
+			if(!found){
+				fprintf(stderr, "Unknown solver '%s'.\n", value);
+				PrintUsage(argv[0]);
+				return 1;
+			}
+			
+			i++;
+		} else if(value && strcmp(arg, "--json") == 0){
+			jsonPath = value; i++;
+		} else if(value && strcmp(arg, "--save-positions") == 0){
+			savePath = value; i++;
+		} else if(value && strcmp(arg, "--compare-positions") == 0){
+			comparePath = value; i++;
+		} else if(strcmp(arg, "--check-accuracy") == 0){
+			checkAccuracy = cpTrue;
+		} else if(value && strcmp(arg, "--sleep") == 0){
+			sleepTimeThreshold = atof(value); i++;
+		} else if(strcmp(arg, "--check-snapshots") == 0){
+			checkSnapshots = cpTrue;
+		} else if(strcmp(arg, "--check-queries") == 0){
+			checkQueries = cpTrue;
+		} else if(strcmp(arg, "--check-bulk-add") == 0){
+			checkBulkAdd = cpTrue;
+		} else if(value && strcmp(arg, "--tolerance") == 0){
+			tolerance = atof(value); i++;
+		} else if(value && strcmp(arg, "--scene") == 0){
+			cpBool found = cpFalse;
+			for(int j=0; j<benchmarkCount; j++){
+				if(strcmp(value, benchmarks[j].name) == 0) selected[j] = found = cpTrue;
+			}
+			
+			if(!found){
+				fprintf(stderr, "Unknown scene '%s'. Use --list to see the scenes.\n", value);
+				return 1;
+			}
+			
+			anySelected = cpTrue;
+			i++;
+		} else {
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+	
+	if(steps < 0 || threads < 1 || (threads > 1 && solverType != SOLVER_HASTY)){
+		PrintUsage(argv[0]);
+		return 1;
+	}
+	
+	if(checkAccuracy && !steps) steps = ACCURACY_STEPS;
+	
+	if(checkSnapshots){
+		cpBool ok = cpTrue;
+		for(int i=0; i<benchmarkCount; i++){
+			if(anySelected && !selected[i]) continue;
+			
+			Benchmark *benchmark = benchmarks + i;
+			cpBool identical = CheckSnapshots(benchmark, (steps ? steps : benchmark->steps), threads);
+			printf("%-14s %s\n", benchmark->name, (identical ? "identical" : "diverged"));
+			ok = ok && identical;
+		}
+		
+		return (ok ? 0 : 2);
+	}
+	
+	if(checkBulkAdd){
+		Benchmark *single = NULL, *bulk = NULL;
+		for(int i=0; i<benchmarkCount; i++){
+			if(strcmp(benchmarks[i].name, "tile_map") == 0) single = benchmarks + i;
+			if(strcmp(benchmarks[i].name, "tile_map_bulk") == 0) bulk = benchmarks + i;
+		}
+		
+		cpBool identical = CheckBulkAdd(single, bulk, (steps ? steps : bulk->steps), threads);
+		printf("%-14s %s\n", bulk->name, (identical ? "identical" : "diverged"));
+		return (identical ? 0 : 2);
+	}
+	
+	Result results[sizeof(benchmarks)/sizeof(*benchmarks)];
+	int count = 0;
+	
+	for(int i=0; i<benchmarkCount; i++){
+		if(anySelected && !selected[i]) continue;
+		
+		Benchmark *benchmark = benchmarks + i;
+		RunBenchmark(benchmark, (steps ? steps : benchmark->steps), threads, results + count);
+		count++;
+	}
+	
+	if(savePath && !SavePositions(savePath, results, count)){
+		fprintf(stderr, "Could not write the positions to '%s'.\n", savePath);
+		return 1;
+	}
+	
+	if(comparePath && !ComparePositions(comparePath, results, count)){
+		fprintf(stderr, "Could not read the positions from '%s'.\n", comparePath);
+		return 1;
+	}
+	
+	// Keep stdout clean for the JSON when it's written there.
+	cpBool jsonToStdout = (jsonPath && strcmp(jsonPath, "-") == 0);
+	if(!jsonToStdout) PrintTable(results, count, comparePath != NULL);
+	
+	if(jsonPath){
+		FILE *file = (jsonToStdout ? stdout : fopen(jsonPath, "w"));
+		if(!file){
+			fprintf(stderr, "Could not open '%s' for writing.\n", jsonPath);
+			return 1;
+		}
+		
+		WriteJSON(file, results, count, threads);
+		if(!jsonToStdout) fclose(file);
+	}
+	
+	cpBool accurate = (!checkAccuracy || !comparePath || CheckAccuracy(results, count, tolerance));
+	
+	if(queryMismatches){
+		fprintf(stderr, "%d batched queries differed from cpSpaceSegmentQueryFirst().\n", queryMismatches);
+		accurate = cpFalse;
+	}
+	
+	for(int i=0; i<count; i++){
+		free(results[i].stepNS);
+		free(results[i].positions);
+	}
+	return (accurate ? 0 : 2);
+}
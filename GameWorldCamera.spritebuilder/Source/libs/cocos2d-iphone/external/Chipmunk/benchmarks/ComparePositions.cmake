@@ -0,0 +1,22 @@
+# Run by ctest as the float_accuracy and batched_solver tests.
+# Saves the final body positions of a reference run of the benchmark, then fails if a second run's drift too far from them.
+# REFERENCE and COMPARED are the benchmark programs. REFERENCE_ARGS and COMPARED_ARGS are extra space separated arguments for them.
+
+separate_arguments(REFERENCE_ARGS)
+separate_arguments(COMPARED_ARGS)
+
+execute_process(
+  COMMAND ${REFERENCE} ${REFERENCE_ARGS} --check-accuracy --save-positions ${POSITIONS}
+  RESULT_VARIABLE result OUTPUT_QUIET
+)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "The reference run of the benchmark failed: ${result}")
+endif()
+
+execute_process(
+  COMMAND ${COMPARED} ${COMPARED_ARGS} --check-accuracy --compare-positions ${POSITIONS}
+  RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "The compared run drifted further from the reference run than the scenes allow.")
+endif()
@@ -0,0 +1,115 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Measures cpHashSet lookup throughput with the same keys and equality test
+// that cpSpace uses for its arbiter cache.
+// Usage: HashSetBench [lookups]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+typedef struct Pair {
+	void *a, *b;
+} Pair;
+
+static cpBool
+PairEql(void **key, Pair *pair)
+{
+	void *a = key[0];
+	void *b = key[1];
+	
+	return ((a == pair->a && b == pair->b) || (b == pair->a && a == pair->b));
+}
+
+static double
+Seconds(void)
+{
+	return (double)clock()/(double)CLOCKS_PER_SEC;
+}
+
+// Shapes are allocated in one block like they would be by a game, so the keys are
+// pointers with their low bits clear.
+typedef struct FakeShape {
+	char bytes[sizeof(cpPolyShape)];
+} FakeShape;
+
+static void
+RunBenchmark(int count, int lookups)
+{
+	FakeShape *shapes = (FakeShape *)cpcalloc(count, sizeof(FakeShape));
+	Pair *pairs = (Pair *)cpcalloc(count, sizeof(Pair));
+	int *order = (int *)cpcalloc(lookups, sizeof(int));
+	
+	cpHashSet *set = cpHashSetNew(0, (cpHashSetEqlFunc)PairEql);
+	
+	// Each shape touches a couple of its neighbors, like a pile of boxes.
+	for(int i=0; i<count; i++){
+		pairs[i].a = shapes + i;
+		pairs[i].b = shapes + (i + 1 + rand()%4)%count;
+		
+		cpHashValue hash = CP_HASH_PAIR((cpHashValue)pairs[i].a, (cpHashValue)pairs[i].b);
+		cpHashSetInsert(set, hash, &pairs[i], NULL, &pairs[i]);
+	}
+	
+	for(int i=0; i<lookups; i++) order[i] = rand()%count;
+	
+	// Hits, like a persistent contact finding its cached arbiter.
+	double start = Seconds();
+	uintptr_t sum = 0;
+	for(int i=0; i<lookups; i++){
+		Pair *pair = pairs + order[i];
+		void *key[] = {pair->b, pair->a};
+		sum += (uintptr_t)cpHashSetFind(set, CP_HASH_PAIR((cpHashValue)key[0], (cpHashValue)key[1]), key);
+	}
+	double hitTime = Seconds() - start;
+	
+	// Misses, like a new contact.
+	start = Seconds();
+	for(int i=0; i<lookups; i++){
+		void *key[] = {shapes + order[i], shapes + (order[i] + 7)%count};
+		sum += (uintptr_t)cpHashSetFind(set, CP_HASH_PAIR((cpHashValue)key[0], (cpHashValue)key[1]), key);
+	}
+	double missTime = Seconds() - start;
+	
+	printf("%7d arbiters: %6.1f ns/hit %6.1f ns/miss (%d entries, checksum %x)\n",
+		count, 1e9*hitTime/lookups, 1e9*missTime/lookups, cpHashSetCount(set), (unsigned int)(sum & 0xFF));
+	
+	cpHashSetFree(set);
+	cpfree(order);
+	cpfree(pairs);
+	cpfree(shapes);
+}
+
+int
+main(int argc, char **argv)
+{
+	int lookups = (argc > 1 ? atoi(argv[1]) : 10000000);
+	
+	srand(5);
+	
+	int counts[] = {10000, 30000, 100000};
+	for(int i=0; i<(int)(sizeof(counts)/sizeof(*counts)); i++) RunBenchmark(counts[i], lookups);
+	
+	return 0;
+}
@@ -94,6 +94,7 @@ void cpMessage(const char *condition, const char *file, int line, int isError, i
 
 typedef struct cpArray cpArray;
 typedef struct cpHashSet cpHashSet;
+typedef struct cpAllocator cpAllocator;
 
 typedef struct cpBody cpBody;
 
@@ -123,6 +124,7 @@ typedef struct cpSpace cpSpace;
 #include "cpVect.h"
 #include "cpBB.h"
 #include "cpTransform.h"
+#include "cpArena.h"
 #include "cpSpatialIndex.h"
 
 #include "cpArbiter.h"	
@@ -27,11 +27,21 @@
 #define CP_ALLOW_PRIVATE_ACCESS 1
 #include "chipmunk.h"
 
+#include <string.h>
+
 #define CP_HASH_COEF (3344921057ul)
 #define CP_HASH_PAIR(A, B) ((cpHashValue)(A)*CP_HASH_COEF ^ (cpHashValue)(B)*CP_HASH_COEF)
+// Arbiters are hashed by the hashids of their shapes rather than their addresses,
+// so the arbiter sets are iterated in the same order on every run and platform.
+#define CP_ARBITER_HASH(A, B) CP_HASH_PAIR((A)->hashid, (B)->hashid)
 
 // TODO: Eww. Magic numbers.
-#define MAGIC_EPSILON 1e-5
+#if CP_USE_DOUBLES
+	#define MAGIC_EPSILON 1e-5
+#else
+	// Floats only resolve positions to about 1e-4 a thousand units from the origin.
+	#define MAGIC_EPSILON 1e-3
+#endif
 
 
 //MARK: cpArray
@@ -53,6 +63,15 @@ cpBool cpArrayContains(cpArray *arr, void *ptr);
 void cpArrayFreeEach(cpArray *arr, void (freeFunc)(void*));
 
 
+//MARK: Allocators
+
+// A NULL allocator uses cpcalloc() and cpfree().
+void *cpAllocatorAlloc(const cpAllocator *allocator, size_t size);
+void cpAllocatorFree(const cpAllocator *allocator, void *ptr, size_t size);
+// Free an array of CP_BUFFER_BYTES sized buffers and the array itself.
+void cpAllocatorFreeBuffers(const cpAllocator *allocator, cpArray *buffers);
+
+
 //MARK: cpHashSet
 
 typedef cpBool (*cpHashSetEqlFunc)(void *ptr, void *elt);
@@ -70,10 +89,36 @@ void *cpHashSetFind(cpHashSet *set, cpHashValue hash, void *ptr);
 
 typedef void (*cpHashSetIteratorFunc)(void *elt, void *data);
 void cpHashSetEach(cpHashSet *set, cpHashSetIteratorFunc func, void *data);
+// Iterate in an order that recreates the same table when inserted into an empty set with the same capacity.
+void cpHashSetEachInTableOrder(cpHashSet *set, cpHashSetIteratorFunc func, void *data);
+
+unsigned int cpHashSetGetCapacity(cpHashSet *set);
+// Only for empty sets. The capacity must be a power of two and at least 8.
+void cpHashSetSetCapacity(cpHashSet *set, unsigned int capacity);
 
 typedef cpBool (*cpHashSetFilterFunc)(void *elt, void *data);
 void cpHashSetFilter(cpHashSet *set, cpHashSetFilterFunc func, void *data);
 
+// Must be called before anything is inserted.
+void cpHashSetSetAllocator(cpHashSet *set, const cpAllocator *allocator);
+
+
+//MARK: cpThreadPool
+
+typedef struct cpThreadPool cpThreadPool;
+typedef void (*cpThreadPoolWorkFunc)(void *data, unsigned long worker);
+
+// Passing 0 threads uses the number of online processors.
+cpThreadPool *cpThreadPoolNew(unsigned long threads);
+void cpThreadPoolFree(cpThreadPool *pool);
+// A NULL pool is treated as a single thread.
+unsigned long cpThreadPoolGetThreads(cpThreadPool *pool);
+
+// Run work on every thread and wait for them to finish. The calling thread is worker 0.
+void cpThreadPoolRun(cpThreadPool *pool, cpThreadPoolWorkFunc work, void *data);
+// Must be called by every worker the same number of times.
+void cpThreadPoolBarrier(cpThreadPool *pool);
+
 
 //MARK: Bodies
 
@@ -105,6 +150,10 @@ struct cpBody {
 	
 	cpTransform transform;
 	
+	// Position and angle before the last step taken by cpSpaceStepFixed(), for interpolating between steps.
+	cpVect p_prev;
+	cpFloat a_prev;
+	
 	cpDataPointer userData;
 	
 	// "pseudo-velocities" used for eliminating overlap.
@@ -123,6 +172,14 @@ struct cpBody {
 		cpBody *next;
 		cpFloat idleTime;
 	} sleeping;
+	
+	// Scratch value used by the solvers while splitting arbiters and constraints into independent batches.
+	// cpHastySpace stores a bitmask of colors, the batched solver stores a batch index.
+	// cpSpaceWriteSnapshot() stores the index the body is written at.
+	uint64_t solverTag;
+	
+	// Sweep the body's shapes when integrating its position so it can't tunnel through thin shapes.
+	cpBool ccd;
 };
 
 void cpBodyAddShape(cpBody *body, cpShape *shape);
@@ -138,6 +195,43 @@ void cpBodyRemoveConstraint(cpBody *body, cpConstraint *constraint);
 
 cpSpatialIndex *cpSpatialIndexInit(cpSpatialIndex *index, cpSpatialIndexClass *klass, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
 
+// Reindex large trees using the threads in the pool. The bbfunc must be safe to call from any thread.
+// Pass NULL to go back to reindexing serially. Ignored for other kinds of indexes.
+void cpBBTreeSetThreadPool(cpSpatialIndex *index, cpThreadPool *pool);
+
+// Attach an empty tree that holds the shapes of sleeping bodies to a dynamic index.
+// When the dynamic index is also a tree, cpSpatialIndexReindexQuery() reports its collisions with the sleeping tree
+// and caches the pairs the same way it does for the static index.
+// Otherwise the sleeping tree must be collided separately with cpSpatialIndexCollideStatic().
+void cpBBTreeSetSleepingIndex(cpSpatialIndex *index, cpSpatialIndex *sleepingIndex);
+
+cpBool cpSpatialIndexIsBBTree(cpSpatialIndex *index);
+
+// Allocate the index's pooled memory with the allocator. Must be called before anything is inserted.
+void cpSpatialIndexSetAllocator(cpSpatialIndex *index, const cpAllocator *allocator);
+// Pass the allocator on to the index's hash sets. Ignored for other kinds of indexes.
+void cpBBTreeSetAllocator(cpSpatialIndex *index, const cpAllocator *allocator);
+void cpSpaceHashSetAllocator(cpSpatialIndex *index, const cpAllocator *allocator);
+void cpSweep2DSetAllocator(cpSpatialIndex *index, const cpAllocator *allocator);
+
+#define CP_SEGMENT_PACKET_SIZE 32
+
+typedef struct cpSpatialIndexSegment {
+	void *obj;
+	cpVect a, b;
+	cpFloat t_exit;
+	void *data;
+} cpSpatialIndexSegment;
+
+// Run up to CP_SEGMENT_PACKET_SIZE segment queries with a single traversal of the tree.
+// t_exit is updated with the return values of func. Other kinds of indexes query each segment separately.
+void cpBBTreeSegmentQueryPacket(cpSpatialIndex *index, cpSpatialIndexSegment *segments, int count, cpSpatialIndexSegmentQueryFunc func);
+
+// Insert many objects at once. When there are at least as many new objects as old ones,
+// the whole tree is rebuilt top down like cpBBTreeOptimize() instead of inserting them one at a time.
+// Other kinds of indexes insert each object separately.
+void cpBBTreeInsertBulk(cpSpatialIndex *index, void **objs, cpHashValue *hashids, int count);
+
 
 //MARK: Arbiters
 
@@ -194,6 +288,8 @@ struct cpArbiter {
 	struct cpArbiterThread thread_a, thread_b;
 	
 	int count;
+	// Scratch value, cpSpaceWriteSnapshot() stores the index the arbiter is written at.
+	uint32_t tag;
 	struct cpContact *contacts;
 	cpVect n;
 	
@@ -203,6 +299,13 @@ struct cpArbiter {
 	
 	cpTimestamp stamp;
 	enum cpArbiterState state;
+	
+	// Relative offset and rotation of body_b in body_a's frame when the contacts were last computed,
+	// and the rotation of the bodies when the contacts were last updated. Used for reusing contacts.
+	cpVect reuseOffset, reuseRot;
+	cpVect rot_a, rot_b;
+	// Number of steps in a row the contacts were reused.
+	cpTimestamp reuseCount;
 };
 
 cpArbiter* cpArbiterInit(cpArbiter *arb, cpShape *a, cpShape *b);
@@ -216,6 +319,8 @@ cpArbiterThreadForBody(cpArbiter *arb, cpBody *body)
 void cpArbiterUnthread(cpArbiter *arb);
 
 void cpArbiterUpdate(cpArbiter *arb, struct cpCollisionInfo *info, cpSpace *space);
+// Find the collision handlers for the types of the arbiter's shapes.
+void cpArbiterLookupHandlers(cpArbiter *arb, cpSpace *space);
 void cpArbiterPreStep(cpArbiter *arb, cpFloat dt, cpFloat bias, cpFloat slop);
 void cpArbiterApplyCachedImpulse(cpArbiter *arb, cpFloat dt_coef);
 void cpArbiterApplyImpulse(cpArbiter *arb);
@@ -266,6 +371,8 @@ struct cpShape {
 	cpFloat e;
 	cpFloat u;
 	cpVect surfaceV;
+	
+	cpFloat broadphaseMargin;
 
 	cpDataPointer userData;
 	
@@ -547,8 +654,17 @@ normal_relative_velocity(cpBody *a, cpBody *b, cpVect r1, cpVect r2, cpVect n){
 	return cpvdot(relative_velocity(a, b, r1, r2), n);
 }
 
+// Static and kinematic bodies have no inverse mass or moment, so impulses can't change them.
+// The solver never writes to them, which lets cpHastySpace's threads share them without coloring them.
+static inline cpBool
+infinite_body(cpBody *body){
+	return (body->CP_PRIVATE(m_inv) == 0.0f && body->CP_PRIVATE(i_inv) == 0.0f);
+}
+
 static inline void
 apply_impulse(cpBody *body, cpVect j, cpVect r){
+	if(infinite_body(body)) return;
+	
 	body->CP_PRIVATE(v) = cpvadd(body->CP_PRIVATE(v), cpvmult(j, body->CP_PRIVATE(m_inv)));
 	body->CP_PRIVATE(w) += body->CP_PRIVATE(i_inv)*cpvcross(r, j);
 }
@@ -563,6 +679,8 @@ apply_impulses(cpBody *a , cpBody *b, cpVect r1, cpVect r2, cpVect j)
 static inline void
 apply_bias_impulse(cpBody *body, cpVect j, cpVect r)
 {
+	if(infinite_body(body)) return;
+	
 	body->CP_PRIVATE(v_bias) = cpvadd(body->CP_PRIVATE(v_bias), cpvmult(j, body->CP_PRIVATE(m_inv)));
 	body->CP_PRIVATE(w_bias) += body->CP_PRIVATE(i_inv)*cpvcross(r, j);
 }
@@ -635,6 +753,8 @@ bias_coef(cpFloat errorBias, cpFloat dt)
 
 //MARK: Spaces
 
+typedef void (*cpSpaceSolverFunc)(cpSpace *space, cpFloat dt);
+
 struct cpSpace {
 	int iterations;
 	
@@ -648,6 +768,19 @@ struct cpSpace {
 	cpFloat collisionBias;
 	cpTimestamp collisionPersistence;
 	
+	cpFloat contactReuseThreshold;
+	cpTimestamp contactReuseWindow;
+	
+	// Margins of the dynamic shape tree, see cpSpaceUpdateBroadphaseMargins().
+	cpFloat broadphaseMargin;
+	cpFloat broadphaseRelativeMargin;
+	cpFloat broadphaseLookahead;
+	
+	// Time step and step limit used by cpSpaceStepFixed(), and the frame time it hasn't stepped yet.
+	cpFloat fixedTimeStep;
+	int maxSubsteps;
+	cpFloat stepAccumulator;
+	
 	cpDataPointer userData;
 	
 	cpTimestamp stamp;
@@ -661,6 +794,10 @@ struct cpSpace {
 	cpHashValue shapeIDCounter;
 	cpSpatialIndex *staticShapes;
 	cpSpatialIndex *dynamicShapes;
+	// Shapes of sleeping bodies. Only checked against awake shapes to wake them up.
+	cpSpatialIndex *sleepingShapes;
+	// Shapes added to the sleeping tree since it was last rebuilt.
+	int sleepingShapesAdded;
 	
 	cpArray *constraints;
 	
@@ -669,6 +806,11 @@ struct cpSpace {
 	cpHashSet *cachedArbiters;
 	cpArray *pooledArbiters;
 	
+	// Cached arbiters between sleeping or static bodies, kept out of the per step filtering.
+	cpHashSet *sleepingArbiters;
+	// Set when a body wakes up so the sleeping arbiters are checked on the next step.
+	cpBool wakeSleepingArbiters;
+	
 	cpArray *allocatedBuffers;
 	unsigned int locked;
 	
@@ -676,11 +818,35 @@ struct cpSpace {
 	cpHashSet *collisionHandlers;
 	cpCollisionHandler defaultHandler;
 	
+	// Collision events recorded by cpSpaceRecordCollisionBegin() and friends.
+	cpCollisionEvent *collisionEvents;
+	int collisionEventCount, collisionEventCapacity;
+	
 	cpBool skipPostStep;
 	cpArray *postStepCallbacks;
 	
 	cpBody *staticBody;
 	cpBody _staticBody;
+	
+	// Runs the impulse solver iterations. Replaced by space subtypes such as cpHastySpace.
+	cpSpaceSolverFunc solveImpulses;
+	struct cpBatchedSolver *batchedSolver;
+	
+	// Worker threads owned by the space subtype, or NULL when single threaded.
+	cpThreadPool *threadPool;
+	
+	// Used for the pooled memory, NULL to use cpcalloc().
+	const cpAllocator *allocator;
+	
+#ifdef CP_SPACE_ENABLE_STEP_STATS
+	// Stats being recorded for the next step, and when the step and the current phase started.
+	cpSpaceStepStats stepStats;
+	double stepStatsStart, stepStatsMark;
+	
+	// Ring buffer of the recorded steps.
+	cpSpaceStepStats stepStatsWindow[CP_SPACE_STEP_STATS_WINDOW];
+	unsigned int stepStatsRecorded;
+#endif
 };
 
 #define cpAssertSpaceUnlocked(space) \
@@ -690,10 +856,15 @@ struct cpSpace {
 	);
 
 void cpSpaceSetStaticBody(cpSpace *space, cpBody *body);
+// Pass the broadphase margins to the dynamic shape tree. The lookahead depends on the current time step.
+void cpSpaceUpdateBroadphaseMargins(cpSpace *space);
 
 extern cpCollisionHandler cpCollisionHandlerDoNothing;
 
 void cpSpaceProcessComponents(cpSpace *space, cpFloat dt);
+void cpSpaceSolveImpulses(cpSpace *space, cpFloat dt);
+void cpSpaceSolveImpulsesBatched(cpSpace *space, cpFloat dt);
+void cpBatchedSolverFree(struct cpBatchedSolver *solver);
 
 void cpSpacePushFreshContactBuffer(cpSpace *space);
 struct cpContact *cpContactBufferGetArray(cpSpace *space);
@@ -707,7 +878,33 @@ typedef struct cpPostStepCallback {
 
 cpPostStepCallback *cpSpaceGetPostStepCallback(cpSpace *space, void *key);
 
+// Hash set transformation that takes an arbiter from the pool and initializes it for the pair of shapes.
+void *cpSpaceArbiterSetTrans(cpShape **shapes, cpSpace *space);
 cpBool cpSpaceArbiterSetFilter(cpArbiter *arb, cpSpace *space);
+
+//MARK: Step Stats
+
+// Seconds from an arbitrary starting point, as precise as the platform allows.
+double cpSpaceStatsTime(void);
+
+#ifdef CP_SPACE_ENABLE_STEP_STATS
+	void cpSpaceStatsBegin(cpSpace *space);
+	void cpSpaceStatsEnd(cpSpace *space);
+	
+	// Add the time since the last mark to the phase.
+	#define cpSpaceStatsMark(__space__, __phase__) { \
+		double __now__ = cpSpaceStatsTime(); \
+		(__space__)->stepStats.__phase__ += __now__ - (__space__)->stepStatsMark; \
+		(__space__)->stepStatsMark = __now__; \
+	}
+	
+	#define cpSpaceStatsCount(__space__, __counter__, __n__) ((__space__)->stepStats.__counter__ += (__n__))
+#else
+	#define cpSpaceStatsBegin(__space__)
+	#define cpSpaceStatsEnd(__space__)
+	#define cpSpaceStatsMark(__space__, __phase__)
+	#define cpSpaceStatsCount(__space__, __counter__, __n__)
+#endif
 void cpSpaceFilterArbiters(cpSpace *space, cpBody *body, cpShape *filter);
 
 void cpSpaceActivateBody(cpSpace *space, cpBody *body);
@@ -719,7 +916,7 @@ cpSpaceUncacheArbiter(cpSpace *space, cpArbiter *arb)
 {
 	const cpShape *a = arb->a, *b = arb->b;
 	const cpShape *shape_pair[] = {a, b};
-	cpHashValue arbHashID = CP_HASH_PAIR((cpHashValue)a, (cpHashValue)b);
+	cpHashValue arbHashID = CP_ARBITER_HASH(a, b);
 	cpHashSetRemove(space->cachedArbiters, arbHashID, shape_pair);
 	cpArrayDeleteObj(space->arbiters, arb);
 }
@@ -734,6 +931,75 @@ void cpShapeUpdateFunc(cpShape *shape, void *unused);
 cpCollisionID cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space);
 
 
+//MARK: Snapshots
+
+// Byte streams used by cpSpaceWriteSnapshot() and cpSpaceRestoreSnapshot().
+// Values are copied in the native layout, the snapshot header records what that layout is.
+
+// Once the buffer is full nothing more is copied, but the size keeps counting the bytes written.
+typedef struct cpSnapshotWriter {
+	uint8_t *cursor, *end;
+	size_t size;
+} cpSnapshotWriter;
+
+// Reading past the end clears ok and returns zeros.
+typedef struct cpSnapshotReader {
+	const uint8_t *cursor, *end;
+	cpBool ok;
+} cpSnapshotReader;
+
+static inline void
+cpSnapshotWrite(cpSnapshotWriter *writer, const void *ptr, size_t size)
+{
+	if(writer->cursor && (size_t)(writer->end - writer->cursor) >= size){
+		memcpy(writer->cursor, ptr, size);
+		writer->cursor += size;
+	} else {
+		writer->cursor = NULL;
+	}
+	
+	writer->size += size;
+}
+
+static inline void
+cpSnapshotRead(cpSnapshotReader *reader, void *ptr, size_t size)
+{
+	if(reader->ok && (size_t)(reader->end - reader->cursor) >= size){
+		memcpy(ptr, reader->cursor, size);
+		reader->cursor += size;
+	} else {
+		reader->ok = cpFalse;
+		memset(ptr, 0, size);
+	}
+}
+
+// Read the number of items in a list. Every item takes at least a byte,
+// so a count larger than the rest of the snapshot means it is corrupt.
+static inline uint32_t
+cpSnapshotReadCount(cpSnapshotReader *reader)
+{
+	uint32_t count;
+	cpSnapshotRead(reader, &count, sizeof(count));
+	
+	if(count > (size_t)(reader->end - reader->cursor)){
+		reader->ok = cpFalse;
+		return 0;
+	}
+	
+	return count;
+}
+
+typedef cpHashValue (*cpSnapshotIDFunc)(void *obj);
+typedef void *(*cpSnapshotObjFunc)(cpHashValue id, void *data);
+
+// Write the exact layout of a tree so a restored copy reindexes and reports pairs in the same order.
+// The ids must be the hash values the objects were inserted with.
+void cpBBTreeWriteSnapshot(cpSpatialIndex *index, cpSnapshotIDFunc idFunc, cpSnapshotWriter *writer);
+// Restore a tree written by cpBBTreeWriteSnapshot() into an empty tree.
+// The pairs of a dynamic tree link to its static and sleeping trees, so those must be restored first.
+cpBool cpBBTreeRestoreSnapshot(cpSpatialIndex *index, cpSnapshotObjFunc objFunc, void *data, cpSnapshotReader *reader);
+
+
 //MARK: Foreach loops
 
 static inline cpConstraint *
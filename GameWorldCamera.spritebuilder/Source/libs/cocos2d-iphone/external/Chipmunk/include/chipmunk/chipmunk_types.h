@@ -119,6 +119,35 @@
 	#define M_E 2.71828182845904523536028747135266250
 #endif
 
+#ifndef CP_DETERMINISTIC_MATH
+	#define CP_DETERMINISTIC_MATH 0
+#endif
+
+/// Portable versions of the transcendental functions that give the same results on every platform.
+/// Deterministic builds use them in place of libm, whose results differ between platforms.
+/// sqrt(), fmod(), floor() and ceil() are always exact, so they don't need replacing.
+cpFloat cpDeterministicSin(cpFloat x);
+cpFloat cpDeterministicCos(cpFloat x);
+cpFloat cpDeterministicAcos(cpFloat x);
+cpFloat cpDeterministicAtan2(cpFloat y, cpFloat x);
+cpFloat cpDeterministicExp(cpFloat x);
+cpFloat cpDeterministicPow(cpFloat x, cpFloat y);
+
+#if CP_DETERMINISTIC_MATH
+	#undef cpfsin
+	#undef cpfcos
+	#undef cpfacos
+	#undef cpfatan2
+	#undef cpfexp
+	#undef cpfpow
+	#define cpfsin cpDeterministicSin
+	#define cpfcos cpDeterministicCos
+	#define cpfacos cpDeterministicAcos
+	#define cpfatan2 cpDeterministicAtan2
+	#define cpfexp cpDeterministicExp
+	#define cpfpow cpDeterministicPow
+#endif
+
 
 /// Return the max of two cpFloats.
 static inline cpFloat cpfmax(cpFloat a, cpFloat b)
@@ -172,8 +201,8 @@ static inline cpFloat cpflerpconst(cpFloat f1, cpFloat f2, cpFloat d)
 #endif
 
 /// Type used internally to cache colliding object info for cpCollideShapes().
-/// Should be at least 32 bits.
-typedef uint32_t cpCollisionID;
+/// Holds four 16 bit vertex indexes, so it should be at least 64 bits.
+typedef uint64_t cpCollisionID;
 
 // Oh C, how we love to define our own boolean types to get compiler compatibility
 /// Chipmunk's boolean type.
@@ -0,0 +1,62 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// @defgroup cpArena cpArena
+/// Spaces allocate their pooled memory (spatial index nodes, hash set bins, arbiters and contact buffers)
+/// in large chunks. A cpAllocator lets you decide where those chunks come from.
+/// cpArena is an allocator that carves them out of a few large slabs, so a level's physics memory stays
+/// contiguous, can be released all at once and can be measured.
+/// @{
+
+/// Callbacks used to allocate a space's pooled memory.
+struct cpAllocator {
+	/// Return @c size bytes of zeroed memory.
+	void *(*alloc)(size_t size, void *data);
+	/// Release memory returned by @c alloc. @c size is the size that was requested.
+	void (*free)(void *ptr, size_t size, void *data);
+	/// User data passed to the callbacks.
+	void *data;
+};
+
+typedef struct cpArena cpArena;
+
+/// Allocate and initialize an arena. Memory is reserved in slabs of @c slabBytes. Pass 0 for the default of 1MB.
+/// Requests are rounded up to a power of two size class and freed memory is reused by later requests of the same class.
+/// Arenas are not thread safe. Don't share one between spaces that are stepped at the same time.
+cpArena *cpArenaNew(size_t slabBytes);
+/// Free an arena and all of its memory.
+void cpArenaFree(cpArena *arena);
+
+/// Get the allocator to pass to cpSpaceSetAllocator(). It is valid until the arena is freed.
+const cpAllocator *cpArenaGetAllocator(cpArena *arena);
+
+/// Release everything allocated from the arena at once. The slabs are kept to be reused.
+/// Only call this when nothing that used the arena will touch its memory again, such as after freeing a level's spaces.
+void cpArenaReset(cpArena *arena);
+
+/// Number of bytes currently handed out by the arena.
+size_t cpArenaGetBytesInUse(cpArena *arena);
+/// Largest number of bytes handed out at once since the arena was created or reset.
+size_t cpArenaGetPeakBytes(cpArena *arena);
+/// Number of bytes the arena has reserved from the system.
+size_t cpArenaGetReservedBytes(cpArena *arena);
+
+/// @}
@@ -75,6 +75,14 @@ void cpBodySetType(cpBody *body, cpBodyType type);
 /// Get the space this body is added to.
 cpSpace* cpBodyGetSpace(const cpBody *body);
 
+/// Returns true if continuous collision detection is enabled for the body.
+cpBool cpBodyGetCCD(const cpBody *body);
+/// Enable continuous collision detection for a fast moving dynamic body such as a projectile.
+/// Each step the body's shapes are swept along its motion against the other shapes in the space
+/// and the body is stopped at the first impact so it can't tunnel through thin shapes.
+/// Sweeps ignore rotation and collision handlers, and use the other shapes' positions from the start of the step.
+void cpBodySetCCD(cpBody *body, cpBool ccd);
+
 /// Get the mass of the body.
 cpFloat cpBodyGetMass(const cpBody *body);
 /// Set the mass of the body.
@@ -123,6 +131,15 @@ void cpBodySetTorque(cpBody *body, cpFloat torque);
 /// Get the rotation vector of the body. (The x basis vector of it's transform.)
 cpVect cpBodyGetRotation(const cpBody *body);
 
+/// Get the body's transform interpolated between the last two steps taken by cpSpaceStepFixed().
+/// Pass cpSpaceGetStepAlpha() as @c alpha to draw the body at the time of the current frame.
+/// Setting a body's position or angle moves it there without interpolating.
+cpTransform cpBodyGetInterpolatedTransform(const cpBody *body, cpFloat alpha);
+/// Get the body's position interpolated between the last two steps taken by cpSpaceStepFixed().
+cpVect cpBodyGetInterpolatedPosition(const cpBody *body, cpFloat alpha);
+/// Get the body's angle interpolated between the last two steps taken by cpSpaceStepFixed().
+cpFloat cpBodyGetInterpolatedAngle(const cpBody *body, cpFloat alpha);
+
 /// Get the user data pointer assigned to the body.
 cpDataPointer cpBodyGetUserData(const cpBody *body);
 /// Set the user data pointer assigned to the body.
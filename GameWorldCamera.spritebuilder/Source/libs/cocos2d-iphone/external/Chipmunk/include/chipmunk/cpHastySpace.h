@@ -0,0 +1,63 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// @defgroup cpHastySpace cpHastySpace
+/// cpHastySpace is a cpSpace subtype that runs the impulse solver on multiple threads.
+/// Arbiters and constraints are colored so that no two items in a batch share a dynamic body.
+/// The batches are always solved in the same order, so results do not depend on the thread count.
+/// You must explicitly include the cpHastySpace.h header to use it.
+/// @{
+
+#ifndef CHIPMUNK_HASTY_SPACE_H
+#define CHIPMUNK_HASTY_SPACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cpHastySpace cpHastySpace;
+
+/// Allocate and initialize a hasty space. It runs single threaded until cpHastySpaceSetThreads() is called.
+cpSpace *cpHastySpaceNew(void);
+/// Stop the worker threads and free a hasty space. Do not call cpSpaceFree() on a hasty space.
+void cpHastySpaceFree(cpSpace *space);
+
+/// Set the number of threads (including the calling thread) used to run the solver.
+/// Large dynamic bounding box trees are also reindexed on the same threads.
+/// Passing 0 uses the number of online processors.
+void cpHastySpaceSetThreads(cpSpace *space, unsigned long threads);
+/// Get the number of threads the solver is using.
+unsigned long cpHastySpaceGetThreads(cpSpace *space);
+
+/// Don't run the solver in parallel unless there are at least this many arbiters and constraints.
+/// Smaller steps are solved on the calling thread, using the same batch order.
+void cpHastySpaceSetThreadingThreshold(cpSpace *space, unsigned long threshold);
+/// Get the threading threshold.
+unsigned long cpHastySpaceGetThreadingThreshold(cpSpace *space);
+
+/// Step a hasty space. This is the same as calling cpSpaceStep().
+void cpHastySpaceStep(cpSpace *space, cpFloat dt);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
+/// @}
@@ -0,0 +1,107 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// @defgroup cpPolyline cpPolyline
+/// Polylines are lists of connected vertexes, such as the outlines that cpMarchSoft() and cpMarchHard() generate.
+/// They can be simplified and turned into segment shapes, or closed outlines can be broken into convex pieces for poly shapes.
+/// You must explicitly include the cpPolyline.h header to use them.
+/// @{
+
+#ifndef CHIPMUNK_POLYLINE_H
+#define CHIPMUNK_POLYLINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// A list of connected vertexes.
+/// A polyline is closed when its first and last vertexes are the same.
+/// Closed polylines that outline a solid area wind counterclockwise like poly shapes do.
+typedef struct cpPolyline {
+	int count, capacity;
+	cpVect verts[];
+} cpPolyline;
+
+/// Destroy and free a polyline.
+void cpPolylineFree(cpPolyline *line);
+
+/// Returns true if the first and last vertexes of the polyline are the same.
+cpBool cpPolylineIsClosed(cpPolyline *line);
+
+/// Return a copy of the polyline simplified with the Douglas-Peucker algorithm.
+/// No vertex of the original polyline will be further than @c tol from the simplified one.
+/// Works best on smooth outlines such as the ones from cpMarchSoft().
+cpPolyline *cpPolylineSimplifyCurves(cpPolyline *line, cpFloat tol);
+
+/// Return a copy of the polyline with nearly straight runs of vertexes joined together.
+/// A vertex is dropped when the line bends less than @c tol radians there.
+/// Works best on blocky outlines such as the ones from cpMarchHard().
+cpPolyline *cpPolylineSimplifyVertexes(cpPolyline *line, cpFloat tol);
+
+/// Return the convex hull of the polyline as a closed polyline.
+/// @c tol is passed to cpConvexHull() to drop nearly colinear vertexes.
+cpPolyline *cpPolylineToConvexHull(cpPolyline *line, cpFloat tol);
+
+/// Create a segment shape for each segment of the polyline, attached to @c body.
+/// The neighbors of the segments are set with cpSegmentShapeSetNeighbors() so other shapes slide smoothly across the joints.
+/// @c shapes must have room for @c line->count - 1 shapes. Returns the number of shapes created.
+int cpPolylineSegmentShapes(cpPolyline *line, cpBody *body, cpFloat radius, cpShape **shapes);
+
+/// A collection of polylines.
+typedef struct cpPolylineSet {
+	int count, capacity;
+	cpPolyline **lines;
+} cpPolylineSet;
+
+/// Allocate a new polyline set.
+cpPolylineSet *cpPolylineSetAlloc(void);
+/// Initialize a new polyline set.
+cpPolylineSet *cpPolylineSetInit(cpPolylineSet *set);
+/// Allocate and initialize a polyline set.
+cpPolylineSet *cpPolylineSetNew(void);
+
+/// Destroy a polyline set, and free its polylines too if @c freePolylines is true.
+void cpPolylineSetDestroy(cpPolylineSet *set, cpBool freePolylines);
+/// Destroy and free a polyline set, and free its polylines too if @c freePolylines is true.
+void cpPolylineSetFree(cpPolylineSet *set, cpBool freePolylines);
+
+/// Add a line segment to a polyline set.
+/// Segments that share endpoints are joined into the same polyline, so the segments must all wind in the same direction.
+/// This function's signature matches cpMarchSegmentFunc so it can be passed straight to cpMarchSoft() or cpMarchHard().
+void cpPolylineSetCollectSegment(cpVect v0, cpVect v1, cpPolylineSet *lines);
+
+/// Break a closed counterclockwise polyline into convex pieces, returned as a set of closed polylines.
+/// Concavities shallower than @c tol are filled in instead of split, so a larger tolerance gives fewer pieces.
+/// The polyline must not cross itself. Holes aren't supported since they come out of the marching functions as separate polylines.
+/// Returns NULL if the polyline isn't closed or winds clockwise.
+cpPolylineSet *cpPolylineConvexDecomposition(cpPolyline *line, cpFloat tol);
+
+/// Create a poly shape for each polyline in @c set, attached to @c body.
+/// The polylines must be closed and convex, such as the ones returned by cpPolylineConvexDecomposition().
+/// @c shapes must have room for @c set->count shapes. Returns the number of shapes created.
+int cpPolylineSetPolyShapes(cpPolylineSet *set, cpBody *body, cpFloat radius, cpShape **shapes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/// @}
@@ -133,6 +133,13 @@ cpVect cpShapeGetSurfaceVelocity(const cpShape *shape);
 /// Set the surface velocity of this shape.
 void cpShapeSetSurfaceVelocity(cpShape *shape, cpVect surfaceVelocity);
 
+/// Get the extra distance added to the sides of this shape's bounding box in the broadphase.
+cpFloat cpShapeGetBroadphaseMargin(const cpShape *shape);
+/// Set the extra distance added to the sides of this shape's bounding box in the broadphase, on top of the space's margin.
+/// Useful for shapes that jitter or change direction a lot. Takes effect the next time the shape is reinserted.
+/// See cpSpaceSetBroadphaseMargin().
+void cpShapeSetBroadphaseMargin(cpShape *shape, cpFloat broadphaseMargin);
+
 /// Get the user definable data pointer of this shape.
 cpDataPointer cpShapeGetUserData(const cpShape *shape);
 /// Set the user definable data pointer of this shape.
@@ -48,6 +48,15 @@ struct cpCollisionHandler {
 	cpDataPointer userData;
 };
 
+/// Impulse solvers that can be used by cpSpaceStep().
+typedef enum cpSpaceSolverType {
+	/// Solve contacts one at a time. This is the default.
+	CP_SPACE_SOLVER_SCALAR,
+	/// Pack contacts into batches that share no dynamic bodies and solve each batch with SIMD instructions.
+	/// Results are not identical to the scalar solver, but are within floating point tolerance.
+	CP_SPACE_SOLVER_BATCHED,
+} cpSpaceSolverType;
+
 // TODO: Make timestep a parameter?
 
 
@@ -112,6 +121,36 @@ void cpSpaceSetCollisionBias(cpSpace *space, cpFloat collisionBias);
 cpTimestamp cpSpaceGetCollisionPersistence(const cpSpace *space);
 void cpSpaceSetCollisionPersistence(cpSpace *space, cpTimestamp collisionPersistence);
 
+/// Touching shapes keep their contacts from the previous step instead of colliding them again
+/// if the relative motion of their bodies would have moved the contact points less than this distance.
+/// Saves the collision cost of resting stacks. Defaults to 0, which disables contact reuse.
+/// Keep it well below the collision slop.
+cpFloat cpSpaceGetContactReuseThreshold(const cpSpace *space);
+void cpSpaceSetContactReuseThreshold(cpSpace *space, cpFloat contactReuseThreshold);
+
+/// Maximum number of steps in a row that contacts can be reused before they are collided again.
+/// Bounds the error from slow drift, and from changing a shape's geometry while it is touching something.
+/// Defaults to 4.
+cpTimestamp cpSpaceGetContactReuseWindow(const cpSpace *space);
+void cpSpaceSetContactReuseWindow(cpSpace *space, cpTimestamp contactReuseWindow);
+
+/// Distance added to every side of the bounding boxes of moving shapes in the broadphase.
+/// Shapes aren't reinserted into the broadphase until they move out of their enlarged bounding boxes,
+/// but bigger boxes also find more pairs of shapes that aren't touching. Defaults to 0. See cpBBTreeSetMargins().
+/// cpShapeSetBroadphaseMargin() adds to it for individual shapes.
+cpFloat cpSpaceGetBroadphaseMargin(const cpSpace *space);
+void cpSpaceSetBroadphaseMargin(cpSpace *space, cpFloat broadphaseMargin);
+
+/// Fraction of the size of a moving shape's bounding box added to each of its sides in the broadphase. Defaults to 0.1.
+cpFloat cpSpaceGetBroadphaseRelativeMargin(const cpSpace *space);
+void cpSpaceSetBroadphaseRelativeMargin(cpSpace *space, cpFloat broadphaseRelativeMargin);
+
+/// Number of time steps ahead that the broadphase bounding boxes of moving shapes are stretched along their velocity.
+/// Fast shapes stay inside their bounding boxes for about that many steps regardless of how long the steps are.
+/// Defaults to 0, which stretches them by a fixed 0.1 seconds of movement instead.
+cpFloat cpSpaceGetBroadphaseLookahead(const cpSpace *space);
+void cpSpaceSetBroadphaseLookahead(cpSpace *space, cpFloat broadphaseLookahead);
+
 /// User definable data pointer.
 /// Generally this points to your game's controller or game state
 /// class so you can access it when given a cpSpace reference in a callback.
@@ -122,10 +161,25 @@ void cpSpaceSetUserData(cpSpace *space, cpDataPointer userData);
 /// This is merely provided for convenience and you are not required to use it.
 cpBody* cpSpaceGetStaticBody(const cpSpace *space);
 
+/// Time step that cpSpaceStepFixed() divides frame time into. Defaults to 1/60.
+cpFloat cpSpaceGetFixedTimeStep(const cpSpace *space);
+void cpSpaceSetFixedTimeStep(cpSpace *space, cpFloat fixedTimeStep);
+
+/// Most steps that a call to cpSpaceStepFixed() takes. Frame time beyond that is dropped,
+/// so a slow frame slows the simulation down instead of making the following frames slower still.
+/// Defaults to 8.
+int cpSpaceGetMaxSubsteps(const cpSpace *space);
+void cpSpaceSetMaxSubsteps(cpSpace *space, int maxSubsteps);
+
 /// Returns the current (or most recent) time step used with the given space.
 /// Useful from callbacks if your time step is not a compile-time global.
 cpFloat cpSpaceGetCurrentTimeStep(const cpSpace *space);
 
+/// Impulse solver used to solve contacts. Defaults to CP_SPACE_SOLVER_SCALAR.
+/// Cannot be changed on a cpHastySpace.
+cpSpaceSolverType cpSpaceGetSolverType(const cpSpace *space);
+void cpSpaceSetSolverType(cpSpace *space, cpSpaceSolverType type);
+
 /// returns true from inside a callback when objects cannot be added/removed.
 cpBool cpSpaceIsLocked(cpSpace *space);
 
@@ -137,6 +191,43 @@ cpCollisionHandler *cpSpaceAddCollisionHandler(cpSpace *space, cpCollisionType a
 cpCollisionHandler *cpSpaceAddWildcardHandler(cpSpace *space, cpCollisionType type);
 
 
+//MARK: Collision Events
+
+/// Types of the events in a space's collision event buffer.
+typedef enum cpCollisionEventType {
+	CP_COLLISION_EVENT_BEGIN,
+	CP_COLLISION_EVENT_POST_SOLVE,
+	CP_COLLISION_EVENT_SEPARATE,
+} cpCollisionEventType;
+
+/// A collision recorded by one of the cpSpaceRecordCollision*() handler functions.
+typedef struct cpCollisionEvent {
+	cpCollisionEventType type;
+	/// The colliding shapes in the order of the collision handler's types, the same as cpArbiterGetShapes().
+	/// Shapes removed from the space may have been freed by the time a separate event is read.
+	cpShape *a, *b;
+	/// The userData pointer of the collision handler that recorded the event.
+	cpDataPointer userData;
+	/// The contact points and collision normal. Empty for separate events.
+	cpContactPointSet contacts;
+	/// The impulse the solver applied to resolve the collision. Zero except for post-solve events.
+	cpVect impulse;
+} cpCollisionEvent;
+
+/// Collision handler functions that append an event to the space's collision event buffer instead of handling it right away.
+/// Set them as the begin, post-solve and separate functions of a handler to read all of its collisions in one pass after cpSpaceStep() returns.
+/// They don't call the wildcard handlers.
+cpBool cpSpaceRecordCollisionBegin(cpArbiter *arb, cpSpace *space, cpDataPointer userData);
+void cpSpaceRecordCollisionPostSolve(cpArbiter *arb, cpSpace *space, cpDataPointer userData);
+void cpSpaceRecordCollisionSeparate(cpArbiter *arb, cpSpace *space, cpDataPointer userData);
+
+/// Get the events recorded since the buffer was last cleared, in the order they happened.
+/// The pointer is valid until the next event is recorded or the buffer is cleared.
+const cpCollisionEvent *cpSpaceGetCollisionEvents(const cpSpace *space, int *count);
+/// Empty the collision event buffer. Events pile up until it's cleared, usually once the game has read them after each step.
+void cpSpaceClearCollisionEvents(cpSpace *space);
+
+
 //MARK: Add/Remove objects
 
 /// Add a collision shape to the simulation.
@@ -147,6 +238,15 @@ cpBody* cpSpaceAddBody(cpSpace *space, cpBody *body);
 /// Add a constraint to the simulation.
 cpConstraint* cpSpaceAddConstraint(cpSpace *space, cpConstraint *constraint);
 
+/// Add many collision shapes at once, such as when loading a level.
+/// Works like calling cpSpaceAddShape() for each shape, but the spatial indexes are updated in one pass at the end.
+/// When the shapes outnumber the ones already in an index, the index tree is rebuilt from scratch
+/// which leaves the static index in the same state as cpSpaceOptimizeStatic().
+/// There is no need to call cpSpaceReindexStatic() afterwards.
+void cpSpaceAddShapes(cpSpace *space, cpShape **shapes, int count);
+/// Add many rigid bodies at once. Works like calling cpSpaceAddBody() for each body.
+void cpSpaceAddBodies(cpSpace *space, cpBody **bodies, int count);
+
 /// Remove a collision shape from the simulation.
 void cpSpaceRemoveShape(cpSpace *space, cpShape *shape);
 /// Remove a rigid body from the simulation.
@@ -191,6 +291,21 @@ void cpSpaceSegmentQuery(cpSpace *space, cpVect start, cpVect end, cpFloat radiu
 /// Perform a directed line segment query (like a raycast) against the space and return the first shape hit. Returns NULL if no shapes were hit.
 cpShape *cpSpaceSegmentQueryFirst(cpSpace *space, cpVect start, cpVect end, cpFloat radius, cpShapeFilter filter, cpSegmentQueryInfo *out);
 
+/// A segment to query with cpSpaceSegmentQueryBatch().
+typedef struct cpSegmentQueryRequest {
+	cpVect start, end;
+	cpFloat radius;
+	cpShapeFilter filter;
+} cpSegmentQueryRequest;
+
+/// Perform many cpSpaceSegmentQueryFirst() queries at once. @c results must have room for @c count entries.
+/// Nearby segments are grouped into packets that traverse the spatial indexes together,
+/// and a cpHastySpace spreads the packets across its threads.
+/// When two shapes are hit at exactly the same alpha, either one may be returned.
+/// On a single thread the sorting and packets cost more than calling cpSpaceSegmentQueryFirst() for each segment,
+/// so a batch only pays off when a threaded cpHastySpace can split it.
+void cpSpaceSegmentQueryBatch(cpSpace *space, const cpSegmentQueryRequest *requests, int count, cpSegmentQueryInfo *results);
+
 /// Rectangle Query callback function type.
 typedef void (*cpSpaceBBQueryFunc)(cpShape *shape, void *data);
 /// Perform a fast rectangle query on the space calling @c func for each shape found.
@@ -225,13 +340,37 @@ void cpSpaceEachConstraint(cpSpace *space, cpSpaceConstraintIteratorFunc func, v
 
 /// Update the collision detection info for the static shapes in the space.
 void cpSpaceReindexStatic(cpSpace *space);
+/// Rebuild the static shape index for fast queries. Call it after adding the level's static shapes.
+/// Queries use a compact frozen copy of the tree until static shapes are added, removed or reindexed.
+/// Ignored if the space doesn't use a bounding box tree for its static shapes.
+void cpSpaceOptimizeStatic(cpSpace *space);
 /// Update the collision detection data for a specific shape in the space.
 void cpSpaceReindexShape(cpSpace *space, cpShape *shape);
+/// Set how many leaves of the dynamic shape tree are reinserted each step to keep it balanced. Defaults to 0.
+/// See cpBBTreeSetRebalanceBudget().
+/// Ignored if the space doesn't use a bounding box tree for its dynamic shapes.
+void cpSpaceSetTreeRebalanceBudget(cpSpace *space, int budget);
+/// Measure the quality of the space's dynamic shape tree to check that it stays healthy in long running simulations.
+void cpSpaceGetTreeQuality(cpSpace *space, cpBBTreeQuality *quality);
+/// Get the sizes of the space's dynamic shape hash, such as to see what an adaptive hash settled on.
+/// The sizes are zeroed if the space doesn't use a spatial hash.
+void cpSpaceGetHashSizing(cpSpace *space, cpSpaceHashSizing *sizing);
 /// Update the collision detection data for all shapes attached to a body.
 void cpSpaceReindexShapesForBody(cpSpace *space, cpBody *body);
 
 /// Switch the space to use a spatial has as it's spatial index.
+/// Pass 0 for @c dim to have the hashes size themselves. @c count is then only the initial table size.
 void cpSpaceUseSpatialHash(cpSpace *space, cpFloat dim, int count);
+/// Switch the space to use an incremental sweep and prune index for it's dynamic shapes.
+/// Works best when most shapes move a little each step. Static shapes stay in a bounding box tree.
+void cpSpaceUseSweepAndPrune(cpSpace *space);
+
+/// Allocate the space's pooled memory (arbiters, contact buffers and spatial index memory) using @c allocator.
+/// Pass NULL to use cpcalloc(). Must be called before anything is added to the space.
+/// The allocator must outlive the space. Bodies, shapes and constraints are still allocated by their constructors.
+void cpSpaceSetAllocator(cpSpace *space, const cpAllocator *allocator);
+/// Get the allocator used by the space's pooled memory, or NULL.
+const cpAllocator *cpSpaceGetAllocator(cpSpace *space);
 
 
 //MARK: Time Stepping
@@ -239,6 +378,82 @@ void cpSpaceUseSpatialHash(cpSpace *space, cpFloat dim, int count);
 /// Step the space forward in time by @c dt.
 void cpSpaceStep(cpSpace *space, cpFloat dt);
 
+/// Step the space by the fixed time step as many times as fit in @c dt seconds of variable frame time.
+/// The remainder is carried over to the next call. Returns the number of steps taken.
+/// Stepping a constant amount keeps the simulation deterministic and the solver stable regardless of the frame rate.
+/// Bodies keep their position and angle from before the last step so they can be drawn in between, see cpBodyGetInterpolatedTransform().
+int cpSpaceStepFixed(cpSpace *space, cpFloat dt);
+
+/// Number of steps that cpSpaceStepFixed() would take for @c dt seconds of frame time.
+/// Use it to give kinematic bodies the velocity that moves them to their target over the steps taken this frame.
+int cpSpaceGetFixedStepCount(const cpSpace *space, cpFloat dt);
+
+/// Fraction of a fixed time step that cpSpaceStepFixed() has left over, between 0 and 1.
+/// Use it to interpolate bodies between their last two steps. Drawing them there lags the simulation by up to one step.
+cpFloat cpSpaceGetStepAlpha(const cpSpace *space);
+
+
+//MARK: Step Stats
+
+#ifdef CP_SPACE_ENABLE_STEP_STATS
+
+/// Number of steps kept for cpSpaceGetStepStatsWindow().
+#define CP_SPACE_STEP_STATS_WINDOW 60
+
+/// Timings and counters recorded by cpSpaceStep() when Chipmunk is compiled with CP_SPACE_ENABLE_STEP_STATS defined.
+/// Times are in seconds.
+typedef struct cpSpaceStepStats {
+	/// The whole step, including the callbacks.
+	double total;
+	/// Updating the body positions.
+	double integratePositions;
+	/// Reindexing the shapes and colliding the pairs the broadphase found.
+	double collide;
+	/// Rebuilding the contact graph and putting idle islands to sleep.
+	double components;
+	/// Resetting the arbiter lists, filtering the cached arbiters and calling separate callbacks.
+	double filterArbiters;
+	/// Prestepping the arbiters and constraints.
+	double preStep;
+	/// Updating the body velocities.
+	double integrateVelocities;
+	/// Applying the cached impulses and running the impulse solver iterations.
+	double solve;
+	/// Post-solve and post-step callbacks.
+	double callbacks;
+	
+	/// Shape pairs passed from the broadphase to the narrowphase.
+	unsigned int pairsTested;
+	/// Pairs from the broadphase whose shapes' bounding boxes don't overlap. Bigger broadphase margins find more of them.
+	unsigned int falsePairs;
+	/// Shapes reinserted into the broadphase because they moved out of their bounding boxes. Bigger margins mean fewer of them.
+	unsigned int leavesReinserted;
+	/// Pairs the narrowphase found touching.
+	unsigned int narrowPhaseHits;
+	/// Touching pairs that reused the contacts of the last step instead of running the narrowphase.
+	unsigned int pairsReused;
+	/// Arbiters solved.
+	unsigned int arbiters;
+	/// Contacts in the solved arbiters.
+	unsigned int contacts;
+	/// Constraints solved.
+	unsigned int constraints;
+	/// Sleeping islands woken up since the previous step.
+	unsigned int islandsWoken;
+	/// Islands put to sleep since the previous step.
+	unsigned int islandsSlept;
+} cpSpaceStepStats;
+
+/// Get the timings and counters of the last call to cpSpaceStep(). They are all zero before the first step.
+void cpSpaceGetStepStats(const cpSpace *space, cpSpaceStepStats *stats);
+/// Get the mean and the maximum of each stat over the last CP_SPACE_STEP_STATS_WINDOW steps. Either pointer may be NULL.
+/// Returns the number of steps in the window.
+int cpSpaceGetStepStatsWindow(const cpSpace *space, cpSpaceStepStats *mean, cpSpaceStepStats *max);
+/// Forget the recorded steps.
+void cpSpaceResetStepStats(cpSpace *space);
+
+#endif
+
 
 //MARK: Debug API
 
@@ -0,0 +1,84 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// @defgroup cpSpaceGroup cpSpaceGroup
+/// A space group steps many independent spaces at the same time on a shared set of worker threads.
+/// Each space is stepped by exactly one thread at a time, and spaces are spread evenly across the threads.
+/// Threads that run out of spaces take them from the threads that still have the most left.
+/// Post-step callbacks run on the thread that stepped the space, so they must only touch that space and the game state that goes with it.
+/// You must explicitly include the cpSpaceGroup.h header to use it.
+/// @{
+
+#ifndef CHIPMUNK_SPACE_GROUP_H
+#define CHIPMUNK_SPACE_GROUP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cpSpaceGroup cpSpaceGroup;
+
+/// Timings recorded for each space in a group. Times are in seconds.
+typedef struct cpSpaceGroupStats {
+	/// Number of times the group stepped the space.
+	unsigned long steps;
+	/// The last step.
+	double last;
+	/// The slowest step.
+	double max;
+	/// All of the steps added together.
+	double total;
+} cpSpaceGroupStats;
+
+/// Allocate and initialize a space group that steps its spaces with @c threads threads, including the calling thread.
+/// Passing 0 uses the number of online processors.
+cpSpaceGroup *cpSpaceGroupNew(unsigned long threads);
+/// Stop the worker threads and free a space group. The spaces are not freed.
+void cpSpaceGroupFree(cpSpaceGroup *group);
+
+/// Get the number of threads the group steps its spaces with.
+unsigned long cpSpaceGroupGetThreads(cpSpaceGroup *group);
+
+/// Add a space to the group. A space must not be in more than one group.
+/// Hasty spaces can be added, but their own threads then compete with the group's.
+void cpSpaceGroupAddSpace(cpSpaceGroup *group, cpSpace *space);
+/// Remove a space from the group. Its timings are forgotten.
+void cpSpaceGroupRemoveSpace(cpSpaceGroup *group, cpSpace *space);
+/// Get the number of spaces in the group.
+int cpSpaceGroupGetCount(cpSpaceGroup *group);
+
+/// Call cpSpaceStep() on every space in the group and wait for them all to finish.
+void cpSpaceGroupStep(cpSpaceGroup *group, cpFloat dt);
+/// Call cpSpaceStepFixed() on every space in the group and wait for them all to finish.
+/// Each space uses its own fixed time step. All of the substeps taken by one call count as a single step in the timings.
+void cpSpaceGroupStepFixed(cpSpaceGroup *group, cpFloat dt);
+
+/// Get the timings of a space in the group.
+void cpSpaceGroupGetStats(cpSpaceGroup *group, cpSpace *space, cpSpaceGroupStats *stats);
+/// Forget the timings of every space in the group.
+void cpSpaceGroupResetStats(cpSpaceGroup *group);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/// @}
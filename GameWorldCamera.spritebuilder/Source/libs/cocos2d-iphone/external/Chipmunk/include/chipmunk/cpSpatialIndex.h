@@ -61,6 +61,8 @@ struct cpSpatialIndex {
 	cpSpatialIndexBBFunc bbfunc;
 	
 	cpSpatialIndex *staticIndex, *dynamicIndex;
+	
+	const cpAllocator *allocator;
 };
 
 
@@ -70,7 +72,8 @@ typedef struct cpSpaceHash cpSpaceHash;
 
 /// Allocate a spatial hash.
 cpSpaceHash* cpSpaceHashAlloc(void);
-/// Initialize a spatial hash. 
+/// Initialize a spatial hash.
+/// Pass 0 for @c celldim to let the hash pick its cell dimensions and table size as objects are added and moved.
 cpSpatialIndex* cpSpaceHashInit(cpSpaceHash *hash, cpFloat celldim, int numcells, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
 /// Allocate and initialize a spatial hash.
 cpSpatialIndex* cpSpaceHashNew(cpFloat celldim, int cells, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
@@ -79,8 +82,24 @@ cpSpatialIndex* cpSpaceHashNew(cpFloat celldim, int cells, cpSpatialIndexBBFunc
 /// The cell dimensions should roughly match the average size of your objects
 /// and the table size should be ~10 larger than the number of objects inserted.
 /// Some trial and error is required to find the optimum numbers for efficiency.
+/// Pass 0 for @c celldim to switch to automatic sizing instead.
 void cpSpaceHashResize(cpSpaceHash *hash, cpFloat celldim, int numcells);
 
+/// The sizes a spatial hash is using, see cpSpaceHashGetSizing().
+typedef struct cpSpaceHashSizing {
+	/// Whether the hash picks its own sizes.
+	cpBool adaptive;
+	/// Current cell dimensions.
+	cpFloat celldim;
+	/// Current table size.
+	int numcells;
+	/// Number of times an adaptive hash changed its sizes. Stays low once the objects settle down.
+	int resizes;
+} cpSpaceHashSizing;
+
+/// Get the sizes a spatial hash is using, such as to see what an adaptive hash settled on.
+void cpSpaceHashGetSizing(cpSpatialIndex *index, cpSpaceHashSizing *sizing);
+
 //MARK: AABB Tree
 
 typedef struct cpBBTree cpBBTree;
@@ -101,6 +120,48 @@ typedef cpVect (*cpBBTreeVelocityFunc)(void *obj);
 /// Set the velocity function for the bounding box tree to enable temporal coherence.
 void cpBBTreeSetVelocityFunc(cpSpatialIndex *index, cpBBTreeVelocityFunc func);
 
+/// Bounding box tree margin callback function.
+/// This function should return an extra margin to add to every side of the object's bounding box.
+typedef cpFloat (*cpBBTreeMarginFunc)(void *obj);
+/// Set how much the bounding boxes of the leaves are fattened so they don't have to be reinserted every time their objects move.
+/// Each side is pushed out by @c absolute plus @c relative times the size of the bounding box,
+/// or by the object's velocity times @c lookahead seconds in the direction it's moving, whichever is further.
+/// Bigger margins mean fewer reinserts but more pairs whose objects aren't actually touching.
+/// Defaults to 0, 0.1 and 0.1. Only trees with a velocity function fatten their leaves.
+void cpBBTreeSetMargins(cpSpatialIndex *index, cpFloat absolute, cpFloat relative, cpFloat lookahead);
+/// Set a function that gives a per object margin hint, added to the absolute margin. Pass NULL to remove it.
+void cpBBTreeSetMarginFunc(cpSpatialIndex *index, cpBBTreeMarginFunc func);
+/// Number of times a leaf was reinserted because its object moved out of its fattened bounding box.
+/// Returns 0 for other kinds of spatial indexes.
+unsigned long cpBBTreeGetReinsertCount(cpSpatialIndex *index);
+
+/// Set how many leaves are reinserted each time the tree is reindexed to keep it from degrading over time. Defaults to 0.
+/// The tree is already rotated into a better shape along the path of every leaf that is inserted or moves out of its bounds,
+/// so this only matters when leaves are removed a lot or sit still for a long time.
+void cpBBTreeSetRebalanceBudget(cpSpatialIndex *index, int budget);
+
+/// Number of buckets in cpBBTreeQuality.depthHistogram.
+#define CP_BBTREE_DEPTH_BUCKETS 32
+
+/// Measurements of how well a bounding box tree is organized, see cpBBTreeGetQuality().
+typedef struct cpBBTreeQuality {
+	/// Number of leaves in the tree.
+	int leaves;
+	/// Sum of the areas of the internal nodes. Queries visit nodes roughly in proportion to it, so smaller is better.
+	cpFloat internalArea;
+	/// Area of the root node. internalArea/rootArea measures the tree independently of the size of the world.
+	cpFloat rootArea;
+	/// Depth of the deepest leaf. The root is at depth 0.
+	int maxDepth;
+	/// Average depth of the leaves. About log2(leaves) for a balanced tree.
+	cpFloat averageDepth;
+	/// Number of leaves at each depth. Leaves deeper than the last bucket are counted in it.
+	int depthHistogram[CP_BBTREE_DEPTH_BUCKETS];
+} cpBBTreeQuality;
+
+/// Measure the quality of a bounding box tree. Walks the whole tree, so it's meant for debugging and profiling.
+void cpBBTreeGetQuality(cpSpatialIndex *index, cpBBTreeQuality *quality);
+
 //MARK: Single Axis Sweep
 
 typedef struct cpSweep1D cpSweep1D;
@@ -112,6 +173,19 @@ cpSpatialIndex* cpSweep1DInit(cpSweep1D *sweep, cpSpatialIndexBBFunc bbfunc, cpS
 /// Allocate and initialize a 1D sort and sweep broadphase.
 cpSpatialIndex* cpSweep1DNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
 
+//MARK: Incremental Sweep and Prune
+
+typedef struct cpSweep2D cpSweep2D;
+
+/// Allocate a 2D incremental sweep and prune broadphase.
+/// The endpoints along both axes stay sorted between steps, so reindexing is nearly linear
+/// when objects move a little each step. The overlapping pairs are tracked as the endpoints swap.
+cpSweep2D* cpSweep2DAlloc(void);
+/// Initialize a 2D incremental sweep and prune broadphase.
+cpSpatialIndex* cpSweep2DInit(cpSweep2D *sweep, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
+/// Allocate and initialize a 2D incremental sweep and prune broadphase.
+cpSpatialIndex* cpSweep2DNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
+
 //MARK: Spatial Index Implementation
 
 typedef void (*cpSpatialIndexDestroyImpl)(cpSpatialIndex *index);
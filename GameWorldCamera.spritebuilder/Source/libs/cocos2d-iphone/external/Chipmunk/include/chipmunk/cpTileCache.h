@@ -0,0 +1,86 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// @defgroup cpTileCache cpTileCache
+/// A tile cache generates static segment shapes for a large sampled area, such as destructible terrain, one square tile at a time.
+/// Each tile is traced with marching squares, simplified, and added to the space as a chain of segment shapes on the static body.
+/// When part of the terrain changes, mark that area dirty and only the tiles it touches are regenerated.
+/// Neighboring tiles share the samples along their edges so their outlines meet exactly.
+/// Settings only apply to tiles generated after they are changed. Mark every tile dirty to apply them everywhere.
+/// You must explicitly include the cpTileCache.h header to use them.
+/// @{
+
+#ifndef CHIPMUNK_TILE_CACHE_H
+#define CHIPMUNK_TILE_CACHE_H
+
+#include "cpMarch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cpTileCache cpTileCache;
+
+/// Called for each shape a tile cache creates before it's added to the space.
+/// Use it to set the friction, filter, collision type and so on.
+typedef void (*cpTileCacheShapeFunc)(cpTileCache *cache, cpShape *shape, void *data);
+
+/// Create a tile cache that adds its shapes to @c space.
+/// @c bounds is divided into square tiles @c tileSize wide. Tiles along the top and right edges may extend past @c bounds.
+/// Each tile is sampled on a grid of @c samplesPerTile by @c samplesPerTile points.
+cpTileCache *cpTileCacheNew(cpSpace *space, cpBB bounds, cpFloat tileSize, unsigned long samplesPerTile, cpMarchSampleFunc sample, void *sampleData);
+/// Remove the tile cache's shapes from the space, free them, and free the tile cache.
+void cpTileCacheFree(cpTileCache *cache);
+
+/// Density threshold that the outlines are traced along. Defaults to 0.5.
+cpFloat cpTileCacheGetThreshold(const cpTileCache *cache);
+void cpTileCacheSetThreshold(cpTileCache *cache, cpFloat threshold);
+
+/// Trace the tiles with cpMarchHard() instead of cpMarchSoft(). Defaults to false.
+cpBool cpTileCacheGetMarchHard(const cpTileCache *cache);
+void cpTileCacheSetMarchHard(cpTileCache *cache, cpBool hard);
+
+/// Tolerance passed to cpPolylineSimplifyCurves() for the outlines. Defaults to 0.0, which only removes colinear vertexes.
+cpFloat cpTileCacheGetSimplifyTolerance(const cpTileCache *cache);
+void cpTileCacheSetSimplifyTolerance(cpTileCache *cache, cpFloat tol);
+
+/// Radius of the segment shapes. Defaults to 0.0.
+cpFloat cpTileCacheGetSegmentRadius(const cpTileCache *cache);
+void cpTileCacheSetSegmentRadius(cpTileCache *cache, cpFloat radius);
+
+/// Set the function that's called for each new shape.
+void cpTileCacheSetShapeFunc(cpTileCache *cache, cpTileCacheShapeFunc func, void *data);
+
+/// Remove the shapes of every tile that touches @c bb so they are regenerated by the next cpTileCacheEnsure() call that covers them.
+/// Call this after changing what the sample function returns in that area.
+void cpTileCacheMarkDirty(cpTileCache *cache, cpBB bb);
+
+/// Generate the shapes for every tile that touches @c bb and doesn't have them yet.
+/// Like cpSpaceAddShape(), this can't be called while the space is locked.
+/// Returns the number of tiles generated.
+int cpTileCacheEnsure(cpTileCache *cache, cpBB bb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/// @}
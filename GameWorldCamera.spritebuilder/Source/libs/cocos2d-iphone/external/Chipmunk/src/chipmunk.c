@@ -228,6 +228,8 @@ QHullReduce(cpFloat tol, cpVect *verts, int count, cpVect a, cpVect pivot, cpVec
 		result[index++] = pivot;
 		
 		int right_count = QHullPartition(verts + left_count, count - left_count, pivot, b, tol);
+		if(right_count == 0) return index;
+		
 		return index + QHullReduce(tol, verts + left_count + 1, right_count - 1, pivot, verts[left_count], b, result + index);
 	}
 }
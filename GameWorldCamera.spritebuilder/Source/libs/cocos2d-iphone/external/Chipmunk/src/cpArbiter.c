@@ -338,6 +338,11 @@ cpArbiterInit(cpArbiter *arb, cpShape *a, cpShape *b)
 	arb->stamp = 0;
 	arb->state = CP_ARBITER_STATE_FIRST_COLLISION;
 	
+	arb->reuseOffset = cpvzero;
+	arb->reuseRot = cpv(1.0f, 0.0f);
+	arb->rot_a = arb->rot_b = cpv(1.0f, 0.0f);
+	arb->reuseCount = 0;
+	
 	arb->data = NULL;
 	
 	return arb;
@@ -351,6 +356,23 @@ cpSpaceLookupHandler(cpSpace *space, cpCollisionType a, cpCollisionType b, cpCol
 	return (handler ? handler : defaultValue);
 }
 
+void
+cpArbiterLookupHandlers(cpArbiter *arb, cpSpace *space)
+{
+	cpCollisionType typeA = arb->a->type, typeB = arb->b->type;
+	cpCollisionHandler *defaultHandler = &space->defaultHandler;
+	cpCollisionHandler *handler = arb->handler = cpSpaceLookupHandler(space, typeA, typeB, defaultHandler);
+	
+	// Check if the types match, but don't swap for a default handler which use the wildcard for type A.
+	cpBool swapped = arb->swapped = (typeA != handler->typeA && handler->typeA != CP_WILDCARD_COLLISION_TYPE);
+	
+	if(handler != defaultHandler || space->usesWildcards){
+		// The order of the main handler swaps the wildcard handlers too. Uffda.
+		arb->handlerA = cpSpaceLookupHandler(space, (swapped ? typeB : typeA), CP_WILDCARD_COLLISION_TYPE, &cpCollisionHandlerDoNothing);
+		arb->handlerB = cpSpaceLookupHandler(space, (swapped ? typeA : typeB), CP_WILDCARD_COLLISION_TYPE, &cpCollisionHandlerDoNothing);
+	}
+}
+
 void
 cpArbiterUpdate(cpArbiter *arb, struct cpCollisionInfo *info, cpSpace *space)
 {
@@ -394,18 +416,7 @@ cpArbiterUpdate(cpArbiter *arb, struct cpCollisionInfo *info, cpSpace *space)
 	cpVect surface_vr = cpvsub(b->surfaceV, a->surfaceV);
 	arb->surface_vr = cpvsub(surface_vr, cpvmult(info->n, cpvdot(surface_vr, info->n)));
 	
-	cpCollisionType typeA = info->a->type, typeB = info->b->type;
-	cpCollisionHandler *defaultHandler = &space->defaultHandler;
-	cpCollisionHandler *handler = arb->handler = cpSpaceLookupHandler(space, typeA, typeB, defaultHandler);
-	
-	// Check if the types match, but don't swap for a default handler which use the wildcard for type A.
-	cpBool swapped = arb->swapped = (typeA != handler->typeA && handler->typeA != CP_WILDCARD_COLLISION_TYPE);
-	
-	if(handler != defaultHandler || space->usesWildcards){
-		// The order of the main handler swaps the wildcard handlers too. Uffda.
-		arb->handlerA = cpSpaceLookupHandler(space, (swapped ? typeB : typeA), CP_WILDCARD_COLLISION_TYPE, &cpCollisionHandlerDoNothing);
-		arb->handlerB = cpSpaceLookupHandler(space, (swapped ? typeA : typeB), CP_WILDCARD_COLLISION_TYPE, &cpCollisionHandlerDoNothing);
-	}
+	cpArbiterLookupHandlers(arb, space);
 		
 	// mark it as new if it's been cached
 	if(arb->state == CP_ARBITER_STATE_CACHED) arb->state = CP_ARBITER_STATE_FIRST_COLLISION;
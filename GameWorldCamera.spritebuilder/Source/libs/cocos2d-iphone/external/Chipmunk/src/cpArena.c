@@ -0,0 +1,268 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+// Size classes are powers of two starting at 1<<MIN_CLASS_SHIFT bytes.
+#define MIN_CLASS_SHIFT 4
+#define CLASS_COUNT 16
+
+#define DEFAULT_SLAB_BYTES (1024*1024)
+
+typedef struct FreeBlock {
+	struct FreeBlock *next;
+} FreeBlock;
+
+// Requests too big for the size classes go straight to cpcalloc().
+// The header is padded to keep the memory after it 16 byte aligned.
+typedef struct LargeBlock {
+	struct LargeBlock *prev, *next;
+	size_t size, padding;
+} LargeBlock;
+
+struct cpArena {
+	cpAllocator allocator;
+	
+	size_t slabBytes;
+	cpArray *slabs;
+	
+	// Slab that new blocks are carved from, -1 if none yet.
+	int slabIndex;
+	size_t slabOffset;
+	
+	FreeBlock *freeLists[CLASS_COUNT];
+	LargeBlock *largeBlocks;
+	
+	size_t bytesInUse, peakBytes, reservedBytes;
+};
+
+//MARK: Allocator Functions
+
+void *
+cpAllocatorAlloc(const cpAllocator *allocator, size_t size)
+{
+	return (allocator ? allocator->alloc(size, allocator->data) : cpcalloc(1, size));
+}
+
+void
+cpAllocatorFree(const cpAllocator *allocator, void *ptr, size_t size)
+{
+	if(allocator){
+		allocator->free(ptr, size, allocator->data);
+	} else {
+		cpfree(ptr);
+	}
+}
+
+void
+cpAllocatorFreeBuffers(const cpAllocator *allocator, cpArray *buffers)
+{
+	if(buffers){
+		for(int i=0; i<buffers->num; i++) cpAllocatorFree(allocator, buffers->arr[i], CP_BUFFER_BYTES);
+		cpArrayFree(buffers);
+	}
+}
+
+//MARK: Arena Functions
+
+// Returns -1 if the request is too big for the size classes.
+static inline int
+SizeClass(cpArena *arena, size_t size)
+{
+	size_t classBytes = (size_t)1 << MIN_CLASS_SHIFT;
+	
+	for(int i=0; i<CLASS_COUNT; i++, classBytes <<= 1){
+		if(classBytes > arena->slabBytes) break;
+		if(size <= classBytes) return i;
+	}
+	
+	return -1;
+}
+
+static inline size_t
+ClassBytes(int sizeClass)
+{
+	return (size_t)1 << (MIN_CLASS_SHIFT + sizeClass);
+}
+
+static void *
+SlabAlloc(cpArena *arena, size_t bytes)
+{
+	if(arena->slabIndex < 0 || arena->slabOffset + bytes > arena->slabBytes){
+		// Move on to the next slab. The rest of the current one is wasted.
+		arena->slabIndex++;
+		arena->slabOffset = 0;
+		
+		if(arena->slabIndex == arena->slabs->num){
+			cpArrayPush(arena->slabs, cpcalloc(1, arena->slabBytes));
+			arena->reservedBytes += arena->slabBytes;
+		}
+	}
+	
+	void *ptr = (char *)arena->slabs->arr[arena->slabIndex] + arena->slabOffset;
+	arena->slabOffset += bytes;
+	
+	return ptr;
+}
+
+static void *
+ArenaAlloc(size_t size, cpArena *arena)
+{
+	int sizeClass = SizeClass(arena, size);
+	void *ptr = NULL;
+	
+	if(sizeClass < 0){
+		LargeBlock *block = (LargeBlock *)cpcalloc(1, sizeof(LargeBlock) + size);
+		block->size = size;
+		block->prev = NULL;
+		block->next = arena->largeBlocks;
+		if(block->next) block->next->prev = block;
+		arena->largeBlocks = block;
+		
+		arena->reservedBytes += size;
+		ptr = block + 1;
+	} else {
+		size = ClassBytes(sizeClass);
+		
+		FreeBlock *block = arena->freeLists[sizeClass];
+		if(block){
+			arena->freeLists[sizeClass] = block->next;
+			ptr = block;
+		} else {
+			ptr = SlabAlloc(arena, size);
+		}
+		
+		// Slabs are reused after a reset, so the memory always needs to be cleared.
+		memset(ptr, 0, size);
+	}
+	
+	arena->bytesInUse += size;
+	if(arena->bytesInUse > arena->peakBytes) arena->peakBytes = arena->bytesInUse;
+	
+	return ptr;
+}
+
+static void
+ArenaFree(void *ptr, size_t size, cpArena *arena)
+{
+	int sizeClass = SizeClass(arena, size);
+	
+	if(sizeClass < 0){
+		LargeBlock *block = (LargeBlock *)ptr - 1;
+		if(block->prev) block->prev->next = block->next; else arena->largeBlocks = block->next;
+		if(block->next) block->next->prev = block->prev;
+		
+		arena->reservedBytes -= size;
+		cpfree(block);
+	} else {
+		size = ClassBytes(sizeClass);
+		
+		FreeBlock *block = (FreeBlock *)ptr;
+		block->next = arena->freeLists[sizeClass];
+		arena->freeLists[sizeClass] = block;
+	}
+	
+	arena->bytesInUse -= size;
+}
+
+static void
+FreeLargeBlocks(cpArena *arena)
+{
+	for(LargeBlock *block = arena->largeBlocks, *next; block; block = next){
+		next = block->next;
+		arena->reservedBytes -= block->size;
+		cpfree(block);
+	}
+	
+	arena->largeBlocks = NULL;
+}
+
+cpArena *
+cpArenaNew(size_t slabBytes)
+{
+	cpArena *arena = (cpArena *)cpcalloc(1, sizeof(cpArena));
+	
+	arena->allocator.alloc = (void *(*)(size_t, void *))ArenaAlloc;
+	arena->allocator.free = (void (*)(void *, size_t, void *))ArenaFree;
+	arena->allocator.data = arena;
+	
+	arena->slabBytes = (slabBytes ? slabBytes : DEFAULT_SLAB_BYTES);
+	arena->slabs = cpArrayNew(0);
+	arena->slabIndex = -1;
+	arena->slabOffset = 0;
+	
+	arena->largeBlocks = NULL;
+	arena->bytesInUse = arena->peakBytes = arena->reservedBytes = 0;
+	
+	return arena;
+}
+
+void
+cpArenaFree(cpArena *arena)
+{
+	if(arena){
+		FreeLargeBlocks(arena);
+		
+		cpArrayFreeEach(arena->slabs, cpfree);
+		cpArrayFree(arena->slabs);
+		
+		cpfree(arena);
+	}
+}
+
+const cpAllocator *
+cpArenaGetAllocator(cpArena *arena)
+{
+	return &arena->allocator;
+}
+
+void
+cpArenaReset(cpArena *arena)
+{
+	FreeLargeBlocks(arena);
+	
+	for(int i=0; i<CLASS_COUNT; i++) arena->freeLists[i] = NULL;
+	arena->slabIndex = -1;
+	arena->slabOffset = 0;
+	
+	arena->bytesInUse = 0;
+	arena->peakBytes = 0;
+}
+
+size_t
+cpArenaGetBytesInUse(cpArena *arena)
+{
+	return arena->bytesInUse;
+}
+
+size_t
+cpArenaGetPeakBytes(cpArena *arena)
+{
+	return arena->peakBytes;
+}
+
+size_t
+cpArenaGetReservedBytes(cpArena *arena)
+{
+	return arena->reservedBytes;
+}
@@ -21,6 +21,7 @@
 
 #include "stdlib.h"
 #include "stdio.h"
+#include "string.h"
 
 #include "chipmunk/chipmunk_private.h"
 
@@ -28,19 +29,41 @@ static inline cpSpatialIndexClass *Klass();
 
 typedef struct Node Node;
 typedef struct Pair Pair;
+typedef struct ParallelReindex ParallelReindex;
+typedef struct FlatNode FlatNode;
 
 struct cpBBTree {
 	cpSpatialIndex spatialIndex;
 	cpBBTreeVelocityFunc velocityFunc;
 	
+	// How much the leaves of a tree with a velocity function are fattened, see cpBBTreeSetMargins().
+	cpFloat marginAbsolute, marginRelative, velocityLookahead;
+	cpBBTreeMarginFunc marginFunc;
+	
 	cpHashSet *leaves;
 	Node *root;
 	
+	// Second static tree for the shapes of sleeping bodies, see cpBBTreeSetSleepingIndex().
+	cpBBTree *sleepingTree;
+	
 	Node *pooledNodes;
 	Pair *pooledPairs;
 	cpArray *allocatedBuffers;
 	
 	cpTimestamp stamp;
+	
+	cpThreadPool *threadPool;
+	ParallelReindex *parallelReindex;
+	
+	// Frozen copy of the tree built by cpBBTreeOptimize() for faster queries.
+	// Freed as soon as the tree changes.
+	FlatNode *flatNodes;
+	
+	// Number of leaves reinserted by each reindex to keep the tree from degrading, see cpBBTreeSetRebalanceBudget().
+	int rebalanceBudget;
+	
+	// Leaves reinserted because they moved out of their fat bounding boxes.
+	unsigned long reinsertCount;
 };
 
 struct Node {
@@ -55,6 +78,8 @@ struct Node {
 		// Leaves
 		struct {
 			cpTimestamp stamp;
+			// Scratch value, cpBBTreeWriteSnapshot() numbers the leaves with it.
+			unsigned int tag;
 			Pair *pairs;
 		} leaf;
 	} node;
@@ -65,6 +90,18 @@ struct Node {
 #define B node.children.b
 #define STAMP node.leaf.stamp
 #define PAIRS node.leaf.pairs
+#define TAG node.leaf.tag
+
+// Nodes of the frozen tree are stored depth first in a single array.
+// The first child of an internal node always follows it, so only the index of the second child is stored.
+struct FlatNode {
+	cpBB bb;
+	void *obj;
+	uint32_t other;
+};
+
+// Deeper trees are not flattened so the queries can use a fixed size stack.
+#define FLAT_MAX_DEPTH 128
 
 typedef struct Thread {
 	Pair *prev;
@@ -86,11 +123,12 @@ GetBB(cpBBTree *tree, void *obj)
 	
 	cpBBTreeVelocityFunc velocityFunc = tree->velocityFunc;
 	if(velocityFunc){
-		cpFloat coef = 0.1f;
-		cpFloat x = (bb.r - bb.l)*coef;
-		cpFloat y = (bb.t - bb.b)*coef;
+		// Each side is pushed out by the size margin or by how far the object is predicted to move, whichever is more.
+		cpFloat margin = tree->marginAbsolute + (tree->marginFunc ? tree->marginFunc(obj) : 0.0f);
+		cpFloat x = margin + (bb.r - bb.l)*tree->marginRelative;
+		cpFloat y = margin + (bb.t - bb.b)*tree->marginRelative;
 		
-		cpVect v = cpvmult(velocityFunc(obj), 0.1f);
+		cpVect v = cpvmult(velocityFunc(obj), tree->velocityLookahead);
 		return cpBBNew(bb.l + cpfmin(-x, v.x), bb.b + cpfmin(-y, v.y), bb.r + cpfmax(x, v.x), bb.t + cpfmax(y, v.y));
 	} else {
 		return bb;
@@ -156,7 +194,7 @@ PairFromPool(cpBBTree *tree)
 		int count = CP_BUFFER_BYTES/sizeof(Pair);
 		cpAssertHard(count, "Internal Error: Buffer size is too small.");
 		
-		Pair *buffer = (Pair *)cpcalloc(1, CP_BUFFER_BYTES);
+		Pair *buffer = (Pair *)cpAllocatorAlloc(tree->spatialIndex.allocator, CP_BUFFER_BYTES);
 		cpArrayPush(tree->allocatedBuffers, buffer);
 		
 		// push all but the first one, return the first instead
@@ -245,7 +283,7 @@ NodeFromPool(cpBBTree *tree)
 		int count = CP_BUFFER_BYTES/sizeof(Node);
 		cpAssertHard(count, "Internal Error: Buffer size is too small.");
 		
-		Node *buffer = (Node *)cpcalloc(1, CP_BUFFER_BYTES);
+		Node *buffer = (Node *)cpAllocatorAlloc(tree->spatialIndex.allocator, CP_BUFFER_BYTES);
 		cpArrayPush(tree->allocatedBuffers, buffer);
 		
 		// push all but the first one, return the first instead
@@ -349,6 +387,54 @@ SubtreeInsert(Node *subtree, Node *leaf, cpBBTree *tree)
 	}
 }
 
+// Swap one child of the node with a grandchild from its other side if that shrinks the child that gets the swapped node.
+// The node keeps the same leaves, so its own bounds and the bounds of its ancestors don't change.
+static void
+NodeRotate(Node *node)
+{
+	Node *a = node->A, *b = node->B;
+	
+	// 1 and 2 swap b with the A or B child of a, 3 and 4 swap a with the A or B child of b.
+	int rotation = 0;
+	cpFloat best = 0.0f;
+	
+	if(!NodeIsLeaf(a)){
+		cpFloat area = cpBBArea(a->bb);
+		cpFloat gain1 = area - cpBBMergedArea(b->bb, a->B->bb);
+		cpFloat gain2 = area - cpBBMergedArea(b->bb, a->A->bb);
+		if(gain1 > best){best = gain1; rotation = 1;}
+		if(gain2 > best){best = gain2; rotation = 2;}
+	}
+	
+	if(!NodeIsLeaf(b)){
+		cpFloat area = cpBBArea(b->bb);
+		cpFloat gain3 = area - cpBBMergedArea(a->bb, b->B->bb);
+		cpFloat gain4 = area - cpBBMergedArea(a->bb, b->A->bb);
+		if(gain3 > best){best = gain3; rotation = 3;}
+		if(gain4 > best){best = gain4; rotation = 4;}
+	}
+	
+	switch(rotation){
+		case 1: {Node *child = a->A; NodeSetA(a, b); NodeSetB(node, child); break;}
+		case 2: {Node *child = a->B; NodeSetB(a, b); NodeSetB(node, child); break;}
+		case 3: {Node *child = b->A; NodeSetA(b, a); NodeSetA(node, child); break;}
+		case 4: {Node *child = b->B; NodeSetB(b, a); NodeSetA(node, child); break;}
+		default: return;
+	}
+	
+	Node *changed = (rotation <= 2 ? a : b);
+	changed->bb = cpBBMerge(changed->A->bb, changed->B->bb);
+}
+
+// Insert a leaf, then rotate the nodes along its path back to the root.
+// SubtreeInsert() only looks one level ahead, so this keeps the tree from slowly skewing as leaves move around.
+static void
+TreeInsertLeaf(cpBBTree *tree, Node *leaf)
+{
+	tree->root = SubtreeInsert(tree->root, leaf, tree);
+	for(Node *node = leaf->parent; node; node = node->parent) NodeRotate(node);
+}
+
 static void
 SubtreeQuery(Node *subtree, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
 {
@@ -417,22 +503,42 @@ SubtreeRemove(Node *subtree, Node *leaf, cpBBTree *tree)
 
 typedef struct MarkContext {
 	cpBBTree *tree;
-	Node *staticRoot;
+	Node *staticRoot, *sleepingRoot;
 	cpSpatialIndexQueryFunc func;
 	void *data;
 } MarkContext;
 
+static inline void
+MarkLeafHit(Node *leaf, Node *other, cpBool left, MarkContext *context)
+{
+	if(left){
+		PairInsert(leaf, other, context->tree);
+	} else {
+		if(other->STAMP < leaf->STAMP) PairInsert(other, leaf, context->tree);
+		context->func(leaf->obj, other->obj, 0, context->data);
+	}
+}
+
+static void
+MarkLeafPairs(Node *leaf, MarkContext *context)
+{
+	Pair *pair = leaf->PAIRS;
+	while(pair){
+		if(leaf == pair->b.leaf){
+			pair->id = context->func(pair->a.leaf->obj, leaf->obj, pair->id, context->data);
+			pair = pair->b.next;
+		} else {
+			pair = pair->a.next;
+		}
+	}
+}
+
 static void
 MarkLeafQuery(Node *subtree, Node *leaf, cpBool left, MarkContext *context)
 {
 	if(cpBBIntersects(leaf->bb, subtree->bb)){
 		if(NodeIsLeaf(subtree)){
-			if(left){
-				PairInsert(leaf, subtree, context->tree);
-			} else {
-				if(subtree->STAMP < leaf->STAMP) PairInsert(subtree, leaf, context->tree);
-				context->func(leaf->obj, subtree->obj, 0, context->data);
-			}
+			MarkLeafHit(leaf, subtree, left, context);
 		} else {
 			MarkLeafQuery(subtree->A, leaf, left, context);
 			MarkLeafQuery(subtree->B, leaf, left, context);
@@ -448,6 +554,9 @@ MarkLeaf(Node *leaf, MarkContext *context)
 		Node *staticRoot = context->staticRoot;
 		if(staticRoot) MarkLeafQuery(staticRoot, leaf, cpFalse, context);
 		
+		Node *sleepingRoot = context->sleepingRoot;
+		if(sleepingRoot) MarkLeafQuery(sleepingRoot, leaf, cpFalse, context);
+		
 		for(Node *node = leaf; node->parent; node = node->parent){
 			if(node == node->parent->A){
 				MarkLeafQuery(node->parent->B, leaf, cpTrue, context);
@@ -456,15 +565,7 @@ MarkLeaf(Node *leaf, MarkContext *context)
 			}
 		}
 	} else {
-		Pair *pair = leaf->PAIRS;
-		while(pair){
-			if(leaf == pair->b.leaf){
-				pair->id = context->func(pair->a.leaf->obj, leaf->obj, pair->id, context->data);
-				pair = pair->b.next;
-			} else {
-				pair = pair->a.next;
-			}
-		}
+		MarkLeafPairs(leaf, context);
 	}
 }
 
@@ -495,21 +596,29 @@ LeafNew(cpBBTree *tree, void *obj, cpBB bb)
 	return node;
 }
 
+static void FlatNodesInvalidate(cpBBTree *tree);
+
+static void
+LeafReinsert(Node *leaf, cpBBTree *tree)
+{
+	FlatNodesInvalidate(tree);
+	leaf->bb = GetBB(tree, leaf->obj);
+	tree->reinsertCount++;
+	
+	tree->root = SubtreeRemove(tree->root, leaf, tree);
+	TreeInsertLeaf(tree, leaf);
+	
+	PairsClear(leaf, tree);
+	leaf->STAMP = GetMasterTree(tree)->stamp;
+}
+
 static cpBool
 LeafUpdate(Node *leaf, cpBBTree *tree)
 {
-	Node *root = tree->root;
 	cpBB bb = tree->spatialIndex.bbfunc(leaf->obj);
 	
 	if(!cpBBContainsBB(leaf->bb, bb)){
-		leaf->bb = GetBB(tree, leaf->obj);
-		
-		root = SubtreeRemove(root, leaf, tree);
-		tree->root = SubtreeInsert(root, leaf, tree);
-		
-		PairsClear(leaf, tree);
-		leaf->STAMP = GetMasterTree(tree)->stamp;
-		
+		LeafReinsert(leaf, tree);
 		return cpTrue;
 	} else {
 		return cpFalse;
@@ -526,12 +635,13 @@ LeafAddPairs(Node *leaf, cpBBTree *tree)
 		Node *dynamicRoot = GetRootIfTree(dynamicIndex);
 		if(dynamicRoot){
 			cpBBTree *dynamicTree = GetTree(dynamicIndex);
-			MarkContext context = {dynamicTree, NULL, NULL, NULL};
+			MarkContext context = {dynamicTree, NULL, NULL, NULL, NULL};
 			MarkLeafQuery(dynamicRoot, leaf, cpTrue, &context);
 		}
 	} else {
 		Node *staticRoot = GetRootIfTree(tree->spatialIndex.staticIndex);
-		MarkContext context = {tree, staticRoot, VoidQueryFunc, NULL};
+		Node *sleepingRoot = (tree->sleepingTree ? tree->sleepingTree->root : NULL);
+		MarkContext context = {tree, staticRoot, sleepingRoot, VoidQueryFunc, NULL};
 		MarkLeaf(leaf, &context);
 	}
 }
@@ -563,14 +673,27 @@ cpBBTreeInit(cpBBTree *tree, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *static
 	
 	tree->velocityFunc = NULL;
 	
+	tree->marginAbsolute = 0.0f;
+	tree->marginRelative = 0.1f;
+	tree->velocityLookahead = 0.1f;
+	tree->marginFunc = NULL;
+	
 	tree->leaves = cpHashSetNew(0, (cpHashSetEqlFunc)leafSetEql);
 	tree->root = NULL;
+	tree->sleepingTree = NULL;
 	
 	tree->pooledNodes = NULL;
 	tree->allocatedBuffers = cpArrayNew(0);
 	
 	tree->stamp = 0;
 	
+	tree->threadPool = NULL;
+	tree->parallelReindex = NULL;
+	tree->flatNodes = NULL;
+	
+	tree->rebalanceBudget = 0;
+	tree->reinsertCount = 0;
+	
 	return (cpSpatialIndex *)tree;
 }
 
@@ -585,19 +708,94 @@ cpBBTreeSetVelocityFunc(cpSpatialIndex *index, cpBBTreeVelocityFunc func)
 	((cpBBTree *)index)->velocityFunc = func;
 }
 
+void
+cpBBTreeSetMargins(cpSpatialIndex *index, cpFloat absolute, cpFloat relative, cpFloat lookahead)
+{
+	if(index->klass != Klass()){
+		cpAssertWarn(cpFalse, "Ignoring cpBBTreeSetMargins() call to non-tree spatial index.");
+		return;
+	}
+	
+	cpBBTree *tree = (cpBBTree *)index;
+	tree->marginAbsolute = absolute;
+	tree->marginRelative = relative;
+	tree->velocityLookahead = lookahead;
+}
+
+void
+cpBBTreeSetMarginFunc(cpSpatialIndex *index, cpBBTreeMarginFunc func)
+{
+	if(index->klass != Klass()){
+		cpAssertWarn(cpFalse, "Ignoring cpBBTreeSetMarginFunc() call to non-tree spatial index.");
+		return;
+	}
+	
+	((cpBBTree *)index)->marginFunc = func;
+}
+
+unsigned long
+cpBBTreeGetReinsertCount(cpSpatialIndex *index)
+{
+	return (index->klass == Klass() ? ((cpBBTree *)index)->reinsertCount : 0);
+}
+
+void
+cpBBTreeSetRebalanceBudget(cpSpatialIndex *index, int budget)
+{
+	if(index->klass != Klass()){
+		cpAssertWarn(cpFalse, "Ignoring cpBBTreeSetRebalanceBudget() call to non-tree spatial index.");
+		return;
+	}
+	
+	((cpBBTree *)index)->rebalanceBudget = budget;
+}
+
+void
+cpBBTreeSetThreadPool(cpSpatialIndex *index, cpThreadPool *pool)
+{
+	// Silently ignored so spaces can pass their pool to whatever index they are using.
+	if(index->klass != Klass()) return;
+	
+	((cpBBTree *)index)->threadPool = pool;
+}
+
+void
+cpBBTreeSetSleepingIndex(cpSpatialIndex *index, cpSpatialIndex *sleepingIndex)
+{
+	cpAssertHard(sleepingIndex->klass == Klass(), "Internal Error: The sleeping index must be a bounding box tree.");
+	cpAssertHard(cpSpatialIndexCount(sleepingIndex) == 0, "Internal Error: The sleeping index must be empty.");
+	
+	// Like a static index, inserting into the sleeping tree finds its pairs in the dynamic index.
+	sleepingIndex->dynamicIndex = index;
+	if(index->klass == Klass()) ((cpBBTree *)index)->sleepingTree = (cpBBTree *)sleepingIndex;
+}
+
+void
+cpBBTreeSetAllocator(cpSpatialIndex *index, const cpAllocator *allocator)
+{
+	if(index->klass != Klass()) return;
+	
+	cpBBTree *tree = (cpBBTree *)index;
+	cpAssertHard(tree->allocatedBuffers->num == 0, "The allocator must be set before anything is added.");
+	cpHashSetSetAllocator(tree->leaves, allocator);
+}
+
 cpSpatialIndex *
 cpBBTreeNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
 {
 	return cpBBTreeInit(cpBBTreeAlloc(), bbfunc, staticIndex);
 }
 
+static void ParallelReindexFree(ParallelReindex *reindex);
+
 static void
 cpBBTreeDestroy(cpBBTree *tree)
 {
 	cpHashSetFree(tree->leaves);
+	ParallelReindexFree(tree->parallelReindex);
+	FlatNodesInvalidate(tree);
 	
-	if(tree->allocatedBuffers) cpArrayFreeEach(tree->allocatedBuffers, cpfree);
-	cpArrayFree(tree->allocatedBuffers);
+	cpAllocatorFreeBuffers(tree->spatialIndex.allocator, tree->allocatedBuffers);
 }
 
 //MARK: Insert/Remove
@@ -606,9 +804,8 @@ static void
 cpBBTreeInsert(cpBBTree *tree, void *obj, cpHashValue hashid)
 {
 	Node *leaf = (Node *)cpHashSetInsert(tree->leaves, hashid, obj, (cpHashSetTransFunc)leafSetTrans, tree);
-	
-	Node *root = tree->root;
-	tree->root = SubtreeInsert(root, leaf, tree);
+	FlatNodesInvalidate(tree);
+	TreeInsertLeaf(tree, leaf);
 	
 	leaf->STAMP = GetMasterTree(tree)->stamp;
 	LeafAddPairs(leaf, tree);
@@ -619,6 +816,7 @@ static void
 cpBBTreeRemove(cpBBTree *tree, void *obj, cpHashValue hashid)
 {
 	Node *leaf = (Node *)cpHashSetRemove(tree->leaves, hashid, obj);
+	FlatNodesInvalidate(tree);
 	
 	tree->root = SubtreeRemove(tree->root, leaf, tree);
 	PairsClear(leaf, tree);
@@ -635,19 +833,55 @@ cpBBTreeContains(cpBBTree *tree, void *obj, cpHashValue hashid)
 
 static void LeafUpdateWrap(Node *leaf, cpBBTree *tree) {LeafUpdate(leaf, tree);}
 
+static void ParallelReindexQuery(cpBBTree *tree, MarkContext *context);
+
+// Trees with fewer leaves than this are always reindexed on the calling thread.
+#define PARALLEL_REINDEX_THRESHOLD 1024
+
+// Reinsert a few leaves picked along pseudo random paths so the whole tree gets revisited over time.
+// Where a leaf is in the tree doesn't change which leaves it overlaps, so its pairs are kept.
+static void
+TreeRebalance(cpBBTree *tree, int budget)
+{
+	if(budget <= 0 || NodeIsLeaf(tree->root)) return;
+	FlatNodesInvalidate(tree);
+	
+	// Derive the paths from the stamp so they are the same when a restored snapshot is stepped again.
+	uint32_t path = (uint32_t)GetMasterTree(tree)->stamp*2654435761u;
+	
+	for(int i=0; i<budget; i++){
+		path = path*1664525u + 1013904223u;
+		
+		Node *leaf = tree->root;
+		for(uint32_t bits = path; !NodeIsLeaf(leaf); bits = (bits >> 1) | (bits << 31)){
+			leaf = (bits & 0x80000000u ? leaf->A : leaf->B);
+		}
+		
+		tree->root = SubtreeRemove(tree->root, leaf, tree);
+		TreeInsertLeaf(tree, leaf);
+	}
+}
+
 static void
 cpBBTreeReindexQuery(cpBBTree *tree, cpSpatialIndexQueryFunc func, void *data)
 {
 	if(!tree->root) return;
 	
-	// LeafUpdate() may modify tree->root. Don't cache it.
-	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)LeafUpdateWrap, tree);
+	TreeRebalance(tree, tree->rebalanceBudget);
 	
 	cpSpatialIndex *staticIndex = tree->spatialIndex.staticIndex;
 	Node *staticRoot = (staticIndex && staticIndex->klass == Klass() ? ((cpBBTree *)staticIndex)->root : NULL);
+	Node *sleepingRoot = (tree->sleepingTree ? tree->sleepingTree->root : NULL);
+	MarkContext context = {tree, staticRoot, sleepingRoot, func, data};
+	
+	if(cpThreadPoolGetThreads(tree->threadPool) > 1 && cpHashSetCount(tree->leaves) >= PARALLEL_REINDEX_THRESHOLD){
+		ParallelReindexQuery(tree, &context);
+	} else {
+		// LeafUpdate() may modify tree->root. Don't cache it.
+		cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)LeafUpdateWrap, tree);
+		MarkSubtree(tree->root, &context);
+	}
 	
-	MarkContext context = {tree, staticRoot, func, data};
-	MarkSubtree(tree->root, &context);
 	if(staticIndex && !staticRoot) cpSpatialIndexCollideStatic((cpSpatialIndex *)tree, staticIndex, func, data);
 	
 	IncrementStamp(tree);
@@ -671,150 +905,609 @@ cpBBTreeReindexObject(cpBBTree *tree, void *obj, cpHashValue hashid)
 
 //MARK: Query
 
+// Same traversal order as SubtreeQuery().
+static void
+FlatQuery(FlatNode *nodes, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	uint32_t stack[FLAT_MAX_DEPTH + 1];
+	int top = 0;
+	stack[top++] = 0;
+	
+	while(top){
+		FlatNode *node = nodes + stack[--top];
+		
+		if(cpBBIntersects(node->bb, bb)){
+			if(node->obj){
+				func(obj, node->obj, 0, data);
+			} else {
+				stack[top++] = node->other;
+				stack[top++] = (uint32_t)(node - nodes) + 1;
+			}
+		}
+	}
+}
+
+// Same traversal order and pruning as SubtreeSegmentQuery().
+static void
+FlatSegmentQuery(FlatNode *nodes, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
+{
+	if(nodes[0].obj){
+		func(obj, nodes[0].obj, data);
+		return;
+	}
+	
+	struct {uint32_t index; cpFloat t;} stack[FLAT_MAX_DEPTH + 1];
+	int top = 0;
+	stack[top].index = 0; stack[top].t = 0.0f; top++;
+	
+	while(top){
+		top--;
+		if(stack[top].t >= t_exit) continue;
+		
+		FlatNode *node = nodes + stack[top].index;
+		if(node->obj){
+			t_exit = cpfmin(t_exit, func(obj, node->obj, data));
+		} else {
+			uint32_t index_a = (uint32_t)(node - nodes) + 1, index_b = node->other;
+			cpFloat t_a = cpBBSegmentQuery(nodes[index_a].bb, a, b);
+			cpFloat t_b = cpBBSegmentQuery(nodes[index_b].bb, a, b);
+			
+			// Push the farther child first so the nearer one is visited first.
+			if(t_a < t_b){
+				stack[top].index = index_b; stack[top].t = t_b; top++;
+				stack[top].index = index_a; stack[top].t = t_a; top++;
+			} else {
+				stack[top].index = index_a; stack[top].t = t_a; top++;
+				stack[top].index = index_b; stack[top].t = t_b; top++;
+			}
+		}
+	}
+}
+
 static void
 cpBBTreeSegmentQuery(cpBBTree *tree, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
 {
 	Node *root = tree->root;
-	if(root) SubtreeSegmentQuery(root, obj, a, b, t_exit, func, data);
+	if(tree->flatNodes){
+		FlatSegmentQuery(tree->flatNodes, obj, a, b, t_exit, func, data);
+	} else if(root){
+		SubtreeSegmentQuery(root, obj, a, b, t_exit, func, data);
+	}
 }
 
 static void
 cpBBTreeQuery(cpBBTree *tree, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
 {
-	if(tree->root) SubtreeQuery(tree->root, obj, bb, func, data);
+	if(tree->flatNodes){
+		FlatQuery(tree->flatNodes, obj, bb, func, data);
+	} else if(tree->root){
+		SubtreeQuery(tree->root, obj, bb, func, data);
+	}
 }
 
-//MARK: Misc
+//MARK: Parallel Reindex
 
-static int
-cpBBTreeCount(cpBBTree *tree)
-{
-	return cpHashSetCount(tree->leaves);
-}
+// The parallel reindex produces exactly the same tree, pairs and callback order as the serial one.
+// Only the read-only parts run on the workers: checking which leaves escaped their bounding boxes,
+// and querying the trees for the leaves that moved. Tree updates, pair insertion and the query
+// callbacks are replayed on the calling thread in the same order MarkSubtree() would use.
 
-typedef struct eachContext {
-	cpSpatialIndexIteratorFunc func;
-	void *data;
-} eachContext;
+typedef struct MarkHit {
+	Node *node;
+	cpBool left;
+} MarkHit;
 
-static void each_helper(Node *node, eachContext *context){context->func(node->obj, context->data);}
+typedef struct HitBuffer {
+	int num, max;
+	MarkHit *hits;
+} HitBuffer;
 
-static void
-cpBBTreeEach(cpBBTree *tree, cpSpatialIndexIteratorFunc func, void *data)
-{
-	eachContext context = {func, data};
-	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)each_helper, &context);
-}
+typedef struct MovedLeaf {
+	Node *leaf;
+	int worker, start, count;
+} MovedLeaf;
 
-static cpSpatialIndexClass klass = {
-	(cpSpatialIndexDestroyImpl)cpBBTreeDestroy,
-	
-	(cpSpatialIndexCountImpl)cpBBTreeCount,
-	(cpSpatialIndexEachImpl)cpBBTreeEach,
+struct ParallelReindex {
+	cpBBTree *tree;
+	Node *staticRoot, *sleepingRoot;
+	unsigned long threads;
 	
-	(cpSpatialIndexContainsImpl)cpBBTreeContains,
-	(cpSpatialIndexInsertImpl)cpBBTreeInsert,
-	(cpSpatialIndexRemoveImpl)cpBBTreeRemove,
+	// Leaves in cpHashSetEach() order and whether each one escaped its bounding box.
+	int leafCount, leafCapacity;
+	Node **leaves;
+	cpBool *escaped;
 	
-	(cpSpatialIndexReindexImpl)cpBBTreeReindex,
-	(cpSpatialIndexReindexObjectImpl)cpBBTreeReindexObject,
-	(cpSpatialIndexReindexQueryImpl)cpBBTreeReindexQuery,
+	// Moved leaves in MarkSubtree() order.
+	int movedCount, movedCapacity;
+	MovedLeaf *moved;
 	
-	(cpSpatialIndexQueryImpl)cpBBTreeQuery,
-	(cpSpatialIndexSegmentQueryImpl)cpBBTreeSegmentQuery,
+	// One hit buffer per thread.
+	int bufferCount;
+	HitBuffer *buffers;
 };
 
-static inline cpSpatialIndexClass *Klass(){return &klass;}
-
-
-//MARK: Tree Optimization
-
-static int
-cpfcompare(const cpFloat *a, const cpFloat *b){
-	return (*a < *b ? -1 : (*b < *a ? 1 : 0));
+static void
+ParallelReindexFree(ParallelReindex *reindex)
+{
+	if(reindex){
+		for(int i=0; i<reindex->bufferCount; i++) cpfree(reindex->buffers[i].hits);
+		cpfree(reindex->buffers);
+		cpfree(reindex->leaves);
+		cpfree(reindex->escaped);
+		cpfree(reindex->moved);
+		cpfree(reindex);
+	}
 }
 
 static void
-fillNodeArray(Node *node, Node ***cursor){
-	(**cursor) = node;
-	(*cursor)++;
+PushLeaf(Node *leaf, ParallelReindex *reindex)
+{
+	if(reindex->leafCount == reindex->leafCapacity){
+		reindex->leafCapacity = (reindex->leafCapacity ? 2*reindex->leafCapacity : 1024);
+		reindex->leaves = (Node **)cprealloc(reindex->leaves, reindex->leafCapacity*sizeof(Node *));
+		reindex->escaped = (cpBool *)cprealloc(reindex->escaped, reindex->leafCapacity*sizeof(cpBool));
+	}
+	
+	reindex->leaves[reindex->leafCount++] = leaf;
 }
 
-static Node *
-partitionNodes(cpBBTree *tree, Node **nodes, int count)
+static void
+PushMoved(Node *leaf, ParallelReindex *reindex)
 {
-	if(count == 1){
-		return nodes[0];
-	} else if(count == 2) {
-		return NodeNew(tree, nodes[0], nodes[1]);
+	if(reindex->movedCount == reindex->movedCapacity){
+		reindex->movedCapacity = (reindex->movedCapacity ? 2*reindex->movedCapacity : 256);
+		reindex->moved = (MovedLeaf *)cprealloc(reindex->moved, reindex->movedCapacity*sizeof(MovedLeaf));
 	}
 	
-	// Find the AABB for these nodes
-	cpBB bb = nodes[0]->bb;
-	for(int i=1; i<count; i++) bb = cpBBMerge(bb, nodes[i]->bb);
-	
-	// Split it on it's longest axis
-	cpBool splitWidth = (bb.r - bb.l > bb.t - bb.b);
+	MovedLeaf moved = {leaf, 0, 0, 0};
+	reindex->moved[reindex->movedCount++] = moved;
+}
+
+static inline void
+PushHit(HitBuffer *buffer, Node *node, cpBool left)
+{
+	if(buffer->num == buffer->max){
+		buffer->max = (buffer->max ? 2*buffer->max : 1024);
+		buffer->hits = (MarkHit *)cprealloc(buffer->hits, buffer->max*sizeof(MarkHit));
+	}
 	
-	// Sort the bounds and use the median as the splitting point
-	cpFloat *bounds = (cpFloat *)cpcalloc(count*2, sizeof(cpFloat));
-	if(splitWidth){
-		for(int i=0; i<count; i++){
-			bounds[2*i + 0] = nodes[i]->bb.l;
-			bounds[2*i + 1] = nodes[i]->bb.r;
-		}
+	MarkHit hit = {node, left};
+	buffer->hits[buffer->num++] = hit;
+}
+
+static void
+GatherMoved(Node *subtree, cpTimestamp stamp, ParallelReindex *reindex)
+{
+	if(NodeIsLeaf(subtree)){
+		if(subtree->STAMP == stamp) PushMoved(subtree, reindex);
 	} else {
-		for(int i=0; i<count; i++){
-			bounds[2*i + 0] = nodes[i]->bb.b;
-			bounds[2*i + 1] = nodes[i]->bb.t;
+		GatherMoved(subtree->A, stamp, reindex);
+		GatherMoved(subtree->B, stamp, reindex);
+	}
+}
+
+// Same traversal as MarkLeafQuery(), but only records the hits.
+static void
+CollectLeafQuery(Node *subtree, Node *leaf, cpBool left, HitBuffer *buffer)
+{
+	if(cpBBIntersects(leaf->bb, subtree->bb)){
+		if(NodeIsLeaf(subtree)){
+			PushHit(buffer, subtree, left);
+		} else {
+			CollectLeafQuery(subtree->A, leaf, left, buffer);
+			CollectLeafQuery(subtree->B, leaf, left, buffer);
 		}
 	}
-	
-	qsort(bounds, count*2, sizeof(cpFloat), (int (*)(const void *, const void *))cpfcompare);
-	cpFloat split = (bounds[count - 1] + bounds[count])*0.5f; // use the medain as the split
-	cpfree(bounds);
+}
 
-	// Generate the child BBs
-	cpBB a = bb, b = bb;
-	if(splitWidth) a.r = b.l = split; else a.t = b.b = split;
+static void
+CollectLeaf(Node *leaf, ParallelReindex *reindex, HitBuffer *buffer)
+{
+	if(reindex->staticRoot) CollectLeafQuery(reindex->staticRoot, leaf, cpFalse, buffer);
+	if(reindex->sleepingRoot) CollectLeafQuery(reindex->sleepingRoot, leaf, cpFalse, buffer);
 	
-	// Partition the nodes
-	int right = count;
-	for(int left=0; left < right;){
-		Node *node = nodes[left];
-		if(cpBBMergedArea(node->bb, b) < cpBBMergedArea(node->bb, a)){
-//		if(cpBBProximity(node->bb, b) < cpBBProximity(node->bb, a)){
-			right--;
-			nodes[left] = nodes[right];
-			nodes[right] = node;
+	for(Node *node = leaf; node->parent; node = node->parent){
+		if(node == node->parent->A){
+			CollectLeafQuery(node->parent->B, leaf, cpTrue, buffer);
 		} else {
-			left++;
+			CollectLeafQuery(node->parent->A, leaf, cpFalse, buffer);
 		}
 	}
+}
+
+static void
+ParallelCheckLeaves(ParallelReindex *reindex, unsigned long worker)
+{
+	cpSpatialIndexBBFunc bbfunc = reindex->tree->spatialIndex.bbfunc;
+	unsigned long count = reindex->leafCount, threads = reindex->threads;
 	
-	if(right == count){
-		Node *node = NULL;
-		for(int i=0; i<count; i++) node = SubtreeInsert(node, nodes[i], tree);
-		return node;
+	for(unsigned long i = count*worker/threads, end = count*(worker + 1)/threads; i<end; i++){
+		Node *leaf = reindex->leaves[i];
+		reindex->escaped[i] = !cpBBContainsBB(leaf->bb, bbfunc(leaf->obj));
 	}
+}
+
+static void
+ParallelCollectHits(ParallelReindex *reindex, unsigned long worker)
+{
+	HitBuffer *buffer = reindex->buffers + worker;
+	buffer->num = 0;
 	
-	// Recurse and build the node!
-	return NodeNew(tree,
-		partitionNodes(tree, nodes, right),
-		partitionNodes(tree, nodes + right, count - right)
-	);
+	unsigned long count = reindex->movedCount, threads = reindex->threads;
+	for(unsigned long i = count*worker/threads, end = count*(worker + 1)/threads; i<end; i++){
+		MovedLeaf *moved = reindex->moved + i;
+		moved->worker = (int)worker;
+		moved->start = buffer->num;
+		CollectLeaf(moved->leaf, reindex, buffer);
+		moved->count = buffer->num - moved->start;
+	}
 }
 
-//static void
-//cpBBTreeOptimizeIncremental(cpBBTree *tree, int passes)
-//{
-//	for(int i=0; i<passes; i++){
-//		Node *root = tree->root;
-//		Node *node = root;
-//		int bit = 0;
-//		unsigned int path = tree->opath;
-//		
-//		while(!NodeIsLeaf(node)){
+static void
+ReplaySubtree(Node *subtree, cpTimestamp stamp, ParallelReindex *reindex, MovedLeaf **cursor, MarkContext *context)
+{
+	if(NodeIsLeaf(subtree)){
+		if(subtree->STAMP == stamp){
+			MovedLeaf *moved = (*cursor)++;
+			MarkHit *hits = reindex->buffers[moved->worker].hits + moved->start;
+			for(int i=0; i<moved->count; i++) MarkLeafHit(subtree, hits[i].node, hits[i].left, context);
+		} else {
+			MarkLeafPairs(subtree, context);
+		}
+	} else {
+		ReplaySubtree(subtree->A, stamp, reindex, cursor, context);
+		ReplaySubtree(subtree->B, stamp, reindex, cursor, context);
+	}
+}
+
+static void PushLeafWrap(Node *leaf, ParallelReindex *reindex){PushLeaf(leaf, reindex);}
+
+static void
+ParallelReindexQuery(cpBBTree *tree, MarkContext *context)
+{
+	ParallelReindex *reindex = tree->parallelReindex;
+	if(reindex == NULL) reindex = tree->parallelReindex = (ParallelReindex *)cpcalloc(1, sizeof(ParallelReindex));
+	
+	cpThreadPool *pool = tree->threadPool;
+	unsigned long threads = cpThreadPoolGetThreads(pool);
+	if(reindex->bufferCount < (int)threads){
+		reindex->buffers = (HitBuffer *)cprealloc(reindex->buffers, threads*sizeof(HitBuffer));
+		memset(reindex->buffers + reindex->bufferCount, 0, (threads - reindex->bufferCount)*sizeof(HitBuffer));
+		reindex->bufferCount = (int)threads;
+	}
+	
+	reindex->tree = tree;
+	reindex->staticRoot = context->staticRoot;
+	reindex->sleepingRoot = context->sleepingRoot;
+	reindex->threads = threads;
+	
+	// Find the leaves that escaped their bounding boxes, then reinsert them in cpHashSetEach() order.
+	reindex->leafCount = 0;
+	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)PushLeafWrap, reindex);
+	cpThreadPoolRun(pool, (cpThreadPoolWorkFunc)ParallelCheckLeaves, reindex);
+	
+	for(int i=0; i<reindex->leafCount; i++){
+		if(reindex->escaped[i]) LeafReinsert(reindex->leaves[i], tree);
+	}
+	
+	// Query the trees for the moved leaves, then replay the hits in MarkSubtree() order.
+	cpTimestamp stamp = GetMasterTree(tree)->stamp;
+	reindex->movedCount = 0;
+	GatherMoved(tree->root, stamp, reindex);
+	cpThreadPoolRun(pool, (cpThreadPoolWorkFunc)ParallelCollectHits, reindex);
+	
+	MovedLeaf *cursor = reindex->moved;
+	ReplaySubtree(tree->root, stamp, reindex, &cursor, context);
+}
+
+//MARK: Segment Query Packets
+
+// Packets walk the tree once for several segments. Each segment only visits the nodes it would visit
+// on its own, and its exit time is updated as soon as it hits something.
+
+static inline int
+LowestBit(uint32_t bits)
+{
+#if defined(__GNUC__)
+	return __builtin_ctz(bits);
+#else
+	int i = 0;
+	while(!(bits>>i & 1)) i++;
+	return i;
+#endif
+}
+
+static inline uint32_t
+PacketTest(cpBB bb, cpSpatialIndexSegment *segments, uint32_t mask, cpFloat *t, cpFloat *t_min)
+{
+	uint32_t hits = 0;
+	(*t_min) = INFINITY;
+	
+	for(uint32_t bits = mask; bits; bits &= bits - 1){
+		int i = LowestBit(bits);
+		cpSpatialIndexSegment *segment = segments + i;
+		t[i] = cpBBSegmentQuery(bb, segment->a, segment->b);
+		
+		if(t[i] < segment->t_exit){
+			hits |= (uint32_t)1<<i;
+			(*t_min) = cpfmin(*t_min, t[i]);
+		}
+	}
+	
+	return hits;
+}
+
+static inline uint32_t
+PacketRetest(cpSpatialIndexSegment *segments, uint32_t mask, cpFloat *t)
+{
+	for(uint32_t bits = mask; bits; bits &= bits - 1){
+		int i = LowestBit(bits);
+		if(t[i] >= segments[i].t_exit) mask &= ~((uint32_t)1<<i);
+	}
+	
+	return mask;
+}
+
+static inline void
+PacketLeaf(void *obj, cpSpatialIndexSegment *segments, uint32_t mask, cpSpatialIndexSegmentQueryFunc func)
+{
+	for(uint32_t bits = mask; bits; bits &= bits - 1){
+		cpSpatialIndexSegment *segment = segments + LowestBit(bits);
+		segment->t_exit = cpfmin(segment->t_exit, func(segment->obj, obj, segment->data));
+	}
+}
+
+static void
+SubtreeSegmentQueryPacket(Node *subtree, cpSpatialIndexSegment *segments, uint32_t mask, cpSpatialIndexSegmentQueryFunc func)
+{
+	if(NodeIsLeaf(subtree)){
+		PacketLeaf(subtree->obj, segments, mask, func);
+	} else {
+		cpFloat t_a[CP_SEGMENT_PACKET_SIZE], t_b[CP_SEGMENT_PACKET_SIZE], min_a, min_b;
+		uint32_t mask_a = PacketTest(subtree->A->bb, segments, mask, t_a, &min_a);
+		uint32_t mask_b = PacketTest(subtree->B->bb, segments, mask, t_b, &min_b);
+		
+		if(min_a < min_b){
+			if(mask_a) SubtreeSegmentQueryPacket(subtree->A, segments, mask_a, func);
+			mask_b = PacketRetest(segments, mask_b, t_b);
+			if(mask_b) SubtreeSegmentQueryPacket(subtree->B, segments, mask_b, func);
+		} else {
+			if(mask_b) SubtreeSegmentQueryPacket(subtree->B, segments, mask_b, func);
+			mask_a = PacketRetest(segments, mask_a, t_a);
+			if(mask_a) SubtreeSegmentQueryPacket(subtree->A, segments, mask_a, func);
+		}
+	}
+}
+
+static void
+FlatSegmentQueryPacket(FlatNode *nodes, uint32_t index, cpSpatialIndexSegment *segments, uint32_t mask, cpSpatialIndexSegmentQueryFunc func)
+{
+	FlatNode *node = nodes + index;
+	
+	if(node->obj){
+		PacketLeaf(node->obj, segments, mask, func);
+	} else {
+		uint32_t index_a = index + 1, index_b = node->other;
+		cpFloat t_a[CP_SEGMENT_PACKET_SIZE], t_b[CP_SEGMENT_PACKET_SIZE], min_a, min_b;
+		uint32_t mask_a = PacketTest(nodes[index_a].bb, segments, mask, t_a, &min_a);
+		uint32_t mask_b = PacketTest(nodes[index_b].bb, segments, mask, t_b, &min_b);
+		
+		if(min_a < min_b){
+			if(mask_a) FlatSegmentQueryPacket(nodes, index_a, segments, mask_a, func);
+			mask_b = PacketRetest(segments, mask_b, t_b);
+			if(mask_b) FlatSegmentQueryPacket(nodes, index_b, segments, mask_b, func);
+		} else {
+			if(mask_b) FlatSegmentQueryPacket(nodes, index_b, segments, mask_b, func);
+			mask_a = PacketRetest(segments, mask_a, t_a);
+			if(mask_a) FlatSegmentQueryPacket(nodes, index_a, segments, mask_a, func);
+		}
+	}
+}
+
+cpBool
+cpSpatialIndexIsBBTree(cpSpatialIndex *index)
+{
+	return (index->klass == Klass());
+}
+
+void
+cpBBTreeSegmentQueryPacket(cpSpatialIndex *index, cpSpatialIndexSegment *segments, int count, cpSpatialIndexSegmentQueryFunc func)
+{
+	cpAssertHard(count <= CP_SEGMENT_PACKET_SIZE, "Internal Error: Segment packet is too large.");
+	
+	if(index->klass != Klass()){
+		for(int i=0; i<count; i++){
+			cpSpatialIndexSegment *segment = segments + i;
+			cpSpatialIndexSegmentQuery(index, segment->obj, segment->a, segment->b, segment->t_exit, func, segment->data);
+		}
+		
+		return;
+	}
+	
+	cpBBTree *tree = (cpBBTree *)index;
+	uint32_t mask = (count == 32 ? ~(uint32_t)0 : ((uint32_t)1<<count) - 1);
+	
+	if(tree->flatNodes){
+		FlatSegmentQueryPacket(tree->flatNodes, 0, segments, mask, func);
+	} else if(tree->root){
+		SubtreeSegmentQueryPacket(tree->root, segments, mask, func);
+	}
+}
+
+//MARK: Misc
+
+static int
+cpBBTreeCount(cpBBTree *tree)
+{
+	return cpHashSetCount(tree->leaves);
+}
+
+typedef struct eachContext {
+	cpSpatialIndexIteratorFunc func;
+	void *data;
+} eachContext;
+
+static void each_helper(Node *node, eachContext *context){context->func(node->obj, context->data);}
+
+static void
+cpBBTreeEach(cpBBTree *tree, cpSpatialIndexIteratorFunc func, void *data)
+{
+	eachContext context = {func, data};
+	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)each_helper, &context);
+}
+
+static cpSpatialIndexClass klass = {
+	(cpSpatialIndexDestroyImpl)cpBBTreeDestroy,
+	
+	(cpSpatialIndexCountImpl)cpBBTreeCount,
+	(cpSpatialIndexEachImpl)cpBBTreeEach,
+	
+	(cpSpatialIndexContainsImpl)cpBBTreeContains,
+	(cpSpatialIndexInsertImpl)cpBBTreeInsert,
+	(cpSpatialIndexRemoveImpl)cpBBTreeRemove,
+	
+	(cpSpatialIndexReindexImpl)cpBBTreeReindex,
+	(cpSpatialIndexReindexObjectImpl)cpBBTreeReindexObject,
+	(cpSpatialIndexReindexQueryImpl)cpBBTreeReindexQuery,
+	
+	(cpSpatialIndexQueryImpl)cpBBTreeQuery,
+	(cpSpatialIndexSegmentQueryImpl)cpBBTreeSegmentQuery,
+};
+
+static inline cpSpatialIndexClass *Klass(){return &klass;}
+
+
+//MARK: Tree Optimization
+
+// Leaves are copied into an array along with their bounds while building so the partitioning doesn't chase pointers.
+typedef struct BuildLeaf {
+	cpBB bb;
+	Node *node;
+} BuildLeaf;
+
+static void
+fillLeafArray(Node *node, BuildLeaf **cursor){
+	(*cursor)->bb = node->bb;
+	(*cursor)->node = node;
+	(*cursor)++;
+}
+
+// Number of bins used to pick the splitting plane when building a tree.
+#define BUILD_BINS 16
+
+typedef struct BuildBin {
+	cpBB bb;
+	int count;
+} BuildBin;
+
+static inline int
+BuildLeafBin(BuildLeaf *leaf, cpBool splitWidth, cpFloat min, cpFloat scale)
+{
+	cpBB bb = leaf->bb;
+	cpFloat center = (splitWidth ? bb.l + bb.r : bb.b + bb.t)*0.5f;
+	
+	int bin = (int)((center - min)*scale);
+	return (bin < BUILD_BINS - 1 ? bin : BUILD_BINS - 1);
+}
+
+// Build a subtree top down using a binned surface area heuristic.
+// The leaves are binned along the axis where their centers are most spread out,
+// and they are split between the bins where the children's area times their leaf count is the smallest.
+static Node *
+partitionNodes(cpBBTree *tree, BuildLeaf *leaves, int count)
+{
+	if(count == 1){
+		return leaves[0].node;
+	} else if(count == 2) {
+		return NodeNew(tree, leaves[0].node, leaves[1].node);
+	}
+	
+	cpBB empty = cpBBNew(INFINITY, INFINITY, -INFINITY, -INFINITY);
+	
+	cpBB centers = empty;
+	for(int i=0; i<count; i++) centers = cpBBExpand(centers, cpBBCenter(leaves[i].bb));
+	
+	cpBool splitWidth = (centers.r - centers.l > centers.t - centers.b);
+	cpFloat min = (splitWidth ? centers.l : centers.b);
+	cpFloat extent = (splitWidth ? centers.r - centers.l : centers.t - centers.b);
+	
+	if(extent == 0.0f){
+		// The leaves are all centered on the same point and can't be split.
+		Node *node = NULL;
+		for(int i=0; i<count; i++) node = SubtreeInsert(node, leaves[i].node, tree);
+		return node;
+	}
+	
+	cpFloat scale = BUILD_BINS/extent;
+	
+	BuildBin bins[BUILD_BINS];
+	for(int i=0; i<BUILD_BINS; i++){
+		bins[i].bb = empty;
+		bins[i].count = 0;
+	}
+	
+	for(int i=0; i<count; i++){
+		BuildBin *bin = bins + BuildLeafBin(leaves + i, splitWidth, min, scale);
+		bin->bb = cpBBMerge(bin->bb, leaves[i].bb);
+		bin->count++;
+	}
+	
+	// Sweep from the right to find the cost of each right side, then from the left to find the cheapest split.
+	// The first and last bins can't be empty, so there is always a split with leaves on both sides.
+	cpFloat rightCost[BUILD_BINS];
+	cpBB bb = empty;
+	int n = 0;
+	for(int i=BUILD_BINS - 1; i>0; i--){
+		bb = cpBBMerge(bb, bins[i].bb);
+		n += bins[i].count;
+		rightCost[i] = (n ? cpBBArea(bb)*n : 0.0f);
+	}
+	
+	int split = 0;
+	cpFloat best = INFINITY;
+	bb = empty;
+	n = 0;
+	for(int i=0; i<BUILD_BINS - 1; i++){
+		bb = cpBBMerge(bb, bins[i].bb);
+		n += bins[i].count;
+		
+		cpFloat cost = (n ? cpBBArea(bb)*n : 0.0f) + rightCost[i + 1];
+		if(n && n < count && cost < best){
+			best = cost;
+			split = i;
+		}
+	}
+	
+	// Partition the leaves
+	int right = count;
+	for(int left=0; left < right;){
+		if(BuildLeafBin(leaves + left, splitWidth, min, scale) > split){
+			right--;
+			BuildLeaf leaf = leaves[left];
+			leaves[left] = leaves[right];
+			leaves[right] = leaf;
+		} else {
+			left++;
+		}
+	}
+	
+	// Recurse and build the node!
+	return NodeNew(tree,
+		partitionNodes(tree, leaves, right),
+		partitionNodes(tree, leaves + right, count - right)
+	);
+}
+
+//static void
+//cpBBTreeOptimizeIncremental(cpBBTree *tree, int passes)
+//{
+//	for(int i=0; i<passes; i++){
+//		Node *root = tree->root;
+//		Node *node = root;
+//		int bit = 0;
+//		unsigned int path = tree->opath;
+//		
+//		while(!NodeIsLeaf(node)){
 //			node = (path&(1<<bit) ? node->a : node->b);
 //			bit = (bit + 1)&(sizeof(unsigned int)*8 - 1);
 //		}
@@ -824,6 +1517,71 @@ partitionNodes(cpBBTree *tree, Node **nodes, int count)
 //	}
 //}
 
+static void
+FlatNodesInvalidate(cpBBTree *tree)
+{
+	cpfree(tree->flatNodes);
+	tree->flatNodes = NULL;
+}
+
+static int
+SubtreeDepth(Node *node)
+{
+	if(NodeIsLeaf(node)) return 1;
+	
+	int depth_a = SubtreeDepth(node->A), depth_b = SubtreeDepth(node->B);
+	return 1 + (depth_a > depth_b ? depth_a : depth_b);
+}
+
+static uint32_t
+FlattenSubtree(Node *node, FlatNode *nodes, uint32_t *cursor)
+{
+	uint32_t index = (*cursor)++;
+	FlatNode *flat = nodes + index;
+	flat->bb = node->bb;
+	
+	if(NodeIsLeaf(node)){
+		flat->obj = node->obj;
+		flat->other = 0;
+	} else {
+		flat->obj = NULL;
+		FlattenSubtree(node->A, nodes, cursor);
+		flat->other = FlattenSubtree(node->B, nodes, cursor);
+	}
+	
+	return index;
+}
+
+// Build the frozen copy used by the queries until the tree changes again.
+static void
+FlatNodesBuild(cpBBTree *tree)
+{
+	FlatNodesInvalidate(tree);
+	
+	if(SubtreeDepth(tree->root) <= FLAT_MAX_DEPTH){
+		uint32_t cursor = 0;
+		tree->flatNodes = (FlatNode *)cpcalloc(2*cpBBTreeCount(tree) - 1, sizeof(FlatNode));
+		FlattenSubtree(tree->root, tree->flatNodes, &cursor);
+	}
+}
+
+// Throw away the internal nodes and build the tree again top down from its leaves.
+static void
+TreeRebuild(cpBBTree *tree)
+{
+	int count = cpBBTreeCount(tree);
+	BuildLeaf *leaves = (BuildLeaf *)cpcalloc(count, sizeof(BuildLeaf));
+	BuildLeaf *cursor = leaves;
+	
+	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)fillLeafArray, &cursor);
+	
+	if(tree->root) SubtreeRecycle(tree, tree->root);
+	tree->root = partitionNodes(tree, leaves, count);
+	cpfree(leaves);
+	
+	FlatNodesBuild(tree);
+}
+
 void
 cpBBTreeOptimize(cpSpatialIndex *index)
 {
@@ -833,18 +1591,402 @@ cpBBTreeOptimize(cpSpatialIndex *index)
 	}
 	
 	cpBBTree *tree = (cpBBTree *)index;
+	if(!tree->root) return;
+	
+	TreeRebuild(tree);
+}
+
+//MARK: Tree Quality
+
+static void
+SubtreeQuality(Node *node, int depth, cpBBTreeQuality *quality)
+{
+	if(NodeIsLeaf(node)){
+		quality->leaves++;
+		quality->averageDepth += depth;
+		quality->maxDepth = (depth > quality->maxDepth ? depth : quality->maxDepth);
+		quality->depthHistogram[depth < CP_BBTREE_DEPTH_BUCKETS ? depth : CP_BBTREE_DEPTH_BUCKETS - 1]++;
+	} else {
+		quality->internalArea += cpBBArea(node->bb);
+		SubtreeQuality(node->A, depth + 1, quality);
+		SubtreeQuality(node->B, depth + 1, quality);
+	}
+}
+
+void
+cpBBTreeGetQuality(cpSpatialIndex *index, cpBBTreeQuality *quality)
+{
+	memset(quality, 0, sizeof(cpBBTreeQuality));
+	
+	cpBBTree *tree = GetTree(index);
+	if(!tree){
+		cpAssertWarn(cpFalse, "Ignoring cpBBTreeGetQuality() call to non-tree spatial index.");
+		return;
+	}
+	
 	Node *root = tree->root;
-	if(!root) return;
+	if(root){
+		quality->rootArea = cpBBArea(root->bb);
+		SubtreeQuality(root, 0, quality);
+		quality->averageDepth /= quality->leaves;
+	}
+}
+
+//MARK: Bulk Insertion
+
+void
+cpBBTreeInsertBulk(cpSpatialIndex *index, void **objs, cpHashValue *hashids, int count)
+{
+	cpBBTree *tree = GetTree(index);
+	if(!tree){
+		for(int i=0; i<count; i++) cpSpatialIndexInsert(index, objs[i], hashids[i]);
+		return;
+	}
 	
-	int count = cpBBTreeCount(tree);
-	Node **nodes = (Node **)cpcalloc(count, sizeof(Node *));
-	Node **cursor = nodes;
+	if(count == 0) return;
+	
+	int existing = cpBBTreeCount(tree);
+	cpTimestamp stamp = GetMasterTree(tree)->stamp;
+	
+	Node **leaves = (Node **)cpcalloc(count, sizeof(Node *));
+	for(int i=0; i<count; i++){
+		Node *leaf = (Node *)cpHashSetInsert(tree->leaves, hashids[i], objs[i], (cpHashSetTransFunc)leafSetTrans, tree);
+		leaf->STAMP = stamp;
+		leaves[i] = leaf;
+	}
+	
+	cpAssertHard(cpBBTreeCount(tree) == existing + count, "Internal Error: Object was already in the tree or inserted twice.");
+	
+	if(count >= existing){
+		// Rebuilding is about as cheap as inserting the new leaves one at a time, and makes a much better tree.
+		TreeRebuild(tree);
+	} else {
+		FlatNodesInvalidate(tree);
+		for(int i=0; i<count; i++) TreeInsertLeaf(tree, leaves[i]);
+	}
+	
+	// All of the new leaves are in the tree now, so pairs between them are only found once.
+	for(int i=0; i<count; i++) LeafAddPairs(leaves[i], tree);
+	IncrementStamp(tree);
+	
+	cpfree(leaves);
+}
+
+//MARK: Snapshots
+
+// Leaves are numbered in the order their ids are written, which is the order of the leaf table.
+// Pairs refer to their other leaf by its number and which of the trees it belongs to.
+typedef enum SnapshotTree {
+	SNAPSHOT_TREE_SELF,
+	SNAPSHOT_TREE_STATIC,
+	SNAPSHOT_TREE_SLEEPING,
+	SNAPSHOT_TREE_COUNT,
+} SnapshotTree;
+
+#define SNAPSHOT_TREE_BITS 2
+
+// A pair read from a snapshot, its first leaf and its collision id.
+struct SnapshotPair {
+	Node *a;
+	cpCollisionID id;
+};
+
+typedef struct SnapshotContext {
+	cpBBTree *tree;
+	
+	cpSnapshotIDFunc idFunc;
+	cpSnapshotWriter *writer;
+	
+	cpSnapshotObjFunc objFunc;
+	void *data;
+	cpSnapshotReader *reader;
+	
+	// Only the leaves of a dynamic tree list their pairs. Every pair has at least one dynamic leaf.
+	cpBool pairs;
+	
+	// The next leaf number and the tree it's in while numbering leaves.
+	unsigned int number;
+	SnapshotTree which;
+	
+	// The leaves of each tree by their number while restoring. NULL if that tree wasn't restored as a tree.
+	Node **leafArrays[SNAPSHOT_TREE_COUNT];
+	unsigned int leafCounts[SNAPSHOT_TREE_COUNT];
+	
+	// Leaves and internal nodes left to restore, and the pairs of the leaf being restored.
+	int leaves, internal;
+	int scratchCount, scratchCapacity;
+	struct SnapshotPair *scratch;
+} SnapshotContext;
+
+static inline Pair *
+PairNextForLeaf(Pair *pair, Node *leaf)
+{
+	return (pair->a.leaf == leaf ? pair->a.next : pair->b.next);
+}
+
+static void
+LeafTag(Node *leaf, SnapshotContext *context)
+{
+	leaf->TAG = (context->number++ << SNAPSHOT_TREE_BITS) | context->which;
+}
+
+static void
+TreeTagLeaves(cpBBTree *tree, SnapshotTree which, SnapshotContext *context)
+{
+	context->number = 0;
+	context->which = which;
+	cpHashSetEachInTableOrder(tree->leaves, (cpHashSetIteratorFunc)LeafTag, context);
+}
+
+static void
+LeafWriteID(Node *leaf, SnapshotContext *context)
+{
+	cpHashValue id = context->idFunc(leaf->obj);
+	cpSnapshotWrite(context->writer, &id, sizeof(id));
+	LeafTag(leaf, context);
+}
+
+// Only the order of the pairs a leaf is the second leaf of matters, it's the order MarkLeafPairs() reports them in.
+// Each pair is written once by that leaf, the second leaf of a pair is always in the dynamic tree.
+static void
+LeafWritePairs(Node *leaf, SnapshotContext *context)
+{
+	cpSnapshotWriter *writer = context->writer;
+	
+	// The count is filled in once the list has been walked.
+	uint32_t count = 0;
+	uint8_t *countCursor = writer->cursor;
+	cpSnapshotWrite(writer, &count, sizeof(count));
+	
+	for(Pair *pair = leaf->PAIRS; pair; pair = PairNextForLeaf(pair, leaf)){
+		if(pair->b.leaf != leaf) continue;
+		
+		// The first leaf's number and which tree it's in, and the pair's collision id.
+		uint32_t other = pair->a.leaf->TAG;
+		uint8_t entry[sizeof(other) + sizeof(pair->id)];
+		memcpy(entry, &other, sizeof(other));
+		memcpy(entry + sizeof(other), &pair->id, sizeof(pair->id));
+		cpSnapshotWrite(writer, entry, sizeof(entry));
+		count++;
+	}
+	
+	if(writer->cursor) memcpy(countCursor, &count, sizeof(count));
+}
+
+// Nodes are written depth first. The bounds of an internal node are always its children's bounds merged,
+// so only the leaves' bounds are written.
+static void
+SubtreeWriteSnapshot(Node *node, SnapshotContext *context)
+{
+	cpSnapshotWriter *writer = context->writer;
+	
+	uint8_t isLeaf = NodeIsLeaf(node);
+	cpSnapshotWrite(writer, &isLeaf, sizeof(isLeaf));
+	
+	if(isLeaf){
+		uint32_t number = node->TAG >> SNAPSHOT_TREE_BITS;
+		cpSnapshotWrite(writer, &node->bb, sizeof(node->bb));
+		cpSnapshotWrite(writer, &number, sizeof(number));
+		cpSnapshotWrite(writer, &node->STAMP, sizeof(node->STAMP));
+		if(context->pairs) LeafWritePairs(node, context);
+	} else {
+		SubtreeWriteSnapshot(node->A, context);
+		SubtreeWriteSnapshot(node->B, context);
+	}
+}
+
+void
+cpBBTreeWriteSnapshot(cpSpatialIndex *index, cpSnapshotIDFunc idFunc, cpSnapshotWriter *writer)
+{
+	cpBBTree *tree = GetTree(index);
+	cpAssertHard(tree, "Internal Error: Index is not a bounding box tree.");
+	
+	SnapshotContext context = {tree, idFunc, writer, NULL, NULL, NULL, (index->dynamicIndex == NULL)};
+	
+	// Number the leaves of the trees the pairs link to.
+	if(context.pairs){
+		cpBBTree *staticTree = GetTree(index->staticIndex);
+		if(staticTree) TreeTagLeaves(staticTree, SNAPSHOT_TREE_STATIC, &context);
+		if(tree->sleepingTree) TreeTagLeaves(tree->sleepingTree, SNAPSHOT_TREE_SLEEPING, &context);
+	}
+	
+	uint32_t count = cpHashSetCount(tree->leaves), capacity = cpHashSetGetCapacity(tree->leaves);
+	cpSnapshotWrite(writer, &tree->stamp, sizeof(tree->stamp));
+	cpSnapshotWrite(writer, &count, sizeof(count));
+	cpSnapshotWrite(writer, &capacity, sizeof(capacity));
+	
+	// Write the leaves in an order that rebuilds the same hash table, so reindexing visits them in the same order.
+	context.number = 0;
+	context.which = SNAPSHOT_TREE_SELF;
+	cpHashSetEachInTableOrder(tree->leaves, (cpHashSetIteratorFunc)LeafWriteID, &context);
+	if(tree->root) SubtreeWriteSnapshot(tree->root, &context);
+	
+	uint8_t flat = (tree->flatNodes != NULL);
+	cpSnapshotWrite(writer, &flat, sizeof(flat));
+}
+
+static void LeafArrayPush(Node *leaf, Node ***cursor){*((*cursor)++) = leaf;}
+
+// The leaves of an already restored tree, numbered the same way they were written.
+static Node **
+TreeLeafArray(cpBBTree *tree, unsigned int *count)
+{
+	(*count) = cpHashSetCount(tree->leaves);
+	
+	Node **leaves = (Node **)cpcalloc((*count) + 1, sizeof(Node *));
+	Node **cursor = leaves;
+	cpHashSetEachInTableOrder(tree->leaves, (cpHashSetIteratorFunc)LeafArrayPush, &cursor);
+	
+	return leaves;
+}
+
+static void
+ScratchPush(SnapshotContext *context, Node *a, cpCollisionID id)
+{
+	if(context->scratchCount == context->scratchCapacity){
+		context->scratchCapacity = (context->scratchCapacity ? 2*context->scratchCapacity : 32);
+		context->scratch = (struct SnapshotPair *)cprealloc(context->scratch, context->scratchCapacity*sizeof(struct SnapshotPair));
+	}
+	
+	struct SnapshotPair pair = {a, id};
+	context->scratch[context->scratchCount++] = pair;
+}
+
+// Pairs are pushed onto the head of the lists, so they are inserted in reverse to keep their order.
+// The lists of the first leaves come out in a different order, but nothing depends on it.
+static cpBool
+LeafRestorePairs(Node *leaf, SnapshotContext *context)
+{
+	cpSnapshotReader *reader = context->reader;
+	
+	context->scratchCount = 0;
+	uint32_t count = cpSnapshotReadCount(reader);
+	
+	for(uint32_t i=0; i<count; i++){
+		uint32_t tag;
+		cpCollisionID id;
+		cpSnapshotRead(reader, &tag, sizeof(tag));
+		cpSnapshotRead(reader, &id, sizeof(id));
+		if(!reader->ok) return cpFalse;
+		
+		SnapshotTree which = (SnapshotTree)(tag & ((1 << SNAPSHOT_TREE_BITS) - 1));
+		unsigned int number = tag >> SNAPSHOT_TREE_BITS;
+		if(which >= SNAPSHOT_TREE_COUNT) return cpFalse;
+		
+		// The other leaf was not restored as a tree. Its index finds its collisions a different way.
+		Node **leaves = context->leafArrays[which];
+		if(leaves == NULL) continue;
+		
+		if(number >= context->leafCounts[which] || leaves[number] == leaf) return cpFalse;
+		ScratchPush(context, leaves[number], id);
+	}
+	
+	for(int i=context->scratchCount - 1; i>=0; i--){
+		PairInsert(context->scratch[i].a, leaf, context->tree);
+		leaf->PAIRS->id = context->scratch[i].id;
+	}
+	
+	return cpTrue;
+}
+
+static Node *
+SubtreeRestoreSnapshot(SnapshotContext *context)
+{
+	cpSnapshotReader *reader = context->reader;
+	cpBBTree *tree = context->tree;
+	
+	uint8_t isLeaf;
+	cpSnapshotRead(reader, &isLeaf, sizeof(isLeaf));
+	if(!reader->ok) return NULL;
+	
+	if(isLeaf){
+		cpBB bb;
+		uint32_t number;
+		cpSnapshotRead(reader, &bb, sizeof(bb));
+		cpSnapshotRead(reader, &number, sizeof(number));
+		if(!reader->ok || number >= context->leafCounts[SNAPSHOT_TREE_SELF]) return NULL;
+		
+		// Each leaf must be used once. Placed leaves point to themselves until their parent is made.
+		Node *leaf = context->leafArrays[SNAPSHOT_TREE_SELF][number];
+		if(leaf->parent || context->leaves-- <= 0) return NULL;
+		
+		leaf->parent = leaf;
+		leaf->bb = bb;
+		cpSnapshotRead(reader, &leaf->STAMP, sizeof(leaf->STAMP));
+		if(context->pairs && !LeafRestorePairs(leaf, context)) return NULL;
+		
+		return leaf;
+	} else {
+		if(context->internal-- <= 0) return NULL;
+		
+		Node *a = SubtreeRestoreSnapshot(context); if(a == NULL) return NULL;
+		Node *b = SubtreeRestoreSnapshot(context); if(b == NULL) return NULL;
+		
+		return NodeNew(tree, a, b);
+	}
+}
+
+cpBool
+cpBBTreeRestoreSnapshot(cpSpatialIndex *index, cpSnapshotObjFunc objFunc, void *data, cpSnapshotReader *reader)
+{
+	cpBBTree *tree = GetTree(index);
+	cpAssertHard(tree && tree->root == NULL && cpHashSetCount(tree->leaves) == 0, "Internal Error: Snapshots can only be restored into an empty tree.");
+	
+	SnapshotContext context = {tree, NULL, NULL, objFunc, data, reader, (index->dynamicIndex == NULL)};
+	
+	cpSnapshotRead(reader, &tree->stamp, sizeof(tree->stamp));
+	uint32_t count = cpSnapshotReadCount(reader), capacity;
+	cpSnapshotRead(reader, &capacity, sizeof(capacity));
+	if(!reader->ok || capacity < 8 || (capacity & (capacity - 1)) || capacity < 2*(uint64_t)count) return cpFalse;
+	
+	Node **leaves = context.leafArrays[SNAPSHOT_TREE_SELF] = (Node **)cpcalloc(count + 1, sizeof(Node *));
+	context.leafCounts[SNAPSHOT_TREE_SELF] = count;
+	
+	cpHashSetSetCapacity(tree->leaves, capacity);
+	for(uint32_t i=0; i<count; i++){
+		cpHashValue id;
+		cpSnapshotRead(reader, &id, sizeof(id));
+		void *obj = objFunc(id, data);
+		if(!reader->ok || obj == NULL || cpHashSetFind(tree->leaves, id, obj)){
+			cpfree(leaves);
+			return cpFalse;
+		}
+		
+		Node *leaf = leaves[i] = NodeFromPool(tree);
+		leaf->obj = obj;
+		leaf->bb = cpBBNew(0.0f, 0.0f, 0.0f, 0.0f);
+		leaf->parent = NULL;
+		leaf->STAMP = 0;
+		leaf->PAIRS = NULL;
+		
+		cpHashSetInsert(tree->leaves, id, obj, NULL, leaf);
+	}
+	
+	if(context.pairs){
+		cpBBTree *staticTree = GetTree(index->staticIndex);
+		if(staticTree) context.leafArrays[SNAPSHOT_TREE_STATIC] = TreeLeafArray(staticTree, &context.leafCounts[SNAPSHOT_TREE_STATIC]);
+		if(tree->sleepingTree) context.leafArrays[SNAPSHOT_TREE_SLEEPING] = TreeLeafArray(tree->sleepingTree, &context.leafCounts[SNAPSHOT_TREE_SLEEPING]);
+	}
+	
+	if(count > 0){
+		context.leaves = count;
+		context.internal = count - 1;
+		tree->root = SubtreeRestoreSnapshot(&context);
+	}
+	
+	cpfree(context.scratch);
+	for(int i=0; i<SNAPSHOT_TREE_COUNT; i++) cpfree(context.leafArrays[i]);
+	
+	if(count > 0){
+		if(tree->root == NULL || context.leaves != 0) return cpFalse;
+		tree->root->parent = NULL;
+	}
 	
-	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)fillNodeArray, &cursor);
+	uint8_t flat;
+	cpSnapshotRead(reader, &flat, sizeof(flat));
+	if(flat && tree->root) FlatNodesBuild(tree);
 	
-	SubtreeRecycle(tree, root);
-	tree->root = partitionNodes(tree, nodes, count);
-	cpfree(nodes);
+	return reader->ok;
 }
 
 //MARK: Debug Draw
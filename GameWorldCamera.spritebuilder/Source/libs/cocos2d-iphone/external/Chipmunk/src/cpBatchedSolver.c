@@ -0,0 +1,362 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+// The batched solver packs prestepped contacts into structure of arrays batches.
+// No two contacts in a batch share a dynamic body, so every lane of a batch can be solved at once.
+
+//MARK: Vector Types
+
+// Deterministic builds use the portable fallback so the batches are the same size on every platform.
+#if CP_DETERMINISTIC_MATH
+	#define CP_BATCHED_SOLVER_PORTABLE 1
+#elif CP_USE_DOUBLES && defined(__AVX__)
+	#include <immintrin.h>
+	#define LANES 4
+	typedef __m256d cpFloatV;
+	#define cpfvload(p) _mm256_loadu_pd(p)
+	#define cpfvstore(p, v) _mm256_storeu_pd(p, v)
+	#define cpfvsplat(f) _mm256_set1_pd(f)
+	#define cpfvadd(a, b) _mm256_add_pd(a, b)
+	#define cpfvsub(a, b) _mm256_sub_pd(a, b)
+	#define cpfvmul(a, b) _mm256_mul_pd(a, b)
+	#define cpfvmin(a, b) _mm256_min_pd(a, b)
+	#define cpfvmax(a, b) _mm256_max_pd(a, b)
+#elif CP_USE_DOUBLES && defined(__SSE2__)
+	#include <emmintrin.h>
+	#define LANES 2
+	typedef __m128d cpFloatV;
+	#define cpfvload(p) _mm_loadu_pd(p)
+	#define cpfvstore(p, v) _mm_storeu_pd(p, v)
+	#define cpfvsplat(f) _mm_set1_pd(f)
+	#define cpfvadd(a, b) _mm_add_pd(a, b)
+	#define cpfvsub(a, b) _mm_sub_pd(a, b)
+	#define cpfvmul(a, b) _mm_mul_pd(a, b)
+	#define cpfvmin(a, b) _mm_min_pd(a, b)
+	#define cpfvmax(a, b) _mm_max_pd(a, b)
+#elif !CP_USE_DOUBLES && defined(__AVX__)
+	#include <immintrin.h>
+	#define LANES 8
+	typedef __m256 cpFloatV;
+	#define cpfvload(p) _mm256_loadu_ps(p)
+	#define cpfvstore(p, v) _mm256_storeu_ps(p, v)
+	#define cpfvsplat(f) _mm256_set1_ps(f)
+	#define cpfvadd(a, b) _mm256_add_ps(a, b)
+	#define cpfvsub(a, b) _mm256_sub_ps(a, b)
+	#define cpfvmul(a, b) _mm256_mul_ps(a, b)
+	#define cpfvmin(a, b) _mm256_min_ps(a, b)
+	#define cpfvmax(a, b) _mm256_max_ps(a, b)
+#elif !CP_USE_DOUBLES && defined(__SSE__)
+	#include <xmmintrin.h>
+	#define LANES 4
+	typedef __m128 cpFloatV;
+	#define cpfvload(p) _mm_loadu_ps(p)
+	#define cpfvstore(p, v) _mm_storeu_ps(p, v)
+	#define cpfvsplat(f) _mm_set1_ps(f)
+	#define cpfvadd(a, b) _mm_add_ps(a, b)
+	#define cpfvsub(a, b) _mm_sub_ps(a, b)
+	#define cpfvmul(a, b) _mm_mul_ps(a, b)
+	#define cpfvmin(a, b) _mm_min_ps(a, b)
+	#define cpfvmax(a, b) _mm_max_ps(a, b)
+#elif !CP_USE_DOUBLES && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+	#include <arm_neon.h>
+	#define LANES 4
+	typedef float32x4_t cpFloatV;
+	#define cpfvload(p) vld1q_f32(p)
+	#define cpfvstore(p, v) vst1q_f32(p, v)
+	#define cpfvsplat(f) vdupq_n_f32(f)
+	#define cpfvadd(a, b) vaddq_f32(a, b)
+	#define cpfvsub(a, b) vsubq_f32(a, b)
+	#define cpfvmul(a, b) vmulq_f32(a, b)
+	#define cpfvmin(a, b) vminq_f32(a, b)
+	#define cpfvmax(a, b) vmaxq_f32(a, b)
+#else
+	#define CP_BATCHED_SOLVER_PORTABLE 1
+#endif
+
+#if CP_BATCHED_SOLVER_PORTABLE
+	// Portable fallback. Compilers generally vectorize these loops on their own.
+	#define LANES 4
+	typedef struct cpFloatV {cpFloat f[LANES];} cpFloatV;
+	
+	#define CP_FLOATV_OP(name, expr) \
+		static inline cpFloatV name(cpFloatV a, cpFloatV b){ \
+			cpFloatV r; for(int i=0; i<LANES; i++) r.f[i] = (expr); return r; \
+		}
+	
+	CP_FLOATV_OP(cpfvadd, a.f[i] + b.f[i])
+	CP_FLOATV_OP(cpfvsub, a.f[i] - b.f[i])
+	CP_FLOATV_OP(cpfvmul, a.f[i] * b.f[i])
+	CP_FLOATV_OP(cpfvmin, cpfmin(a.f[i], b.f[i]))
+	CP_FLOATV_OP(cpfvmax, cpfmax(a.f[i], b.f[i]))
+	
+	static inline cpFloatV cpfvload(const cpFloat *p){cpFloatV r; memcpy(r.f, p, sizeof(r.f)); return r;}
+	static inline void cpfvstore(cpFloat *p, cpFloatV v){memcpy(p, v.f, sizeof(v.f));}
+	static inline cpFloatV cpfvsplat(cpFloat f){cpFloatV r; for(int i=0; i<LANES; i++) r.f[i] = f; return r;}
+#endif
+
+//MARK: Batches
+
+typedef struct cpContactBatch {
+	int count;
+	cpBody *a[LANES], *b[LANES];
+	struct cpContact *contacts[LANES];
+	
+	cpFloat r1x[LANES], r1y[LANES], r2x[LANES], r2y[LANES];
+	cpFloat nx[LANES], ny[LANES];
+	cpFloat surface_vrx[LANES], surface_vry[LANES];
+	cpFloat friction[LANES];
+	
+	cpFloat nMass[LANES], tMass[LANES];
+	cpFloat bias[LANES], bounce[LANES];
+	cpFloat jnAcc[LANES], jtAcc[LANES], jBias[LANES];
+	
+	cpFloat a_m_inv[LANES], a_i_inv[LANES];
+	cpFloat b_m_inv[LANES], b_i_inv[LANES];
+} cpContactBatch;
+
+struct cpBatchedSolver {
+	int count, capacity;
+	cpContactBatch *batches;
+};
+
+void
+cpBatchedSolverFree(struct cpBatchedSolver *solver)
+{
+	if(solver){
+		cpfree(solver->batches);
+		cpfree(solver);
+	}
+}
+
+static inline cpBool
+IsDynamic(cpBody *body)
+{
+	return (cpBodyGetType(body) == CP_BODY_TYPE_DYNAMIC);
+}
+
+static cpContactBatch *
+PushBatch(struct cpBatchedSolver *solver)
+{
+	if(solver->count == solver->capacity){
+		solver->capacity = (solver->capacity ? 2*solver->capacity : 16);
+		solver->batches = (cpContactBatch *)cprealloc(solver->batches, solver->capacity*sizeof(cpContactBatch));
+	}
+	
+	cpContactBatch *batch = solver->batches + solver->count++;
+	memset(batch, 0, sizeof(cpContactBatch));
+	return batch;
+}
+
+static void
+BuildBatches(struct cpBatchedSolver *solver, cpSpace *space)
+{
+	cpArray *arbiters = space->arbiters;
+	solver->count = 0;
+	
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiter *arb = (cpArbiter *)arbiters->arr[i];
+		arb->body_a->solverTag = arb->body_b->solverTag = 0;
+	}
+	
+	int firstOpen = 0;
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiter *arb = (cpArbiter *)arbiters->arr[i];
+		cpBody *a = arb->body_a, *b = arb->body_b;
+		cpBool dynamicA = IsDynamic(a), dynamicB = IsDynamic(b);
+		
+		for(int j=0; j<arb->count; j++){
+			struct cpContact *con = arb->contacts + j;
+			
+			// A contact goes after the last batch that used either of its bodies.
+			// That keeps the order each body sees its contacts the same as in the scalar solver.
+			int k = firstOpen;
+			if(dynamicA && (int)a->solverTag > k) k = (int)a->solverTag;
+			if(dynamicB && (int)b->solverTag > k) k = (int)b->solverTag;
+			while(k < solver->count && solver->batches[k].count == LANES) k++;
+			
+			cpContactBatch *batch = (k < solver->count ? solver->batches + k : PushBatch(solver));
+			int lane = batch->count++;
+			
+			batch->a[lane] = a;
+			batch->b[lane] = b;
+			batch->contacts[lane] = con;
+			
+			batch->r1x[lane] = con->r1.x; batch->r1y[lane] = con->r1.y;
+			batch->r2x[lane] = con->r2.x; batch->r2y[lane] = con->r2.y;
+			batch->nx[lane] = arb->n.x; batch->ny[lane] = arb->n.y;
+			batch->surface_vrx[lane] = arb->surface_vr.x; batch->surface_vry[lane] = arb->surface_vr.y;
+			batch->friction[lane] = arb->u;
+			
+			batch->nMass[lane] = con->nMass; batch->tMass[lane] = con->tMass;
+			batch->bias[lane] = con->bias; batch->bounce[lane] = con->bounce;
+			batch->jnAcc[lane] = con->jnAcc; batch->jtAcc[lane] = con->jtAcc; batch->jBias[lane] = con->jBias;
+			
+			batch->a_m_inv[lane] = a->m_inv; batch->a_i_inv[lane] = a->i_inv;
+			batch->b_m_inv[lane] = b->m_inv; batch->b_i_inv[lane] = b->i_inv;
+			
+			if(dynamicA) a->solverTag = k + 1;
+			if(dynamicB) b->solverTag = k + 1;
+			
+			while(firstOpen < solver->count && solver->batches[firstOpen].count == LANES) firstOpen++;
+		}
+	}
+	
+	// Pad the unused lanes with zero mass contacts on the static body. They never apply an impulse.
+	cpBody *staticBody = space->staticBody;
+	for(int i=0; i<solver->count; i++){
+		cpContactBatch *batch = solver->batches + i;
+		for(int lane=batch->count; lane<LANES; lane++) batch->a[lane] = batch->b[lane] = staticBody;
+	}
+}
+
+//MARK: Solver
+
+static void
+SolveBatch(cpContactBatch *batch)
+{
+	cpFloat v1x[LANES], v1y[LANES], w1[LANES], vb1x[LANES], vb1y[LANES], wb1[LANES];
+	cpFloat v2x[LANES], v2y[LANES], w2[LANES], vb2x[LANES], vb2y[LANES], wb2[LANES];
+	
+	for(int i=0; i<LANES; i++){
+		cpBody *a = batch->a[i], *b = batch->b[i];
+		v1x[i] = a->v.x; v1y[i] = a->v.y; w1[i] = a->w;
+		vb1x[i] = a->v_bias.x; vb1y[i] = a->v_bias.y; wb1[i] = a->w_bias;
+		v2x[i] = b->v.x; v2y[i] = b->v.y; w2[i] = b->w;
+		vb2x[i] = b->v_bias.x; vb2y[i] = b->v_bias.y; wb2[i] = b->w_bias;
+	}
+	
+	cpFloatV zero = cpfvsplat(0.0f);
+	cpFloatV r1x = cpfvload(batch->r1x), r1y = cpfvload(batch->r1y);
+	cpFloatV r2x = cpfvload(batch->r2x), r2y = cpfvload(batch->r2y);
+	cpFloatV nx = cpfvload(batch->nx), ny = cpfvload(batch->ny);
+	
+	cpFloatV a_v_x = cpfvload(v1x), a_v_y = cpfvload(v1y), a_w = cpfvload(w1);
+	cpFloatV a_vb_x = cpfvload(vb1x), a_vb_y = cpfvload(vb1y), a_wb = cpfvload(wb1);
+	cpFloatV b_v_x = cpfvload(v2x), b_v_y = cpfvload(v2y), b_w = cpfvload(w2);
+	cpFloatV b_vb_x = cpfvload(vb2x), b_vb_y = cpfvload(vb2y), b_wb = cpfvload(wb2);
+	
+	// Relative bias velocity along the normal.
+	cpFloatV vbrx = cpfvsub(cpfvsub(b_vb_x, cpfvmul(r2y, b_wb)), cpfvsub(a_vb_x, cpfvmul(r1y, a_wb)));
+	cpFloatV vbry = cpfvsub(cpfvadd(b_vb_y, cpfvmul(r2x, b_wb)), cpfvadd(a_vb_y, cpfvmul(r1x, a_wb)));
+	cpFloatV vbn = cpfvadd(cpfvmul(vbrx, nx), cpfvmul(vbry, ny));
+	
+	// Relative velocity along the normal and tangent.
+	cpFloatV vrx = cpfvsub(cpfvsub(b_v_x, cpfvmul(r2y, b_w)), cpfvsub(a_v_x, cpfvmul(r1y, a_w)));
+	cpFloatV vry = cpfvsub(cpfvadd(b_v_y, cpfvmul(r2x, b_w)), cpfvadd(a_v_y, cpfvmul(r1x, a_w)));
+	vrx = cpfvadd(vrx, cpfvload(batch->surface_vrx));
+	vry = cpfvadd(vry, cpfvload(batch->surface_vry));
+	cpFloatV vrn = cpfvadd(cpfvmul(vrx, nx), cpfvmul(vry, ny));
+	cpFloatV vrt = cpfvsub(cpfvmul(vry, nx), cpfvmul(vrx, ny));
+	
+	cpFloatV nMass = cpfvload(batch->nMass);
+	
+	cpFloatV jbn = cpfvmul(cpfvsub(cpfvload(batch->bias), vbn), nMass);
+	cpFloatV jbnOld = cpfvload(batch->jBias);
+	cpFloatV jBias = cpfvmax(cpfvadd(jbnOld, jbn), zero);
+	
+	cpFloatV jn = cpfvmul(cpfvsub(zero, cpfvadd(cpfvload(batch->bounce), vrn)), nMass);
+	cpFloatV jnOld = cpfvload(batch->jnAcc);
+	cpFloatV jnAcc = cpfvmax(cpfvadd(jnOld, jn), zero);
+	
+	cpFloatV jtMax = cpfvmul(cpfvload(batch->friction), jnAcc);
+	cpFloatV jt = cpfvmul(cpfvsub(zero, vrt), cpfvload(batch->tMass));
+	cpFloatV jtOld = cpfvload(batch->jtAcc);
+	cpFloatV jtAcc = cpfvmax(cpfvmin(cpfvadd(jtOld, jt), jtMax), cpfvsub(zero, jtMax));
+	
+	cpfvstore(batch->jBias, jBias);
+	cpfvstore(batch->jnAcc, jnAcc);
+	cpfvstore(batch->jtAcc, jtAcc);
+	
+	cpFloatV a_m_inv = cpfvload(batch->a_m_inv), a_i_inv = cpfvload(batch->a_i_inv);
+	cpFloatV b_m_inv = cpfvload(batch->b_m_inv), b_i_inv = cpfvload(batch->b_i_inv);
+	
+	// Apply the bias impulse along the normal.
+	cpFloatV djb = cpfvsub(jBias, jbnOld);
+	cpFloatV jbx = cpfvmul(nx, djb), jby = cpfvmul(ny, djb);
+	a_vb_x = cpfvsub(a_vb_x, cpfvmul(jbx, a_m_inv));
+	a_vb_y = cpfvsub(a_vb_y, cpfvmul(jby, a_m_inv));
+	a_wb = cpfvsub(a_wb, cpfvmul(a_i_inv, cpfvsub(cpfvmul(r1x, jby), cpfvmul(r1y, jbx))));
+	b_vb_x = cpfvadd(b_vb_x, cpfvmul(jbx, b_m_inv));
+	b_vb_y = cpfvadd(b_vb_y, cpfvmul(jby, b_m_inv));
+	b_wb = cpfvadd(b_wb, cpfvmul(b_i_inv, cpfvsub(cpfvmul(r2x, jby), cpfvmul(r2y, jbx))));
+	
+	// Apply the normal and friction impulses rotated into world space.
+	cpFloatV djn = cpfvsub(jnAcc, jnOld), djt = cpfvsub(jtAcc, jtOld);
+	cpFloatV jx = cpfvsub(cpfvmul(nx, djn), cpfvmul(ny, djt));
+	cpFloatV jy = cpfvadd(cpfvmul(nx, djt), cpfvmul(ny, djn));
+	a_v_x = cpfvsub(a_v_x, cpfvmul(jx, a_m_inv));
+	a_v_y = cpfvsub(a_v_y, cpfvmul(jy, a_m_inv));
+	a_w = cpfvsub(a_w, cpfvmul(a_i_inv, cpfvsub(cpfvmul(r1x, jy), cpfvmul(r1y, jx))));
+	b_v_x = cpfvadd(b_v_x, cpfvmul(jx, b_m_inv));
+	b_v_y = cpfvadd(b_v_y, cpfvmul(jy, b_m_inv));
+	b_w = cpfvadd(b_w, cpfvmul(b_i_inv, cpfvsub(cpfvmul(r2x, jy), cpfvmul(r2y, jx))));
+	
+	cpfvstore(v1x, a_v_x); cpfvstore(v1y, a_v_y); cpfvstore(w1, a_w);
+	cpfvstore(vb1x, a_vb_x); cpfvstore(vb1y, a_vb_y); cpfvstore(wb1, a_wb);
+	cpfvstore(v2x, b_v_x); cpfvstore(v2y, b_v_y); cpfvstore(w2, b_w);
+	cpfvstore(vb2x, b_vb_x); cpfvstore(vb2y, b_vb_y); cpfvstore(wb2, b_wb);
+	
+	// Scatter the velocities back. Static and kinematic bodies may appear in several lanes,
+	// but they have no inverse mass so every lane writes back the same value.
+	for(int i=0; i<LANES; i++){
+		cpBody *a = batch->a[i], *b = batch->b[i];
+		a->v = cpv(v1x[i], v1y[i]); a->w = w1[i];
+		a->v_bias = cpv(vb1x[i], vb1y[i]); a->w_bias = wb1[i];
+		b->v = cpv(v2x[i], v2y[i]); b->w = w2[i];
+		b->v_bias = cpv(vb2x[i], vb2y[i]); b->w_bias = wb2[i];
+	}
+}
+
+void
+cpSpaceSolveImpulsesBatched(cpSpace *space, cpFloat dt)
+{
+	struct cpBatchedSolver *solver = space->batchedSolver;
+	if(solver == NULL) solver = space->batchedSolver = (struct cpBatchedSolver *)cpcalloc(1, sizeof(struct cpBatchedSolver));
+	
+	BuildBatches(solver, space);
+	
+	cpArray *constraints = space->constraints;
+	for(int i=0; i<space->iterations; i++){
+		for(int j=0; j<solver->count; j++){
+			SolveBatch(solver->batches + j);
+		}
+		
+		for(int j=0; j<constraints->num; j++){
+			cpConstraint *constraint = (cpConstraint *)constraints->arr[j];
+			constraint->klass->applyImpulse(constraint, dt);
+		}
+	}
+	
+	// Copy the accumulated impulses back for the post-solve callbacks and the next step's warm start.
+	for(int i=0; i<solver->count; i++){
+		cpContactBatch *batch = solver->batches + i;
+		for(int lane=0; lane<batch->count; lane++){
+			struct cpContact *con = batch->contacts[lane];
+			con->jnAcc = batch->jnAcc[lane];
+			con->jtAcc = batch->jtAcc[lane];
+			con->jBias = batch->jBias[lane];
+		}
+	}
+}
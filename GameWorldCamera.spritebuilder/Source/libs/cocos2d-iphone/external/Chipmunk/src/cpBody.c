@@ -46,6 +46,7 @@ cpBodyInit(cpBody *body, cpFloat mass, cpFloat moment)
 	body->sleeping.idleTime = 0.0f;
 	
 	body->p = cpvzero;
+	body->p_prev = cpvzero;
 	body->v = cpvzero;
 	body->f = cpvzero;
 	
@@ -56,6 +57,7 @@ cpBodyInit(cpBody *body, cpFloat mass, cpFloat moment)
 	body->w_bias = 0.0f;
 	
 	body->userData = NULL;
+	body->ccd = cpFalse;
 	
 	// Setters must be called after full initialization so the sanity checks don't assert on garbage data.
 	cpBodySetMass(body, mass);
@@ -244,6 +246,18 @@ cpBodyGetSpace(const cpBody *body)
 	return body->space;
 }
 
+cpBool
+cpBodyGetCCD(const cpBody *body)
+{
+	return body->ccd;
+}
+
+void
+cpBodySetCCD(cpBody *body, cpBool ccd)
+{
+	body->ccd = ccd;
+}
+
 cpFloat
 cpBodyGetMass(const cpBody *body)
 {
@@ -344,18 +358,24 @@ cpBodyRemoveConstraint(cpBody *body, cpConstraint *constraint)
 }
 
 // 'p' is the position of the CoG
-static void
-SetTransform(cpBody *body, cpVect p, cpFloat a)
+static cpTransform
+BodyTransform(const cpBody *body, cpVect p, cpFloat a)
 {
 	cpVect rot = cpvforangle(a);
 	cpVect c = body->cog;
 	
-	body->transform = cpTransformNewTranspose(
+	return cpTransformNewTranspose(
 		rot.x, -rot.y, p.x - (c.x*rot.x - c.y*rot.y),
 		rot.y,  rot.x, p.y - (c.x*rot.y + c.y*rot.x)
 	);
 }
 
+static void
+SetTransform(cpBody *body, cpVect p, cpFloat a)
+{
+	body->transform = BodyTransform(body, p, a);
+}
+
 static inline cpFloat
 SetAngle(cpBody *body, cpFloat a)
 {
@@ -378,6 +398,9 @@ cpBodySetPosition(cpBody *body, cpVect position)
 	cpVect p = body->p = cpvadd(cpTransformVect(body->transform, body->cog), position);
 	cpAssertSaneBody(body);
 	
+	// Teleport instead of interpolating from the old position.
+	body->p_prev = p;
+	
 	SetTransform(body, p, body->a);
 }
 
@@ -434,10 +457,37 @@ cpBodySetAngle(cpBody *body, cpFloat angle)
 {
 	cpBodyActivate(body);
 	SetAngle(body, angle);
+	body->a_prev = angle;
 	
 	SetTransform(body, body->p, angle);
 }
 
+// Sleeping bodies are drawn where they fell asleep, which can be a hair past their last saved state.
+static inline cpFloat
+InterpolationAlpha(const cpBody *body, cpFloat alpha)
+{
+	return (cpBodyIsSleeping(body) ? 1.0f : alpha);
+}
+
+cpTransform
+cpBodyGetInterpolatedTransform(const cpBody *body, cpFloat alpha)
+{
+	alpha = InterpolationAlpha(body, alpha);
+	return BodyTransform(body, cpvlerp(body->p_prev, body->p, alpha), cpflerp(body->a_prev, body->a, alpha));
+}
+
+cpVect
+cpBodyGetInterpolatedPosition(const cpBody *body, cpFloat alpha)
+{
+	return cpTransformPoint(cpBodyGetInterpolatedTransform(body, alpha), cpvzero);
+}
+
+cpFloat
+cpBodyGetInterpolatedAngle(const cpBody *body, cpFloat alpha)
+{
+	return cpflerp(body->a_prev, body->a, InterpolationAlpha(body, alpha));
+}
+
 cpFloat
 cpBodyGetAngularVelocity(const cpBody *body)
 {
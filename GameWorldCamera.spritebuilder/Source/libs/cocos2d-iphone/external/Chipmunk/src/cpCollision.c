@@ -40,6 +40,9 @@
 #define WARN_GJK_ITERATIONS 20
 #define WARN_EPA_ITERATIONS 20
 
+// Polys with more vertexes than this find support points by walking from a nearby vertex instead of checking them all.
+#define POLY_HILL_CLIMB_COUNT 16
+
 static inline void
 cpCollisionInfoPushContact(struct cpCollisionInfo *info, cpVect p1, cpVect p2, cpHashValue hash)
 {
@@ -59,7 +62,7 @@ cpCollisionInfoPushContact(struct cpCollisionInfo *info, cpVect p1, cpVect p2, c
 // The GJK and EPA algorithms use support points to iteratively sample the surface of the two shapes' minkowski difference.
 
 static inline int
-PolySupportPointIndex(const int count, const struct cpSplittingPlane *planes, const cpVect n)
+PolySupportPointIndexScan(const int count, const struct cpSplittingPlane *planes, const cpVect n)
 {
 	cpFloat max = -INFINITY;
 	int index = 0;
@@ -76,6 +79,52 @@ PolySupportPointIndex(const int count, const struct cpSplittingPlane *planes, co
 	return index;
 }
 
+// The projections of a convex poly's vertexes onto an axis rise to a single maximum and fall to a single minimum going around it.
+// Starting at a vertex close to the support point, walking uphill finds it after only a few steps.
+static int
+PolySupportPointIndexClimb(const int count, const struct cpSplittingPlane *planes, const cpVect n, int i)
+{
+	cpFloat d = cpvdot(planes[i].v0, n);
+	
+	int next = (i + 1 < count ? i + 1 : 0);
+	cpFloat dNext = cpvdot(planes[next].v0, n);
+	if(dNext > d){
+		do {
+			i = next; d = dNext;
+			next = (i + 1 < count ? i + 1 : 0);
+			dNext = cpvdot(planes[next].v0, n);
+		} while(dNext > d);
+		
+		return i;
+	}
+	
+	int prev = (i > 0 ? i - 1 : count - 1);
+	cpFloat dPrev = cpvdot(planes[prev].v0, n);
+	if(dPrev > d){
+		do {
+			i = prev; d = dPrev;
+			prev = (i > 0 ? i - 1 : count - 1);
+			dPrev = cpvdot(planes[prev].v0, n);
+		} while(dPrev > d);
+		
+		return i;
+	}
+	
+	// Neither neighbor is higher. Unless the vertex is in the middle of a run of collinear vertexes, it's the maximum.
+	return (dNext < d && dPrev < d ? i : PolySupportPointIndexScan(count, planes, n));
+}
+
+// Find the support point index starting from the index of a recent support point on the same poly.
+static inline int
+PolySupportPointIndex(const int count, const struct cpSplittingPlane *planes, const cpVect n, const int hint)
+{
+	if(count > POLY_HILL_CLIMB_COUNT){
+		return PolySupportPointIndexClimb(count, planes, n, hint);
+	} else {
+		return PolySupportPointIndexScan(count, planes, n);
+	}
+}
+
 struct SupportPoint {
 	cpVect p;
 	// Save an index of the point so it can be cheaply looked up as a starting point for the next frame.
@@ -89,16 +138,17 @@ SupportPointNew(cpVect p, cpCollisionID index)
 	return point;
 }
 
-typedef struct SupportPoint (*SupportPointFunc)(const cpShape *shape, const cpVect n);
+// The hint is the index of a recent support point on the same shape.
+typedef struct SupportPoint (*SupportPointFunc)(const cpShape *shape, const cpVect n, const int hint);
 
 static inline struct SupportPoint
-CircleSupportPoint(const cpCircleShape *circle, const cpVect n)
+CircleSupportPoint(const cpCircleShape *circle, const cpVect n, const int hint)
 {
 	return SupportPointNew(circle->tc, 0);
 }
 
 static inline struct SupportPoint
-SegmentSupportPoint(const cpSegmentShape *seg, const cpVect n)
+SegmentSupportPoint(const cpSegmentShape *seg, const cpVect n, const int hint)
 {
 	if(cpvdot(seg->ta, n) > cpvdot(seg->tb, n)){
 		return SupportPointNew(seg->ta, 0);
@@ -108,10 +158,10 @@ SegmentSupportPoint(const cpSegmentShape *seg, const cpVect n)
 }
 
 static inline struct SupportPoint
-PolySupportPoint(const cpPolyShape *poly, const cpVect n)
+PolySupportPoint(const cpPolyShape *poly, const cpVect n, const int hint)
 {
 	const struct cpSplittingPlane *planes = poly->planes;
-	int i = PolySupportPointIndex(poly->count, planes, n);
+	int i = PolySupportPointIndex(poly->count, planes, n, hint);
 	return SupportPointNew(planes[i].v0, i);
 }
 
@@ -121,28 +171,33 @@ struct MinkowskiPoint {
 	cpVect a, b;
 	// b - a
 	cpVect ab;
-	// Concatenate the two support point indexes.
+	// Concatenate the two 16 bit support point indexes.
 	cpCollisionID id;
 };
 
 static inline struct MinkowskiPoint
 MinkowskiPointNew(const struct SupportPoint a, const struct SupportPoint b)
 {
-	struct MinkowskiPoint point = {a.p, b.p, cpvsub(b.p, a.p), (a.index & 0xFF)<<8 | (b.index & 0xFF)};
+	struct MinkowskiPoint point = {a.p, b.p, cpvsub(b.p, a.p), (a.index & 0xFFFF)<<16 | (b.index & 0xFFFF)};
 	return point;
 }
 
 struct SupportContext {
 	const cpShape *shape1, *shape2;
 	SupportPointFunc func1, func2;
+	// Indexes of the last support points found on each shape.
+	int hint1, hint2;
 };
 
 // Calculate the maximal point on the minkowski difference of two shapes along a particular axis.
 static inline struct MinkowskiPoint
-Support(const struct SupportContext *ctx, const cpVect n)
+Support(struct SupportContext *ctx, const cpVect n)
 {
-	struct SupportPoint a = ctx->func1(ctx->shape1, cpvneg(n));
-	struct SupportPoint b = ctx->func2(ctx->shape2, n);
+	struct SupportPoint a = ctx->func1(ctx->shape1, cpvneg(n), ctx->hint1);
+	struct SupportPoint b = ctx->func2(ctx->shape2, n, ctx->hint2);
+	
+	ctx->hint1 = (int)a.index;
+	ctx->hint2 = (int)b.index;
 	return MinkowskiPointNew(a, b);
 }
 
@@ -160,14 +215,13 @@ struct Edge {
 };
 
 static struct Edge
-SupportEdgeForPoly(const cpPolyShape *poly, const cpVect n)
+SupportEdgeForPoly(const cpPolyShape *poly, const cpVect n, const int hint)
 {
 	int count = poly->count;
-	int i1 = PolySupportPointIndex(poly->count, poly->planes, n);
+	int i1 = PolySupportPointIndex(count, poly->planes, n, hint);
 	
-	// TODO: get rid of mod eventually, very expensive on ARM
-	int i0 = (i1 - 1 + count)%count;
-	int i2 = (i1 + 1)%count;
+	int i0 = (i1 > 0 ? i1 - 1 : count - 1);
+	int i2 = (i1 + 1 < count ? i1 + 1 : 0);
 	
 	const struct cpSplittingPlane *planes = poly->planes;
 	cpHashValue hashid = poly->shape.hashid;
@@ -218,7 +272,7 @@ struct ClosestPoints {
 	cpVect n;
 	// Signed distance between the points.
 	cpFloat d;
-	// Concatenation of the id's of the minkoski points.
+	// Concatenation of the 32 bit id's of the minkoski points.
 	cpCollisionID id;
 };
 
@@ -234,7 +288,7 @@ ClosestPointsNew(const struct MinkowskiPoint v0, const struct MinkowskiPoint v1)
 	// This gives you the closest surface points in absolute coordinates. NEAT!
 	cpVect pa = LerpT(v0.a, v1.a, t);
 	cpVect pb = LerpT(v0.b, v1.b, t);
-	cpCollisionID id = (v0.id & 0xFFFF)<<16 | (v1.id & 0xFFFF);
+	cpCollisionID id = (v0.id & 0xFFFFFFFF)<<32 | (v1.id & 0xFFFFFFFF);
 	
 	// First try calculating the MSA from the minkowski difference edge.
 	// This gives us a nice, accurate MSA when the surfaces are close together.
@@ -273,7 +327,7 @@ CheckArea(cpVect v1, cpVect v2)
 // Recursive implementation of the EPA loop.
 // Each recursion adds a point to the convex hull until it's known that we have the closest point on the surface.
 static struct ClosestPoints
-EPARecurse(const struct SupportContext *ctx, const int count, const struct MinkowskiPoint *hull, const int iteration)
+EPARecurse(struct SupportContext *ctx, const int count, const struct MinkowskiPoint *hull, const int iteration)
 {
 	int mini = 0;
 	cpFloat minDist = INFINITY;
@@ -336,7 +390,7 @@ EPARecurse(const struct SupportContext *ctx, const int count, const struct Minko
 // EPA is called from GJK when two shapes overlap.
 // This is moderately expensive step! Avoid it by adding radii to your shapes so their inner polygons won't overlap.
 static struct ClosestPoints
-EPA(const struct SupportContext *ctx, const struct MinkowskiPoint v0, const struct MinkowskiPoint v1, const struct MinkowskiPoint v2)
+EPA(struct SupportContext *ctx, const struct MinkowskiPoint v0, const struct MinkowskiPoint v1, const struct MinkowskiPoint v2)
 {
 	// TODO: allocate a NxM array here and do an in place convex hull reduction in EPARecurse
 	struct MinkowskiPoint hull[3] = {v0, v1, v2};
@@ -347,7 +401,7 @@ EPA(const struct SupportContext *ctx, const struct MinkowskiPoint v0, const stru
 
 // Recursive implementatino of the GJK loop.
 static inline struct ClosestPoints
-GJKRecurse(const struct SupportContext *ctx, const struct MinkowskiPoint v0, const struct MinkowskiPoint v1, const int iteration)
+GJKRecurse(struct SupportContext *ctx, const struct MinkowskiPoint v0, const struct MinkowskiPoint v1, const int iteration)
 {
 	if(iteration > MAX_GJK_ITERATIONS){
 		cpAssertWarn(iteration < WARN_GJK_ITERATIONS, "High GJK iterations: %d", iteration);
@@ -419,7 +473,7 @@ ShapePoint(const cpShape *shape, const int i)
 
 // Find the closest points between two shapes using the GJK algorithm.
 static struct ClosestPoints
-GJK(const struct SupportContext *ctx, cpCollisionID *id)
+GJK(struct SupportContext *ctx, cpCollisionID *id)
 {
 #if DRAW_GJK || DRAW_EPA
 	int count1 = 1;
@@ -462,8 +516,14 @@ GJK(const struct SupportContext *ctx, cpCollisionID *id)
 	struct MinkowskiPoint v0, v1;
 	if(*id){
 		// Use the minkowski points from the last frame as a starting point using the cached indexes.
-		v0 = MinkowskiPointNew(ShapePoint(ctx->shape1, (*id>>24)&0xFF), ShapePoint(ctx->shape2, (*id>>16)&0xFF));
-		v1 = MinkowskiPointNew(ShapePoint(ctx->shape1, (*id>> 8)&0xFF), ShapePoint(ctx->shape2, (*id    )&0xFF));
+		struct SupportPoint a = ShapePoint(ctx->shape1, (*id>>48)&0xFFFF);
+		struct SupportPoint b = ShapePoint(ctx->shape2, (*id>>32)&0xFFFF);
+		v0 = MinkowskiPointNew(a, b);
+		v1 = MinkowskiPointNew(ShapePoint(ctx->shape1, (*id>>16)&0xFFFF), ShapePoint(ctx->shape2, (*id)&0xFFFF));
+		
+		// Start the support point searches from there too.
+		ctx->hint1 = (int)a.index;
+		ctx->hint2 = (int)b.index;
 	} else {
 		// No cached indexes, use the shapes' bounding box centers as a guess for a starting axis.
 		cpVect axis = cpvperp(cpvsub(cpBBCenter(ctx->shape1->bb), cpBBCenter(ctx->shape2->bb)));
@@ -575,7 +635,7 @@ CircleToSegment(const cpCircleShape *circle, const cpSegmentShape *segment, stru
 static void
 SegmentToSegment(const cpSegmentShape *seg1, const cpSegmentShape *seg2, struct cpCollisionInfo *info)
 {
-	struct SupportContext context = {(cpShape *)seg1, (cpShape *)seg2, (SupportPointFunc)SegmentSupportPoint, (SupportPointFunc)SegmentSupportPoint};
+	struct SupportContext context = {(cpShape *)seg1, (cpShape *)seg2, (SupportPointFunc)SegmentSupportPoint, (SupportPointFunc)SegmentSupportPoint, 0, 0};
 	struct ClosestPoints points = GJK(&context, &info->id);
 	
 #if DRAW_CLOSEST
@@ -611,7 +671,7 @@ SegmentToSegment(const cpSegmentShape *seg1, const cpSegmentShape *seg2, struct
 static void
 PolyToPoly(const cpPolyShape *poly1, const cpPolyShape *poly2, struct cpCollisionInfo *info)
 {
-	struct SupportContext context = {(cpShape *)poly1, (cpShape *)poly2, (SupportPointFunc)PolySupportPoint, (SupportPointFunc)PolySupportPoint};
+	struct SupportContext context = {(cpShape *)poly1, (cpShape *)poly2, (SupportPointFunc)PolySupportPoint, (SupportPointFunc)PolySupportPoint, 0, 0};
 	struct ClosestPoints points = GJK(&context, &info->id);
 	
 #if DRAW_CLOSEST
@@ -627,14 +687,14 @@ PolyToPoly(const cpPolyShape *poly1, const cpPolyShape *poly2, struct cpCollisio
 	
 	// If the closest points are nearer than the sum of the radii...
 	if(points.d - poly1->r - poly2->r <= 0.0){
-		ContactPoints(SupportEdgeForPoly(poly1, points.n), SupportEdgeForPoly(poly2, cpvneg(points.n)), points, info);
+		ContactPoints(SupportEdgeForPoly(poly1, points.n, context.hint1), SupportEdgeForPoly(poly2, cpvneg(points.n), context.hint2), points, info);
 	}
 }
 
 static void
 SegmentToPoly(const cpSegmentShape *seg, const cpPolyShape *poly, struct cpCollisionInfo *info)
 {
-	struct SupportContext context = {(cpShape *)seg, (cpShape *)poly, (SupportPointFunc)SegmentSupportPoint, (SupportPointFunc)PolySupportPoint};
+	struct SupportContext context = {(cpShape *)seg, (cpShape *)poly, (SupportPointFunc)SegmentSupportPoint, (SupportPointFunc)PolySupportPoint, 0, 0};
 	struct ClosestPoints points = GJK(&context, &info->id);
 	
 #if DRAW_CLOSEST
@@ -660,14 +720,14 @@ SegmentToPoly(const cpSegmentShape *seg, const cpPolyShape *poly, struct cpColli
 			(!cpveql(points.a, seg->tb) || cpvdot(n, cpvrotate(seg->b_tangent, rot)) <= 0.0)
 		)
 	){
-		ContactPoints(SupportEdgeForSegment(seg, n), SupportEdgeForPoly(poly, cpvneg(n)), points, info);
+		ContactPoints(SupportEdgeForSegment(seg, n), SupportEdgeForPoly(poly, cpvneg(n), context.hint2), points, info);
 	}
 }
 
 static void
 CircleToPoly(const cpCircleShape *circle, const cpPolyShape *poly, struct cpCollisionInfo *info)
 {
-	struct SupportContext context = {(cpShape *)circle, (cpShape *)poly, (SupportPointFunc)CircleSupportPoint, (SupportPointFunc)PolySupportPoint};
+	struct SupportContext context = {(cpShape *)circle, (cpShape *)poly, (SupportPointFunc)CircleSupportPoint, (SupportPointFunc)PolySupportPoint, 0, 0};
 	struct ClosestPoints points = GJK(&context, &info->id);
 	
 #if DRAW_CLOSEST
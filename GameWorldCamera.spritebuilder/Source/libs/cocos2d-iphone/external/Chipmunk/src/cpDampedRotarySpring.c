@@ -67,8 +67,8 @@ applyImpulse(cpDampedRotarySpring *spring, cpFloat dt)
 	cpFloat j_damp = w_damp*spring->iSum;
 	spring->jAcc += j_damp;
 	
-	a->w += j_damp*a->i_inv;
-	b->w -= j_damp*b->i_inv;
+	if(!infinite_body(a)) a->w += j_damp*a->i_inv;
+	if(!infinite_body(b)) b->w -= j_damp*b->i_inv;
 }
 
 static cpFloat
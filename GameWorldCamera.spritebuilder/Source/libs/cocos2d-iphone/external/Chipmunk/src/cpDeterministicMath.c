@@ -0,0 +1,349 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "chipmunk/chipmunk_private.h"
+
+// Replacements for the libm transcendental functions that give bit identical results on every IEEE 754 platform.
+// They only use +, -, *, / and functions that are exact such as floor(), frexp() and ldexp(),
+// so they must be compiled without -ffast-math and with floating point contraction turned off.
+// The argument reductions and polynomials are the ones from fdlibm, evaluated in double precision for both float and double builds.
+
+//MARK: Sine and Cosine
+
+// Sine and cosine on [-pi/4, pi/4].
+static inline double
+KernelSin(double x)
+{
+	const double S1 = -1.66666666666666324348e-01;
+	const double S2 =  8.33333333332248946124e-03;
+	const double S3 = -1.98412698298579493134e-04;
+	const double S4 =  2.75573137070700676789e-06;
+	const double S5 = -2.50507602534068634195e-08;
+	const double S6 =  1.58969099521155010221e-10;
+	
+	double z = x*x;
+	double r = S2 + z*(S3 + z*(S4 + z*(S5 + z*S6)));
+	return x + z*x*(S1 + z*r);
+}
+
+static inline double
+KernelCos(double x)
+{
+	const double C1 =  4.16666666666666019037e-02;
+	const double C2 = -1.38888888888741095749e-03;
+	const double C3 =  2.48015872894767294178e-05;
+	const double C4 = -2.75573143513906633035e-07;
+	const double C5 =  2.08757232129817482790e-09;
+	const double C6 = -1.13596475577881948265e-11;
+	
+	double z = x*x;
+	double r = z*(C1 + z*(C2 + z*(C3 + z*(C4 + z*(C5 + z*C6)))));
+	double hz = 0.5*z, w = 1.0 - hz;
+	return w + (((1.0 - w) - hz) + z*r);
+}
+
+// Bits of 2/pi after the binary point, enough to reduce the largest double.
+static const uint32_t TWO_OVER_PI[] = {
+	0xA2F9836E, 0x4E441529, 0xFC2757D1, 0xF534DDC0, 0xDB629599, 0x3C439041, 0xFE5163AB, 0xDEBBC561,
+	0xB7246E3A, 0x424DD2E0, 0x06492EEA, 0x09D1921C, 0xFE1DEB1C, 0xB129A73E, 0xE88235F5, 0x2EBB4484,
+	0xE99C7026, 0xB45F7E41, 0x3991D639, 0x835339F4, 0x9C845F8B, 0xBDF9283B, 0x1FF897FF, 0xDE05980F,
+	0xEF2F118B, 0x5A0A6D1F, 0x6D367ECF, 0x27CB09B7, 0x4F463F66, 0x9E5FEA2D, 0x7527BAC7, 0xEBE5F17B,
+	0x3D0739F7, 0x8A5292EA, 0x6BFB5FB1, 0x1F8D5D08, 0x56033046, 0xFC7B6BAB,
+};
+
+// Number of words of 2/pi multiplied in by ReduceQuadrantLarge().
+#define REDUCE_WORDS 6
+
+// 32 bits of the little endian number p starting at bit pos.
+static inline uint32_t
+Bits32(const uint32_t *p, int count, int pos)
+{
+	int i = pos/32;
+	uint64_t w = p[i] | (i + 1 < count ? (uint64_t)p[i + 1] << 32 : 0);
+	return (uint32_t)(w >> (pos%32));
+}
+
+// Payne-Hanek reduction for arguments too large for ReduceQuadrant().
+// |x| is split into an integer m times 2^e, and m is multiplied by the window of 2/pi bits
+// that can change x*2/pi modulo 4 using integer arithmetic, so the result is exact to about 2^-106.
+static int
+ReduceQuadrantLarge(double x, double *r)
+{
+	int e;
+	uint64_t m = (uint64_t)ldexp(frexp(fabs(x), &e), 53);
+	e -= 53;
+	
+	// Words before j0 only add multiples of 4 to x*2/pi.
+	int j0 = (e > 2 ? (e - 2)/32 : 0);
+	
+	uint32_t mw[2] = {(uint32_t)m, (uint32_t)(m >> 32)};
+	uint32_t p[REDUCE_WORDS + 2] = {0};
+	for(int i = 0; i < REDUCE_WORDS; i++){
+		uint64_t w = TWO_OVER_PI[j0 + REDUCE_WORDS - 1 - i], carry = 0;
+		for(int j = 0; j < 2; j++){
+			uint64_t t = w*mw[j] + p[i + j] + carry;
+			p[i + j] = (uint32_t)t;
+			carry = t >> 32;
+		}
+		p[i + 2] = (uint32_t)carry;
+	}
+	
+	// p*2^-point is x*2/pi modulo 4 plus a fraction.
+	int point = 32*(j0 + REDUCE_WORDS) - e;
+	int q = Bits32(p, REDUCE_WORDS + 2, point) & 3;
+	uint32_t f[4];
+	for(int i = 0; i < 4; i++) f[i] = Bits32(p, REDUCE_WORDS + 2, point - 32*(i + 1));
+	
+	// Round to the nearest quadrant. 1 - f is taken on the words so small remainders keep their precision.
+	cpBool up = (f[0] >> 31);
+	if(up){
+		q += 1;
+		for(int i = 0; i < 4; i++) f[i] = ~f[i];
+	}
+	
+	double y = ((f[0]*2.3283064365386962890625e-10 + f[1]*5.42101086242752217004e-20) + f[2]*1.26217744835361888866e-29) + f[3]*2.93873587705571876992e-39;
+	y = y*1.57079632679489655800e+00 + y*6.12323399573676603587e-17;
+	if(up) y = -y;
+	
+	if(x < 0.0){
+		(*r) = -y;
+		return -q & 3;
+	} else {
+		(*r) = y;
+		return q & 3;
+	}
+}
+
+// Reduce x to r in [-pi/4, pi/4] and return the quadrant it was in.
+// pi/2 is split into three parts so the first products are exact while the quadrant count is below 2^20.
+// Larger arguments use ReduceQuadrantLarge().
+static inline int
+ReduceQuadrant(double x, double *r)
+{
+	const double INV_PIO2 = 6.36619772367581382433e-01;
+	const double PIO2_1 = 1.57079632673412561417e+00;
+	const double PIO2_2 = 6.07710050630396597660e-11;
+	const double PIO2_3 = 2.02226624871116645580e-21;
+	
+	// 2^19*pi/2
+	if(fabs(x) >= 8.23549665395302981e+05) return ReduceQuadrantLarge(x, r);
+	
+	double k = floor(x*INV_PIO2 + 0.5);
+	(*r) = ((x - k*PIO2_1) - k*PIO2_2) - k*PIO2_3;
+	return (int)(k - 4.0*floor(0.25*k));
+}
+
+cpFloat
+cpDeterministicSin(cpFloat x)
+{
+	// Infinities and NaNs.
+	if(x - x != 0.0f) return x - x;
+	
+	double r;
+	switch(ReduceQuadrant(x, &r)){
+		case 0: return (cpFloat) KernelSin(r);
+		case 1: return (cpFloat) KernelCos(r);
+		case 2: return (cpFloat)-KernelSin(r);
+		default: return (cpFloat)-KernelCos(r);
+	}
+}
+
+cpFloat
+cpDeterministicCos(cpFloat x)
+{
+	if(x - x != 0.0f) return x - x;
+	
+	double r;
+	switch(ReduceQuadrant(x, &r)){
+		case 0: return (cpFloat) KernelCos(r);
+		case 1: return (cpFloat)-KernelSin(r);
+		case 2: return (cpFloat)-KernelCos(r);
+		default: return (cpFloat) KernelSin(r);
+	}
+}
+
+//MARK: Arctangent
+
+static const double PI_HI = 3.1415926535897931160e+00;
+static const double PI_LO = 1.2246467991473531772e-16;
+
+static double
+Atan(double x)
+{
+	static const double atanhi[] = {4.63647609000806093515e-01, 7.85398163397448278999e-01, 9.82793723247329054082e-01, 1.57079632679489655800e+00};
+	static const double atanlo[] = {2.26987774529616870924e-17, 3.06161699786838301793e-17, 1.39033110312309984516e-17, 6.12323399573676603587e-17};
+	static const double aT[] = {
+		 3.33333333333329318027e-01, -1.99999999998764832476e-01,  1.42857142725034663711e-01, -1.11111104054623557880e-01,
+		 9.09088713343650656196e-02, -7.69187620504482999495e-02,  6.66107313738753120669e-02, -5.83357013379057348645e-02,
+		 4.97687799461593236017e-02, -3.65315727442169155270e-02,  1.62858201153657823623e-02,
+	};
+	
+	if(x != x) return x + x;
+	
+	// Reduce |x| to a small argument t and an offset atanhi[id] + atanlo[id].
+	double ax = fabs(x), t;
+	int id;
+	
+	if(ax >= 7.3786976294838206464e+19){
+		// |x| >= 2^66, so atan(x) rounds to +/- pi/2.
+		double z = atanhi[3] + atanlo[3];
+		return (x < 0.0 ? -z : z);
+	} else if(ax < 0.4375){
+		if(ax < 7.4505805969238281e-09) return x;
+		id = -1; t = x;
+	} else if(ax < 0.6875){
+		id = 0; t = (2.0*ax - 1.0)/(2.0 + ax);
+	} else if(ax < 1.1875){
+		id = 1; t = (ax - 1.0)/(ax + 1.0);
+	} else if(ax < 2.4375){
+		id = 2; t = (ax - 1.5)/(1.0 + 1.5*ax);
+	} else {
+		id = 3; t = -1.0/ax;
+	}
+	
+	double z = t*t, w = z*z;
+	double s1 = z*(aT[0] + w*(aT[2] + w*(aT[4] + w*(aT[6] + w*(aT[8] + w*aT[10])))));
+	double s2 = w*(aT[1] + w*(aT[3] + w*(aT[5] + w*(aT[7] + w*aT[9]))));
+	if(id < 0) return t - t*(s1 + s2);
+	
+	z = atanhi[id] - ((t*(s1 + s2) - atanlo[id]) - t);
+	return (x < 0.0 ? -z : z);
+}
+
+cpFloat
+cpDeterministicAtan2(cpFloat y, cpFloat x)
+{
+	if(x != x || y != y) return x + y;
+	
+	if(y == 0.0f){
+		// Keeps the sign of zero like atan2() does.
+		return (signbit(x) ? (signbit(y) ? -PI_HI : PI_HI) : y);
+	} else if(x == 0.0f || isinf(y)){
+		if(isinf(x)){
+			double z = (x > 0.0f ? 0.25*PI_HI : 0.75*PI_HI);
+			return (cpFloat)(y < 0.0f ? -z : z);
+		} else {
+			return (cpFloat)(y < 0.0f ? -0.5*PI_HI : 0.5*PI_HI);
+		}
+	} else if(isinf(x)){
+		double z = (x > 0.0f ? 0.0 : PI_HI);
+		return (cpFloat)(y < 0.0f ? -z : z);
+	}
+	
+	double z = Atan(fabs((double)y/(double)x));
+	if(x < 0.0f) z = PI_HI - (z - PI_LO);
+	return (cpFloat)(y < 0.0f ? -z : z);
+}
+
+cpFloat
+cpDeterministicAcos(cpFloat x)
+{
+	double s = sqrt((1.0 - (double)x)*(1.0 + (double)x));
+	return cpDeterministicAtan2((cpFloat)s, x);
+}
+
+//MARK: Exponentials and Logarithms
+
+static const double LN2_HI = 6.93147180369123816490e-01;
+static const double LN2_LO = 1.90821492927058770002e-10;
+
+static double
+Exp(double x)
+{
+	const double INV_LN2 = 1.44269504088896338700e+00;
+	const double P1 =  1.66666666666666019037e-01;
+	const double P2 = -2.77777777770155933842e-03;
+	const double P3 =  6.61375632143793436117e-05;
+	const double P4 = -1.65339022054652515390e-06;
+	const double P5 =  4.13813679705723846039e-08;
+	
+	if(x != x) return x + x;
+	if(x > 7.09782712893383973096e+02) return INFINITY;
+	if(x < -7.45133219101941108420e+02) return 0.0;
+	if(fabs(x) < 3.7252902984e-09) return 1.0 + x;
+	
+	// x = k*ln2 + r with |r| <= ln2/2.
+	double k = floor(x*INV_LN2 + 0.5);
+	double hi = x - k*LN2_HI, lo = k*LN2_LO;
+	double r = hi - lo;
+	
+	double t = r*r;
+	double c = r - t*(P1 + t*(P2 + t*(P3 + t*(P4 + t*P5))));
+	double y = 1.0 - ((lo - (r*c)/(2.0 - c)) - hi);
+	return ldexp(y, (int)k);
+}
+
+static double
+Log(double x)
+{
+	const double LG1 = 6.666666666666735130e-01;
+	const double LG2 = 3.999999999940941908e-01;
+	const double LG3 = 2.857142874366239149e-01;
+	const double LG4 = 2.222219843214978396e-01;
+	const double LG5 = 1.818357216161805012e-01;
+	const double LG6 = 1.531383769920937332e-01;
+	const double LG7 = 1.479819860511658591e-01;
+	
+	if(x != x || x == INFINITY) return x + x;
+	if(x < 0.0) return NAN;
+	if(x == 0.0) return -INFINITY;
+	
+	// x = 2^k*m with m in [sqrt(2)/2, sqrt(2)).
+	int k;
+	double m = frexp(x, &k);
+	if(m < 7.07106781186547524401e-01){
+		m *= 2.0;
+		k--;
+	}
+	
+	double f = m - 1.0;
+	double s = f/(2.0 + f), z = s*s, w = z*z;
+	double R = z*(LG1 + w*(LG3 + w*(LG5 + w*LG7))) + w*(LG2 + w*(LG4 + w*LG6));
+	double hfsq = 0.5*f*f, dk = k;
+	return dk*LN2_HI - ((hfsq - (s*(hfsq + R) + dk*LN2_LO)) - f);
+}
+
+cpFloat
+cpDeterministicExp(cpFloat x)
+{
+	return (cpFloat)Exp(x);
+}
+
+// Computed as exp(y*log(x)), so the error of log() grows with y*log(x). That's a few ulps at most for the
+// damping and bias factors Chipmunk raises to the power of dt, but a few hundred for huge results.
+cpFloat
+cpDeterministicPow(cpFloat x, cpFloat y)
+{
+	if(y == 0.0f || x == 1.0f) return 1.0f;
+	if(x != x || y != y) return x + y;
+	
+	// Negative bases only have real powers for integer exponents.
+	double sign = 1.0;
+	if(x < 0.0f){
+		if(y != floor(y)) return NAN;
+		if(fmod(y, 2.0) != 0.0) sign = -1.0;
+		x = -x;
+	}
+	
+	if(x == 0.0f) return (cpFloat)(y > 0.0f ? 0.0*sign : INFINITY*sign);
+	return (cpFloat)(sign*Exp((double)y*Log(x)));
+}
@@ -64,8 +64,8 @@ applyImpulse(cpGearJoint *joint, cpFloat dt)
 	j = joint->jAcc - jOld;
 	
 	// apply impulse
-	a->w -= j*a->i_inv*joint->ratio_inv;
-	b->w += j*b->i_inv;
+	if(!infinite_body(a)) a->w -= j*a->i_inv*joint->ratio_inv;
+	if(!infinite_body(b)) b->w += j*b->i_inv;
 }
 
 static cpFloat
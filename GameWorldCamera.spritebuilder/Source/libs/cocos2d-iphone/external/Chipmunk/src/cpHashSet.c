@@ -20,35 +20,71 @@
  */
 
 #include "chipmunk/chipmunk_private.h"
-#include "prime.h"
+
+// Open addressing hash set using linear probing.
+// Bins store the element and its hash in one flat table so lookups don't chase pointers.
+// Removal shifts the rest of the cluster back instead of leaving tombstones.
 
 typedef struct cpHashSetBin {
 	void *elt;
 	cpHashValue hash;
-	struct cpHashSetBin *next;
 } cpHashSetBin;
 
 struct cpHashSet {
-	unsigned int entries, size;
+	unsigned int entries, capacity;
+	// Amount to shift the scrambled hash by to get a table index.
+	unsigned int shift;
 	
 	cpHashSetEqlFunc eql;
 	void *default_value;
 	
-	cpHashSetBin **table;
-	cpHashSetBin *pooledBins;
-	
-	cpArray *allocatedBuffers;
+	cpHashSetBin *table;
+	const cpAllocator *allocator;
 };
 
+#define MIN_CAPACITY 8
+
+static inline unsigned int
+HashIndex(cpHashSet *set, cpHashValue hash)
+{
+	// Pointer hashes have their low bits clear, so scramble and use the high bits.
+	return (unsigned int)(((uint64_t)hash*0x9E3779B97F4A7C15ull) >> set->shift);
+}
+
+static inline unsigned int
+NextIndex(cpHashSet *set, unsigned int idx)
+{
+	return (idx + 1) & (set->capacity - 1);
+}
+
+static inline cpBool
+BinMatches(cpHashSet *set, cpHashSetBin *bin, cpHashValue hash, void *ptr)
+{
+	return (bin->hash == hash && set->eql(ptr, bin->elt));
+}
+
+static void
+AllocTable(cpHashSet *set, unsigned int capacity)
+{
+	unsigned int shift = 64;
+	for(unsigned int i=1; i<capacity; i<<=1) shift--;
+	
+	set->capacity = capacity;
+	set->shift = shift;
+	set->table = (cpHashSetBin *)cpAllocatorAlloc(set->allocator, capacity*sizeof(cpHashSetBin));
+}
+
+static inline void
+FreeTable(cpHashSet *set, cpHashSetBin *table, unsigned int capacity)
+{
+	cpAllocatorFree(set->allocator, table, capacity*sizeof(cpHashSetBin));
+}
+
 void
 cpHashSetFree(cpHashSet *set)
 {
 	if(set){
-		cpfree(set->table);
-		
-		cpArrayFreeEach(set->allocatedBuffers, cpfree);
-		cpArrayFree(set->allocatedBuffers);
-		
+		FreeTable(set, set->table, set->capacity);
 		cpfree(set);
 	}
 }
@@ -58,89 +94,92 @@ cpHashSetNew(int size, cpHashSetEqlFunc eqlFunc)
 {
 	cpHashSet *set = (cpHashSet *)cpcalloc(1, sizeof(cpHashSet));
 	
-	set->size = next_prime(size);
+	unsigned int capacity = MIN_CAPACITY;
+	while(capacity < 2*(unsigned int)size) capacity <<= 1;
+	
 	set->entries = 0;
 	
 	set->eql = eqlFunc;
 	set->default_value = NULL;
 	
-	set->table = (cpHashSetBin **)cpcalloc(set->size, sizeof(cpHashSetBin *));
-	set->pooledBins = NULL;
-	
-	set->allocatedBuffers = cpArrayNew(0);
+	set->allocator = NULL;
+	AllocTable(set, capacity);
 	
 	return set;
 }
 
 void
-cpHashSetSetDefaultValue(cpHashSet *set, void *default_value)
+cpHashSetSetAllocator(cpHashSet *set, const cpAllocator *allocator)
 {
-	set->default_value = default_value;
+	cpAssertHard(set->entries == 0, "The allocator must be set before anything is added.");
+	
+	FreeTable(set, set->table, set->capacity);
+	set->allocator = allocator;
+	AllocTable(set, set->capacity);
+}
+
+unsigned int
+cpHashSetGetCapacity(cpHashSet *set)
+{
+	return set->capacity;
+}
+
+void
+cpHashSetSetCapacity(cpHashSet *set, unsigned int capacity)
+{
+	cpAssertHard(set->entries == 0, "Internal Error: The capacity can only be set on an empty set.");
+	cpAssertHard(capacity >= MIN_CAPACITY && (capacity & (capacity - 1)) == 0, "Internal Error: Invalid hash set capacity.");
+	
+	FreeTable(set, set->table, set->capacity);
+	AllocTable(set, capacity);
 }
 
-static int
-setIsFull(cpHashSet *set)
+void
+cpHashSetSetDefaultValue(cpHashSet *set, void *default_value)
 {
-	return (set->entries >= set->size);
+	set->default_value = default_value;
 }
 
 static void
 cpHashSetResize(cpHashSet *set)
 {
-	// Get the next approximate doubled prime.
-	unsigned int newSize = next_prime(set->size + 1);
-	// Allocate a new table.
-	cpHashSetBin **newTable = (cpHashSetBin **)cpcalloc(newSize, sizeof(cpHashSetBin *));
-	
-	// Iterate over the chains.
-	for(unsigned int i=0; i<set->size; i++){
-		// Rehash the bins into the new table.
-		cpHashSetBin *bin = set->table[i];
-		while(bin){
-			cpHashSetBin *next = bin->next;
-			
-			cpHashValue idx = bin->hash%newSize;
-			bin->next = newTable[idx];
-			newTable[idx] = bin;
-			
-			bin = next;
+	cpHashSetBin *oldTable = set->table;
+	unsigned int oldCapacity = set->capacity;
+	
+	AllocTable(set, 2*oldCapacity);
+	
+	// Reinsert the elements into the new table. They are all unique so they only need an empty bin.
+	for(unsigned int i=0; i<oldCapacity; i++){
+		cpHashSetBin *bin = oldTable + i;
+		if(bin->elt){
+			unsigned int idx = HashIndex(set, bin->hash);
+			while(set->table[idx].elt) idx = NextIndex(set, idx);
+			set->table[idx] = *bin;
 		}
 	}
 	
-	cpfree(set->table);
-	
-	set->table = newTable;
-	set->size = newSize;
-}
-
-static inline void
-recycleBin(cpHashSet *set, cpHashSetBin *bin)
-{
-	bin->next = set->pooledBins;
-	set->pooledBins = bin;
-	bin->elt = NULL;
+	FreeTable(set, oldTable, oldCapacity);
 }
 
-static cpHashSetBin *
-getUnusedBin(cpHashSet *set)
+// Empty the bin at 'hole' and shift back any later elements of the cluster that can move closer to their home bins.
+static void
+RemoveBin(cpHashSet *set, unsigned int hole)
 {
-	cpHashSetBin *bin = set->pooledBins;
+	cpHashSetBin *table = set->table;
+	unsigned int mask = set->capacity - 1;
 	
-	if(bin){
-		set->pooledBins = bin->next;
-		return bin;
-	} else {
-		// Pool is exhausted, make more
-		int count = CP_BUFFER_BYTES/sizeof(cpHashSetBin);
-		cpAssertHard(count, "Internal Error: Buffer size is too small.");
-		
-		cpHashSetBin *buffer = (cpHashSetBin *)cpcalloc(1, CP_BUFFER_BYTES);
-		cpArrayPush(set->allocatedBuffers, buffer);
+	for(unsigned int idx = NextIndex(set, hole); table[idx].elt; idx = NextIndex(set, idx)){
+		unsigned int home = HashIndex(set, table[idx].hash);
 		
-		// push all but the first one, return it instead
-		for(int i=1; i<count; i++) recycleBin(set, buffer + i);
-		return buffer;
+		// Move the element back if its home bin is not cyclically within (hole, idx].
+		if(((idx - home) & mask) >= ((idx - hole) & mask)){
+			table[hole] = table[idx];
+			hole = idx;
+		}
 	}
+	
+	table[hole].elt = NULL;
+	set->entries--;
 }
 
 int
@@ -152,53 +191,51 @@ cpHashSetCount(cpHashSet *set)
 void *
 cpHashSetInsert(cpHashSet *set, cpHashValue hash, void *ptr, cpHashSetTransFunc trans, void *data)
 {
-	cpHashValue idx = hash%set->size;
+	unsigned int idx = HashIndex(set, hash);
 	
-	// Find the bin with the matching element.
-	cpHashSetBin *bin = set->table[idx];
-	while(bin && !set->eql(ptr, bin->elt))
-		bin = bin->next;
+	// Find the bin with the matching element, or the end of the cluster.
+	cpHashSetBin *bin = set->table + idx;
+	while(bin->elt){
+		if(BinMatches(set, bin, hash, ptr)) return bin->elt;
+		
+		idx = NextIndex(set, idx);
+		bin = set->table + idx;
+	}
 	
 	// Create it if necessary.
-	if(!bin){
-		bin = getUnusedBin(set);
-		bin->hash = hash;
-		bin->elt = (trans ? trans(ptr, data) : data);
-		
-		bin->next = set->table[idx];
-		set->table[idx] = bin;
+	void *elt = (trans ? trans(ptr, data) : data);
+	cpAssertHard(elt, "Internal Error: Hash set elements cannot be NULL.");
+	
+	// Keep the table at most half full so probe sequences stay short.
+	if(2*(set->entries + 1) > set->capacity){
+		cpHashSetResize(set);
 		
-		set->entries++;
-		if(setIsFull(set)) cpHashSetResize(set);
+		idx = HashIndex(set, hash);
+		while(set->table[idx].elt) idx = NextIndex(set, idx);
+		bin = set->table + idx;
 	}
 	
-	return bin->elt;
+	bin->elt = elt;
+	bin->hash = hash;
+	set->entries++;
+	
+	return elt;
 }
 
 void *
 cpHashSetRemove(cpHashSet *set, cpHashValue hash, void *ptr)
 {
-	cpHashValue idx = hash%set->size;
-	
-	cpHashSetBin **prev_ptr = &set->table[idx];
-	cpHashSetBin *bin = set->table[idx];
-	
 	// Find the bin
-	while(bin && !set->eql(ptr, bin->elt)){
-		prev_ptr = &bin->next;
-		bin = bin->next;
-	}
-	
-	// Remove it if it exists.
-	if(bin){
-		// Update the previous linked list pointer
-		(*prev_ptr) = bin->next;
-		set->entries--;
-		
-		void *elt = bin->elt;
-		recycleBin(set, bin);
+	for(unsigned int idx = HashIndex(set, hash); set->table[idx].elt; idx = NextIndex(set, idx)){
+		cpHashSetBin *bin = set->table + idx;
 		
-		return elt;
+		// Remove it if it exists.
+		if(BinMatches(set, bin, hash, ptr)){
+			void *elt = bin->elt;
+			RemoveBin(set, idx);
+			
+			return elt;
+		}
 	}
 	
 	return NULL;
@@ -206,48 +243,55 @@ cpHashSetRemove(cpHashSet *set, cpHashValue hash, void *ptr)
 
 void *
 cpHashSetFind(cpHashSet *set, cpHashValue hash, void *ptr)
-{	
-	cpHashValue idx = hash%set->size;
-	cpHashSetBin *bin = set->table[idx];
-	while(bin && !set->eql(ptr, bin->elt))
-		bin = bin->next;
-		
-	return (bin ? bin->elt : set->default_value);
+{
+	for(unsigned int idx = HashIndex(set, hash); set->table[idx].elt; idx = NextIndex(set, idx)){
+		cpHashSetBin *bin = set->table + idx;
+		if(BinMatches(set, bin, hash, ptr)) return bin->elt;
+	}
+	
+	return set->default_value;
 }
 
 void
 cpHashSetEach(cpHashSet *set, cpHashSetIteratorFunc func, void *data)
 {
-	for(unsigned int i=0; i<set->size; i++){
-		cpHashSetBin *bin = set->table[i];
-		while(bin){
-			cpHashSetBin *next = bin->next;
-			func(bin->elt, data);
-			bin = next;
-		}
+	for(unsigned int i=0; i<set->capacity; i++){
+		void *elt = set->table[i].elt;
+		if(elt) func(elt, data);
 	}
 }
 
 void
 cpHashSetFilter(cpHashSet *set, cpHashSetFilterFunc func, void *data)
 {
-	for(unsigned int i=0; i<set->size; i++){
-		// The rest works similarly to cpHashSetRemove() above.
-		cpHashSetBin **prev_ptr = &set->table[i];
-		cpHashSetBin *bin = set->table[i];
-		while(bin){
-			cpHashSetBin *next = bin->next;
-			
-			if(func(bin->elt, data)){
-				prev_ptr = &bin->next;
-			} else {
-				(*prev_ptr) = next;
-
-				set->entries--;
-				recycleBin(set, bin);
-			}
-			
-			bin = next;
+	// Start at an empty bin. Clusters never wrap past it and removals only shift
+	// elements back into the bin being visited, so each element is seen exactly once.
+	unsigned int start = 0;
+	while(set->table[start].elt) start++;
+	
+	unsigned int idx = NextIndex(set, start);
+	while(idx != start){
+		void *elt = set->table[idx].elt;
+		
+		if(elt && !func(elt, data)){
+			// Another element may have moved into this bin, so check it again.
+			RemoveBin(set, idx);
+		} else {
+			idx = NextIndex(set, idx);
 		}
 	}
 }
+
+void
+cpHashSetEachInTableOrder(cpHashSet *set, cpHashSetIteratorFunc func, void *data)
+{
+	// Start after an empty bin so every cluster is visited from its first bin. Inserting the elements
+	// into an empty table of the same capacity in this order puts each one back into the same bin.
+	unsigned int start = 0;
+	while(set->table[start].elt) start++;
+	
+	for(unsigned int idx = NextIndex(set, start); idx != start; idx = NextIndex(set, idx)){
+		void *elt = set->table[idx].elt;
+		if(elt) func(elt, data);
+	}
+}
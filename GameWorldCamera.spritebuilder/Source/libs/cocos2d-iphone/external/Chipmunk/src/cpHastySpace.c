@@ -0,0 +1,285 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+#include "chipmunk/cpHastySpace.h"
+
+// Bodies track the colors they are using in a 64 bit mask.
+// Items that can't be given one of the first 64 colors go into an overflow batch solved serially.
+#define MAX_COLORS 64
+
+typedef struct SolverItem {
+	cpArbiter *arb;
+	cpConstraint *constraint;
+} SolverItem;
+
+struct cpHastySpace {
+	cpSpace space;
+	
+	unsigned long threading_threshold;
+	
+	// Solver items sorted by color.
+	// Batch i runs from color_offsets[i] to color_offsets[i + 1], the overflow batch runs to item_count.
+	int item_count, item_capacity;
+	SolverItem *items;
+	unsigned char *colors;
+	int color_count;
+	int color_offsets[MAX_COLORS + 1];
+	
+	cpFloat dt;
+};
+
+//MARK: Solver
+
+static inline cpBool
+IsDynamic(cpBody *body)
+{
+	return (cpBodyGetType(body) == CP_BODY_TYPE_DYNAMIC);
+}
+
+static inline void
+ResetColors(cpBody *a, cpBody *b)
+{
+	a->solverTag = 0;
+	b->solverTag = 0;
+}
+
+// Pick the lowest color not used by either body and reserve it.
+// Static and kinematic bodies are ignored. The solver only ever reads them (see infinite_body()),
+// so items sharing one can run on different threads at once.
+static int
+ReserveColor(cpBody *a, cpBody *b)
+{
+	cpBool dynamicA = IsDynamic(a), dynamicB = IsDynamic(b);
+	uint64_t used = (dynamicA ? a->solverTag : 0) | (dynamicB ? b->solverTag : 0);
+	
+	int color = 0;
+	while(color < MAX_COLORS && (used>>color & 1)) color++;
+	if(color == MAX_COLORS) return MAX_COLORS;
+	
+	uint64_t bit = (uint64_t)1<<color;
+	if(dynamicA) a->solverTag |= bit;
+	if(dynamicB) b->solverTag |= bit;
+	
+	return color;
+}
+
+static void
+ColorSolverItems(cpHastySpace *hasty)
+{
+	cpArray *arbiters = hasty->space.arbiters;
+	cpArray *constraints = hasty->space.constraints;
+	int count = arbiters->num + constraints->num;
+	
+	if(count > hasty->item_capacity){
+		hasty->item_capacity = (count > 2*hasty->item_capacity ? count : 2*hasty->item_capacity);
+		hasty->items = (SolverItem *)cprealloc(hasty->items, hasty->item_capacity*sizeof(SolverItem));
+		hasty->colors = (unsigned char *)cprealloc(hasty->colors, hasty->item_capacity*sizeof(unsigned char));
+	}
+	
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiter *arb = (cpArbiter *)arbiters->arr[i];
+		ResetColors(arb->body_a, arb->body_b);
+	}
+	
+	for(int i=0; i<constraints->num; i++){
+		cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+		ResetColors(constraint->a, constraint->b);
+	}
+	
+	// Greedily color the items in the order they appear in the space.
+	// This doesn't depend on the number of threads, which keeps the results deterministic.
+	int counts[MAX_COLORS + 1] = {0};
+	unsigned char *colors = hasty->colors;
+	
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiter *arb = (cpArbiter *)arbiters->arr[i];
+		counts[colors[i] = ReserveColor(arb->body_a, arb->body_b)]++;
+	}
+	
+	for(int i=0; i<constraints->num; i++){
+		cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+		counts[colors[arbiters->num + i] = ReserveColor(constraint->a, constraint->b)]++;
+	}
+	
+	int color_count = 0;
+	int offsets[MAX_COLORS + 1];
+	for(int c=0, offset=0; c<=MAX_COLORS; c++){
+		offsets[c] = offset;
+		offset += counts[c];
+		if(c < MAX_COLORS && counts[c]) color_count = c + 1;
+	}
+	
+	// The unused colors are empty, so the overflow batch starts right after the last used color.
+	memcpy(hasty->color_offsets, offsets, sizeof(offsets));
+	hasty->color_offsets[color_count] = offsets[MAX_COLORS];
+	hasty->color_count = color_count;
+	hasty->item_count = count;
+	
+	SolverItem *items = hasty->items;
+	for(int i=0; i<arbiters->num; i++){
+		SolverItem item = {(cpArbiter *)arbiters->arr[i], NULL};
+		items[offsets[colors[i]]++] = item;
+	}
+	
+	for(int i=0; i<constraints->num; i++){
+		SolverItem item = {NULL, (cpConstraint *)constraints->arr[i]};
+		items[offsets[colors[arbiters->num + i]]++] = item;
+	}
+}
+
+static inline void
+SolveItems(SolverItem *items, unsigned long start, unsigned long end, cpFloat dt)
+{
+	for(unsigned long i=start; i<end; i++){
+		SolverItem *item = items + i;
+		
+		if(item->arb){
+			cpArbiterApplyImpulse(item->arb);
+		} else {
+			cpConstraint *constraint = item->constraint;
+			constraint->klass->applyImpulse(constraint, dt);
+		}
+	}
+}
+
+static void
+Solver(cpHastySpace *hasty, unsigned long worker)
+{
+	SolverItem *items = hasty->items;
+	unsigned long num_threads = cpThreadPoolGetThreads(hasty->space.threadPool);
+	int *offsets = hasty->color_offsets;
+	int overflow = offsets[hasty->color_count];
+	cpFloat dt = hasty->dt;
+	
+	for(int i=0; i<hasty->space.iterations; i++){
+		for(int c=0; c<hasty->color_count; c++){
+			unsigned long start = offsets[c], count = offsets[c + 1] - start;
+			SolveItems(items, start + count*worker/num_threads, start + count*(worker + 1)/num_threads, dt);
+			cpThreadPoolBarrier(hasty->space.threadPool);
+		}
+		
+		if(overflow < hasty->item_count){
+			if(worker == 0) SolveItems(items, overflow, hasty->item_count, dt);
+			cpThreadPoolBarrier(hasty->space.threadPool);
+		}
+	}
+}
+
+static void
+cpHastySpaceSolveImpulses(cpSpace *space, cpFloat dt)
+{
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	ColorSolverItems(hasty);
+	
+	if(hasty->space.threadPool && (unsigned long)hasty->item_count >= hasty->threading_threshold){
+		hasty->dt = dt;
+		cpThreadPoolRun(hasty->space.threadPool, (cpThreadPoolWorkFunc)Solver, hasty);
+	} else {
+		// Same order as the threaded solver: colors first, then the overflow batch.
+		for(int i=0; i<space->iterations; i++){
+			SolveItems(hasty->items, 0, hasty->item_count, dt);
+		}
+	}
+}
+
+//MARK: Public Functions
+
+cpSpace *
+cpHastySpaceNew(void)
+{
+	cpHastySpace *hasty = (cpHastySpace *)cpcalloc(1, sizeof(cpHastySpace));
+	cpSpaceInit((cpSpace *)hasty);
+	hasty->space.solveImpulses = cpHastySpaceSolveImpulses;
+	
+	hasty->threading_threshold = 50;
+	
+	return (cpSpace *)hasty;
+}
+
+void
+cpHastySpaceFree(cpSpace *space)
+{
+	if(space){
+		cpHastySpace *hasty = (cpHastySpace *)space;
+		cpAssertHard(space->solveImpulses == cpHastySpaceSolveImpulses, "Space is not a cpHastySpace.");
+		
+		cpBBTreeSetThreadPool(space->dynamicShapes, NULL);
+		cpThreadPoolFree(hasty->space.threadPool);
+		cpfree(hasty->items);
+		cpfree(hasty->colors);
+		
+		cpSpaceFree(space);
+	}
+}
+
+void
+cpHastySpaceSetThreads(cpSpace *space, unsigned long threads)
+{
+	cpAssertHard(space->solveImpulses == cpHastySpaceSolveImpulses, "Space is not a cpHastySpace.");
+	cpAssertSpaceUnlocked(space);
+	
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	cpBBTreeSetThreadPool(space->dynamicShapes, NULL);
+	cpThreadPoolFree(hasty->space.threadPool);
+	hasty->space.threadPool = NULL;
+	
+	if(threads != 1){
+		hasty->space.threadPool = cpThreadPoolNew(threads);
+		
+		if(cpThreadPoolGetThreads(hasty->space.threadPool) == 1){
+			cpThreadPoolFree(hasty->space.threadPool);
+			hasty->space.threadPool = NULL;
+		}
+	}
+	
+	// The broadphase uses the same threads to reindex the dynamic shapes.
+	cpBBTreeSetThreadPool(space->dynamicShapes, hasty->space.threadPool);
+}
+
+unsigned long
+cpHastySpaceGetThreads(cpSpace *space)
+{
+	cpAssertHard(space->solveImpulses == cpHastySpaceSolveImpulses, "Space is not a cpHastySpace.");
+	return cpThreadPoolGetThreads(space->threadPool);
+}
+
+void
+cpHastySpaceSetThreadingThreshold(cpSpace *space, unsigned long threshold)
+{
+	cpAssertHard(space->solveImpulses == cpHastySpaceSolveImpulses, "Space is not a cpHastySpace.");
+	((cpHastySpace *)space)->threading_threshold = threshold;
+}
+
+unsigned long
+cpHastySpaceGetThreadingThreshold(cpSpace *space)
+{
+	cpAssertHard(space->solveImpulses == cpHastySpaceSolveImpulses, "Space is not a cpHastySpace.");
+	return ((cpHastySpace *)space)->threading_threshold;
+}
+
+void
+cpHastySpaceStep(cpSpace *space, cpFloat dt)
+{
+	cpSpaceStep(space, dt);
+}
@@ -0,0 +1,176 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "chipmunk/chipmunk_private.h"
+#include "chipmunk/cpMarch.h"
+
+// Handles a single cell given the samples at its corners.
+// a, b, c and d are the bottom left, bottom right, top left and top right samples.
+typedef void (*cpMarchCellFunc)(
+	cpFloat t, cpFloat a, cpFloat b, cpFloat c, cpFloat d,
+	cpFloat x0, cpFloat x1, cpFloat y0, cpFloat y1,
+	cpMarchSegmentFunc segment, void *segment_data
+);
+
+// Samples one row at a time so each point is only sampled once.
+static void
+cpMarchCells(
+	cpBB bb, unsigned long x_samples, unsigned long y_samples, cpFloat t,
+	cpMarchSegmentFunc segment, void *segment_data,
+	cpMarchSampleFunc sample, void *sample_data,
+	cpMarchCellFunc cell
+){
+	cpAssertHard(x_samples >= 2 && y_samples >= 2, "At least two samples are needed in each direction.");
+
+	cpFloat x_denom = 1.0/(cpFloat)(x_samples - 1);
+	cpFloat y_denom = 1.0/(cpFloat)(y_samples - 1);
+
+	// The samples from the previous row.
+	cpFloat *buffer = (cpFloat *)cpcalloc(x_samples, sizeof(cpFloat));
+	for(unsigned long i=0; i<x_samples; i++) buffer[i] = sample(cpv(cpflerp(bb.l, bb.r, i*x_denom), bb.b), sample_data);
+
+	for(unsigned long j=0; j<y_samples-1; j++){
+		cpFloat y0 = cpflerp(bb.b, bb.t, (j + 0)*y_denom);
+		cpFloat y1 = cpflerp(bb.b, bb.t, (j + 1)*y_denom);
+
+		cpFloat a, b = buffer[0];
+		cpFloat c, d = sample(cpv(bb.l, y1), sample_data);
+		buffer[0] = d;
+
+		for(unsigned long i=0; i<x_samples-1; i++){
+			cpFloat x0 = cpflerp(bb.l, bb.r, (i + 0)*x_denom);
+			cpFloat x1 = cpflerp(bb.l, bb.r, (i + 1)*x_denom);
+
+			a = b, b = buffer[i + 1];
+			c = d, d = sample(cpv(x1, y1), sample_data);
+			buffer[i + 1] = d;
+
+			cell(t, a, b, c, d, x0, x1, y0, y1, segment, segment_data);
+		}
+	}
+
+	cpfree(buffer);
+}
+
+//MARK: Marching Squares
+
+// Outputs a segment unless it's degenerate, which happens when a sample lands exactly on the threshold.
+static inline void
+seg(cpVect v0, cpVect v1, cpMarchSegmentFunc f, void *data)
+{
+	if(!cpveql(v0, v1)) f(v0, v1, data);
+}
+
+// Lerps between two positions based on their sample values.
+static inline cpFloat
+midlerp(cpFloat x0, cpFloat x1, cpFloat s0, cpFloat s1, cpFloat t)
+{
+	return cpflerp(x0, x1, (t - s0)/(s1 - s0));
+}
+
+// The segments keep the solid side on their left.
+// Ambiguous saddle cells are always split so the two solid corners don't touch.
+static void
+cpMarchCellSoft(
+	cpFloat t, cpFloat a, cpFloat b, cpFloat c, cpFloat d,
+	cpFloat x0, cpFloat x1, cpFloat y0, cpFloat y1,
+	cpMarchSegmentFunc segment, void *segment_data
+){
+	switch((a>t)<<0 | (b>t)<<1 | (c>t)<<2 | (d>t)<<3){
+		case 0x1: seg(cpv(midlerp(x0,x1,a,b,t), y0), cpv(x0, midlerp(y0,y1,a,c,t)), segment, segment_data); break;
+		case 0x2: seg(cpv(x1, midlerp(y0,y1,b,d,t)), cpv(midlerp(x0,x1,a,b,t), y0), segment, segment_data); break;
+		case 0x3: seg(cpv(x1, midlerp(y0,y1,b,d,t)), cpv(x0, midlerp(y0,y1,a,c,t)), segment, segment_data); break;
+		case 0x4: seg(cpv(x0, midlerp(y0,y1,a,c,t)), cpv(midlerp(x0,x1,c,d,t), y1), segment, segment_data); break;
+		case 0x5: seg(cpv(midlerp(x0,x1,a,b,t), y0), cpv(midlerp(x0,x1,c,d,t), y1), segment, segment_data); break;
+		case 0x6: seg(cpv(x1, midlerp(y0,y1,b,d,t)), cpv(midlerp(x0,x1,a,b,t), y0), segment, segment_data);
+		          seg(cpv(x0, midlerp(y0,y1,a,c,t)), cpv(midlerp(x0,x1,c,d,t), y1), segment, segment_data); break;
+		case 0x7: seg(cpv(x1, midlerp(y0,y1,b,d,t)), cpv(midlerp(x0,x1,c,d,t), y1), segment, segment_data); break;
+		case 0x8: seg(cpv(midlerp(x0,x1,c,d,t), y1), cpv(x1, midlerp(y0,y1,b,d,t)), segment, segment_data); break;
+		case 0x9: seg(cpv(midlerp(x0,x1,a,b,t), y0), cpv(x0, midlerp(y0,y1,a,c,t)), segment, segment_data);
+		          seg(cpv(midlerp(x0,x1,c,d,t), y1), cpv(x1, midlerp(y0,y1,b,d,t)), segment, segment_data); break;
+		case 0xA: seg(cpv(midlerp(x0,x1,c,d,t), y1), cpv(midlerp(x0,x1,a,b,t), y0), segment, segment_data); break;
+		case 0xB: seg(cpv(midlerp(x0,x1,c,d,t), y1), cpv(x0, midlerp(y0,y1,a,c,t)), segment, segment_data); break;
+		case 0xC: seg(cpv(x0, midlerp(y0,y1,a,c,t)), cpv(x1, midlerp(y0,y1,b,d,t)), segment, segment_data); break;
+		case 0xD: seg(cpv(midlerp(x0,x1,a,b,t), y0), cpv(x1, midlerp(y0,y1,b,d,t)), segment, segment_data); break;
+		case 0xE: seg(cpv(x0, midlerp(y0,y1,a,c,t)), cpv(midlerp(x0,x1,a,b,t), y0), segment, segment_data); break;
+		default: break; // 0x0 and 0xF
+	}
+}
+
+void
+cpMarchSoft(
+	cpBB bb, unsigned long x_samples, unsigned long y_samples, cpFloat threshold,
+	cpMarchSegmentFunc segment, void *segment_data,
+	cpMarchSampleFunc sample, void *sample_data
+){
+	cpMarchCells(bb, x_samples, y_samples, threshold, segment, segment_data, sample, sample_data, cpMarchCellSoft);
+}
+
+//MARK: Hard Marching Squares
+
+// Outputs the two segments of a path that turns at the middle of the cell.
+// Emitting them back to back keeps the two paths of a saddle cell from getting mixed up where they meet.
+static inline void
+segs(cpVect a, cpVect b, cpVect c, cpMarchSegmentFunc f, void *data)
+{
+	seg(a, b, f, data);
+	seg(b, c, f, data);
+}
+
+static void
+cpMarchCellHard(
+	cpFloat t, cpFloat a, cpFloat b, cpFloat c, cpFloat d,
+	cpFloat x0, cpFloat x1, cpFloat y0, cpFloat y1,
+	cpMarchSegmentFunc segment, void *segment_data
+){
+	// The edges of the squares around the samples run through the middle of the cell.
+	cpFloat xm = cpflerp(x0, x1, 0.5f);
+	cpFloat ym = cpflerp(y0, y1, 0.5f);
+
+	switch((a>t)<<0 | (b>t)<<1 | (c>t)<<2 | (d>t)<<3){
+		case 0x1: segs(cpv(xm, y0), cpv(xm, ym), cpv(x0, ym), segment, segment_data); break;
+		case 0x2: segs(cpv(x1, ym), cpv(xm, ym), cpv(xm, y0), segment, segment_data); break;
+		case 0x3: seg(cpv(x1, ym), cpv(x0, ym), segment, segment_data); break;
+		case 0x4: segs(cpv(x0, ym), cpv(xm, ym), cpv(xm, y1), segment, segment_data); break;
+		case 0x5: seg(cpv(xm, y0), cpv(xm, y1), segment, segment_data); break;
+		case 0x6: segs(cpv(x1, ym), cpv(xm, ym), cpv(xm, y0), segment, segment_data);
+		          segs(cpv(x0, ym), cpv(xm, ym), cpv(xm, y1), segment, segment_data); break;
+		case 0x7: segs(cpv(x1, ym), cpv(xm, ym), cpv(xm, y1), segment, segment_data); break;
+		case 0x8: segs(cpv(xm, y1), cpv(xm, ym), cpv(x1, ym), segment, segment_data); break;
+		case 0x9: segs(cpv(xm, y0), cpv(xm, ym), cpv(x0, ym), segment, segment_data);
+		          segs(cpv(xm, y1), cpv(xm, ym), cpv(x1, ym), segment, segment_data); break;
+		case 0xA: seg(cpv(xm, y1), cpv(xm, y0), segment, segment_data); break;
+		case 0xB: segs(cpv(xm, y1), cpv(xm, ym), cpv(x0, ym), segment, segment_data); break;
+		case 0xC: seg(cpv(x0, ym), cpv(x1, ym), segment, segment_data); break;
+		case 0xD: segs(cpv(xm, y0), cpv(xm, ym), cpv(x1, ym), segment, segment_data); break;
+		case 0xE: segs(cpv(x0, ym), cpv(xm, ym), cpv(xm, y0), segment, segment_data); break;
+		default: break; // 0x0 and 0xF
+	}
+}
+
+void
+cpMarchHard(
+	cpBB bb, unsigned long x_samples, unsigned long y_samples, cpFloat threshold,
+	cpMarchSegmentFunc segment, void *segment_data,
+	cpMarchSampleFunc sample, void *sample_data
+){
+	cpMarchCells(bb, x_samples, y_samples, threshold, segment, segment_data, sample, sample_data, cpMarchCellHard);
+}
@@ -110,26 +110,49 @@ cpPolyShapeSegmentQuery(cpPolyShape *poly, cpVect a, cpVect b, cpFloat r2, cpSeg
 	cpFloat r = poly->r;
 	cpFloat rsum = r + r2;
 	
+	// Clip the segment against every edge's plane pushed out by the radii.
+	// Checking each edge's span on its own can let a segment slip between two edges at a vertex in float builds.
+	cpFloat tEnter = 0.0f, tExit = 1.0f;
+	int enter = -1;
+	
 	for(int i=0; i<count; i++){
+		// Relative to the vertex so large world coordinates don't swamp the differences.
 		cpVect n = planes[i].n;
-		cpFloat an = cpvdot(a, n);
-		cpFloat d =  an - cpvdot(planes[i].v0, n) - rsum;
-		if(d < 0.0f) continue;
+		cpFloat d = cpvdot(cpvsub(a, planes[i].v0), n) - rsum;
+		cpFloat denom = cpvdot(cpvsub(b, a), n);
+		
+		if(denom < 0.0f){
+			cpFloat t = -d/denom;
+			if(t > tEnter){
+				tEnter = t;
+				enter = i;
+			}
+		} else if(denom > 0.0f){
+			tExit = cpfmin(tExit, -d/denom);
+		} else if(d > 0.0f){
+			// Parallel to the edge and outside of it.
+			return;
+		}
 		
-		cpFloat bn = cpvdot(b, n);
-		cpFloat t = d/(an - bn);
-		if(t < 0.0f || 1.0f < t) continue;
+		// The rounded shape is inside the clipped region, so the vertexes can't be hit either.
+		if(tEnter > tExit) return;
+	}
+	
+	if(enter >= 0){
+		cpVect n = planes[enter].n;
+		cpVect v0 = planes[enter].v0;
+		cpVect point = cpvlerp(a, b, tEnter);
 		
-		cpVect point = cpvlerp(a, b, t);
-		cpFloat dt = cpvcross(n, point);
-		cpFloat dtMin = cpvcross(n, planes[(i - 1 + count)%count].v0);
-		cpFloat dtMax = cpvcross(n, planes[i].v0);
+		// The corners of the pushed out planes stick out past the beveled vertexes.
+		// Hits there are left to the vertex checks below.
+		cpFloat dt = cpvcross(n, cpvsub(point, v0));
+		cpFloat dtMin = cpvcross(n, cpvsub(planes[(enter - 1 + count)%count].v0, v0));
 		
-		if(dtMin <= dt && dt <= dtMax){
+		if(rsum == 0.0f || (dtMin <= dt && dt <= 0.0f)){
 			info->shape = (cpShape *)poly;
-			info->point = cpvsub(cpvlerp(a, b, t), cpvmult(n, r2));
+			info->point = cpvsub(point, cpvmult(n, r2));
 			info->normal = n;
-			info->alpha = t;
+			info->alpha = tEnter;
 		}
 	}
 	
@@ -0,0 +1,566 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "chipmunk/chipmunk_private.h"
+#include "chipmunk/cpPolyline.h"
+
+static inline int Next(int i, int count){return (i + 1)%count;}
+static inline int Prev(int i, int count){return (i - 1 + count)%count;}
+
+//MARK: Polylines
+
+#define DEFAULT_POLYLINE_CAPACITY 16
+
+static size_t
+cpPolylineSizeForCapacity(int capacity)
+{
+	return sizeof(cpPolyline) + capacity*sizeof(cpVect);
+}
+
+static cpPolyline *
+cpPolylineMake(int capacity)
+{
+	capacity = (capacity > DEFAULT_POLYLINE_CAPACITY ? capacity : DEFAULT_POLYLINE_CAPACITY);
+
+	cpPolyline *line = (cpPolyline *)cpcalloc(1, cpPolylineSizeForCapacity(capacity));
+	line->count = 0;
+	line->capacity = capacity;
+
+	return line;
+}
+
+static cpPolyline *
+cpPolylineMake2(int capacity, cpVect a, cpVect b)
+{
+	cpPolyline *line = cpPolylineMake(capacity);
+	line->count = 2;
+	line->verts[0] = a;
+	line->verts[1] = b;
+
+	return line;
+}
+
+static cpPolyline *
+cpPolylineShrink(cpPolyline *line)
+{
+	line->capacity = line->count;
+	return (cpPolyline *)cprealloc(line, cpPolylineSizeForCapacity(line->count));
+}
+
+void
+cpPolylineFree(cpPolyline *line)
+{
+	cpfree(line);
+}
+
+// Grow the allocated memory for a polyline to fit @c count more vertexes.
+static cpPolyline *
+cpPolylineGrow(cpPolyline *line, int count)
+{
+	count += line->count;
+
+	int capacity = line->capacity;
+	while(capacity < count) capacity *= 2;
+
+	if(line->capacity < capacity){
+		line->capacity = capacity;
+		line = (cpPolyline *)cprealloc(line, cpPolylineSizeForCapacity(capacity));
+	}
+
+	return line;
+}
+
+// Push v onto the end of line.
+static cpPolyline *
+cpPolylinePush(cpPolyline *line, cpVect v)
+{
+	line = cpPolylineGrow(line, 1);
+	line->verts[line->count] = v;
+	line->count++;
+
+	return line;
+}
+
+// Push v onto the beginning of line.
+static cpPolyline *
+cpPolylineEnqueue(cpPolyline *line, cpVect v)
+{
+	line = cpPolylineGrow(line, 1);
+	memmove(line->verts + 1, line->verts, line->count*sizeof(cpVect));
+	line->verts[0] = v;
+	line->count++;
+
+	return line;
+}
+
+static cpPolyline *
+cpPolylineCopy(cpPolyline *line)
+{
+	cpPolyline *copy = cpPolylineMake(line->count);
+	memcpy(copy->verts, line->verts, line->count*sizeof(cpVect));
+	copy->count = line->count;
+
+	return cpPolylineShrink(copy);
+}
+
+cpBool
+cpPolylineIsClosed(cpPolyline *line)
+{
+	return (line->count > 1 && cpveql(line->verts[0], line->verts[line->count - 1]));
+}
+
+//MARK: Simplification
+
+// The cosine of the angle at b. -1 when a, b and c are in a straight line.
+static cpFloat
+Sharpness(cpVect a, cpVect b, cpVect c)
+{
+	return cpvdot(cpvnormalize(cpvsub(a, b)), cpvnormalize(cpvsub(c, b)));
+}
+
+cpPolyline *
+cpPolylineSimplifyVertexes(cpPolyline *line, cpFloat tol)
+{
+	if(line->count < 3) return cpPolylineCopy(line);
+
+	cpPolyline *reduced = cpPolylineMake2(0, line->verts[0], line->verts[1]);
+	cpFloat minSharp = -cpfcos(tol);
+
+	for(int i=2; i<line->count; i++){
+		cpVect vert = line->verts[i];
+		cpFloat sharp = Sharpness(reduced->verts[reduced->count - 2], reduced->verts[reduced->count - 1], vert);
+
+		if(sharp <= minSharp){
+			// Straight enough to replace the last vertex.
+			reduced->verts[reduced->count - 1] = vert;
+		} else {
+			reduced = cpPolylinePush(reduced, vert);
+		}
+	}
+
+	// The first vertex of a loop can be straight too.
+	if(
+		cpPolylineIsClosed(line) && reduced->count > 4 &&
+		Sharpness(reduced->verts[reduced->count - 2], reduced->verts[0], reduced->verts[1]) <= minSharp
+	){
+		reduced->verts[0] = reduced->verts[reduced->count - 2];
+		reduced->count--;
+	}
+
+	return cpPolylineShrink(reduced);
+}
+
+// Recursive function used by cpPolylineSimplifyCurves().
+// Pushes the vertexes strictly between start and end that are needed to stay within tol of the original.
+static cpPolyline *
+DouglasPeucker(cpVect *verts, cpPolyline *reduced, int length, int start, int end, cpFloat tol)
+{
+	// Nothing to simplify if the points are adjacent.
+	if((end - start + length)%length < 2) return reduced;
+
+	cpVect a = verts[start];
+	cpVect b = verts[end];
+
+	// Find the vertex furthest from the segment ab.
+	int maxi = start;
+	cpFloat max = 0.0f;
+	for(int i=Next(start, length); i!=end; i=Next(i, length)){
+		cpFloat dist = cpvdist(verts[i], cpClosetPointOnSegment(verts[i], a, b));
+		if(dist > max){
+			max = dist;
+			maxi = i;
+		}
+	}
+
+	if(max > tol){
+		reduced = DouglasPeucker(verts, reduced, length, start, maxi, tol);
+		reduced = cpPolylinePush(reduced, verts[maxi]);
+		reduced = DouglasPeucker(verts, reduced, length, maxi, end, tol);
+	}
+
+	return reduced;
+}
+
+cpPolyline *
+cpPolylineSimplifyCurves(cpPolyline *line, cpFloat tol)
+{
+	if(line->count < 3) return cpPolylineCopy(line);
+
+	cpPolyline *reduced = cpPolylineMake(0);
+	cpVect *verts = line->verts;
+
+	if(cpPolylineIsClosed(line)){
+		// Leave off the repeated vertex and split the loop at the vertex furthest from the first one.
+		int length = line->count - 1;
+
+		int end = 0;
+		cpFloat max = 0.0f;
+		for(int i=1; i<length; i++){
+			cpFloat dist = cpvdistsq(verts[0], verts[i]);
+			if(dist > max){
+				max = dist;
+				end = i;
+			}
+		}
+
+		reduced = cpPolylinePush(reduced, verts[0]);
+		reduced = DouglasPeucker(verts, reduced, length, 0, end, tol);
+		reduced = cpPolylinePush(reduced, verts[end]);
+		reduced = DouglasPeucker(verts, reduced, length, end, 0, tol);
+		reduced = cpPolylinePush(reduced, verts[0]);
+	} else {
+		int length = line->count;
+
+		reduced = cpPolylinePush(reduced, verts[0]);
+		reduced = DouglasPeucker(verts, reduced, length, 0, length - 1, tol);
+		reduced = cpPolylinePush(reduced, verts[length - 1]);
+	}
+
+	return cpPolylineShrink(reduced);
+}
+
+cpPolyline *
+cpPolylineToConvexHull(cpPolyline *line, cpFloat tol)
+{
+	cpPolyline *hull = cpPolylineMake(line->count + 1);
+	hull->count = cpConvexHull(line->count, line->verts, hull->verts, NULL, tol);
+	hull = cpPolylinePush(hull, hull->verts[0]);
+
+	return cpPolylineShrink(hull);
+}
+
+int
+cpPolylineSegmentShapes(cpPolyline *line, cpBody *body, cpFloat radius, cpShape **shapes)
+{
+	int count = line->count - 1;
+	cpVect *verts = line->verts;
+	cpBool closed = cpPolylineIsClosed(line);
+
+	for(int i=0; i<count; i++){
+		cpVect a = verts[i], b = verts[i + 1];
+
+		// The open ends of a line have no neighbors, which makes the tangents zero.
+		cpVect prev = (i > 0 ? verts[i - 1] : (closed ? verts[count - 1] : a));
+		cpVect next = (i < count - 1 ? verts[i + 2] : (closed ? verts[1] : b));
+
+		shapes[i] = cpSegmentShapeNew(body, a, b, radius);
+		cpSegmentShapeSetNeighbors(shapes[i], prev, next);
+	}
+
+	return (count > 0 ? count : 0);
+}
+
+//MARK: Polyline Sets
+
+cpPolylineSet *
+cpPolylineSetAlloc(void)
+{
+	return (cpPolylineSet *)cpcalloc(1, sizeof(cpPolylineSet));
+}
+
+cpPolylineSet *
+cpPolylineSetInit(cpPolylineSet *set)
+{
+	set->count = 0;
+	set->capacity = 8;
+	set->lines = (cpPolyline **)cpcalloc(set->capacity, sizeof(cpPolyline *));
+
+	return set;
+}
+
+cpPolylineSet *
+cpPolylineSetNew(void)
+{
+	return cpPolylineSetInit(cpPolylineSetAlloc());
+}
+
+void
+cpPolylineSetDestroy(cpPolylineSet *set, cpBool freePolylines)
+{
+	if(freePolylines){
+		for(int i=0; i<set->count; i++) cpPolylineFree(set->lines[i]);
+	}
+
+	cpfree(set->lines);
+}
+
+void
+cpPolylineSetFree(cpPolylineSet *set, cpBool freePolylines)
+{
+	if(set){
+		cpPolylineSetDestroy(set, freePolylines);
+		cpfree(set);
+	}
+}
+
+static void
+cpPolylineSetPush(cpPolylineSet *set, cpPolyline *line)
+{
+	if(set->count == set->capacity){
+		set->capacity *= 2;
+		set->lines = (cpPolyline **)cprealloc(set->lines, set->capacity*sizeof(cpPolyline *));
+	}
+
+	set->lines[set->count] = line;
+	set->count++;
+}
+
+// Find the open polyline that ends with v, searching the newest ones first.
+static int
+cpPolylineSetFindEnds(cpPolylineSet *set, cpVect v)
+{
+	for(int i=set->count - 1; i>=0; i--){
+		cpPolyline *line = set->lines[i];
+		if(cpveql(line->verts[line->count - 1], v) && !cpPolylineIsClosed(line)) return i;
+	}
+
+	return -1;
+}
+
+// Find the open polyline that starts with v, searching the newest ones first.
+static int
+cpPolylineSetFindStarts(cpPolylineSet *set, cpVect v)
+{
+	for(int i=set->count - 1; i>=0; i--){
+		cpPolyline *line = set->lines[i];
+		if(cpveql(line->verts[0], v) && !cpPolylineIsClosed(line)) return i;
+	}
+
+	return -1;
+}
+
+// Append the polyline at index 'after' to the one at 'before', and remove it from the set.
+static void
+cpPolylineSetJoin(cpPolylineSet *set, int before, int after)
+{
+	cpPolyline *lbefore = set->lines[before];
+	cpPolyline *lafter = set->lines[after];
+
+	// The first vertex of 'after' is the same as the last of 'before'.
+	int count = lbefore->count;
+	lbefore = cpPolylineGrow(lbefore, lafter->count - 1);
+	memcpy(lbefore->verts + count, lafter->verts + 1, (lafter->count - 1)*sizeof(cpVect));
+	lbefore->count += lafter->count - 1;
+	set->lines[before] = lbefore;
+
+	cpPolylineFree(lafter);
+	set->count--;
+	set->lines[after] = set->lines[set->count];
+}
+
+void
+cpPolylineSetCollectSegment(cpVect v0, cpVect v1, cpPolylineSet *lines)
+{
+	int before = cpPolylineSetFindEnds(lines, v0);
+	int after = cpPolylineSetFindStarts(lines, v1);
+
+	if(before >= 0 && after >= 0){
+		if(before == after){
+			// This segment closes a loop.
+			lines->lines[before] = cpPolylinePush(lines->lines[before], v1);
+		} else {
+			// This segment connects two lines.
+			cpPolylineSetJoin(lines, before, after);
+		}
+	} else if(before >= 0){
+		lines->lines[before] = cpPolylinePush(lines->lines[before], v1);
+	} else if(after >= 0){
+		lines->lines[after] = cpPolylineEnqueue(lines->lines[after], v0);
+	} else {
+		cpPolylineSetPush(lines, cpPolylineMake2(0, v0, v1));
+	}
+}
+
+int
+cpPolylineSetPolyShapes(cpPolylineSet *set, cpBody *body, cpFloat radius, cpShape **shapes)
+{
+	for(int i=0; i<set->count; i++){
+		cpPolyline *line = set->lines[i];
+		shapes[i] = cpPolyShapeNew(body, line->count - 1, line->verts, cpTransformIdentity, radius);
+	}
+
+	return set->count;
+}
+
+//MARK: Convex Decomposition
+
+// True if c is to the left of the line through a and b.
+static inline cpBool
+Left(cpVect a, cpVect b, cpVect c)
+{
+	return cpvcross(cpvsub(b, a), cpvsub(c, a)) > 0.0f;
+}
+
+static inline cpBool
+LeftOn(cpVect a, cpVect b, cpVect c)
+{
+	return cpvcross(cpvsub(b, a), cpvsub(c, a)) >= 0.0f;
+}
+
+// True if the segments ab and cd cross at a point that isn't one of their endpoints.
+static cpBool
+SegmentsCross(cpVect a, cpVect b, cpVect c, cpVect d)
+{
+	return (
+		Left(a, b, c) != Left(a, b, d) && Left(c, d, a) != Left(c, d, b) &&
+		LeftOn(a, b, c) != LeftOn(a, b, d) && LeftOn(c, d, a) != LeftOn(c, d, b)
+	);
+}
+
+// True if the diagonal from vertex i to b starts off into the inside of the polygon.
+static cpBool
+InCone(cpVect *verts, int count, int i, cpVect b)
+{
+	cpVect prev = verts[Prev(i, count)];
+	cpVect a = verts[i];
+	cpVect next = verts[Next(i, count)];
+
+	if(LeftOn(prev, a, next)){
+		// Convex vertex.
+		return Left(a, b, prev) && Left(b, a, next);
+	} else {
+		// Reflex vertex.
+		return !(LeftOn(a, b, next) && LeftOn(b, a, prev));
+	}
+}
+
+static cpBool
+IsDiagonal(cpVect *verts, int count, int i, int j)
+{
+	if(!InCone(verts, count, i, verts[j]) || !InCone(verts, count, j, verts[i])) return cpFalse;
+
+	cpVect a = verts[i], b = verts[j];
+	for(int k=0; k<count; k++){
+		int l = Next(k, count);
+		if(k == i || k == j || l == i || l == j) continue;
+		if(SegmentsCross(a, b, verts[k], verts[l])) return cpFalse;
+	}
+
+	return cpTrue;
+}
+
+// Find the vertex that sits deepest inside the convex hull of the polygon.
+static int
+FindNotch(cpVect *verts, int count, cpVect *hull, int hullCount, cpFloat *depth)
+{
+	int notch = -1;
+	(*depth) = 0.0f;
+
+	for(int i=0; i<count; i++){
+		// Reflex vertexes are the only ones that can be inside the hull.
+		if(LeftOn(verts[Prev(i, count)], verts[i], verts[Next(i, count)])) continue;
+
+		cpFloat d = INFINITY;
+		for(int j=0; j<hullCount; j++){
+			cpVect a = hull[j], b = hull[Next(j, hullCount)];
+			cpVect n = cpvnormalize(cpvrperp(cpvsub(b, a)));
+			d = cpfmin(d, cpvdot(n, cpvsub(a, verts[i])));
+		}
+
+		if(d > (*depth)){
+			(*depth) = d;
+			notch = i;
+		}
+	}
+
+	return notch;
+}
+
+// Pick the diagonal from the notch that points most directly into the polygon.
+static int
+FindSplit(cpVect *verts, int count, int notch)
+{
+	cpVect v = verts[notch];
+	cpVect bisector = cpvnormalize(cpvadd(
+		cpvnormalize(cpvsub(v, verts[Prev(notch, count)])),
+		cpvnormalize(cpvsub(v, verts[Next(notch, count)]))
+	));
+
+	int split = -1;
+	cpFloat best = -INFINITY;
+
+	for(int i=0; i<count; i++){
+		if(i == notch || i == Prev(notch, count) || i == Next(notch, count)) continue;
+
+		cpFloat score = cpvdot(cpvnormalize(cpvsub(verts[i], v)), bisector);
+		if(score > best && IsDiagonal(verts, count, notch, i)){
+			best = score;
+			split = i;
+		}
+	}
+
+	return split;
+}
+
+// Recursive function used by cpPolylineConvexDecomposition().
+// verts is an open loop of count vertexes.
+static void
+ApproximateConvexDecomposition(cpVect *verts, int count, cpFloat tol, cpPolylineSet *set)
+{
+	cpVect *hull = (cpVect *)cpcalloc(count, sizeof(cpVect));
+	int hullCount = cpConvexHull(count, verts, hull, NULL, 0.0f);
+
+	cpFloat depth;
+	int notch = FindNotch(verts, count, hull, hullCount, &depth);
+	int split = (notch >= 0 && depth > tol ? FindSplit(verts, count, notch) : -1);
+
+	if(split < 0){
+		// Close enough to convex, or the polygon is too degenerate to split further.
+		cpPolyline *piece = cpPolylineMake(hullCount + 1);
+		memcpy(piece->verts, hull, hullCount*sizeof(cpVect));
+		piece->verts[hullCount] = hull[0];
+		piece->count = hullCount + 1;
+
+		cpPolylineSetPush(set, cpPolylineShrink(piece));
+	} else {
+		// Both halves include the notch and split vertexes.
+		cpVect *half = (cpVect *)cpcalloc(count, sizeof(cpVect));
+
+		int halfCount = 0;
+		for(int i=notch; i!=split; i=Next(i, count)) half[halfCount++] = verts[i];
+		half[halfCount++] = verts[split];
+		ApproximateConvexDecomposition(half, halfCount, tol, set);
+
+		halfCount = 0;
+		for(int i=split; i!=notch; i=Next(i, count)) half[halfCount++] = verts[i];
+		half[halfCount++] = verts[notch];
+		ApproximateConvexDecomposition(half, halfCount, tol, set);
+
+		cpfree(half);
+	}
+
+	cpfree(hull);
+}
+
+cpPolylineSet *
+cpPolylineConvexDecomposition(cpPolyline *line, cpFloat tol)
+{
+	if(!cpPolylineIsClosed(line) || line->count < 4) return NULL;
+
+	// Leave off the repeated vertex.
+	int count = line->count - 1;
+	if(cpAreaForPoly(count, line->verts, 0.0f) <= 0.0f) return NULL;
+
+	cpPolylineSet *set = cpPolylineSetNew();
+	ApproximateConvexDecomposition(line->verts, count, tol, set);
+
+	return set;
+}
@@ -81,8 +81,8 @@ applyImpulse(cpRotaryLimitJoint *joint, cpFloat dt)
 	j = joint->jAcc - jOld;
 	
 	// apply impulse
-	a->w -= j*a->i_inv;
-	b->w += j*b->i_inv;
+	if(!infinite_body(a)) a->w -= j*a->i_inv;
+	if(!infinite_body(b)) b->w += j*b->i_inv;
 }
 
 static cpFloat
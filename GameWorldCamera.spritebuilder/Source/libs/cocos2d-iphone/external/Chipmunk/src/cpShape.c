@@ -42,6 +42,8 @@ cpShapeInit(cpShape *shape, const cpShapeClass *klass, cpBody *body, struct cpSh
 	shape->u = 0.0f;
 	shape->surfaceV = cpvzero;
 	
+	shape->broadphaseMargin = 0.0f;
+	
 	shape->type = 0;
 	shape->filter.group = CP_NO_GROUP;
 	shape->filter.categories = CP_ALL_CATEGORIES;
@@ -169,6 +171,18 @@ cpShapeSetSurfaceVelocity(cpShape *shape, cpVect surfaceVelocity)
 	shape->surfaceV = surfaceVelocity;
 }
 
+cpFloat
+cpShapeGetBroadphaseMargin(const cpShape *shape)
+{
+	return shape->broadphaseMargin;
+}
+
+void
+cpShapeSetBroadphaseMargin(cpShape *shape, cpFloat broadphaseMargin)
+{
+	shape->broadphaseMargin = broadphaseMargin;
+}
+
 cpDataPointer
 cpShapeGetUserData(const cpShape *shape)
 {
@@ -104,6 +104,8 @@ cpCollisionHandler cpCollisionHandlerDoNothing = {
 
 // function to get the estimated velocity of a shape for the cpBBTree.
 static cpVect ShapeVelocityFunc(cpShape *shape){return shape->body->v;}
+// function to get the extra margin of a shape for the cpBBTree.
+static cpFloat ShapeMarginFunc(cpShape *shape){return shape->broadphaseMargin;}
 
 // Used for disposing of collision handlers.
 static void FreeWrap(void *ptr, void *unused){cpfree(ptr);}
@@ -137,6 +139,17 @@ cpSpaceInit(cpSpace *space)
 	space->collisionBias = cpfpow(1.0f - 0.1f, 60.0f);
 	space->collisionPersistence = 3;
 	
+	space->contactReuseThreshold = 0.0f;
+	space->contactReuseWindow = 4;
+	
+	space->broadphaseMargin = 0.0f;
+	space->broadphaseRelativeMargin = 0.1f;
+	space->broadphaseLookahead = 0.0f;
+	
+	space->fixedTimeStep = 1.0f/60.0f;
+	space->maxSubsteps = 8;
+	space->stepAccumulator = 0.0f;
+	
 	space->locked = 0;
 	space->stamp = 0;
 	
@@ -144,6 +157,10 @@ cpSpaceInit(cpSpace *space)
 	space->staticShapes = cpBBTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
 	space->dynamicShapes = cpBBTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, space->staticShapes);
 	cpBBTreeSetVelocityFunc(space->dynamicShapes, (cpBBTreeVelocityFunc)ShapeVelocityFunc);
+	cpBBTreeSetMarginFunc(space->dynamicShapes, (cpBBTreeMarginFunc)ShapeMarginFunc);
+	space->sleepingShapes = cpBBTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
+	cpBBTreeSetSleepingIndex(space->dynamicShapes, space->sleepingShapes);
+	space->sleepingShapesAdded = 0;
 	
 	space->allocatedBuffers = cpArrayNew(0);
 	
@@ -160,6 +177,8 @@ cpSpaceInit(cpSpace *space)
 	
 	space->contactBuffersHead = NULL;
 	space->cachedArbiters = cpHashSetNew(0, (cpHashSetEqlFunc)arbiterSetEql);
+	space->sleepingArbiters = cpHashSetNew(0, (cpHashSetEqlFunc)arbiterSetEql);
+	space->wakeSleepingArbiters = cpFalse;
 	
 	space->constraints = cpArrayNew(0);
 	
@@ -167,9 +186,22 @@ cpSpaceInit(cpSpace *space)
 	space->defaultHandler = cpCollisionHandlerDoNothing;
 	space->collisionHandlers = cpHashSetNew(0, (cpHashSetEqlFunc)handlerSetEql);
 	
+	space->collisionEvents = NULL;
+	space->collisionEventCount = space->collisionEventCapacity = 0;
+	
 	space->postStepCallbacks = cpArrayNew(0);
 	space->skipPostStep = cpFalse;
 	
+	space->solveImpulses = cpSpaceSolveImpulses;
+	space->batchedSolver = NULL;
+	space->threadPool = NULL;
+	space->allocator = NULL;
+	
+#ifdef CP_SPACE_ENABLE_STEP_STATS
+	memset(&space->stepStats, 0, sizeof(cpSpaceStepStats));
+	space->stepStatsRecorded = 0;
+#endif
+	
 	cpBody *staticBody = cpBodyInit(&space->_staticBody, 0.0f, 0.0f);
 	cpBodySetType(staticBody, CP_BODY_TYPE_STATIC);
 	cpSpaceSetStaticBody(space, staticBody);
@@ -192,6 +224,7 @@ cpSpaceDestroy(cpSpace *space)
 	
 	cpSpatialIndexFree(space->staticShapes);
 	cpSpatialIndexFree(space->dynamicShapes);
+	cpSpatialIndexFree(space->sleepingShapes);
 	
 	cpArrayFree(space->dynamicBodies);
 	cpArrayFree(space->staticBodies);
@@ -201,14 +234,13 @@ cpSpaceDestroy(cpSpace *space)
 	cpArrayFree(space->constraints);
 	
 	cpHashSetFree(space->cachedArbiters);
+	cpHashSetFree(space->sleepingArbiters);
+	cpBatchedSolverFree(space->batchedSolver);
 	
 	cpArrayFree(space->arbiters);
 	cpArrayFree(space->pooledArbiters);
 	
-	if(space->allocatedBuffers){
-		cpArrayFreeEach(space->allocatedBuffers, cpfree);
-		cpArrayFree(space->allocatedBuffers);
-	}
+	cpAllocatorFreeBuffers(space->allocator, space->allocatedBuffers);
 	
 	if(space->postStepCallbacks){
 		cpArrayFreeEach(space->postStepCallbacks, cpfree);
@@ -217,6 +249,8 @@ cpSpaceDestroy(cpSpace *space)
 	
 	if(space->collisionHandlers) cpHashSetEach(space->collisionHandlers, FreeWrap, NULL);
 	cpHashSetFree(space->collisionHandlers);
+	
+	cpfree(space->collisionEvents);
 }
 
 void
@@ -329,6 +363,78 @@ cpSpaceSetCollisionPersistence(cpSpace *space, cpTimestamp collisionPersistence)
 	space->collisionPersistence = collisionPersistence;
 }
 
+cpFloat
+cpSpaceGetContactReuseThreshold(const cpSpace *space)
+{
+	return space->contactReuseThreshold;
+}
+
+void
+cpSpaceSetContactReuseThreshold(cpSpace *space, cpFloat contactReuseThreshold)
+{
+	space->contactReuseThreshold = contactReuseThreshold;
+}
+
+cpTimestamp
+cpSpaceGetContactReuseWindow(const cpSpace *space)
+{
+	return space->contactReuseWindow;
+}
+
+void
+cpSpaceSetContactReuseWindow(cpSpace *space, cpTimestamp contactReuseWindow)
+{
+	space->contactReuseWindow = contactReuseWindow;
+}
+
+void
+cpSpaceUpdateBroadphaseMargins(cpSpace *space)
+{
+	if(!cpSpatialIndexIsBBTree(space->dynamicShapes)) return;
+	
+	cpFloat lookahead = (space->broadphaseLookahead > 0.0f ? space->broadphaseLookahead*space->curr_dt : 0.1f);
+	cpBBTreeSetMargins(space->dynamicShapes, space->broadphaseMargin, space->broadphaseRelativeMargin, lookahead);
+}
+
+cpFloat
+cpSpaceGetBroadphaseMargin(const cpSpace *space)
+{
+	return space->broadphaseMargin;
+}
+
+void
+cpSpaceSetBroadphaseMargin(cpSpace *space, cpFloat broadphaseMargin)
+{
+	space->broadphaseMargin = broadphaseMargin;
+	cpSpaceUpdateBroadphaseMargins(space);
+}
+
+cpFloat
+cpSpaceGetBroadphaseRelativeMargin(const cpSpace *space)
+{
+	return space->broadphaseRelativeMargin;
+}
+
+void
+cpSpaceSetBroadphaseRelativeMargin(cpSpace *space, cpFloat broadphaseRelativeMargin)
+{
+	space->broadphaseRelativeMargin = broadphaseRelativeMargin;
+	cpSpaceUpdateBroadphaseMargins(space);
+}
+
+cpFloat
+cpSpaceGetBroadphaseLookahead(const cpSpace *space)
+{
+	return space->broadphaseLookahead;
+}
+
+void
+cpSpaceSetBroadphaseLookahead(cpSpace *space, cpFloat broadphaseLookahead)
+{
+	space->broadphaseLookahead = broadphaseLookahead;
+	cpSpaceUpdateBroadphaseMargins(space);
+}
+
 cpDataPointer
 cpSpaceGetUserData(const cpSpace *space)
 {
@@ -347,6 +453,32 @@ cpSpaceGetStaticBody(const cpSpace *space)
 	return space->staticBody;
 }
 
+cpFloat
+cpSpaceGetFixedTimeStep(const cpSpace *space)
+{
+	return space->fixedTimeStep;
+}
+
+void
+cpSpaceSetFixedTimeStep(cpSpace *space, cpFloat fixedTimeStep)
+{
+	cpAssertHard(fixedTimeStep > 0.0f, "The fixed time step must be positive.");
+	space->fixedTimeStep = fixedTimeStep;
+}
+
+int
+cpSpaceGetMaxSubsteps(const cpSpace *space)
+{
+	return space->maxSubsteps;
+}
+
+void
+cpSpaceSetMaxSubsteps(cpSpace *space, int maxSubsteps)
+{
+	cpAssertHard(maxSubsteps > 0, "The maximum number of substeps must be positive.");
+	space->maxSubsteps = maxSubsteps;
+}
+
 cpFloat
 cpSpaceGetCurrentTimeStep(const cpSpace *space)
 {
@@ -371,6 +503,24 @@ cpSpaceIsLocked(cpSpace *space)
 	return (space->locked > 0);
 }
 
+cpSpaceSolverType
+cpSpaceGetSolverType(const cpSpace *space)
+{
+	return (space->solveImpulses == cpSpaceSolveImpulsesBatched ? CP_SPACE_SOLVER_BATCHED : CP_SPACE_SOLVER_SCALAR);
+}
+
+void
+cpSpaceSetSolverType(cpSpace *space, cpSpaceSolverType type)
+{
+	cpAssertHard(
+		space->solveImpulses == cpSpaceSolveImpulses || space->solveImpulses == cpSpaceSolveImpulsesBatched,
+		"The solver type cannot be changed for this kind of space."
+	);
+	cpAssertSpaceUnlocked(space);
+	
+	space->solveImpulses = (type == CP_SPACE_SOLVER_BATCHED ? cpSpaceSolveImpulsesBatched : cpSpaceSolveImpulses);
+}
+
 //MARK: Collision Handler Function Management
 
 static void
@@ -450,6 +600,49 @@ cpSpaceAddBody(cpSpace *space, cpBody *body)
 	return body;
 }
 
+void
+cpSpaceAddShapes(cpSpace *space, cpShape **shapes, int count)
+{
+	cpAssertSpaceUnlocked(space);
+	
+	// Static shapes are gathered from the front of the arrays and the rest from the back.
+	void **objs = (void **)cpcalloc(count, sizeof(void *));
+	cpHashValue *hashids = (cpHashValue *)cpcalloc(count, sizeof(cpHashValue));
+	int staticCount = 0, dynamicCount = 0;
+	
+	for(int i=0; i<count; i++){
+		cpShape *shape = shapes[i];
+		cpBody *body = shape->body;
+		
+		cpAssertHard(shape->space != space, "You have already added this shape to this space. You must not add it a second time.");
+		cpAssertHard(!shape->space, "You have already added this shape to another space. You cannot add it to a second.");
+		
+		cpBool isStatic = (cpBodyGetType(body) == CP_BODY_TYPE_STATIC);
+		if(!isStatic) cpBodyActivate(body);
+		cpBodyAddShape(body, shape);
+		
+		shape->hashid = space->shapeIDCounter++;
+		cpShapeUpdate(shape, body->transform);
+		shape->space = space;
+		
+		int index = (isStatic ? staticCount++ : count - ++dynamicCount);
+		objs[index] = shape;
+		hashids[index] = shape->hashid;
+	}
+	
+	cpBBTreeInsertBulk(space->staticShapes, objs, hashids, staticCount);
+	cpBBTreeInsertBulk(space->dynamicShapes, objs + staticCount, hashids + staticCount, dynamicCount);
+	
+	cpfree(objs);
+	cpfree(hashids);
+}
+
+void
+cpSpaceAddBodies(cpSpace *space, cpBody **bodies, int count)
+{
+	for(int i=0; i<count; i++) cpSpaceAddBody(space, bodies[i]);
+}
+
 cpConstraint *
 cpSpaceAddConstraint(cpSpace *space, cpConstraint *constraint)
 {
@@ -516,6 +709,7 @@ cpSpaceFilterArbiters(cpSpace *space, cpBody *body, cpShape *filter)
 	cpSpaceLock(space); {
 		struct arbiterFilterContext context = {space, body, filter};
 		cpHashSetFilter(space->cachedArbiters, (cpHashSetFilterFunc)cachedArbitersFilter, &context);
+		cpHashSetFilter(space->sleepingArbiters, (cpHashSetFilterFunc)cachedArbitersFilter, &context);
 	} cpSpaceUnlock(space, cpTrue);
 }
 
@@ -633,6 +827,7 @@ cpSpaceEachShape(cpSpace *space, cpSpaceShapeIteratorFunc func, void *data)
 		spaceShapeContext context = {func, data};
 		cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)spaceEachShapeIterator, &context);
 		cpSpatialIndexEach(space->staticShapes, (cpSpatialIndexIteratorFunc)spaceEachShapeIterator, &context);
+		cpSpatialIndexEach(space->sleepingShapes, (cpSpatialIndexIteratorFunc)spaceEachShapeIterator, &context);
 	} cpSpaceUnlock(space, cpTrue);
 }
 
@@ -659,6 +854,14 @@ cpSpaceReindexStatic(cpSpace *space)
 	cpSpatialIndexReindex(space->staticShapes);
 }
 
+void
+cpSpaceOptimizeStatic(cpSpace *space)
+{
+	cpAssertHard(!space->locked, "You cannot optimize the static index while the space is locked. Wait until the current query or step is complete.");
+	
+	if(cpSpatialIndexIsBBTree(space->staticShapes)) cpBBTreeOptimize(space->staticShapes);
+}
+
 void
 cpSpaceReindexShape(cpSpace *space, cpShape *shape)
 {
@@ -666,9 +869,28 @@ cpSpaceReindexShape(cpSpace *space, cpShape *shape)
 	
 	cpShapeCacheBB(shape);
 	
-	// attempt to rehash the shape in both hashes
+	// attempt to rehash the shape in all of the indexes
 	cpSpatialIndexReindexObject(space->dynamicShapes, shape, shape->hashid);
 	cpSpatialIndexReindexObject(space->staticShapes, shape, shape->hashid);
+	cpSpatialIndexReindexObject(space->sleepingShapes, shape, shape->hashid);
+}
+
+void
+cpSpaceSetTreeRebalanceBudget(cpSpace *space, int budget)
+{
+	if(cpSpatialIndexIsBBTree(space->dynamicShapes)) cpBBTreeSetRebalanceBudget(space->dynamicShapes, budget);
+}
+
+void
+cpSpaceGetTreeQuality(cpSpace *space, cpBBTreeQuality *quality)
+{
+	cpBBTreeGetQuality(space->dynamicShapes, quality);
+}
+
+void
+cpSpaceGetHashSizing(cpSpace *space, cpSpaceHashSizing *sizing)
+{
+	cpSpaceHashGetSizing(space->dynamicShapes, sizing);
 }
 
 void
@@ -684,18 +906,62 @@ copyShapes(cpShape *shape, cpSpatialIndex *index)
 	cpSpatialIndexInsert(index, shape, shape->hashid);
 }
 
-void
-cpSpaceUseSpatialHash(cpSpace *space, cpFloat dim, int count)
+static void
+SpaceReplaceIndexes(cpSpace *space, cpSpatialIndex *staticShapes, cpSpatialIndex *dynamicShapes)
 {
-	cpSpatialIndex *staticShapes = cpSpaceHashNew(dim, count, (cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
-	cpSpatialIndex *dynamicShapes = cpSpaceHashNew(dim, count, (cpSpatialIndexBBFunc)cpShapeGetBB, staticShapes);
+	// The sleeping tree caches pairs with the dynamic index, so it needs to be rebuilt too.
+	cpSpatialIndex *sleepingShapes = cpBBTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
+	cpBBTreeSetSleepingIndex(dynamicShapes, sleepingShapes);
+	
+	cpSpatialIndexSetAllocator(staticShapes, space->allocator);
+	cpSpatialIndexSetAllocator(dynamicShapes, space->allocator);
+	cpSpatialIndexSetAllocator(sleepingShapes, space->allocator);
 	
 	cpSpatialIndexEach(space->staticShapes, (cpSpatialIndexIteratorFunc)copyShapes, staticShapes);
 	cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)copyShapes, dynamicShapes);
+	cpSpatialIndexEach(space->sleepingShapes, (cpSpatialIndexIteratorFunc)copyShapes, sleepingShapes);
 	
 	cpSpatialIndexFree(space->staticShapes);
 	cpSpatialIndexFree(space->dynamicShapes);
+	cpSpatialIndexFree(space->sleepingShapes);
 	
 	space->staticShapes = staticShapes;
 	space->dynamicShapes = dynamicShapes;
+	space->sleepingShapes = sleepingShapes;
+}
+
+void
+cpSpaceUseSpatialHash(cpSpace *space, cpFloat dim, int count)
+{
+	cpSpatialIndex *staticShapes = cpSpaceHashNew(dim, count, (cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
+	cpSpatialIndex *dynamicShapes = cpSpaceHashNew(dim, count, (cpSpatialIndexBBFunc)cpShapeGetBB, staticShapes);
+	SpaceReplaceIndexes(space, staticShapes, dynamicShapes);
+}
+
+void
+cpSpaceUseSweepAndPrune(cpSpace *space)
+{
+	cpSpatialIndex *staticShapes = cpBBTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
+	cpSpatialIndex *dynamicShapes = cpSweep2DNew((cpSpatialIndexBBFunc)cpShapeGetBB, staticShapes);
+	SpaceReplaceIndexes(space, staticShapes, dynamicShapes);
+}
+
+void
+cpSpaceSetAllocator(cpSpace *space, const cpAllocator *allocator)
+{
+	cpAssertHard(space->allocatedBuffers->num == 0, "The allocator must be set before anything is added to the space.");
+	space->allocator = allocator;
+	
+	cpHashSetSetAllocator(space->cachedArbiters, allocator);
+	cpHashSetSetAllocator(space->sleepingArbiters, allocator);
+	cpHashSetSetAllocator(space->collisionHandlers, allocator);
+	cpSpatialIndexSetAllocator(space->staticShapes, allocator);
+	cpSpatialIndexSetAllocator(space->dynamicShapes, allocator);
+	cpSpatialIndexSetAllocator(space->sleepingShapes, allocator);
+}
+
+const cpAllocator *
+cpSpaceGetAllocator(cpSpace *space)
+{
+	return space->allocator;
 }
@@ -38,10 +38,13 @@ cpSpaceActivateBody(cpSpace *space, cpBody *body)
 		cpArrayPush(space->dynamicBodies, body);
 
 		CP_BODY_FOREACH_SHAPE(body, shape){
-			cpSpatialIndexRemove(space->staticShapes, shape, shape->hashid);
+			cpSpatialIndexRemove(space->sleepingShapes, shape, shape->hashid);
 			cpSpatialIndexInsert(space->dynamicShapes, shape, shape->hashid);
 		}
 		
+		// Any arbiters parked while the body slept are restored at the start of the next step.
+		if(cpHashSetCount(space->sleepingArbiters) > 0) space->wakeSleepingArbiters = cpTrue;
+		
 		CP_BODY_FOREACH_ARBITER(body, arb){
 			cpBody *bodyA = arb->body_a;
 			
@@ -61,7 +64,7 @@ cpSpaceActivateBody(cpSpace *space, cpBody *body)
 				// Reinsert the arbiter into the arbiter cache
 				const cpShape *a = arb->a, *b = arb->b;
 				const cpShape *shape_pair[] = {a, b};
-				cpHashValue arbHashID = CP_HASH_PAIR((cpHashValue)a, (cpHashValue)b);
+				cpHashValue arbHashID = CP_ARBITER_HASH(a, b);
 				cpHashSetInsert(space->cachedArbiters, arbHashID, shape_pair, NULL, arb);
 				
 				// Update the arbiter's state
@@ -88,7 +91,8 @@ cpSpaceDeactivateBody(cpSpace *space, cpBody *body)
 	
 	CP_BODY_FOREACH_SHAPE(body, shape){
 		cpSpatialIndexRemove(space->dynamicShapes, shape, shape->hashid);
-		cpSpatialIndexInsert(space->staticShapes, shape, shape->hashid);
+		cpSpatialIndexInsert(space->sleepingShapes, shape, shape->hashid);
+		space->sleepingShapesAdded++;
 	}
 	
 	CP_BODY_FOREACH_ARBITER(body, arb){
@@ -141,6 +145,7 @@ cpBodyActivate(cpBody *body)
 			}
 			
 			cpArrayDeleteObj(space->sleepingComponents, root);
+			cpSpaceStatsCount(space, islandsWoken, 1);
 		}
 		
 		CP_BODY_FOREACH_ARBITER(body, arb){
@@ -289,6 +294,7 @@ cpSpaceProcessComponents(cpSpace *space, cpFloat dt)
 				// Check if the component should be put to sleep.
 				if(!ComponentActive(body, space->sleepTimeThreshold)){
 					cpArrayPush(space->sleepingComponents, body);
+					cpSpaceStatsCount(space, islandsSlept, 1);
 					CP_BODY_FOREACH_COMPONENT(body, other) cpSpaceDeactivateBody(space, other);
 					
 					// cpSpaceDeactivateBody() removed the current body from the list.
@@ -343,6 +349,7 @@ cpBodySleepWithGroup(cpBody *body, cpBody *group){
 		body->sleeping.idleTime = 0.0f;
 		
 		cpArrayPush(space->sleepingComponents, body);
+		cpSpaceStatsCount(space, islandsSlept, 1);
 	}
 	
 	cpArrayDeleteObj(space->dynamicBodies, body);
@@ -0,0 +1,79 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "chipmunk/chipmunk_private.h"
+
+static cpCollisionEvent *
+PushEvent(cpSpace *space, cpCollisionEventType type, cpArbiter *arb, cpDataPointer userData)
+{
+	if(space->collisionEventCount == space->collisionEventCapacity){
+		space->collisionEventCapacity = (space->collisionEventCapacity ? 2*space->collisionEventCapacity : 64);
+		space->collisionEvents = (cpCollisionEvent *)cprealloc(space->collisionEvents, space->collisionEventCapacity*sizeof(cpCollisionEvent));
+	}
+	
+	cpCollisionEvent *event = space->collisionEvents + space->collisionEventCount++;
+	event->type = type;
+	cpArbiterGetShapes(arb, &event->a, &event->b);
+	event->userData = userData;
+	event->contacts.count = 0;
+	event->contacts.normal = cpvzero;
+	event->impulse = cpvzero;
+	
+	return event;
+}
+
+cpBool
+cpSpaceRecordCollisionBegin(cpArbiter *arb, cpSpace *space, cpDataPointer userData)
+{
+	cpCollisionEvent *event = PushEvent(space, CP_COLLISION_EVENT_BEGIN, arb, userData);
+	event->contacts = cpArbiterGetContactPointSet(arb);
+	
+	return cpTrue;
+}
+
+void
+cpSpaceRecordCollisionPostSolve(cpArbiter *arb, cpSpace *space, cpDataPointer userData)
+{
+	cpCollisionEvent *event = PushEvent(space, CP_COLLISION_EVENT_POST_SOLVE, arb, userData);
+	event->contacts = cpArbiterGetContactPointSet(arb);
+	event->impulse = cpArbiterTotalImpulse(arb);
+}
+
+void
+cpSpaceRecordCollisionSeparate(cpArbiter *arb, cpSpace *space, cpDataPointer userData)
+{
+	// The contacts of a separating arbiter may be in a buffer that was already reused.
+	PushEvent(space, CP_COLLISION_EVENT_SEPARATE, arb, userData);
+}
+
+const cpCollisionEvent *
+cpSpaceGetCollisionEvents(const cpSpace *space, int *count)
+{
+	(*count) = space->collisionEventCount;
+	return space->collisionEvents;
+}
+
+void
+cpSpaceClearCollisionEvents(cpSpace *space)
+{
+	space->collisionEventCount = 0;
+}
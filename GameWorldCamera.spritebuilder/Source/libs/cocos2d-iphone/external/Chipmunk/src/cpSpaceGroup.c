@@ -0,0 +1,233 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <string.h>
+#include <pthread.h>
+
+#include "chipmunk/chipmunk_private.h"
+#include "chipmunk/cpSpaceGroup.h"
+
+typedef struct GroupEntry {
+	cpSpace *space;
+	cpSpaceGroupStats stats;
+} GroupEntry;
+
+// Range of entries a worker has left to step.
+typedef struct WorkerQueue {
+	int start, end;
+} WorkerQueue;
+
+struct cpSpaceGroup {
+	cpThreadPool *pool;
+	
+	int count, capacity;
+	GroupEntry *entries;
+	
+	// Work for the current step. The queues are only touched while holding the mutex.
+	pthread_mutex_t mutex;
+	WorkerQueue *queues;
+	cpFloat dt;
+	cpBool fixed;
+};
+
+cpSpaceGroup *
+cpSpaceGroupNew(unsigned long threads)
+{
+	cpSpaceGroup *group = (cpSpaceGroup *)cpcalloc(1, sizeof(cpSpaceGroup));
+	
+	if(threads != 1){
+		group->pool = cpThreadPoolNew(threads);
+		
+		if(cpThreadPoolGetThreads(group->pool) == 1){
+			cpThreadPoolFree(group->pool);
+			group->pool = NULL;
+		}
+	}
+	
+	group->count = group->capacity = 0;
+	group->entries = NULL;
+	
+	pthread_mutex_init(&group->mutex, NULL);
+	group->queues = (WorkerQueue *)cpcalloc(cpThreadPoolGetThreads(group->pool), sizeof(WorkerQueue));
+	
+	return group;
+}
+
+void
+cpSpaceGroupFree(cpSpaceGroup *group)
+{
+	if(group){
+		cpThreadPoolFree(group->pool);
+		pthread_mutex_destroy(&group->mutex);
+		
+		cpfree(group->queues);
+		cpfree(group->entries);
+		cpfree(group);
+	}
+}
+
+unsigned long
+cpSpaceGroupGetThreads(cpSpaceGroup *group)
+{
+	return cpThreadPoolGetThreads(group->pool);
+}
+
+static GroupEntry *
+FindEntry(cpSpaceGroup *group, cpSpace *space)
+{
+	for(int i=0; i<group->count; i++){
+		if(group->entries[i].space == space) return group->entries + i;
+	}
+	
+	return NULL;
+}
+
+void
+cpSpaceGroupAddSpace(cpSpaceGroup *group, cpSpace *space)
+{
+	cpAssertHard(!FindEntry(group, space), "You have already added this space to this group.");
+	
+	if(group->count == group->capacity){
+		group->capacity = (group->capacity ? 2*group->capacity : 8);
+		group->entries = (GroupEntry *)cprealloc(group->entries, group->capacity*sizeof(GroupEntry));
+	}
+	
+	GroupEntry *entry = group->entries + group->count++;
+	entry->space = space;
+	memset(&entry->stats, 0, sizeof(cpSpaceGroupStats));
+}
+
+void
+cpSpaceGroupRemoveSpace(cpSpaceGroup *group, cpSpace *space)
+{
+	GroupEntry *entry = FindEntry(group, space);
+	cpAssertHard(entry, "Cannot remove a space that was not added to the group.");
+	
+	// Keep the order so the spaces stay with the same workers.
+	memmove(entry, entry + 1, (group->entries + group->count - (entry + 1))*sizeof(GroupEntry));
+	group->count--;
+}
+
+int
+cpSpaceGroupGetCount(cpSpaceGroup *group)
+{
+	return group->count;
+}
+
+//MARK: Stepping
+
+// Returns the index of the next entry for the worker to step, or -1 when there are none left.
+static int
+TakeEntry(cpSpaceGroup *group, unsigned long worker)
+{
+	int index = -1;
+	
+	pthread_mutex_lock(&group->mutex); {
+		WorkerQueue *queue = group->queues + worker;
+		
+		if(queue->start < queue->end){
+			index = queue->start++;
+		} else {
+			// Steal from the back of the longest queue so its worker keeps the spaces it's about to step.
+			WorkerQueue *victim = NULL;
+			for(unsigned long i=0, threads = cpThreadPoolGetThreads(group->pool); i<threads; i++){
+				WorkerQueue *other = group->queues + i;
+				if(other->end - other->start > (victim ? victim->end - victim->start : 0)) victim = other;
+			}
+			
+			if(victim) index = --victim->end;
+		}
+	} pthread_mutex_unlock(&group->mutex);
+	
+	return index;
+}
+
+static void
+StepEntry(cpSpaceGroup *group, GroupEntry *entry)
+{
+	double start = cpSpaceStatsTime();
+	
+	if(group->fixed){
+		cpSpaceStepFixed(entry->space, group->dt);
+	} else {
+		cpSpaceStep(entry->space, group->dt);
+	}
+	
+	cpSpaceGroupStats *stats = &entry->stats;
+	stats->last = cpSpaceStatsTime() - start;
+	stats->max = cpfmax(stats->max, stats->last);
+	stats->total += stats->last;
+	stats->steps++;
+}
+
+static void
+StepWorker(cpSpaceGroup *group, unsigned long worker)
+{
+	for(int index; (index = TakeEntry(group, worker)) >= 0;){
+		StepEntry(group, group->entries + index);
+	}
+}
+
+static void
+GroupStep(cpSpaceGroup *group, cpFloat dt, cpBool fixed)
+{
+	group->dt = dt;
+	group->fixed = fixed;
+	
+	// Give each worker the same contiguous run of spaces every step.
+	unsigned long threads = cpThreadPoolGetThreads(group->pool);
+	for(unsigned long i=0; i<threads; i++){
+		group->queues[i].start = (int)(group->count*i/threads);
+		group->queues[i].end = (int)(group->count*(i + 1)/threads);
+	}
+	
+	cpThreadPoolRun(group->pool, (cpThreadPoolWorkFunc)StepWorker, group);
+}
+
+void
+cpSpaceGroupStep(cpSpaceGroup *group, cpFloat dt)
+{
+	GroupStep(group, dt, cpFalse);
+}
+
+void
+cpSpaceGroupStepFixed(cpSpaceGroup *group, cpFloat dt)
+{
+	GroupStep(group, dt, cpTrue);
+}
+
+//MARK: Stats
+
+void
+cpSpaceGroupGetStats(cpSpaceGroup *group, cpSpace *space, cpSpaceGroupStats *stats)
+{
+	GroupEntry *entry = FindEntry(group, space);
+	cpAssertHard(entry, "The space was not added to the group.");
+	
+	(*stats) = entry->stats;
+}
+
+void
+cpSpaceGroupResetStats(cpSpaceGroup *group)
+{
+	for(int i=0; i<group->count; i++) memset(&group->entries[i].stats, 0, sizeof(cpSpaceGroupStats));
+}
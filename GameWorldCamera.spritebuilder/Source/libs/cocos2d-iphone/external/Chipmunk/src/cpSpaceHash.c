@@ -39,6 +39,15 @@ struct cpSpaceHash {
 	cpArray *allocatedBuffers;
 	
 	cpTimestamp stamp;
+	
+	// Adaptive mode picks celldim and numcells from the objects and how full the table is.
+	cpBool adaptive;
+	// Number of objects when the sizes were last chosen.
+	int tunedCount;
+	// Bins and non-empty cells added since the table was last cleared.
+	int entries, occupied;
+	// Number of times adaptive mode changed the sizes.
+	int resizes;
 };
 
 
@@ -79,7 +88,7 @@ handleSetTrans(void *obj, cpSpaceHash *hash)
 		int count = CP_BUFFER_BYTES/sizeof(cpHandle);
 		cpAssertHard(count, "Internal Error: Buffer size is too small.");
 		
-		cpHandle *buffer = (cpHandle *)cpcalloc(1, CP_BUFFER_BYTES);
+		cpHandle *buffer = (cpHandle *)cpAllocatorAlloc(hash->spatialIndex.allocator, CP_BUFFER_BYTES);
 		cpArrayPush(hash->allocatedBuffers, buffer);
 		
 		for(int i=0; i<count; i++) cpArrayPush(hash->pooledHandles, buffer + i);
@@ -125,6 +134,9 @@ static void
 clearTable(cpSpaceHash *hash)
 {
 	for(int i=0; i<hash->numcells; i++) clearTableCell(hash, i);
+	
+	hash->entries = 0;
+	hash->occupied = 0;
 }
 
 // Get a recycled or new bin.
@@ -141,7 +153,7 @@ getEmptyBin(cpSpaceHash *hash)
 		int count = CP_BUFFER_BYTES/sizeof(cpSpaceHashBin);
 		cpAssertHard(count, "Internal Error: Buffer size is too small.");
 		
-		cpSpaceHashBin *buffer = (cpSpaceHashBin *)cpcalloc(1, CP_BUFFER_BYTES);
+		cpSpaceHashBin *buffer = (cpSpaceHashBin *)cpAllocatorAlloc(hash->spatialIndex.allocator, CP_BUFFER_BYTES);
 		cpArrayPush(hash->allocatedBuffers, buffer);
 		
 		// push all but the first one, return the first instead
@@ -176,7 +188,13 @@ cpSpaceHashInit(cpSpaceHash *hash, cpFloat celldim, int numcells, cpSpatialIndex
 	cpSpatialIndexInit((cpSpatialIndex *)hash, Klass(), bbfunc, staticIndex);
 	
 	cpSpaceHashAllocTable(hash, next_prime(numcells));
-	hash->celldim = celldim;
+	
+	// The real cell size is picked when the first object is inserted.
+	hash->adaptive = (celldim <= 0.0f);
+	hash->celldim = (hash->adaptive ? 1.0f : celldim);
+	hash->tunedCount = 0;
+	hash->entries = hash->occupied = 0;
+	hash->resizes = 0;
 	
 	hash->handleSet = cpHashSetNew(0, (cpHashSetEqlFunc)handleSetEql);
 	
@@ -196,6 +214,16 @@ cpSpaceHashNew(cpFloat celldim, int cells, cpSpatialIndexBBFunc bbfunc, cpSpatia
 	return cpSpaceHashInit(cpSpaceHashAlloc(), celldim, cells, bbfunc, staticIndex);
 }
 
+void
+cpSpaceHashSetAllocator(cpSpatialIndex *index, const cpAllocator *allocator)
+{
+	if(index->klass != Klass()) return;
+	
+	cpSpaceHash *hash = (cpSpaceHash *)index;
+	cpAssertHard(hash->allocatedBuffers->num == 0, "The allocator must be set before anything is added.");
+	cpHashSetSetAllocator(hash->handleSet, allocator);
+}
+
 static void
 cpSpaceHashDestroy(cpSpaceHash *hash)
 {
@@ -204,8 +232,7 @@ cpSpaceHashDestroy(cpSpaceHash *hash)
 	
 	cpHashSetFree(hash->handleSet);
 	
-	cpArrayFreeEach(hash->allocatedBuffers, cpfree);
-	cpArrayFree(hash->allocatedBuffers);
+	cpAllocatorFreeBuffers(hash->spatialIndex.allocator, hash->allocatedBuffers);
 	cpArrayFree(hash->pooledHandles);
 }
 
@@ -263,17 +290,95 @@ hashHandle(cpSpaceHash *hash, cpHandle *hand, cpBB bb)
 			newBin->handle = hand;
 			newBin->next = bin;
 			hash->table[idx] = newBin;
+			
+			hash->entries++;
+			if(!bin) hash->occupied++;
 		}
 	}
 }
 
+//MARK: Adaptive Sizing
+
+// The cell size is kept within this factor of the average object size.
+#define ADAPTIVE_DIM_SLACK 2.0f
+// Target number of bins per table cell, and how far the load can drift either way before the table is resized.
+#define ADAPTIVE_LOAD 0.5f
+#define ADAPTIVE_LOAD_SLACK 4.0f
+// Average number of bins in a non-empty cell before the cells are made smaller.
+#define ADAPTIVE_MAX_CHAIN 8.0f
+
+typedef struct sizeContext {
+	cpSpaceHash *hash;
+	cpFloat width, height;
+} sizeContext;
+
+static void
+size_helper(cpHandle *hand, sizeContext *context)
+{
+	cpBB bb = context->hash->spatialIndex.bbfunc(hand->obj);
+	context->width += bb.r - bb.l;
+	context->height += bb.t - bb.b;
+}
+
+// Pick a new cell size and table size when the objects or the load drifted too far from the current ones.
+// The slack on both keeps it from flipping back and forth. Returns true if the table was cleared.
+static cpBool
+adaptiveResize(cpSpaceHash *hash)
+{
+	int count = cpHashSetCount(hash->handleSet);
+	hash->tunedCount = count;
+	if(count == 0) return cpFalse;
+	
+	sizeContext context = {hash, 0.0f, 0.0f};
+	cpHashSetEach(hash->handleSet, (cpHashSetIteratorFunc)size_helper, &context);
+	
+	cpFloat width = context.width/count, height = context.height/count;
+	cpFloat size = (width + height)/2.0f;
+	
+	cpFloat dim = hash->celldim;
+	if(size > 0.0f){
+		if(dim > size*ADAPTIVE_DIM_SLACK || dim*ADAPTIVE_DIM_SLACK < size){
+			dim = size;
+		} else if(hash->entries > ADAPTIVE_MAX_CHAIN*hash->occupied && dim*0.5f*ADAPTIVE_DIM_SLACK >= size){
+			// Crowded cells, use smaller ones.
+			dim *= 0.5f;
+		}
+	}
+	
+	// Use the measured number of bins if the cell size didn't change, otherwise estimate it.
+	cpFloat entries = (dim == hash->celldim && hash->entries > 0 ? hash->entries : count*(width/dim + 1.0f)*(height/dim + 1.0f));
+	cpFloat load = entries/hash->numcells;
+	
+	int numcells = hash->numcells;
+	if(load > ADAPTIVE_LOAD*ADAPTIVE_LOAD_SLACK || load < ADAPTIVE_LOAD/ADAPTIVE_LOAD_SLACK){
+		numcells = next_prime((int)cpfmin(entries/ADAPTIVE_LOAD, 1e9));
+	}
+	
+	if(dim == hash->celldim && numcells == hash->numcells) return cpFalse;
+	
+	clearTable(hash);
+	hash->celldim = dim;
+	if(numcells != hash->numcells) cpSpaceHashAllocTable(hash, numcells);
+	hash->resizes++;
+	
+	return cpTrue;
+}
+
 //MARK: Basic Operations
 
+static void cpSpaceHashRehash(cpSpaceHash *hash);
+
 static void
 cpSpaceHashInsert(cpSpaceHash *hash, void *obj, cpHashValue hashid)
 {
 	cpHandle *hand = (cpHandle *)cpHashSetInsert(hash->handleSet, hashid, obj, (cpHashSetTransFunc)handleSetTrans, hash);
-	hashHandle(hash, hand, hash->spatialIndex.bbfunc(obj));
+	
+	// Resize whenever the number of objects doubles. This covers indexes that are filled but never reindexed.
+	if(hash->adaptive && cpHashSetCount(hash->handleSet) > 2*hash->tunedCount){
+		cpSpaceHashRehash(hash);
+	} else {
+		hashHandle(hash, hand, hash->spatialIndex.bbfunc(obj));
+	}
 }
 
 static void
@@ -298,6 +403,7 @@ rehash_helper(cpHandle *hand, cpSpaceHash *hash)
 static void
 cpSpaceHashRehash(cpSpaceHash *hash)
 {
+	if(hash->adaptive) adaptiveResize(hash);
 	clearTable(hash);
 	cpHashSetEach(hash->handleSet, (cpHashSetIteratorFunc)rehash_helper, hash);
 }
@@ -438,6 +544,9 @@ queryRehash_helper(cpHandle *hand, queryRehashContext *context)
 			newBin->handle = hand;
 			newBin->next = bin;
 			table[idx] = newBin;
+			
+			hash->entries++;
+			if(!bin) hash->occupied++;
 		}
 	}
 	
@@ -448,6 +557,7 @@ queryRehash_helper(cpHandle *hand, queryRehashContext *context)
 static void
 cpSpaceHashReindexQuery(cpSpaceHash *hash, cpSpatialIndexQueryFunc func, void *data)
 {
+	if(hash->adaptive) adaptiveResize(hash);
 	clearTable(hash);
 	
 	queryRehashContext context = {hash, func, data};
@@ -554,10 +664,30 @@ cpSpaceHashResize(cpSpaceHash *hash, cpFloat celldim, int numcells)
 	
 	clearTable(hash);
 	
-	hash->celldim = celldim;
+	hash->adaptive = (celldim <= 0.0f);
+	hash->tunedCount = 0;
+	
+	if(!hash->adaptive) hash->celldim = celldim;
 	cpSpaceHashAllocTable(hash, next_prime(numcells));
 }
 
+void
+cpSpaceHashGetSizing(cpSpatialIndex *index, cpSpaceHashSizing *sizing)
+{
+	memset(sizing, 0, sizeof(cpSpaceHashSizing));
+	
+	if(index->klass != Klass()){
+		cpAssertWarn(cpFalse, "Ignoring cpSpaceHashGetSizing() call to non-cpSpaceHash spatial index.");
+		return;
+	}
+	
+	cpSpaceHash *hash = (cpSpaceHash *)index;
+	sizing->adaptive = hash->adaptive;
+	sizing->celldim = hash->celldim;
+	sizing->numcells = hash->numcells;
+	sizing->resizes = hash->resizes;
+}
+
 static int
 cpSpaceHashCount(cpSpaceHash *hash)
 {
@@ -54,6 +54,7 @@ cpSpacePointQuery(cpSpace *space, cpVect point, cpFloat maxDistance, cpShapeFilt
 	cpSpaceLock(space); {
 		cpSpatialIndexQuery(space->dynamicShapes, &context, bb, (cpSpatialIndexQueryFunc)NearestPointQuery, data);
 		cpSpatialIndexQuery(space->staticShapes, &context, bb, (cpSpatialIndexQueryFunc)NearestPointQuery, data);
+		cpSpatialIndexQuery(space->sleepingShapes, &context, bb, (cpSpatialIndexQueryFunc)NearestPointQuery, data);
 	} cpSpaceUnlock(space, cpTrue);
 }
 
@@ -91,6 +92,7 @@ cpSpacePointQueryNearest(cpSpace *space, cpVect point, cpFloat maxDistance, cpSh
 	cpBB bb = cpBBNewForCircle(point, cpfmax(maxDistance, 0.0f));
 	cpSpatialIndexQuery(space->dynamicShapes, &context, bb, (cpSpatialIndexQueryFunc)NearestPointQueryNearest, out);
 	cpSpatialIndexQuery(space->staticShapes, &context, bb, (cpSpatialIndexQueryFunc)NearestPointQueryNearest, out);
+	cpSpatialIndexQuery(space->sleepingShapes, &context, bb, (cpSpatialIndexQueryFunc)NearestPointQueryNearest, out);
 	
 	return (cpShape *)out->shape;
 }
@@ -133,6 +135,7 @@ cpSpaceSegmentQuery(cpSpace *space, cpVect start, cpVect end, cpFloat radius, cp
 	cpSpaceLock(space); {
     cpSpatialIndexSegmentQuery(space->staticShapes, &context, start, end, 1.0f, (cpSpatialIndexSegmentQueryFunc)SegmentQuery, data);
     cpSpatialIndexSegmentQuery(space->dynamicShapes, &context, start, end, 1.0f, (cpSpatialIndexSegmentQueryFunc)SegmentQuery, data);
+    cpSpatialIndexSegmentQuery(space->sleepingShapes, &context, start, end, 1.0f, (cpSpatialIndexSegmentQueryFunc)SegmentQuery, data);
 	} cpSpaceUnlock(space, cpTrue);
 }
 
@@ -171,10 +174,158 @@ cpSpaceSegmentQueryFirst(cpSpace *space, cpVect start, cpVect end, cpFloat radiu
 	
 	cpSpatialIndexSegmentQuery(space->staticShapes, &context, start, end, 1.0f, (cpSpatialIndexSegmentQueryFunc)SegmentQueryFirst, out);
 	cpSpatialIndexSegmentQuery(space->dynamicShapes, &context, start, end, out->alpha, (cpSpatialIndexSegmentQueryFunc)SegmentQueryFirst, out);
+	cpSpatialIndexSegmentQuery(space->sleepingShapes, &context, start, end, out->alpha, (cpSpatialIndexSegmentQueryFunc)SegmentQueryFirst, out);
 	
 	return (cpShape *)out->shape;
 }
 
+//MARK: Batched Segment Query Functions
+
+// Batches smaller than this are always run on the calling thread.
+#define THREADED_BATCH_THRESHOLD 256
+
+typedef struct SegmentQueryBatch {
+	cpSpace *space;
+	cpSegmentQueryInfo *results;
+	struct SegmentQueryContext *contexts;
+	int *order;
+	int count, packetCount;
+	unsigned long threads;
+} SegmentQueryBatch;
+
+typedef struct SortKey {
+	uint32_t key;
+	int index;
+} SortKey;
+
+static int
+SortKeyCompare(const SortKey *a, const SortKey *b)
+{
+	return (a->key < b->key ? -1 : (a->key > b->key ? 1 : a->index - b->index));
+}
+
+static inline uint32_t
+SpreadBits(uint32_t x)
+{
+	x &= 0xFFFF;
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	return x;
+}
+
+// Sort the thin segments along a Morton curve through their midpoints so that packets hold nearby segments.
+// Segments with a radius are moved to the end of the order and are queried one at a time instead.
+// The tree prunes them using their thin bounding box, so their result depends on the traversal order.
+// Returns the number of segments that can be put into packets.
+static int
+SortSegments(const cpSegmentQueryRequest *requests, int count, int *order)
+{
+	cpBB bounds = cpBBNew(INFINITY, INFINITY, -INFINITY, -INFINITY);
+	for(int i=0; i<count; i++) bounds = cpBBExpand(bounds, cpvlerp(requests[i].start, requests[i].end, 0.5f));
+	
+	cpFloat scale_x = (bounds.r > bounds.l ? 65535.0f/(bounds.r - bounds.l) : 0.0f);
+	cpFloat scale_y = (bounds.t > bounds.b ? 65535.0f/(bounds.t - bounds.b) : 0.0f);
+	
+	SortKey *keys = (SortKey *)cpcalloc(count, sizeof(SortKey));
+	int packetCount = 0, last = count;
+	
+	for(int i=0; i<count; i++){
+		if(requests[i].radius > 0.0f){
+			order[--last] = i;
+			continue;
+		}
+		
+		cpVect mid = cpvlerp(requests[i].start, requests[i].end, 0.5f);
+		uint32_t x = (uint32_t)((mid.x - bounds.l)*scale_x);
+		uint32_t y = (uint32_t)((mid.y - bounds.b)*scale_y);
+		
+		keys[packetCount].key = SpreadBits(x) | SpreadBits(y) << 1;
+		keys[packetCount].index = i;
+		packetCount++;
+	}
+	
+	qsort(keys, packetCount, sizeof(SortKey), (int (*)(const void *, const void *))SortKeyCompare);
+	for(int i=0; i<packetCount; i++) order[i] = keys[i].index;
+	
+	cpfree(keys);
+	return packetCount;
+}
+
+static void
+SegmentQueryPackets(SegmentQueryBatch *batch, unsigned long worker)
+{
+	unsigned long packets = (batch->packetCount + CP_SEGMENT_PACKET_SIZE - 1)/CP_SEGMENT_PACKET_SIZE;
+	unsigned long start = packets*worker/batch->threads, end = packets*(worker + 1)/batch->threads;
+	
+	for(unsigned long p=start; p<end; p++){
+		cpSpatialIndexSegment segments[CP_SEGMENT_PACKET_SIZE];
+		int first = (int)p*CP_SEGMENT_PACKET_SIZE;
+		int count = (batch->packetCount - first < CP_SEGMENT_PACKET_SIZE ? batch->packetCount - first : CP_SEGMENT_PACKET_SIZE);
+		
+		for(int i=0; i<count; i++){
+			int index = batch->order[first + i];
+			struct SegmentQueryContext *context = batch->contexts + index;
+			cpSpatialIndexSegment segment = {context, context->start, context->end, 1.0f, batch->results + index};
+			segments[i] = segment;
+		}
+		
+		cpBBTreeSegmentQueryPacket(batch->space->staticShapes, segments, count, (cpSpatialIndexSegmentQueryFunc)SegmentQueryFirst);
+		for(int i=0; i<count; i++) segments[i].t_exit = ((cpSegmentQueryInfo *)segments[i].data)->alpha;
+		
+		cpBBTreeSegmentQueryPacket(batch->space->dynamicShapes, segments, count, (cpSpatialIndexSegmentQueryFunc)SegmentQueryFirst);
+		for(int i=0; i<count; i++) segments[i].t_exit = ((cpSegmentQueryInfo *)segments[i].data)->alpha;
+		
+		cpBBTreeSegmentQueryPacket(batch->space->sleepingShapes, segments, count, (cpSpatialIndexSegmentQueryFunc)SegmentQueryFirst);
+	}
+	
+	unsigned long singles = batch->count - batch->packetCount;
+	start = batch->packetCount + singles*worker/batch->threads, end = batch->packetCount + singles*(worker + 1)/batch->threads;
+	
+	for(unsigned long i=start; i<end; i++){
+		int index = batch->order[i];
+		struct SegmentQueryContext *context = batch->contexts + index;
+		cpSegmentQueryInfo *info = batch->results + index;
+		
+		cpSpatialIndexSegmentQuery(batch->space->staticShapes, context, context->start, context->end, 1.0f, (cpSpatialIndexSegmentQueryFunc)SegmentQueryFirst, info);
+		cpSpatialIndexSegmentQuery(batch->space->dynamicShapes, context, context->start, context->end, info->alpha, (cpSpatialIndexSegmentQueryFunc)SegmentQueryFirst, info);
+		cpSpatialIndexSegmentQuery(batch->space->sleepingShapes, context, context->start, context->end, info->alpha, (cpSpatialIndexSegmentQueryFunc)SegmentQueryFirst, info);
+	}
+}
+
+void
+cpSpaceSegmentQueryBatch(cpSpace *space, const cpSegmentQueryRequest *requests, int count, cpSegmentQueryInfo *results)
+{
+	if(count <= 0) return;
+	
+	struct SegmentQueryContext *contexts = (struct SegmentQueryContext *)cpcalloc(count, sizeof(struct SegmentQueryContext));
+	for(int i=0; i<count; i++){
+		const cpSegmentQueryRequest *request = requests + i;
+		struct SegmentQueryContext context = {request->start, request->end, request->radius, request->filter, NULL};
+		contexts[i] = context;
+		
+		cpSegmentQueryInfo info = {NULL, request->end, cpvzero, 1.0f};
+		results[i] = info;
+	}
+	
+	int *order = (int *)cpcalloc(count, sizeof(int));
+	int packetCount = SortSegments(requests, count, order);
+	
+	// Only the trees can be queried from several threads at once.
+	cpThreadPool *pool = space->threadPool;
+	cpBool threaded = (
+		pool && count >= THREADED_BATCH_THRESHOLD &&
+		cpSpatialIndexIsBBTree(space->staticShapes) && cpSpatialIndexIsBBTree(space->dynamicShapes)
+	);
+	
+	SegmentQueryBatch batch = {space, results, contexts, order, count, packetCount, (threaded ? cpThreadPoolGetThreads(pool) : 1)};
+	cpThreadPoolRun((threaded ? pool : NULL), (cpThreadPoolWorkFunc)SegmentQueryPackets, &batch);
+	
+	cpfree(order);
+	cpfree(contexts);
+}
+
 //MARK: BB Query Functions
 
 struct BBQueryContext {
@@ -204,6 +355,7 @@ cpSpaceBBQuery(cpSpace *space, cpBB bb, cpShapeFilter filter, cpSpaceBBQueryFunc
 	cpSpaceLock(space); {
     cpSpatialIndexQuery(space->dynamicShapes, &context, bb, (cpSpatialIndexQueryFunc)BBQuery, data);
     cpSpatialIndexQuery(space->staticShapes, &context, bb, (cpSpatialIndexQueryFunc)BBQuery, data);
+    cpSpatialIndexQuery(space->sleepingShapes, &context, bb, (cpSpatialIndexQueryFunc)BBQuery, data);
 	} cpSpaceUnlock(space, cpTrue);
 }
 
@@ -240,6 +392,7 @@ cpSpaceShapeQuery(cpSpace *space, cpShape *shape, cpSpaceShapeQueryFunc func, vo
 	cpSpaceLock(space); {
     cpSpatialIndexQuery(space->dynamicShapes, shape, bb, (cpSpatialIndexQueryFunc)ShapeQuery, &context);
     cpSpatialIndexQuery(space->staticShapes, shape, bb, (cpSpatialIndexQueryFunc)ShapeQuery, &context);
+    cpSpatialIndexQuery(space->sleepingShapes, shape, bb, (cpSpatialIndexQueryFunc)ShapeQuery, &context);
 	} cpSpaceUnlock(space, cpTrue);
 	
 	return context.anyCollision;
@@ -0,0 +1,1277 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "chipmunk/chipmunk_private.h"
+#include "chipmunk/cpSpaceSnapshot.h"
+
+// Snapshots are a sequence of sections, each written and read in the same order:
+// header, space properties, bodies with their shapes, constraints, arbiters, and the three spatial indexes.
+// Bodies are referred to by their position in the snapshot, shapes by their hashid.
+
+#define SNAPSHOT_MAGIC 0x70616e73
+#define SNAPSHOT_VERSION 4
+
+#define WRITE_FIELD(__writer__, __field__) cpSnapshotWrite(__writer__, &(__field__), sizeof(__field__))
+#define READ_FIELD(__reader__, __field__) cpSnapshotRead(__reader__, &(__field__), sizeof(__field__))
+
+// Runs of cpFloat fields are copied in one go. They must be declared in order from first to last with no padding between.
+#define RANGE_SIZE(__obj__, __first__, __last__) ((size_t)((const uint8_t *)(&(__obj__)->__last__ + 1) - (const uint8_t *)&(__obj__)->__first__))
+#define WRITE_RANGE(__writer__, __obj__, __first__, __last__) cpSnapshotWrite(__writer__, &(__obj__)->__first__, RANGE_SIZE(__obj__, __first__, __last__))
+#define READ_RANGE(__reader__, __obj__, __first__, __last__) cpSnapshotRead(__reader__, &(__obj__)->__first__, RANGE_SIZE(__obj__, __first__, __last__))
+
+// Raw pointers are only meaningful in the process that wrote them, so snapshots are stamped with a token for the process.
+// Addresses alone can't tell processes apart, a binary without PIE or run with ASLR disabled reuses them every run.
+// The process id and the time can't both repeat, and the addresses add whatever randomization the platform has.
+static uint64_t ProcessToken = 0;
+static pthread_once_t ProcessTokenOnce = PTHREAD_ONCE_INIT;
+
+// The splitmix64 finalizer.
+static inline uint64_t
+MixBits(uint64_t x)
+{
+	x = (x ^ (x >> 30))*0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27))*0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static void
+MakeProcessToken(void)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	
+	uint8_t stackMarker = 0;
+	void *heapMarker = cpcalloc(1, 1);
+	
+	uint64_t token = MixBits((uint64_t)now.tv_sec);
+	token = MixBits(token ^ (uint64_t)now.tv_usec);
+	token = MixBits(token ^ (uint64_t)getpid());
+	token = MixBits(token ^ (uint64_t)(uintptr_t)&stackMarker);
+	token = MixBits(token ^ (uint64_t)(uintptr_t)heapMarker);
+	token = MixBits(token ^ (uint64_t)(uintptr_t)&ProcessToken);
+	cpfree(heapMarker);
+	
+	ProcessToken = token;
+}
+
+static uint64_t
+GetProcessToken(void)
+{
+	pthread_once(&ProcessTokenOnce, MakeProcessToken);
+	return ProcessToken;
+}
+
+typedef enum SnapshotConstraintType {
+	PIN_JOINT,
+	SLIDE_JOINT,
+	PIVOT_JOINT,
+	GROOVE_JOINT,
+	DAMPED_SPRING,
+	DAMPED_ROTARY_SPRING,
+	ROTARY_LIMIT_JOINT,
+	RATCHET_JOINT,
+	GEAR_JOINT,
+	SIMPLE_MOTOR,
+} SnapshotConstraintType;
+
+static void
+LayoutInfo(uint8_t *layout)
+{
+	layout[0] = sizeof(cpFloat);
+	layout[1] = sizeof(cpHashValue);
+	layout[2] = sizeof(cpCollisionType);
+	layout[3] = sizeof(cpGroup);
+	layout[4] = sizeof(cpBitmask);
+	layout[5] = sizeof(cpTimestamp);
+	layout[6] = sizeof(void *);
+	
+	uint16_t byteOrder = 1;
+	memcpy(layout + 7, &byteOrder, sizeof(byteOrder));
+}
+
+#define LAYOUT_BYTES 9
+
+//MARK: Index Maps
+
+// Numbers the constraints in the order they are added.
+// A flat open addressed table, it's filled and searched several times per object on every snapshot.
+typedef struct IndexMap {
+	void **keys;
+	uint32_t *indexes;
+	uint32_t mask;
+	
+	void **objects;
+	uint32_t count, capacity;
+} IndexMap;
+
+static void
+IndexMapInit(IndexMap *map, uint32_t capacity)
+{
+	// Keep the table at most half full.
+	uint32_t size = 16;
+	while(size < 2*capacity) size *= 2;
+	
+	map->keys = (void **)cpcalloc(size, sizeof(void *));
+	map->indexes = (uint32_t *)cpcalloc(size, sizeof(uint32_t));
+	map->mask = size - 1;
+	
+	map->objects = (void **)cpcalloc(capacity + 1, sizeof(void *));
+	map->count = 0;
+	map->capacity = capacity;
+}
+
+static void
+IndexMapDestroy(IndexMap *map)
+{
+	cpfree(map->keys);
+	cpfree(map->indexes);
+	cpfree(map->objects);
+}
+
+static inline uint32_t
+IndexMapSlot(IndexMap *map, void *ptr)
+{
+	cpHashValue hash = (cpHashValue)ptr*CP_HASH_COEF;
+	uint32_t slot = (uint32_t)(hash ^ (hash >> 16)) & map->mask;
+	
+	while(map->keys[slot] && map->keys[slot] != ptr) slot = (slot + 1) & map->mask;
+	return slot;
+}
+
+static void
+IndexMapAdd(IndexMap *map, void *ptr)
+{
+	uint32_t slot = IndexMapSlot(map, ptr);
+	if(map->keys[slot]) return;
+	
+	cpAssertHard(map->count < map->capacity, "Internal Error: Snapshot index map overflow.");
+	map->keys[slot] = ptr;
+	map->indexes[slot] = map->count;
+	map->objects[map->count++] = ptr;
+}
+
+static uint32_t
+IndexMapGet(IndexMap *map, void *ptr)
+{
+	uint32_t slot = IndexMapSlot(map, ptr);
+	cpAssertHard(map->keys[slot] == ptr, "Internal Error: Object missing from the snapshot.");
+	return map->indexes[slot];
+}
+
+// Arbiters are numbered by tagging them instead, there are many more of them.
+typedef struct ArbiterList {
+	cpArbiter **arr;
+	uint32_t count, capacity;
+} ArbiterList;
+
+static void
+ArbiterListPush(cpArbiter *arb, ArbiterList *list)
+{
+	cpAssertHard(list->count < list->capacity, "Internal Error: Snapshot arbiter list overflow.");
+	arb->tag = list->count;
+	list->arr[list->count++] = arb;
+}
+
+//MARK: Writing
+
+static cpHashValue ShapeID(cpShape *shape){return shape->hashid;}
+
+static inline void
+WriteBodyIndex(cpSnapshotWriter *writer, cpSpace *space, cpBody *body)
+{
+	int32_t index = -1;
+	if(body){
+		cpAssertHard(body->space == space, "Constraints and shapes must be attached to bodies added to the space to take a snapshot.");
+		index = (int32_t)body->solverTag;
+	}
+	
+	WRITE_FIELD(writer, index);
+}
+
+// Only the shape's own geometry and properties are saved.
+// The transformed geometry, bounds and mass info are recalculated from them when restoring.
+static void
+WriteShape(cpSnapshotWriter *writer, cpShape *shape)
+{
+	uint8_t type = shape->klass->type;
+	WRITE_FIELD(writer, type);
+	WRITE_FIELD(writer, shape->hashid);
+	
+	switch(type){
+		case CP_CIRCLE_SHAPE: {
+			cpCircleShape *circle = (cpCircleShape *)shape;
+			WRITE_FIELD(writer, circle->c);
+			WRITE_FIELD(writer, circle->r);
+			break;
+		}
+		case CP_SEGMENT_SHAPE: {
+			// The normal is saved since cpSegmentShapeSetEndpoints() flips it.
+			cpSegmentShape *seg = (cpSegmentShape *)shape;
+			WRITE_RANGE(writer, seg, a, n);
+			WRITE_RANGE(writer, seg, r, b_tangent);
+			break;
+		}
+		case CP_POLY_SHAPE: {
+			cpPolyShape *poly = (cpPolyShape *)shape;
+			uint32_t count = poly->count;
+			WRITE_FIELD(writer, count);
+			WRITE_FIELD(writer, poly->r);
+			
+			// The untransformed vertexes, the normals are recalculated from them.
+			struct cpSplittingPlane *planes = poly->planes + count;
+			for(uint32_t i=0; i<count; i++) WRITE_FIELD(writer, planes[i].v0);
+			break;
+		}
+		default: cpAssertHard(cpFalse, "Internal Error: Unknown shape type.");
+	}
+	
+	WRITE_FIELD(writer, shape->massInfo.m);
+	WRITE_FIELD(writer, shape->sensor);
+	WRITE_RANGE(writer, shape, e, surfaceV);
+	WRITE_FIELD(writer, shape->broadphaseMargin);
+	WRITE_FIELD(writer, shape->userData);
+	WRITE_FIELD(writer, shape->type);
+	WRITE_FIELD(writer, shape->filter);
+}
+
+static void
+WriteBody(cpSnapshotWriter *writer, cpSpace *space, cpBody *body)
+{
+	WRITE_FIELD(writer, body->velocity_func);
+	WRITE_FIELD(writer, body->position_func);
+	WRITE_FIELD(writer, body->userData);
+	
+	// Mass, moment, center of gravity, position, velocity, force, angle, angular velocity, torque,
+	// transform and the interpolation state. The transform is saved since continuous collision nudges it apart from the position.
+	WRITE_RANGE(writer, body, m, a_prev);
+	WRITE_RANGE(writer, body, v_bias, w_bias);
+	
+	WRITE_FIELD(writer, body->sleeping.idleTime);
+	WriteBodyIndex(writer, space, body->sleeping.root);
+	WriteBodyIndex(writer, space, body->sleeping.next);
+	WRITE_FIELD(writer, body->ccd);
+	
+	uint32_t count = 0;
+	CP_BODY_FOREACH_SHAPE(body, shape) count++;
+	WRITE_FIELD(writer, count);
+	
+	CP_BODY_FOREACH_SHAPE(body, shape) WriteShape(writer, shape);
+}
+
+static SnapshotConstraintType
+ConstraintType(cpConstraint *constraint)
+{
+	if(cpConstraintIsPinJoint(constraint)) return PIN_JOINT;
+	if(cpConstraintIsSlideJoint(constraint)) return SLIDE_JOINT;
+	if(cpConstraintIsPivotJoint(constraint)) return PIVOT_JOINT;
+	if(cpConstraintIsGrooveJoint(constraint)) return GROOVE_JOINT;
+	if(cpConstraintIsDampedSpring(constraint)) return DAMPED_SPRING;
+	if(cpConstraintIsDampedRotarySpring(constraint)) return DAMPED_ROTARY_SPRING;
+	if(cpConstraintIsRotaryLimitJoint(constraint)) return ROTARY_LIMIT_JOINT;
+	if(cpConstraintIsRatchetJoint(constraint)) return RATCHET_JOINT;
+	if(cpConstraintIsGearJoint(constraint)) return GEAR_JOINT;
+	if(cpConstraintIsSimpleMotor(constraint)) return SIMPLE_MOTOR;
+	
+	cpAssertHard(cpFalse, "Snapshots only support the built in constraint types.");
+	return PIN_JOINT;
+}
+
+// Only the parameters and the accumulated impulses are saved. Everything else is recalculated by preStep().
+static void
+WriteConstraint(cpSnapshotWriter *writer, cpSpace *space, cpConstraint *constraint)
+{
+	uint8_t type = ConstraintType(constraint);
+	WRITE_FIELD(writer, type);
+	
+	WriteBodyIndex(writer, space, constraint->a);
+	WriteBodyIndex(writer, space, constraint->b);
+	
+	WRITE_FIELD(writer, constraint->maxForce);
+	WRITE_FIELD(writer, constraint->errorBias);
+	WRITE_FIELD(writer, constraint->maxBias);
+	WRITE_FIELD(writer, constraint->collideBodies);
+	WRITE_FIELD(writer, constraint->preSolve);
+	WRITE_FIELD(writer, constraint->postSolve);
+	WRITE_FIELD(writer, constraint->userData);
+	
+	switch(type){
+		case PIN_JOINT: {
+			cpPinJoint *joint = (cpPinJoint *)constraint;
+			WRITE_FIELD(writer, joint->anchorA);
+			WRITE_FIELD(writer, joint->anchorB);
+			WRITE_FIELD(writer, joint->dist);
+			WRITE_FIELD(writer, joint->jnAcc);
+			break;
+		}
+		case SLIDE_JOINT: {
+			cpSlideJoint *joint = (cpSlideJoint *)constraint;
+			WRITE_FIELD(writer, joint->anchorA);
+			WRITE_FIELD(writer, joint->anchorB);
+			WRITE_FIELD(writer, joint->min);
+			WRITE_FIELD(writer, joint->max);
+			WRITE_FIELD(writer, joint->jnAcc);
+			break;
+		}
+		case PIVOT_JOINT: {
+			cpPivotJoint *joint = (cpPivotJoint *)constraint;
+			WRITE_FIELD(writer, joint->anchorA);
+			WRITE_FIELD(writer, joint->anchorB);
+			WRITE_FIELD(writer, joint->jAcc);
+			break;
+		}
+		case GROOVE_JOINT: {
+			cpGrooveJoint *joint = (cpGrooveJoint *)constraint;
+			WRITE_FIELD(writer, joint->grv_a);
+			WRITE_FIELD(writer, joint->grv_b);
+			WRITE_FIELD(writer, joint->grv_n);
+			WRITE_FIELD(writer, joint->anchorB);
+			WRITE_FIELD(writer, joint->jAcc);
+			break;
+		}
+		case DAMPED_SPRING: {
+			cpDampedSpring *spring = (cpDampedSpring *)constraint;
+			WRITE_FIELD(writer, spring->anchorA);
+			WRITE_FIELD(writer, spring->anchorB);
+			WRITE_FIELD(writer, spring->restLength);
+			WRITE_FIELD(writer, spring->stiffness);
+			WRITE_FIELD(writer, spring->damping);
+			WRITE_FIELD(writer, spring->springForceFunc);
+			WRITE_FIELD(writer, spring->jAcc);
+			break;
+		}
+		case DAMPED_ROTARY_SPRING: {
+			cpDampedRotarySpring *spring = (cpDampedRotarySpring *)constraint;
+			WRITE_FIELD(writer, spring->restAngle);
+			WRITE_FIELD(writer, spring->stiffness);
+			WRITE_FIELD(writer, spring->damping);
+			WRITE_FIELD(writer, spring->springTorqueFunc);
+			WRITE_FIELD(writer, spring->jAcc);
+			break;
+		}
+		case ROTARY_LIMIT_JOINT: {
+			cpRotaryLimitJoint *joint = (cpRotaryLimitJoint *)constraint;
+			WRITE_FIELD(writer, joint->min);
+			WRITE_FIELD(writer, joint->max);
+			WRITE_FIELD(writer, joint->jAcc);
+			break;
+		}
+		case RATCHET_JOINT: {
+			cpRatchetJoint *joint = (cpRatchetJoint *)constraint;
+			WRITE_FIELD(writer, joint->angle);
+			WRITE_FIELD(writer, joint->phase);
+			WRITE_FIELD(writer, joint->ratchet);
+			WRITE_FIELD(writer, joint->jAcc);
+			break;
+		}
+		case GEAR_JOINT: {
+			cpGearJoint *joint = (cpGearJoint *)constraint;
+			WRITE_FIELD(writer, joint->phase);
+			WRITE_FIELD(writer, joint->ratio);
+			WRITE_FIELD(writer, joint->ratio_inv);
+			WRITE_FIELD(writer, joint->jAcc);
+			break;
+		}
+		case SIMPLE_MOTOR: {
+			cpSimpleMotor *motor = (cpSimpleMotor *)constraint;
+			WRITE_FIELD(writer, motor->rate);
+			WRITE_FIELD(writer, motor->jAcc);
+			break;
+		}
+	}
+}
+
+// Only the contact values that carry over to the next step are saved. The rest are recalculated by cpArbiterPreStep().
+static void
+WriteArbiter(cpSnapshotWriter *writer, cpArbiter *arb)
+{
+	WRITE_FIELD(writer, arb->a->hashid);
+	WRITE_FIELD(writer, arb->b->hashid);
+	
+	WRITE_RANGE(writer, arb, e, surface_vr);
+	WRITE_FIELD(writer, arb->data);
+	WRITE_FIELD(writer, arb->n);
+	
+	WRITE_FIELD(writer, arb->stamp);
+	uint8_t state = arb->state;
+	WRITE_FIELD(writer, state);
+	
+	WRITE_RANGE(writer, arb, reuseOffset, rot_b);
+	WRITE_FIELD(writer, arb->reuseCount);
+	
+	uint8_t count = arb->count;
+	WRITE_FIELD(writer, count);
+	
+	for(int i=0; i<count; i++){
+		struct cpContact *con = arb->contacts + i;
+		WRITE_RANGE(writer, con, r1, r2);
+		WRITE_RANGE(writer, con, jnAcc, jtAcc);
+		WRITE_FIELD(writer, con->hash);
+	}
+}
+
+static void
+WriteIndex(cpSnapshotWriter *writer, cpSpatialIndex *index)
+{
+	uint8_t isTree = cpSpatialIndexIsBBTree(index);
+	WRITE_FIELD(writer, isTree);
+	
+	// The size lets spaces that use a different kind of index skip the tree.
+	uint64_t size = 0;
+	uint8_t *sizeCursor = writer->cursor;
+	size_t start = writer->size;
+	WRITE_FIELD(writer, size);
+	
+	if(isTree){
+		cpBBTreeWriteSnapshot(index, (cpSnapshotIDFunc)ShapeID, writer);
+		
+		if(writer->cursor){
+			size = writer->size - start - sizeof(size);
+			memcpy(sizeCursor, &size, sizeof(size));
+		}
+	}
+}
+
+size_t
+cpSpaceWriteSnapshot(cpSpace *space, void *buffer, size_t capacity)
+{
+	cpAssertSpaceUnlocked(space);
+	cpSnapshotWriter writer = {(uint8_t *)buffer, (uint8_t *)buffer + (buffer ? capacity : 0), 0};
+	
+	uint32_t magic = SNAPSHOT_MAGIC, version = SNAPSHOT_VERSION;
+	uint8_t layout[LAYOUT_BYTES];
+	LayoutInfo(layout);
+	uint64_t process = GetProcessToken();
+	
+	WRITE_FIELD(&writer, magic);
+	WRITE_FIELD(&writer, version);
+	WRITE_FIELD(&writer, layout);
+	WRITE_FIELD(&writer, process);
+	
+	//MARK: Space
+	WRITE_FIELD(&writer, space->iterations);
+	WRITE_FIELD(&writer, space->gravity);
+	WRITE_FIELD(&writer, space->damping);
+	WRITE_FIELD(&writer, space->idleSpeedThreshold);
+	WRITE_FIELD(&writer, space->sleepTimeThreshold);
+	WRITE_FIELD(&writer, space->collisionSlop);
+	WRITE_FIELD(&writer, space->collisionBias);
+	WRITE_FIELD(&writer, space->collisionPersistence);
+	WRITE_FIELD(&writer, space->contactReuseThreshold);
+	WRITE_FIELD(&writer, space->contactReuseWindow);
+	WRITE_FIELD(&writer, space->broadphaseMargin);
+	WRITE_FIELD(&writer, space->broadphaseRelativeMargin);
+	WRITE_FIELD(&writer, space->broadphaseLookahead);
+	WRITE_FIELD(&writer, space->fixedTimeStep);
+	WRITE_FIELD(&writer, space->maxSubsteps);
+	WRITE_FIELD(&writer, space->stepAccumulator);
+	WRITE_FIELD(&writer, space->stamp);
+	WRITE_FIELD(&writer, space->curr_dt);
+	WRITE_FIELD(&writer, space->shapeIDCounter);
+	WRITE_FIELD(&writer, space->sleepingShapesAdded);
+	WRITE_FIELD(&writer, space->wakeSleepingArbiters);
+	
+	//MARK: Bodies
+	// The space's static body comes first, then the static, active and sleeping bodies.
+	// Bodies are numbered in this order and their shapes are written along with them.
+	cpArray *staticBodies = space->staticBodies, *dynamicBodies = space->dynamicBodies, *components = space->sleepingComponents;
+	
+	uint32_t bodyCount = 0, sleepingCount = 0, shapeCount = 0;
+	space->staticBody->solverTag = bodyCount++;
+	for(int i=0; i<staticBodies->num; i++) ((cpBody *)staticBodies->arr[i])->solverTag = bodyCount++;
+	for(int i=0; i<dynamicBodies->num; i++) ((cpBody *)dynamicBodies->arr[i])->solverTag = bodyCount++;
+	for(int i=0; i<components->num; i++){
+		CP_BODY_FOREACH_COMPONENT((cpBody *)components->arr[i], body){
+			body->solverTag = bodyCount++;
+			sleepingCount++;
+		}
+	}
+	
+	uint32_t staticCount = staticBodies->num, dynamicCount = dynamicBodies->num, componentCount = components->num;
+	WRITE_FIELD(&writer, staticCount);
+	WRITE_FIELD(&writer, dynamicCount);
+	WRITE_FIELD(&writer, sleepingCount);
+	
+	// Keep a list of the bodies in order for the per body lists below.
+	cpBody **bodies = (cpBody **)cpcalloc(bodyCount, sizeof(cpBody *));
+	uint32_t bodyIndex = 0;
+	bodies[bodyIndex++] = space->staticBody;
+	for(int i=0; i<staticBodies->num; i++) bodies[bodyIndex++] = (cpBody *)staticBodies->arr[i];
+	for(int i=0; i<dynamicBodies->num; i++) bodies[bodyIndex++] = (cpBody *)dynamicBodies->arr[i];
+	for(int i=0; i<components->num; i++){
+		CP_BODY_FOREACH_COMPONENT((cpBody *)components->arr[i], body) bodies[bodyIndex++] = body;
+	}
+	
+	for(uint32_t i=0; i<bodyCount; i++){
+		WriteBody(&writer, space, bodies[i]);
+		CP_BODY_FOREACH_SHAPE(bodies[i], shape) shapeCount++;
+	}
+	
+	WRITE_FIELD(&writer, componentCount);
+	for(int i=0; i<components->num; i++) WriteBodyIndex(&writer, space, (cpBody *)components->arr[i]);
+	
+	cpAssertHard(
+		(int)shapeCount == cpSpatialIndexCount(space->staticShapes) + cpSpatialIndexCount(space->dynamicShapes) + cpSpatialIndexCount(space->sleepingShapes),
+		"Every shape must be attached to a body added to the space to take a snapshot."
+	);
+	
+	//MARK: Constraints
+	// The active constraints come first in the order they are solved, then the ones that were put to sleep.
+	uint32_t constraintBound = space->constraints->num;
+	for(uint32_t i=bodyCount - sleepingCount; i<bodyCount; i++){
+		CP_BODY_FOREACH_CONSTRAINT(bodies[i], constraint) constraintBound++;
+	}
+	
+	IndexMap constraints;
+	IndexMapInit(&constraints, constraintBound);
+	for(int i=0; i<space->constraints->num; i++) IndexMapAdd(&constraints, space->constraints->arr[i]);
+	for(uint32_t i=bodyCount - sleepingCount; i<bodyCount; i++){
+		CP_BODY_FOREACH_CONSTRAINT(bodies[i], constraint) IndexMapAdd(&constraints, constraint);
+	}
+	
+	uint32_t activeConstraints = space->constraints->num;
+	WRITE_FIELD(&writer, constraints.count);
+	WRITE_FIELD(&writer, activeConstraints);
+	for(uint32_t i=0; i<constraints.count; i++) WriteConstraint(&writer, space, (cpConstraint *)constraints.objects[i]);
+	
+	// The order of each body's constraint list decides the order they are reactivated in.
+	for(uint32_t i=0; i<bodyCount; i++){
+		cpBody *body = bodies[i];
+		
+		uint32_t count = 0;
+		CP_BODY_FOREACH_CONSTRAINT(body, constraint) count++;
+		WRITE_FIELD(&writer, count);
+		
+		CP_BODY_FOREACH_CONSTRAINT(body, constraint){
+			uint32_t index = IndexMapGet(&constraints, constraint);
+			WRITE_FIELD(&writer, index);
+		}
+	}
+	
+	//MARK: Arbiters
+	// Cached arbiters come first, then the ones parked for sleeping bodies,
+	// and last the ones owned by sleeping bodies that keep their contacts in their own memory.
+	// Each arbiter is tagged with its index. Sleeping bodies share the arbiters they list, so those tags are cleared first.
+	ArbiterList arbiters = {NULL, 0, cpHashSetCount(space->cachedArbiters) + cpHashSetCount(space->sleepingArbiters)};
+	for(uint32_t i=bodyCount - sleepingCount; i<bodyCount; i++){
+		CP_BODY_FOREACH_ARBITER(bodies[i], arb){
+			arb->tag = UINT32_MAX;
+			arbiters.capacity++;
+		}
+	}
+	
+	arbiters.arr = (cpArbiter **)cpcalloc(arbiters.capacity + 1, sizeof(cpArbiter *));
+	cpHashSetEach(space->cachedArbiters, (cpHashSetIteratorFunc)ArbiterListPush, &arbiters);
+	uint32_t cachedCount = arbiters.count;
+	cpHashSetEach(space->sleepingArbiters, (cpHashSetIteratorFunc)ArbiterListPush, &arbiters);
+	uint32_t parkedCount = arbiters.count - cachedCount;
+	for(uint32_t i=bodyCount - sleepingCount; i<bodyCount; i++){
+		CP_BODY_FOREACH_ARBITER(bodies[i], arb){
+			if(arb->tag == UINT32_MAX) ArbiterListPush(arb, &arbiters);
+		}
+	}
+	
+	WRITE_FIELD(&writer, arbiters.count);
+	WRITE_FIELD(&writer, cachedCount);
+	WRITE_FIELD(&writer, parkedCount);
+	for(uint32_t i=0; i<arbiters.count; i++) WriteArbiter(&writer, arbiters.arr[i]);
+	
+	// The arbiters to be solved, in order.
+	uint32_t activeArbiters = space->arbiters->num;
+	WRITE_FIELD(&writer, activeArbiters);
+	for(int i=0; i<space->arbiters->num; i++) WRITE_FIELD(&writer, ((cpArbiter *)space->arbiters->arr[i])->tag);
+	
+	// The contact graph. Its order decides the order of the bodies in the sleeping components.
+	for(uint32_t i=0; i<bodyCount; i++){
+		cpBody *body = bodies[i];
+		
+		uint32_t count = 0;
+		CP_BODY_FOREACH_ARBITER(body, arb) count++;
+		WRITE_FIELD(&writer, count);
+		
+		CP_BODY_FOREACH_ARBITER(body, arb) WRITE_FIELD(&writer, arb->tag);
+	}
+	
+	IndexMapDestroy(&constraints);
+	cpfree(arbiters.arr);
+	cpfree(bodies);
+	
+	//MARK: Spatial Indexes
+	WriteIndex(&writer, space->staticShapes);
+	WriteIndex(&writer, space->sleepingShapes);
+	WriteIndex(&writer, space->dynamicShapes);
+	
+	return writer.size;
+}
+
+//MARK: Restoring
+
+typedef struct RestoreContext {
+	cpSpace *space;
+	cpSnapshotReader *reader;
+	
+	// Raw pointers are only restored in the process that wrote them.
+	cpBool sameProcess;
+	
+	uint32_t bodyCount;
+	cpBody **bodies;
+	
+	// Shapes by hashid.
+	cpHashSet *shapes;
+	
+	uint32_t constraintCount;
+	cpConstraint **constraints;
+	
+	uint32_t arbiterCount;
+	cpArbiter **arbiters;
+} RestoreContext;
+
+static cpBool ShapeIDEql(cpHashValue *id, cpShape *shape){return (*id == shape->hashid);}
+static void *ShapeForID(cpHashValue id, cpHashSet *shapes){return cpHashSetFind(shapes, id, &id);}
+
+static cpBody *
+ReadBodyIndex(RestoreContext *context, cpBool allowNULL)
+{
+	int32_t index;
+	READ_FIELD(context->reader, index);
+	
+	if(index >= 0 && (uint32_t)index < context->bodyCount){
+		return context->bodies[index];
+	} else {
+		if(!allowNULL || index != -1) context->reader->ok = cpFalse;
+		return NULL;
+	}
+}
+
+static cpShape *
+ReadShape(RestoreContext *context, cpBody *body)
+{
+	cpSnapshotReader *reader = context->reader;
+	
+	uint8_t type;
+	cpHashValue hashid;
+	READ_FIELD(reader, type);
+	READ_FIELD(reader, hashid);
+	
+	cpShape *shape = NULL;
+	switch(type){
+		case CP_CIRCLE_SHAPE: {
+			cpVect c;
+			cpFloat r;
+			READ_FIELD(reader, c);
+			READ_FIELD(reader, r);
+			shape = cpCircleShapeNew(body, r, c);
+			break;
+		}
+		case CP_SEGMENT_SHAPE: {
+			cpVect a, b, n, aTangent, bTangent;
+			cpFloat r;
+			READ_FIELD(reader, a);
+			READ_FIELD(reader, b);
+			READ_FIELD(reader, n);
+			READ_FIELD(reader, r);
+			READ_FIELD(reader, aTangent);
+			READ_FIELD(reader, bTangent);
+			
+			cpSegmentShape *seg = (cpSegmentShape *)cpSegmentShapeNew(body, a, b, r);
+			seg->n = n;
+			seg->a_tangent = aTangent;
+			seg->b_tangent = bTangent;
+			
+			shape = (cpShape *)seg;
+			break;
+		}
+		case CP_POLY_SHAPE: {
+			uint32_t count = cpSnapshotReadCount(reader);
+			cpFloat r;
+			READ_FIELD(reader, r);
+			if(count < 1){
+				reader->ok = cpFalse;
+				return NULL;
+			}
+			
+			cpVect inlineVerts[CP_POLY_SHAPE_INLINE_ALLOC];
+			cpVect *verts = (count <= CP_POLY_SHAPE_INLINE_ALLOC ? inlineVerts : (cpVect *)cpcalloc(count, sizeof(cpVect)));
+			cpSnapshotRead(reader, verts, count*sizeof(cpVect));
+			
+			shape = (cpShape *)cpPolyShapeInitRaw(cpPolyShapeAlloc(), body, count, verts, r);
+			if(verts != inlineVerts) cpfree(verts);
+			break;
+		}
+		default: {
+			reader->ok = cpFalse;
+			return NULL;
+		}
+	}
+	
+	READ_FIELD(reader, shape->massInfo.m);
+	READ_FIELD(reader, shape->sensor);
+	READ_RANGE(reader, shape, e, surfaceV);
+	READ_FIELD(reader, shape->broadphaseMargin);
+	
+	cpDataPointer userData;
+	READ_FIELD(reader, userData);
+	if(context->sameProcess) shape->userData = userData;
+	
+	READ_FIELD(reader, shape->type);
+	READ_FIELD(reader, shape->filter);
+	
+	shape->hashid = hashid;
+	shape->space = context->space;
+	
+	// The body's transform was read before its shapes.
+	cpShapeUpdate(shape, body->transform);
+	
+	// Arbiters and spatial indexes refer to shapes by their hashid, so they must be unique.
+	if(cpHashSetInsert(context->shapes, hashid, &shape->hashid, NULL, shape) != shape) reader->ok = cpFalse;
+	
+	return shape;
+}
+
+static void
+ReadBody(RestoreContext *context, cpBody *body)
+{
+	cpSnapshotReader *reader = context->reader;
+	
+	cpBodyVelocityFunc velocityFunc;
+	cpBodyPositionFunc positionFunc;
+	cpDataPointer userData;
+	READ_FIELD(reader, velocityFunc);
+	READ_FIELD(reader, positionFunc);
+	READ_FIELD(reader, userData);
+	
+	if(context->sameProcess){
+		body->velocity_func = velocityFunc;
+		body->position_func = positionFunc;
+		body->userData = userData;
+	}
+	
+	READ_RANGE(reader, body, m, a_prev);
+	READ_RANGE(reader, body, v_bias, w_bias);
+	
+	READ_FIELD(reader, body->sleeping.idleTime);
+	body->sleeping.root = ReadBodyIndex(context, cpTrue);
+	body->sleeping.next = ReadBodyIndex(context, cpTrue);
+	READ_FIELD(reader, body->ccd);
+	
+	body->space = context->space;
+	
+	// Keep the shapes in the same order, the spatial indexes are rebuilt from the body lists if they can't be restored.
+	uint32_t count = cpSnapshotReadCount(reader);
+	cpShape *prev = NULL;
+	for(uint32_t i=0; i<count && reader->ok; i++){
+		cpShape *shape = ReadShape(context, body);
+		if(!shape) break;
+		
+		shape->prev = prev;
+		if(prev){
+			prev->next = shape;
+		} else {
+			body->shapeList = shape;
+		}
+		
+		prev = shape;
+	}
+}
+
+static cpConstraint *
+ReadConstraint(RestoreContext *context)
+{
+	cpSnapshotReader *reader = context->reader;
+	
+	uint8_t type;
+	READ_FIELD(reader, type);
+	cpBody *a = ReadBodyIndex(context, cpFalse);
+	cpBody *b = ReadBodyIndex(context, cpFalse);
+	if(!reader->ok || a == b){
+		reader->ok = cpFalse;
+		return NULL;
+	}
+	
+	// Create the constraint with placeholder values, they are overwritten below.
+	cpConstraint *constraint = NULL;
+	switch(type){
+		case PIN_JOINT: constraint = cpPinJointNew(a, b, cpvzero, cpvzero); break;
+		case SLIDE_JOINT: constraint = cpSlideJointNew(a, b, cpvzero, cpvzero, 0.0f, 0.0f); break;
+		case PIVOT_JOINT: constraint = cpPivotJointNew2(a, b, cpvzero, cpvzero); break;
+		case GROOVE_JOINT: constraint = cpGrooveJointNew(a, b, cpvzero, cpv(1.0f, 0.0f), cpvzero); break;
+		case DAMPED_SPRING: constraint = cpDampedSpringNew(a, b, cpvzero, cpvzero, 0.0f, 0.0f, 0.0f); break;
+		case DAMPED_ROTARY_SPRING: constraint = cpDampedRotarySpringNew(a, b, 0.0f, 0.0f, 0.0f); break;
+		case ROTARY_LIMIT_JOINT: constraint = cpRotaryLimitJointNew(a, b, 0.0f, 0.0f); break;
+		case RATCHET_JOINT: constraint = cpRatchetJointNew(a, b, 0.0f, 1.0f); break;
+		case GEAR_JOINT: constraint = cpGearJointNew(a, b, 0.0f, 1.0f); break;
+		case SIMPLE_MOTOR: constraint = cpSimpleMotorNew(a, b, 0.0f); break;
+		default: {
+			reader->ok = cpFalse;
+			return NULL;
+		}
+	}
+	
+	constraint->space = context->space;
+	
+	READ_FIELD(reader, constraint->maxForce);
+	READ_FIELD(reader, constraint->errorBias);
+	READ_FIELD(reader, constraint->maxBias);
+	READ_FIELD(reader, constraint->collideBodies);
+	
+	cpConstraintPreSolveFunc preSolve;
+	cpConstraintPostSolveFunc postSolve;
+	cpDataPointer userData;
+	READ_FIELD(reader, preSolve);
+	READ_FIELD(reader, postSolve);
+	READ_FIELD(reader, userData);
+	
+	if(context->sameProcess){
+		constraint->preSolve = preSolve;
+		constraint->postSolve = postSolve;
+		constraint->userData = userData;
+	}
+	
+	switch(type){
+		case PIN_JOINT: {
+			cpPinJoint *joint = (cpPinJoint *)constraint;
+			READ_FIELD(reader, joint->anchorA);
+			READ_FIELD(reader, joint->anchorB);
+			READ_FIELD(reader, joint->dist);
+			READ_FIELD(reader, joint->jnAcc);
+			break;
+		}
+		case SLIDE_JOINT: {
+			cpSlideJoint *joint = (cpSlideJoint *)constraint;
+			READ_FIELD(reader, joint->anchorA);
+			READ_FIELD(reader, joint->anchorB);
+			READ_FIELD(reader, joint->min);
+			READ_FIELD(reader, joint->max);
+			READ_FIELD(reader, joint->jnAcc);
+			break;
+		}
+		case PIVOT_JOINT: {
+			cpPivotJoint *joint = (cpPivotJoint *)constraint;
+			READ_FIELD(reader, joint->anchorA);
+			READ_FIELD(reader, joint->anchorB);
+			READ_FIELD(reader, joint->jAcc);
+			break;
+		}
+		case GROOVE_JOINT: {
+			cpGrooveJoint *joint = (cpGrooveJoint *)constraint;
+			READ_FIELD(reader, joint->grv_a);
+			READ_FIELD(reader, joint->grv_b);
+			READ_FIELD(reader, joint->grv_n);
+			READ_FIELD(reader, joint->anchorB);
+			READ_FIELD(reader, joint->jAcc);
+			break;
+		}
+		case DAMPED_SPRING: {
+			cpDampedSpring *spring = (cpDampedSpring *)constraint;
+			cpDampedSpringForceFunc springForceFunc;
+			READ_FIELD(reader, spring->anchorA);
+			READ_FIELD(reader, spring->anchorB);
+			READ_FIELD(reader, spring->restLength);
+			READ_FIELD(reader, spring->stiffness);
+			READ_FIELD(reader, spring->damping);
+			READ_FIELD(reader, springForceFunc);
+			READ_FIELD(reader, spring->jAcc);
+			if(context->sameProcess) spring->springForceFunc = springForceFunc;
+			break;
+		}
+		case DAMPED_ROTARY_SPRING: {
+			cpDampedRotarySpring *spring = (cpDampedRotarySpring *)constraint;
+			cpDampedRotarySpringTorqueFunc springTorqueFunc;
+			READ_FIELD(reader, spring->restAngle);
+			READ_FIELD(reader, spring->stiffness);
+			READ_FIELD(reader, spring->damping);
+			READ_FIELD(reader, springTorqueFunc);
+			READ_FIELD(reader, spring->jAcc);
+			if(context->sameProcess) spring->springTorqueFunc = springTorqueFunc;
+			break;
+		}
+		case ROTARY_LIMIT_JOINT: {
+			cpRotaryLimitJoint *joint = (cpRotaryLimitJoint *)constraint;
+			READ_FIELD(reader, joint->min);
+			READ_FIELD(reader, joint->max);
+			READ_FIELD(reader, joint->jAcc);
+			break;
+		}
+		case RATCHET_JOINT: {
+			cpRatchetJoint *joint = (cpRatchetJoint *)constraint;
+			READ_FIELD(reader, joint->angle);
+			READ_FIELD(reader, joint->phase);
+			READ_FIELD(reader, joint->ratchet);
+			READ_FIELD(reader, joint->jAcc);
+			break;
+		}
+		case GEAR_JOINT: {
+			cpGearJoint *joint = (cpGearJoint *)constraint;
+			READ_FIELD(reader, joint->phase);
+			READ_FIELD(reader, joint->ratio);
+			READ_FIELD(reader, joint->ratio_inv);
+			READ_FIELD(reader, joint->jAcc);
+			break;
+		}
+		case SIMPLE_MOTOR: {
+			cpSimpleMotor *motor = (cpSimpleMotor *)constraint;
+			READ_FIELD(reader, motor->rate);
+			READ_FIELD(reader, motor->jAcc);
+			break;
+		}
+	}
+	
+	return constraint;
+}
+
+// Parked and cached arbiters keep their contacts in the space's contact buffers,
+// arbiters owned by sleeping bodies keep them in their own memory like cpSpaceDeactivateBody() does.
+static cpArbiter *
+ReadArbiter(RestoreContext *context, cpBool owned)
+{
+	cpSnapshotReader *reader = context->reader;
+	cpSpace *space = context->space;
+	
+	cpHashValue idA, idB;
+	READ_FIELD(reader, idA);
+	READ_FIELD(reader, idB);
+	
+	cpShape *shape_pair[] = {(cpShape *)ShapeForID(idA, context->shapes), (cpShape *)ShapeForID(idB, context->shapes)};
+	if(!reader->ok || !shape_pair[0] || !shape_pair[1] || shape_pair[0]->body == shape_pair[1]->body){
+		reader->ok = cpFalse;
+		return NULL;
+	}
+	
+	cpArbiter *arb = (cpArbiter *)cpSpaceArbiterSetTrans(shape_pair, space);
+	cpArbiterLookupHandlers(arb, space);
+	
+	READ_RANGE(reader, arb, e, surface_vr);
+	
+	cpDataPointer data;
+	READ_FIELD(reader, data);
+	if(context->sameProcess) arb->data = data;
+	
+	READ_FIELD(reader, arb->n);
+	READ_FIELD(reader, arb->stamp);
+	
+	uint8_t state;
+	READ_FIELD(reader, state);
+	arb->state = (enum cpArbiterState)state;
+	
+	READ_RANGE(reader, arb, reuseOffset, rot_b);
+	READ_FIELD(reader, arb->reuseCount);
+	
+	uint8_t count;
+	READ_FIELD(reader, count);
+	if(count > CP_MAX_CONTACTS_PER_ARBITER){
+		reader->ok = cpFalse;
+		return arb;
+	}
+	
+	struct cpContact *contacts = NULL;
+	if(owned){
+		contacts = (struct cpContact *)cpcalloc(1, count*sizeof(struct cpContact));
+	} else {
+		contacts = cpContactBufferGetArray(space);
+		memset(contacts, 0, count*sizeof(struct cpContact));
+		cpSpacePushContacts(space, count);
+	}
+	
+	for(int i=0; i<count; i++){
+		struct cpContact *con = contacts + i;
+		READ_RANGE(reader, con, r1, r2);
+		READ_RANGE(reader, con, jnAcc, jtAcc);
+		READ_FIELD(reader, con->hash);
+	}
+	
+	arb->contacts = contacts;
+	arb->count = count;
+	
+	return arb;
+}
+
+static void
+InsertShapes(cpSpatialIndex *index, cpBody **bodies, uint32_t start, uint32_t end)
+{
+	for(uint32_t i=start; i<end; i++){
+		CP_BODY_FOREACH_SHAPE(bodies[i], shape) cpSpatialIndexInsert(index, shape, shape->hashid);
+	}
+}
+
+// Restore the index exactly when both spaces use a tree, otherwise skip it and reinsert the shapes.
+static void
+ReadIndex(RestoreContext *context, cpSpatialIndex *index, uint32_t start, uint32_t end)
+{
+	cpSnapshotReader *reader = context->reader;
+	
+	uint8_t isTree;
+	uint64_t size;
+	READ_FIELD(reader, isTree);
+	READ_FIELD(reader, size);
+	if(!reader->ok || size > (uint64_t)(reader->end - reader->cursor)){
+		reader->ok = cpFalse;
+		return;
+	}
+	
+	if(isTree && cpSpatialIndexIsBBTree(index)){
+		cpSnapshotReader tree = {reader->cursor, reader->cursor + size, cpTrue};
+		if(!cpBBTreeRestoreSnapshot(index, (cpSnapshotObjFunc)ShapeForID, context->shapes, &tree) || tree.cursor != tree.end){
+			reader->ok = cpFalse;
+		}
+	} else {
+		InsertShapes(index, context->bodies, start, end);
+	}
+	
+	reader->cursor += size;
+}
+
+static cpBool
+SpaceIsEmpty(cpSpace *space)
+{
+	return (
+		space->staticBodies->num == 0 && space->dynamicBodies->num == 0 && space->sleepingComponents->num == 0 &&
+		space->staticBody->shapeList == NULL && space->staticBody->constraintList == NULL &&
+		space->constraints->num == 0 && space->arbiters->num == 0 &&
+		cpHashSetCount(space->cachedArbiters) == 0 && cpHashSetCount(space->sleepingArbiters) == 0 &&
+		cpSpatialIndexCount(space->staticShapes) == 0 &&
+		cpSpatialIndexCount(space->dynamicShapes) == 0 &&
+		cpSpatialIndexCount(space->sleepingShapes) == 0
+	);
+}
+
+cpBool
+cpSpaceRestoreSnapshot(cpSpace *space, const void *buffer, size_t size)
+{
+	cpAssertSpaceUnlocked(space);
+	cpAssertHard(SpaceIsEmpty(space), "Snapshots can only be restored into an empty space.");
+	
+	cpSnapshotReader reader = {(const uint8_t *)buffer, (const uint8_t *)buffer + size, cpTrue};
+	
+	uint32_t magic, version;
+	uint8_t layout[LAYOUT_BYTES], expectedLayout[LAYOUT_BYTES];
+	uint64_t process;
+	READ_FIELD(&reader, magic);
+	READ_FIELD(&reader, version);
+	READ_FIELD(&reader, layout);
+	READ_FIELD(&reader, process);
+	
+	LayoutInfo(expectedLayout);
+	if(!reader.ok || magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION || memcmp(layout, expectedLayout, LAYOUT_BYTES) != 0){
+		return cpFalse;
+	}
+	
+	RestoreContext context = {space, &reader, (process == GetProcessToken()), 0, NULL, NULL, 0, NULL, 0, NULL};
+	
+	//MARK: Space
+	READ_FIELD(&reader, space->iterations);
+	READ_FIELD(&reader, space->gravity);
+	READ_FIELD(&reader, space->damping);
+	READ_FIELD(&reader, space->idleSpeedThreshold);
+	READ_FIELD(&reader, space->sleepTimeThreshold);
+	READ_FIELD(&reader, space->collisionSlop);
+	READ_FIELD(&reader, space->collisionBias);
+	READ_FIELD(&reader, space->collisionPersistence);
+	READ_FIELD(&reader, space->contactReuseThreshold);
+	READ_FIELD(&reader, space->contactReuseWindow);
+	READ_FIELD(&reader, space->broadphaseMargin);
+	READ_FIELD(&reader, space->broadphaseRelativeMargin);
+	READ_FIELD(&reader, space->broadphaseLookahead);
+	READ_FIELD(&reader, space->fixedTimeStep);
+	READ_FIELD(&reader, space->maxSubsteps);
+	READ_FIELD(&reader, space->stepAccumulator);
+	READ_FIELD(&reader, space->stamp);
+	READ_FIELD(&reader, space->curr_dt);
+	READ_FIELD(&reader, space->shapeIDCounter);
+	READ_FIELD(&reader, space->sleepingShapesAdded);
+	READ_FIELD(&reader, space->wakeSleepingArbiters);
+	cpSpaceUpdateBroadphaseMargins(space);
+	
+	// Restored contacts must outlive the ones they replace, so they go in a buffer stamped with the current step.
+	cpSpacePushFreshContactBuffer(space);
+	
+	//MARK: Bodies
+	uint32_t staticCount = cpSnapshotReadCount(&reader);
+	uint32_t dynamicCount = cpSnapshotReadCount(&reader);
+	uint32_t sleepingCount = cpSnapshotReadCount(&reader);
+	
+	uint64_t bodyCount = 1 + (uint64_t)staticCount + dynamicCount + sleepingCount;
+	if(!reader.ok || bodyCount > (uint64_t)(reader.end - reader.cursor)) return cpFalse;
+	
+	context.bodyCount = (uint32_t)bodyCount;
+	context.bodies = (cpBody **)cpcalloc(context.bodyCount, sizeof(cpBody *));
+	context.shapes = cpHashSetNew(0, (cpHashSetEqlFunc)ShapeIDEql);
+	
+	// Every body is created first so the sleeping components can refer to them.
+	context.bodies[0] = space->staticBody;
+	for(uint32_t i=1; i<context.bodyCount; i++){
+		cpBody *body = context.bodies[i] = cpBodyNew(0.0f, 0.0f);
+		
+		if(i <= staticCount){
+			cpArrayPush(space->staticBodies, body);
+		} else if(i <= staticCount + dynamicCount){
+			cpArrayPush(space->dynamicBodies, body);
+		}
+	}
+	
+	for(uint32_t i=0; i<context.bodyCount && reader.ok; i++) ReadBody(&context, context.bodies[i]);
+	
+	uint32_t componentCount = cpSnapshotReadCount(&reader);
+	for(uint32_t i=0; i<componentCount && reader.ok; i++){
+		cpArrayPush(space->sleepingComponents, ReadBodyIndex(&context, cpFalse));
+	}
+	
+	//MARK: Constraints
+	context.constraintCount = cpSnapshotReadCount(&reader);
+	uint32_t activeConstraints = cpSnapshotReadCount(&reader);
+	if(activeConstraints > context.constraintCount) reader.ok = cpFalse;
+	
+	context.constraints = (cpConstraint **)cpcalloc(context.constraintCount + 1, sizeof(cpConstraint *));
+	for(uint32_t i=0; i<context.constraintCount && reader.ok; i++){
+		cpConstraint *constraint = context.constraints[i] = ReadConstraint(&context);
+		if(constraint && i < activeConstraints) cpArrayPush(space->constraints, constraint);
+	}
+	
+	for(uint32_t i=0; i<context.bodyCount && reader.ok; i++){
+		cpBody *body = context.bodies[i];
+		uint32_t count = cpSnapshotReadCount(&reader);
+		
+		cpConstraint *prev = NULL;
+		for(uint32_t j=0; j<count && reader.ok; j++){
+			uint32_t index;
+			READ_FIELD(&reader, index);
+			
+			cpConstraint *constraint = (index < context.constraintCount ? context.constraints[index] : NULL);
+			if(!constraint || (constraint->a != body && constraint->b != body)){
+				reader.ok = cpFalse;
+				break;
+			}
+			
+			if(prev){
+				if(prev->a == body) prev->next_a = constraint; else prev->next_b = constraint;
+			} else {
+				body->constraintList = constraint;
+			}
+			
+			prev = constraint;
+		}
+	}
+	
+	//MARK: Arbiters
+	context.arbiterCount = cpSnapshotReadCount(&reader);
+	uint32_t cachedCount = cpSnapshotReadCount(&reader);
+	uint32_t parkedCount = cpSnapshotReadCount(&reader);
+	if((uint64_t)cachedCount + parkedCount > context.arbiterCount) reader.ok = cpFalse;
+	
+	context.arbiters = (cpArbiter **)cpcalloc(context.arbiterCount + 1, sizeof(cpArbiter *));
+	for(uint32_t i=0; i<context.arbiterCount && reader.ok; i++){
+		cpBool cached = (i < cachedCount), parked = (!cached && i < cachedCount + parkedCount);
+		cpArbiter *arb = context.arbiters[i] = ReadArbiter(&context, !cached && !parked);
+		
+		if(arb && (cached || parked)){
+			const cpShape *shape_pair[] = {arb->a, arb->b};
+			cpHashValue arbHashID = CP_ARBITER_HASH(arb->a, arb->b);
+			cpHashSetInsert((cached ? space->cachedArbiters : space->sleepingArbiters), arbHashID, shape_pair, NULL, arb);
+		}
+	}
+	
+	uint32_t activeArbiters = cpSnapshotReadCount(&reader);
+	for(uint32_t i=0; i<activeArbiters && reader.ok; i++){
+		uint32_t index;
+		READ_FIELD(&reader, index);
+		
+		if(index < context.arbiterCount){
+			cpArrayPush(space->arbiters, context.arbiters[index]);
+		} else {
+			reader.ok = cpFalse;
+		}
+	}
+	
+	for(uint32_t i=0; i<context.bodyCount && reader.ok; i++){
+		cpBody *body = context.bodies[i];
+		uint32_t count = cpSnapshotReadCount(&reader);
+		
+		cpArbiter *prev = NULL;
+		for(uint32_t j=0; j<count && reader.ok; j++){
+			uint32_t index;
+			READ_FIELD(&reader, index);
+			
+			cpArbiter *arb = (index < context.arbiterCount ? context.arbiters[index] : NULL);
+			if(!arb || (arb->body_a != body && arb->body_b != body)){
+				reader.ok = cpFalse;
+				break;
+			}
+			
+			cpArbiterThreadForBody(arb, body)->prev = prev;
+			if(prev){
+				cpArbiterThreadForBody(prev, body)->next = arb;
+			} else {
+				body->arbiterList = arb;
+			}
+			
+			prev = arb;
+		}
+	}
+	
+	//MARK: Spatial Indexes
+	// The dynamic tree's pairs refer to the static and sleeping leaves, so it's restored last.
+	uint32_t staticEnd = 1 + staticCount, dynamicEnd = staticEnd + dynamicCount;
+	if(reader.ok) ReadIndex(&context, space->staticShapes, 0, staticEnd);
+	if(reader.ok) ReadIndex(&context, space->sleepingShapes, dynamicEnd, context.bodyCount);
+	if(reader.ok) ReadIndex(&context, space->dynamicShapes, staticEnd, dynamicEnd);
+	
+	cpHashSetFree(context.shapes);
+	cpfree(context.bodies);
+	cpfree(context.constraints);
+	cpfree(context.arbiters);
+	
+	return (reader.ok && reader.cursor == reader.end);
+}
+
+//MARK: Checksum
+
+// 64 bit FNV-1a over the bit patterns of the body states.
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static void
+ChecksumFloat(uint64_t *hash, cpFloat f)
+{
+	uint8_t bytes[sizeof(cpFloat)];
+	memcpy(bytes, &f, sizeof(cpFloat));
+	
+	for(size_t i=0; i<sizeof(cpFloat); i++) (*hash) = ((*hash) ^ bytes[i])*FNV_PRIME;
+}
+
+static void
+ChecksumBody(cpBody *body, uint64_t *hash)
+{
+	ChecksumFloat(hash, body->p.x); ChecksumFloat(hash, body->p.y);
+	ChecksumFloat(hash, body->v.x); ChecksumFloat(hash, body->v.y);
+	ChecksumFloat(hash, body->a);
+	ChecksumFloat(hash, body->w);
+}
+
+uint64_t
+cpSpaceGetChecksum(cpSpace *space)
+{
+	uint64_t hash = FNV_OFFSET_BASIS;
+	cpSpaceEachBody(space, (cpSpaceBodyIteratorFunc)ChecksumBody, &hash);
+	
+	return hash;
+}
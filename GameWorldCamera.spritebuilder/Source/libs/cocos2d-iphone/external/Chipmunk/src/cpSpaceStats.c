@@ -0,0 +1,159 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "chipmunk/chipmunk_private.h"
+
+#include <string.h>
+
+#if defined(_WIN32)
+	#include <windows.h>
+#elif defined(__APPLE__)
+	#include <mach/mach_time.h>
+#else
+	#include <time.h>
+#endif
+
+double
+cpSpaceStatsTime(void)
+{
+#if defined(_WIN32)
+	static double period = 0.0;
+	if(period == 0.0){
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		period = 1.0/(double)frequency.QuadPart;
+	}
+	
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return period*(double)counter.QuadPart;
+#elif defined(__APPLE__)
+	static double period = 0.0;
+	if(period == 0.0){
+		mach_timebase_info_data_t timebase;
+		mach_timebase_info(&timebase);
+		period = 1e-9*(double)timebase.numer/(double)timebase.denom;
+	}
+	
+	return period*(double)mach_absolute_time();
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + 1e-9*(double)now.tv_nsec;
+#endif
+}
+
+#ifdef CP_SPACE_ENABLE_STEP_STATS
+
+//MARK: Recording
+
+void
+cpSpaceStatsBegin(cpSpace *space)
+{
+	space->stepStatsStart = space->stepStatsMark = cpSpaceStatsTime();
+}
+
+void
+cpSpaceStatsEnd(cpSpace *space)
+{
+	cpSpaceStepStats *stats = &space->stepStats;
+	stats->total = space->stepStatsMark - space->stepStatsStart;
+	
+	space->stepStatsWindow[space->stepStatsRecorded%CP_SPACE_STEP_STATS_WINDOW] = *stats;
+	space->stepStatsRecorded++;
+	
+	// Anything counted between steps, such as bodies woken up by the user, goes to the next step.
+	memset(stats, 0, sizeof(cpSpaceStepStats));
+}
+
+//MARK: Getters
+
+// Apply a macro to every field of cpSpaceStepStats.
+#define STEP_STATS_TIMES(__macro__) \
+	__macro__(total) __macro__(integratePositions) __macro__(collide) __macro__(components) __macro__(filterArbiters) \
+	__macro__(preStep) __macro__(integrateVelocities) __macro__(solve) __macro__(callbacks)
+
+#define STEP_STATS_COUNTERS(__macro__) \
+	__macro__(pairsTested) __macro__(falsePairs) __macro__(leavesReinserted) __macro__(narrowPhaseHits) __macro__(pairsReused) __macro__(arbiters) __macro__(contacts) __macro__(constraints) \
+	__macro__(islandsWoken) __macro__(islandsSlept)
+
+static inline int
+WindowCount(const cpSpace *space)
+{
+	unsigned int recorded = space->stepStatsRecorded;
+	return (recorded < CP_SPACE_STEP_STATS_WINDOW ? recorded : CP_SPACE_STEP_STATS_WINDOW);
+}
+
+void
+cpSpaceGetStepStats(const cpSpace *space, cpSpaceStepStats *stats)
+{
+	if(space->stepStatsRecorded > 0){
+		*stats = space->stepStatsWindow[(space->stepStatsRecorded - 1)%CP_SPACE_STEP_STATS_WINDOW];
+	} else {
+		memset(stats, 0, sizeof(cpSpaceStepStats));
+	}
+}
+
+int
+cpSpaceGetStepStatsWindow(const cpSpace *space, cpSpaceStepStats *mean, cpSpaceStepStats *max)
+{
+	int count = WindowCount(space);
+	
+	// Counters are summed in wider integers and rounded to the nearest.
+	cpSpaceStepStats sumTimes = {0}, maxStats = {0};
+	struct {
+		#define DECLARE_SUM(__field__) unsigned long long __field__;
+		STEP_STATS_COUNTERS(DECLARE_SUM)
+	} sumCounters = {0};
+	
+	for(int i=0; i<count; i++){
+		const cpSpaceStepStats *stats = &space->stepStatsWindow[i];
+		
+		#define ACCUMULATE_TIME(__field__) sumTimes.__field__ += stats->__field__; maxStats.__field__ = cpfmax(maxStats.__field__, stats->__field__);
+		STEP_STATS_TIMES(ACCUMULATE_TIME)
+		
+		#define ACCUMULATE_COUNTER(__field__) sumCounters.__field__ += stats->__field__; if(stats->__field__ > maxStats.__field__) maxStats.__field__ = stats->__field__;
+		STEP_STATS_COUNTERS(ACCUMULATE_COUNTER)
+	}
+	
+	if(mean){
+		memset(mean, 0, sizeof(cpSpaceStepStats));
+		
+		if(count > 0){
+			#define MEAN_TIME(__field__) mean->__field__ = sumTimes.__field__/count;
+			STEP_STATS_TIMES(MEAN_TIME)
+			
+			#define MEAN_COUNTER(__field__) mean->__field__ = (unsigned int)((sumCounters.__field__ + count/2)/count);
+			STEP_STATS_COUNTERS(MEAN_COUNTER)
+		}
+	}
+	
+	if(max) *max = maxStats;
+	return count;
+}
+
+void
+cpSpaceResetStepStats(cpSpace *space)
+{
+	space->stepStatsRecorded = 0;
+}
+
+#endif
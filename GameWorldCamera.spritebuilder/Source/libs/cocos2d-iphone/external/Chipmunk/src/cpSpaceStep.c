@@ -121,7 +121,7 @@ typedef struct cpContactBuffer {
 static cpContactBufferHeader *
 cpSpaceAllocContactBuffer(cpSpace *space)
 {
-	cpContactBuffer *buffer = (cpContactBuffer *)cpcalloc(1, sizeof(cpContactBuffer));
+	cpContactBuffer *buffer = (cpContactBuffer *)cpAllocatorAlloc(space->allocator, CP_BUFFER_BYTES);
 	cpArrayPush(space->allocatedBuffers, buffer);
 	return (cpContactBufferHeader *)buffer;
 }
@@ -184,7 +184,7 @@ cpSpacePopContacts(cpSpace *space, int count){
 
 //MARK: Collision Detection Functions
 
-static void *
+void *
 cpSpaceArbiterSetTrans(cpShape **shapes, cpSpace *space)
 {
 	if(space->pooledArbiters->num == 0){
@@ -192,7 +192,7 @@ cpSpaceArbiterSetTrans(cpShape **shapes, cpSpace *space)
 		int count = CP_BUFFER_BYTES/sizeof(cpArbiter);
 		cpAssertHard(count, "Internal Error: Buffer size too small.");
 		
-		cpArbiter *buffer = (cpArbiter *)cpcalloc(1, CP_BUFFER_BYTES);
+		cpArbiter *buffer = (cpArbiter *)cpAllocatorAlloc(space->allocator, CP_BUFFER_BYTES);
 		cpArrayPush(space->allocatedBuffers, buffer);
 		
 		for(int i=0; i<count; i++) cpArrayPush(space->pooledArbiters, buffer + i);
@@ -220,10 +220,8 @@ static inline cpBool
 QueryReject(cpShape *a, cpShape *b)
 {
 	return (
-		// BBoxes must overlap
-		!cpBBIntersects(a->bb, b->bb)
 		// Don't collide shapes attached to the same body.
-		|| a->body == b->body
+		a->body == b->body
 		// Don't collide shapes that are filtered.
 		|| cpShapeFilterReject(a->filter, b->filter)
 		// Don't collide bodies if they have a constraint with collideBodies == cpFalse.
@@ -231,26 +229,116 @@ QueryReject(cpShape *a, cpShape *b)
 	);
 }
 
+// Offset and rotation of body b in body a's frame.
+static inline void
+RelativeTransform(const cpBody *a, const cpBody *b, cpVect *offset, cpVect *rot)
+{
+	cpVect rot_a = cpBodyGetRotation(a);
+	(*offset) = cpvunrotate(cpvsub(b->p, a->p), rot_a);
+	(*rot) = cpvunrotate(cpBodyGetRotation(b), rot_a);
+}
+
+// Check if the arbiter's contacts from the last step are close enough to the current positions of the bodies to use again.
+static cpBool
+ArbiterCanReuseContacts(cpArbiter *arb, cpSpace *space)
+{
+	// Only arbiters that were solved on the last step have contacts to reuse.
+	if(arb->stamp != space->stamp - 1 || arb->state != CP_ARBITER_STATE_NORMAL || arb->count == 0) return cpFalse;
+	if(arb->reuseCount >= space->contactReuseWindow) return cpFalse;
+	
+	cpVect offset, rot;
+	RelativeTransform(arb->body_a, arb->body_b, &offset, &rot);
+	
+	// The relative rotation moves a point at radius r on body b by r*|rot - 1|.
+	cpFloat radius = 0.0f;
+	for(int i=0; i<arb->count; i++) radius = cpfmax(radius, cpvlength(arb->contacts[i].r2));
+	
+	cpVect deltaRot = cpvunrotate(rot, arb->reuseRot);
+	cpFloat drift = cpvdist(offset, arb->reuseOffset) + radius*cpvdist(deltaRot, cpv(1.0f, 0.0f));
+	return (drift < space->contactReuseThreshold);
+}
+
+// Move the arbiter's contacts along with the bodies and copy them into the contact buffer.
+// The result looks like the output of cpCollide() so cpArbiterUpdate() keeps the cached impulses.
+static struct cpCollisionInfo
+ArbiterReuseContacts(cpArbiter *arb, cpCollisionID id, struct cpContact *contacts)
+{
+	cpBody *a = arb->body_a, *b = arb->body_b;
+	cpVect rot_a = cpvunrotate(cpBodyGetRotation(a), arb->rot_a);
+	cpVect rot_b = cpvunrotate(cpBodyGetRotation(b), arb->rot_b);
+	
+	struct cpCollisionInfo info = {arb->a, arb->b, id, cpvrotate(arb->n, rot_a), arb->count, contacts};
+	
+	for(int i=0; i<arb->count; i++){
+		struct cpContact *old = &arb->contacts[i];
+		struct cpContact *con = &contacts[i];
+		
+		// Like cpCollide(), store absolute points.
+		con->r1 = cpvadd(a->p, cpvrotate(old->r1, rot_a));
+		con->r2 = cpvadd(b->p, cpvrotate(old->r2, rot_b));
+		con->hash = old->hash;
+	}
+	
+	return info;
+}
+
 // Callback from the spatial hash.
 cpCollisionID
 cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
 {
+	cpSpaceStatsCount(space, pairsTested, 1);
+	
+	// BBoxes must overlap. Pairs that don't are only found because of the broadphase margins.
+	if(!cpBBIntersects(a->bb, b->bb)){
+		cpSpaceStatsCount(space, falsePairs, 1);
+		return id;
+	}
+	
 	// Reject any of the simple cases
 	if(QueryReject(a,b)) return id;
 	
-	// Narrow-phase collision detection.
-	struct cpCollisionInfo info = cpCollide(a, b, id, cpContactBufferGetArray(space));
+	const cpShape *shape_pair[] = {a, b};
+	cpHashValue arbHashID = CP_ARBITER_HASH(a, b);
+	cpArbiter *arb = NULL;
+	struct cpCollisionInfo info;
+	
+	// Resting contacts can skip the narrow-phase and reuse the last step's contacts.
+	// Those are still in the contact buffers as long as collisionPersistence is at least 1.
+	cpBool reused = cpFalse;
+	if(space->contactReuseThreshold > 0.0f && space->collisionPersistence > 0){
+		arb = (cpArbiter *)cpHashSetFind(space->cachedArbiters, arbHashID, shape_pair);
+		reused = (arb && ArbiterCanReuseContacts(arb, space));
+	}
 	
-	if(info.count == 0) return info.id; // Shapes are not colliding.
-	cpSpacePushContacts(space, info.count);
+	if(reused){
+		info = ArbiterReuseContacts(arb, id, cpContactBufferGetArray(space));
+		cpSpacePushContacts(space, info.count);
+		cpSpaceStatsCount(space, pairsReused, 1);
+	} else {
+		// Narrow-phase collision detection.
+		info = cpCollide(a, b, id, cpContactBufferGetArray(space));
+		
+		if(info.count == 0) return info.id; // Shapes are not colliding.
+		cpSpacePushContacts(space, info.count);
+		cpSpaceStatsCount(space, narrowPhaseHits, 1);
+		
+		// Get an arbiter from space->arbiterSet for the two shapes.
+		// This is where the persistant contact magic comes from.
+		arb = (cpArbiter *)cpHashSetInsert(space->cachedArbiters, arbHashID, shape_pair, (cpHashSetTransFunc)cpSpaceArbiterSetTrans, space);
+	}
 	
-	// Get an arbiter from space->arbiterSet for the two shapes.
-	// This is where the persistant contact magic comes from.
-	const cpShape *shape_pair[] = {info.a, info.b};
-	cpHashValue arbHashID = CP_HASH_PAIR((cpHashValue)info.a, (cpHashValue)info.b);
-	cpArbiter *arb = (cpArbiter *)cpHashSetInsert(space->cachedArbiters, arbHashID, shape_pair, (cpHashSetTransFunc)cpSpaceArbiterSetTrans, space);
 	cpArbiterUpdate(arb, &info, space);
 	
+	if(reused){
+		arb->reuseCount++;
+	} else {
+		RelativeTransform(arb->body_a, arb->body_b, &arb->reuseOffset, &arb->reuseRot);
+		arb->reuseCount = 0;
+	}
+	
+	arb->rot_a = cpBodyGetRotation(arb->body_a);
+	arb->rot_b = cpBodyGetRotation(arb->body_b);
+	
 	cpCollisionHandler *handler = arb->handler;
 	
 	// Call the begin function first if it's the first step
@@ -271,6 +359,7 @@ cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
 		!(a->body->m == INFINITY && b->body->m == INFINITY)
 	){
 		cpArrayPush(space->arbiters, arb);
+		cpSpaceStatsCount(space, contacts, info.count);
 	} else {
 		cpSpacePopContacts(space, info.count);
 		
@@ -287,22 +376,37 @@ cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
 	return info.id;
 }
 
+static inline cpBool
+ArbiterIsAsleep(cpArbiter *arb)
+{
+	cpBody *a = arb->body_a, *b = arb->body_b;
+	
+	return (
+		(cpBodyGetType(a) == CP_BODY_TYPE_STATIC || cpBodyIsSleeping(a)) &&
+		(cpBodyGetType(b) == CP_BODY_TYPE_STATIC || cpBodyIsSleeping(b))
+	);
+}
+
 // Hashset filter func to throw away old arbiters.
 cpBool
 cpSpaceArbiterSetFilter(cpArbiter *arb, cpSpace *space)
 {
 	cpTimestamp ticks = space->stamp - arb->stamp;
 	
-	cpBody *a = arb->body_a, *b = arb->body_b;
-	
 	// TODO: should make an arbiter state for this so it doesn't require filtering arbiters for dangling body pointers on body removal.
 	// Preserve arbiters on sensors and rejected arbiters for sleeping objects.
 	// This prevents errant separate callbacks from happenening.
-	if(
-		(cpBodyGetType(a) == CP_BODY_TYPE_STATIC || cpBodyIsSleeping(a)) &&
-		(cpBodyGetType(b) == CP_BODY_TYPE_STATIC || cpBodyIsSleeping(b))
-	){
-		return cpTrue;
+	// They are parked in the sleeping arbiter set so they aren't filtered again every step.
+	if(ArbiterIsAsleep(arb)){
+		// Parked arbiters can wait any number of steps, but the contact buffers are reused after collisionPersistence steps.
+		arb->contacts = NULL;
+		arb->count = 0;
+		
+		const cpShape *shape_pair[] = {arb->a, arb->b};
+		cpHashValue arbHashID = CP_ARBITER_HASH(arb->a, arb->b);
+		cpHashSetInsert(space->sleepingArbiters, arbHashID, shape_pair, NULL, arb);
+		
+		return cpFalse;
 	}
 	
 	// Arbiter was used last frame, but not this one
@@ -323,24 +427,243 @@ cpSpaceArbiterSetFilter(cpArbiter *arb, cpSpace *space)
 	return cpTrue;
 }
 
+// Hashset filter func to move arbiters of bodies that woke up back into the arbiter cache.
+static cpBool
+SleepingArbiterSetFilter(cpArbiter *arb, cpSpace *space)
+{
+	if(ArbiterIsAsleep(arb)) return cpTrue;
+	
+	const cpShape *shape_pair[] = {arb->a, arb->b};
+	cpHashValue arbHashID = CP_ARBITER_HASH(arb->a, arb->b);
+	cpHashSetInsert(space->cachedArbiters, arbHashID, shape_pair, NULL, arb);
+	
+	return cpFalse;
+}
+
+//MARK: Continuous Collision Detection
+
+// Bisection steps used to narrow down the time of impact once an overlapping position is found.
+#define SWEEP_BISECTIONS 8
+// Most positions a shape is tested at along its sweep against each other shape.
+// Sweeps much longer than the shape is thick take larger steps, so very thin shapes might be missed.
+#define SWEEP_MAX_STEPS 64
+
+// Radius of the smallest circle around the center of gravity that holds the shape at any rotation.
+// Also returns the radius of the largest circle that fits inside the shape in @c core.
+static cpFloat
+ShapeSweepRadius(const cpShape *shape, cpFloat *core)
+{
+	// The shape's vertexes are relative to the body's origin, but it's swept along the path of the center of gravity.
+	cpVect cog = shape->body->cog;
+	
+	switch(shape->klass->type){
+		case CP_CIRCLE_SHAPE: {
+			const cpCircleShape *circle = (cpCircleShape *)shape;
+			(*core) = circle->r;
+			return cpvdist(circle->c, cog) + circle->r;
+		} case CP_SEGMENT_SHAPE: {
+			const cpSegmentShape *seg = (cpSegmentShape *)shape;
+			(*core) = seg->r;
+			return cpfmax(cpvdist(seg->a, cog), cpvdist(seg->b, cog)) + seg->r;
+		} case CP_POLY_SHAPE: {
+			const cpPolyShape *poly = (cpPolyShape *)shape;
+			int count = poly->count;
+			// The untransformed planes are stored after the transformed ones.
+			const struct cpSplittingPlane *planes = poly->planes + count;
+			
+			// The inner radius is zero when the center of gravity is outside of the poly.
+			cpFloat inner = INFINITY, outer = 0.0f;
+			for(int i=0; i<count; i++){
+				inner = cpfmin(inner, cpvdot(planes[i].n, cpvsub(planes[i].v0, cog)));
+				outer = cpfmax(outer, cpvdist(planes[i].v0, cog));
+			}
+			
+			(*core) = cpfmax(inner, 0.0f) + poly->r;
+			return outer + poly->r;
+		} default: {
+			(*core) = 0.0f;
+			return 0.0f;
+		}
+	}
+}
+
+struct SweepContext {
+	cpShape *shape;
+	// Transform of the shape's body at the end of the sweep.
+	cpTransform transform;
+	// Center of gravity at the start and end of the sweep.
+	cpVect start, end;
+	cpFloat radius, core;
+	// Bounds of the bounding circle at the start of the sweep.
+	cpBB bb;
+};
+
+// Move the sweeping shape to @c alpha along its sweep and collide it with @c other.
+static struct cpCollisionInfo
+SweepCollide(struct SweepContext *context, cpShape *other, cpFloat alpha, struct cpContact *contacts)
+{
+	cpTransform t = context->transform;
+	cpVect delta = cpvmult(cpvsub(context->end, context->start), alpha - 1.0f);
+	t.tx += delta.x;
+	t.ty += delta.y;
+	cpShapeUpdate(context->shape, t);
+	
+	return cpCollide(context->shape, other, 0, contacts);
+}
+
+static inline cpBool
+SweepOverlaps(struct SweepContext *context, cpShape *other, cpFloat alpha)
+{
+	struct cpContact contacts[CP_MAX_CONTACTS_PER_ARBITER];
+	return (SweepCollide(context, other, alpha, contacts).count > 0);
+}
+
+// The swept bounds are queried instead of the swept line since spatial indexes only test a segment query's center line.
+static cpCollisionID
+SweepQuery(struct SweepContext *context, cpShape *other, cpCollisionID id, cpFloat *alpha)
+{
+	cpShape *shape = context->shape;
+	if(
+		other->body == shape->body || other->sensor ||
+		cpShapeFilterReject(other->filter, shape->filter) ||
+		QueryRejectConstraint(other->body, shape->body)
+	) return id;
+	
+	cpVect delta = cpvsub(context->end, context->start);
+	cpFloat first, last;
+	
+	if(cpBBIntersects(context->bb, other->bb)){
+		// Segment queries don't report shapes the bounding circle starts inside of, so check those directly.
+		struct cpContact contacts[CP_MAX_CONTACTS_PER_ARBITER];
+		struct cpCollisionInfo info = SweepCollide(context, other, 0.0f, contacts);
+		
+		if(info.count > 0){
+			// Already touching, which is normally left to the regular collision detection.
+			// Hold the body in place if it would be pushed further into the other shape than it is thick.
+			cpVect n = (info.a == shape ? info.n : cpvneg(info.n));
+			if(cpvdot(delta, n) > context->core) (*alpha) = 0.0f;
+			
+			return id;
+		}
+		
+		first = 0.0f;
+	} else {
+		// The bounding circle can't touch the other shape before the shape itself does.
+		cpSegmentQueryInfo info;
+		if(!cpShapeSegmentQuery(other, context->start, context->end, context->radius, &info) || info.alpha >= (*alpha)) return id;
+		
+		first = info.alpha;
+	}
+	
+	// Nor can the shape touch it after the bounding circle has left it again.
+	cpSegmentQueryInfo exit;
+	last = (cpShapeSegmentQuery(other, context->end, context->start, context->radius, &exit) ? 1.0f - exit.alpha : 1.0f);
+	last = cpfmin(last, *alpha);
+	
+	// Step along the sweep no further than the shape is thick so that it can't skip over anything.
+	// Shapes with no thickness at all would never get anywhere, so the number of steps is capped too.
+	cpFloat step = cpfmax(context->core/cpvlength(delta), (last - first)/SWEEP_MAX_STEPS);
+	
+	for(cpFloat lo = first, hi; lo < last; lo = hi){
+		hi = cpfmin(lo + step, last);
+		// The step is too small to make progress this far along the sweep.
+		if(hi <= lo) break;
+		
+		if(!SweepOverlaps(context, other, hi)) continue;
+		
+		// Narrow down the first overlapping position.
+		for(int i=0; i<SWEEP_BISECTIONS; i++){
+			cpFloat mid = (lo + hi)*0.5f;
+			if(SweepOverlaps(context, other, mid)) hi = mid; else lo = mid;
+		}
+		
+		(*alpha) = hi;
+		break;
+	}
+	
+	return id;
+}
+
+// Stop a body that was just integrated from @c p at the first shape its shapes would have passed through.
+// The body is left slightly overlapping what it hit so the regular collision detection finds the contact.
+static void
+SweepBody(cpSpace *space, cpBody *body, cpVect p)
+{
+	// Shapes are swept with the body's final rotation along the path of its center of gravity.
+	cpVect start = p, end = body->p;
+	if(cpveql(start, end)) return;
+	
+	cpFloat alpha = 1.0f;
+	
+	CP_BODY_FOREACH_SHAPE(body, shape){
+		if(shape->sensor) continue;
+		
+		struct SweepContext context = {shape, body->transform, start, end};
+		context.radius = ShapeSweepRadius(shape, &context.core);
+		// Shapes with no thickness, like bare segments, are stepped along by the collision slop instead.
+		context.core = cpfmax(context.core, space->collisionSlop);
+		context.bb = cpBBNewForCircle(start, context.radius);
+		
+		cpBB bb = cpBBMerge(context.bb, cpBBNewForCircle(end, context.radius));
+		cpSpatialIndexQuery(space->staticShapes, &context, bb, (cpSpatialIndexQueryFunc)SweepQuery, &alpha);
+		cpSpatialIndexQuery(space->dynamicShapes, &context, bb, (cpSpatialIndexQueryFunc)SweepQuery, &alpha);
+		cpSpatialIndexQuery(space->sleepingShapes, &context, bb, (cpSpatialIndexQueryFunc)SweepQuery, &alpha);
+	}
+	
+	if(alpha < 1.0f){
+		body->p = cpvlerp(start, end, alpha);
+		
+		cpVect delta = cpvsub(body->p, end);
+		body->transform.tx += delta.x;
+		body->transform.ty += delta.y;
+	}
+	
+	// Sweeping left the shapes wherever they were last tested, so bodies swept after this one would collide with them there.
+	CP_BODY_FOREACH_SHAPE(body, shape) cpShapeUpdate(shape, body->transform);
+}
+
 //MARK: All Important cpSpaceStep() Function
 
+// The sleeping tree is rebuilt when more than 1/SLEEPING_REBUILD_RATIO of it was added incrementally.
+#define SLEEPING_REBUILD_RATIO 8
+#define SLEEPING_REBUILD_MIN 32
+
  void
 cpShapeUpdateFunc(cpShape *shape, void *unused)
 {
 	cpShapeCacheBB(shape);
 }
 
+void
+cpSpaceSolveImpulses(cpSpace *space, cpFloat dt)
+{
+	cpArray *arbiters = space->arbiters;
+	cpArray *constraints = space->constraints;
+	
+	for(int i=0; i<space->iterations; i++){
+		for(int j=0; j<arbiters->num; j++){
+			cpArbiterApplyImpulse((cpArbiter *)arbiters->arr[j]);
+		}
+			
+		for(int j=0; j<constraints->num; j++){
+			cpConstraint *constraint = (cpConstraint *)constraints->arr[j];
+			constraint->klass->applyImpulse(constraint, dt);
+		}
+	}
+}
+
 void
 cpSpaceStep(cpSpace *space, cpFloat dt)
 {
 	// don't step if the timestep is 0!
 	if(dt == 0.0f) return;
 	
+	cpSpaceStatsBegin(space);
 	space->stamp++;
 	
 	cpFloat prev_dt = space->curr_dt;
 	space->curr_dt = dt;
+	if(space->broadphaseLookahead > 0.0f) cpSpaceUpdateBroadphaseMargins(space);
 		
 	cpArray *bodies = space->dynamicBodies;
 	cpArray *constraints = space->constraints;
@@ -357,26 +680,61 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 		}
 	}
 	arbiters->num = 0;
+	
+	// Restore the parked arbiters of any bodies that were woken up before colliding them again.
+	if(space->wakeSleepingArbiters){
+		cpHashSetFilter(space->sleepingArbiters, (cpHashSetFilterFunc)SleepingArbiterSetFilter, space);
+		space->wakeSleepingArbiters = cpFalse;
+	}
+	cpSpaceStatsMark(space, filterArbiters);
 
 	cpSpaceLock(space); {
 		// Integrate positions
 		for(int i=0; i<bodies->num; i++){
 			cpBody *body = (cpBody *)bodies->arr[i];
-			body->position_func(body, dt);
+			
+			if(body->ccd && cpBodyGetType(body) == CP_BODY_TYPE_DYNAMIC){
+				cpVect p = body->p;
+				body->position_func(body, dt);
+				SweepBody(space, body, p);
+			} else {
+				body->position_func(body, dt);
+			}
 		}
+		cpSpaceStatsMark(space, integratePositions);
 		
 		// Find colliding pairs.
 		cpSpacePushFreshContactBuffer(space);
 		cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)cpShapeUpdateFunc, NULL);
+#ifdef CP_SPACE_ENABLE_STEP_STATS
+		unsigned long reinserts = cpBBTreeGetReinsertCount(space->dynamicShapes);
+#endif
 		cpSpatialIndexReindexQuery(space->dynamicShapes, (cpSpatialIndexQueryFunc)cpSpaceCollideShapes, space);
+		cpSpaceStatsCount(space, leavesReinserted, (unsigned int)(cpBBTreeGetReinsertCount(space->dynamicShapes) - reinserts));
+		
+		// Touching a sleeping shape wakes it up when the contact graph is rebuilt.
+		// Dynamic trees already find these collisions while reindexing.
+		if(!cpSpatialIndexIsBBTree(space->dynamicShapes)){
+			cpSpatialIndexCollideStatic(space->dynamicShapes, space->sleepingShapes, (cpSpatialIndexQueryFunc)cpSpaceCollideShapes, space);
+		}
 	} cpSpaceUnlock(space, cpFalse);
+	cpSpaceStatsMark(space, collide);
 	
 	// Rebuild the contact graph (and detect sleeping components if sleeping is enabled)
 	cpSpaceProcessComponents(space, dt);
 	
+	// Neighboring bodies tend to fall asleep together, which makes for a lopsided tree when they are inserted one by one.
+	// Rebuild the sleeping tree once a good part of it was added since the last time.
+	if(space->sleepingShapesAdded > SLEEPING_REBUILD_MIN && SLEEPING_REBUILD_RATIO*space->sleepingShapesAdded > cpSpatialIndexCount(space->sleepingShapes)){
+		cpBBTreeOptimize(space->sleepingShapes);
+		space->sleepingShapesAdded = 0;
+	}
+	cpSpaceStatsMark(space, components);
+	
 	cpSpaceLock(space); {
 		// Clear out old cached arbiters and call separate callbacks
 		cpHashSetFilter(space->cachedArbiters, (cpHashSetFilterFunc)cpSpaceArbiterSetFilter, space);
+		cpSpaceStatsMark(space, filterArbiters);
 
 		// Prestep the arbiters and constraints.
 		cpFloat slop = space->collisionSlop;
@@ -393,6 +751,7 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			
 			constraint->klass->preStep(constraint, dt);
 		}
+		cpSpaceStatsMark(space, preStep);
 	
 		// Integrate velocities.
 		cpFloat damping = cpfpow(space->damping, dt);
@@ -401,6 +760,7 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			cpBody *body = (cpBody *)bodies->arr[i];
 			body->velocity_func(body, gravity, damping, dt);
 		}
+		cpSpaceStatsMark(space, integrateVelocities);
 		
 		// Apply cached impulses
 		cpFloat dt_coef = (prev_dt == 0.0f ? 0.0f : dt/prev_dt);
@@ -414,16 +774,8 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 		}
 		
 		// Run the impulse solver.
-		for(int i=0; i<space->iterations; i++){
-			for(int j=0; j<arbiters->num; j++){
-				cpArbiterApplyImpulse((cpArbiter *)arbiters->arr[j]);
-			}
-				
-			for(int j=0; j<constraints->num; j++){
-				cpConstraint *constraint = (cpConstraint *)constraints->arr[j];
-				constraint->klass->applyImpulse(constraint, dt);
-			}
-		}
+		space->solveImpulses(space, dt);
+		cpSpaceStatsMark(space, solve);
 		
 		// Run the constraint post-solve callbacks
 		for(int i=0; i<constraints->num; i++){
@@ -441,4 +793,59 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			handler->postSolveFunc(arb, space, handler->userData);
 		}
 	} cpSpaceUnlock(space, cpTrue);
+	cpSpaceStatsMark(space, callbacks);
+	
+	cpSpaceStatsCount(space, arbiters, arbiters->num);
+	cpSpaceStatsCount(space, constraints, constraints->num);
+	cpSpaceStatsEnd(space);
+}
+
+int
+cpSpaceGetFixedStepCount(const cpSpace *space, cpFloat dt)
+{
+	cpAssertHard(dt >= 0.0f, "Frame time must not be negative.");
+	
+	// Count the same way cpSpaceStepFixed() steps so the rounding matches exactly.
+	cpFloat timeStep = space->fixedTimeStep;
+	cpFloat accumulator = space->stepAccumulator + dt;
+	
+	int steps = 0;
+	while(accumulator >= timeStep && steps < space->maxSubsteps){
+		accumulator -= timeStep;
+		steps++;
+	}
+	
+	return steps;
+}
+
+int
+cpSpaceStepFixed(cpSpace *space, cpFloat dt)
+{
+	cpFloat timeStep = space->fixedTimeStep;
+	int steps = cpSpaceGetFixedStepCount(space, dt);
+	space->stepAccumulator += dt;
+	
+	for(int i=0; i<steps; i++){
+		// Sleeping and static bodies don't move, so only the active ones need to remember where they were.
+		cpArray *bodies = space->dynamicBodies;
+		for(int j=0; j<bodies->num; j++){
+			cpBody *body = (cpBody *)bodies->arr[j];
+			body->p_prev = body->p;
+			body->a_prev = body->a;
+		}
+		
+		cpSpaceStep(space, timeStep);
+		space->stepAccumulator -= timeStep;
+	}
+	
+	// Drop the whole steps that didn't fit instead of falling further behind.
+	if(space->stepAccumulator >= timeStep) space->stepAccumulator = cpfmod(space->stepAccumulator, timeStep);
+	
+	return steps;
+}
+
+cpFloat
+cpSpaceGetStepAlpha(const cpSpace *space)
+{
+	return cpfclamp01(space->stepAccumulator/space->fixedTimeStep);
 }
@@ -36,6 +36,7 @@ cpSpatialIndexInit(cpSpatialIndex *index, cpSpatialIndexClass *klass, cpSpatialI
 	index->klass = klass;
 	index->bbfunc = bbfunc;
 	index->staticIndex = staticIndex;
+	index->allocator = NULL;
 	
 	if(staticIndex){
 		cpAssertHard(!staticIndex->dynamicIndex, "This static index is already associated with a dynamic index.");
@@ -45,6 +46,16 @@ cpSpatialIndexInit(cpSpatialIndex *index, cpSpatialIndexClass *klass, cpSpatialI
 	return index;
 }
 
+void
+cpSpatialIndexSetAllocator(cpSpatialIndex *index, const cpAllocator *allocator)
+{
+	index->allocator = allocator;
+	
+	cpBBTreeSetAllocator(index, allocator);
+	cpSpaceHashSetAllocator(index, allocator);
+	cpSweep2DSetAllocator(index, allocator);
+}
+
 typedef struct dynamicToStaticContext {
 	cpSpatialIndexBBFunc bbfunc;
 	cpSpatialIndex *staticIndex;
@@ -202,10 +202,18 @@ cpSweep1DSegmentQuery(cpSweep1D *sweep, void *obj, cpVect a, cpVect b, cpFloat t
 
 //MARK: Reindex/Query
 
-static int
-TableSort(TableCell *a, TableCell *b)
+// The table is nearly sorted from the last step, so an insertion sort is close to linear.
+// Unlike qsort() it's also stable, so cells with equal bounds keep the same order on every platform.
+static void
+TableSort(TableCell *table, int count)
 {
-	return (a->bounds.min < b->bounds.min ? -1 : (a->bounds.min > b->bounds.min ? 1 : 0));
+	for(int i=1; i<count; i++){
+		TableCell cell = table[i];
+		
+		int j = i;
+		for(; j>0 && table[j - 1].bounds.min > cell.bounds.min; j--) table[j] = table[j - 1];
+		table[j] = cell;
+	}
 }
 
 static void
@@ -216,7 +224,7 @@ cpSweep1DReindexQuery(cpSweep1D *sweep, cpSpatialIndexQueryFunc func, void *data
 	
 	// Update bounds and sort
 	for(int i=0; i<count; i++) table[i] = MakeTableCell(sweep, table[i].obj);
-	qsort(table, count, sizeof(TableCell), (int (*)(const void *, const void *))TableSort); // TODO: use insertion sort instead
+	TableSort(table, count);
 	
 	for(int i=0; i<count; i++){
 		TableCell cell = table[i];
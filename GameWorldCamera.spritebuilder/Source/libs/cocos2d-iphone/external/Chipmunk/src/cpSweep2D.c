@@ -0,0 +1,770 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+static inline cpSpatialIndexClass *Klass();
+
+// Rebuild from scratch when more than 1/REBUILD_PENDING_RATIO of the endpoints are new,
+// or when the insertion sort needs more than REBUILD_SWAP_RATIO swaps per endpoint (teleports).
+#define REBUILD_PENDING_RATIO 16
+#define REBUILD_SWAP_RATIO 2
+
+//MARK: Basic Structures
+
+typedef struct Proxy {
+	void *obj;
+	cpBB bb;
+	// Bounds as of the last sort. The pairs are exactly the proxies whose previous bounds overlap.
+	cpBB prevBB;
+	
+	// Unique for the lifetime of the index, used to build pair keys.
+	unsigned int id;
+	// Index in the active list while rebuilding the pairs.
+	int active;
+	
+	struct Proxy *next;
+} Proxy;
+
+typedef struct Endpoint {
+	cpFloat value;
+	Proxy *proxy;
+	cpBool max;
+} Endpoint;
+
+typedef struct Pair {
+	uint64_t key;
+	Proxy *a, *b;
+} Pair;
+
+struct cpSweep2D {
+	cpSpatialIndex spatialIndex;
+	
+	cpHashSet *proxies;
+	Proxy *pooledProxies;
+	cpArray *allocatedBuffers;
+	unsigned int nextId;
+	
+	// Endpoints sorted along the x and y axes.
+	// Endpoints at or after 'sorted' belong to proxies inserted since the last sort.
+	int num, max, sorted;
+	Endpoint *axes[2];
+	Endpoint *scratch;
+	
+	// Widest proxy along the x axis. Lets queries skip the proxies that end before them.
+	cpFloat maxWidth;
+	
+	// Removed proxies that still have endpoints and pairs.
+	int removed;
+	
+	// Overlapping pairs stored in an open addressed hash table.
+	int pairCount, pairCapacity;
+	Pair *pairs;
+};
+
+static inline cpBool
+EndpointLess(Endpoint a, Endpoint b)
+{
+	// Min endpoints go first when the values are equal so that touching proxies overlap.
+	return (a.value < b.value || (a.value == b.value && !a.max && b.max));
+}
+
+static inline cpFloat
+EndpointValue(Endpoint e, int axis)
+{
+	cpBB bb = e.proxy->bb;
+	return (axis == 0 ? (e.max ? bb.r : bb.l) : (e.max ? bb.t : bb.b));
+}
+
+//MARK: Proxy Functions
+
+static void
+ProxyRecycle(cpSweep2D *sweep, Proxy *proxy)
+{
+	proxy->obj = NULL;
+	proxy->next = sweep->pooledProxies;
+	sweep->pooledProxies = proxy;
+}
+
+static Proxy *
+ProxyFromPool(cpSweep2D *sweep)
+{
+	Proxy *proxy = sweep->pooledProxies;
+	
+	if(proxy){
+		sweep->pooledProxies = proxy->next;
+		return proxy;
+	} else {
+		// Pool is exhausted, make more
+		int count = CP_BUFFER_BYTES/sizeof(Proxy);
+		cpAssertHard(count, "Internal Error: Buffer size is too small.");
+		
+		Proxy *buffer = (Proxy *)cpAllocatorAlloc(sweep->spatialIndex.allocator, CP_BUFFER_BYTES);
+		cpArrayPush(sweep->allocatedBuffers, buffer);
+		
+		for(int i=0; i<count; i++) buffer[i].id = ++sweep->nextId;
+		
+		// push all but the first one, return the first instead
+		for(int i=1; i<count; i++) ProxyRecycle(sweep, buffer + i);
+		return buffer;
+	}
+}
+
+static int
+proxySetEql(void *obj, Proxy *proxy)
+{
+	return (obj == proxy->obj);
+}
+
+static void *
+proxySetTrans(void *obj, cpSweep2D *sweep)
+{
+	Proxy *proxy = ProxyFromPool(sweep);
+	proxy->obj = obj;
+	proxy->bb = sweep->spatialIndex.bbfunc(obj);
+	
+	return proxy;
+}
+
+//MARK: Pair Functions
+
+static inline uint64_t
+PairKey(Proxy *a, Proxy *b)
+{
+	unsigned int id_a = a->id, id_b = b->id;
+	return (id_a < id_b ? (uint64_t)id_a<<32 | id_b : (uint64_t)id_b<<32 | id_a);
+}
+
+static inline int
+PairSlot(uint64_t key, int mask)
+{
+	return (int)((key*0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+static void
+PairInsert(cpSweep2D *sweep, Pair pair)
+{
+	Pair *pairs = sweep->pairs;
+	int mask = sweep->pairCapacity - 1;
+	
+	for(int i=PairSlot(pair.key, mask);; i = (i + 1) & mask){
+		if(pairs[i].key == pair.key) return;
+		
+		if(!pairs[i].key){
+			pairs[i] = pair;
+			sweep->pairCount++;
+			return;
+		}
+	}
+}
+
+// Rehash the pairs into a new table. Pairs with removed proxies are dropped.
+static void
+PairsResize(cpSweep2D *sweep, int capacity)
+{
+	Pair *pairs = sweep->pairs;
+	int count = sweep->pairCapacity;
+	
+	sweep->pairs = (Pair *)cpcalloc(capacity, sizeof(Pair));
+	sweep->pairCapacity = capacity;
+	sweep->pairCount = 0;
+	
+	for(int i=0; i<count; i++){
+		Pair pair = pairs[i];
+		if(pair.key && pair.a->obj && pair.b->obj) PairInsert(sweep, pair);
+	}
+	
+	cpfree(pairs);
+}
+
+static void
+PairAdd(cpSweep2D *sweep, Proxy *a, Proxy *b)
+{
+	// Keep the table at most half full.
+	if(2*(sweep->pairCount + 1) > sweep->pairCapacity){
+		PairsResize(sweep, sweep->pairCapacity ? 2*sweep->pairCapacity : 64);
+	}
+	
+	Pair pair = {PairKey(a, b), a, b};
+	PairInsert(sweep, pair);
+}
+
+static void
+PairRemove(cpSweep2D *sweep, Proxy *a, Proxy *b)
+{
+	if(!sweep->pairCount) return;
+	
+	Pair *pairs = sweep->pairs;
+	int mask = sweep->pairCapacity - 1;
+	uint64_t key = PairKey(a, b);
+	
+	int i = PairSlot(key, mask);
+	while(pairs[i].key != key){
+		if(!pairs[i].key) return;
+		i = (i + 1) & mask;
+	}
+	
+	// Shift the following pairs back into the hole so that lookups don't need tombstones.
+	for(int j = (i + 1) & mask; pairs[j].key; j = (j + 1) & mask){
+		int slot = PairSlot(pairs[j].key, mask);
+		
+		// Move it if its slot isn't cyclically between the hole and its current position.
+		if(i <= j ? (slot <= i || slot > j) : (slot <= i && slot > j)){
+			pairs[i] = pairs[j];
+			i = j;
+		}
+	}
+	
+	pairs[i].key = 0;
+	sweep->pairCount--;
+}
+
+static void
+PairsClear(cpSweep2D *sweep)
+{
+	if(sweep->pairs) memset(sweep->pairs, 0, sweep->pairCapacity*sizeof(Pair));
+	sweep->pairCount = 0;
+}
+
+//MARK: Memory Management Functions
+
+cpSweep2D *
+cpSweep2DAlloc(void)
+{
+	return (cpSweep2D *)cpcalloc(1, sizeof(cpSweep2D));
+}
+
+static void
+ResizeEndpoints(cpSweep2D *sweep, int size)
+{
+	sweep->max = size;
+	sweep->axes[0] = (Endpoint *)cprealloc(sweep->axes[0], size*sizeof(Endpoint));
+	sweep->axes[1] = (Endpoint *)cprealloc(sweep->axes[1], size*sizeof(Endpoint));
+	sweep->scratch = (Endpoint *)cprealloc(sweep->scratch, size*sizeof(Endpoint));
+}
+
+cpSpatialIndex *
+cpSweep2DInit(cpSweep2D *sweep, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
+{
+	cpSpatialIndexInit((cpSpatialIndex *)sweep, Klass(), bbfunc, staticIndex);
+	
+	sweep->proxies = cpHashSetNew(0, (cpHashSetEqlFunc)proxySetEql);
+	sweep->pooledProxies = NULL;
+	sweep->allocatedBuffers = cpArrayNew(0);
+	sweep->nextId = 0;
+	
+	sweep->num = sweep->sorted = 0;
+	sweep->axes[0] = sweep->axes[1] = sweep->scratch = NULL;
+	ResizeEndpoints(sweep, 64);
+	
+	sweep->maxWidth = 0.0f;
+	sweep->removed = 0;
+	
+	sweep->pairCount = sweep->pairCapacity = 0;
+	sweep->pairs = NULL;
+	
+	return (cpSpatialIndex *)sweep;
+}
+
+cpSpatialIndex *
+cpSweep2DNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
+{
+	return cpSweep2DInit(cpSweep2DAlloc(), bbfunc, staticIndex);
+}
+
+void
+cpSweep2DSetAllocator(cpSpatialIndex *index, const cpAllocator *allocator)
+{
+	if(index->klass != Klass()) return;
+	
+	cpSweep2D *sweep = (cpSweep2D *)index;
+	cpAssertHard(sweep->allocatedBuffers->num == 0, "The allocator must be set before anything is added.");
+	cpHashSetSetAllocator(sweep->proxies, allocator);
+}
+
+static void
+cpSweep2DDestroy(cpSweep2D *sweep)
+{
+	cpHashSetFree(sweep->proxies);
+	
+	cpfree(sweep->axes[0]);
+	cpfree(sweep->axes[1]);
+	cpfree(sweep->scratch);
+	cpfree(sweep->pairs);
+	
+	cpAllocatorFreeBuffers(sweep->spatialIndex.allocator, sweep->allocatedBuffers);
+}
+
+//MARK: Misc
+
+static int
+cpSweep2DCount(cpSweep2D *sweep)
+{
+	return cpHashSetCount(sweep->proxies);
+}
+
+typedef struct eachContext {
+	cpSpatialIndexIteratorFunc func;
+	void *data;
+} eachContext;
+
+static void eachHelper(Proxy *proxy, eachContext *context){context->func(proxy->obj, context->data);}
+
+static void
+cpSweep2DEach(cpSweep2D *sweep, cpSpatialIndexIteratorFunc func, void *data)
+{
+	eachContext context = {func, data};
+	cpHashSetEach(sweep->proxies, (cpHashSetIteratorFunc)eachHelper, &context);
+}
+
+static cpBool
+cpSweep2DContains(cpSweep2D *sweep, void *obj, cpHashValue hashid)
+{
+	return (cpHashSetFind(sweep->proxies, hashid, obj) != NULL);
+}
+
+//MARK: Basic Operations
+
+static void
+cpSweep2DInsert(cpSweep2D *sweep, void *obj, cpHashValue hashid)
+{
+	Proxy *proxy = (Proxy *)cpHashSetInsert(sweep->proxies, hashid, obj, (cpHashSetTransFunc)proxySetTrans, sweep);
+	if(sweep->num + 2 > sweep->max) ResizeEndpoints(sweep, 2*sweep->max);
+	
+	// Append the endpoints. They are sorted into place on the next reindex.
+	for(int axis=0; axis<2; axis++){
+		Endpoint min = {0.0f, proxy, cpFalse}, max = {0.0f, proxy, cpTrue};
+		min.value = EndpointValue(min, axis);
+		max.value = EndpointValue(max, axis);
+		
+		sweep->axes[axis][sweep->num + 0] = min;
+		sweep->axes[axis][sweep->num + 1] = max;
+	}
+	
+	sweep->num += 2;
+	sweep->maxWidth = cpfmax(sweep->maxWidth, proxy->bb.r - proxy->bb.l);
+}
+
+static void
+cpSweep2DRemove(cpSweep2D *sweep, void *obj, cpHashValue hashid)
+{
+	Proxy *proxy = (Proxy *)cpHashSetRemove(sweep->proxies, hashid, obj);
+	
+	// The endpoints and pairs are removed in bulk on the next reindex.
+	if(proxy){
+		proxy->obj = NULL;
+		sweep->removed++;
+	}
+}
+
+//MARK: Sorting Functions
+
+// Drop the endpoints and pairs of removed proxies and recycle them.
+static void
+Compact(cpSweep2D *sweep)
+{
+	if(!sweep->removed) return;
+	
+	if(sweep->pairCount) PairsResize(sweep, sweep->pairCapacity);
+	
+	int num = 0, sorted = 0;
+	for(int axis=0; axis<2; axis++){
+		Endpoint *endpoints = sweep->axes[axis];
+		num = sorted = 0;
+		
+		for(int i=0, count=sweep->num; i<count; i++){
+			Endpoint e = endpoints[i];
+			
+			if(e.proxy->obj){
+				if(i < sweep->sorted) sorted++;
+				endpoints[num++] = e;
+			} else if(axis == 1 && e.max){
+				// Done with this proxy once both axes are compacted.
+				ProxyRecycle(sweep, e.proxy);
+			}
+		}
+	}
+	
+	sweep->num = num;
+	sweep->sorted = sorted;
+	sweep->removed = 0;
+}
+
+static void
+SetValues(cpSweep2D *sweep)
+{
+	cpFloat maxWidth = 0.0f;
+	
+	for(int axis=0; axis<2; axis++){
+		Endpoint *endpoints = sweep->axes[axis];
+		for(int i=0, count=sweep->num; i<count; i++) endpoints[i].value = EndpointValue(endpoints[i], axis);
+	}
+	
+	Endpoint *endpoints = sweep->axes[0];
+	for(int i=0, count=sweep->num; i<count; i++){
+		cpBB bb = endpoints[i].proxy->bb;
+		if(endpoints[i].max && endpoints[i].proxy->obj) maxWidth = cpfmax(maxWidth, bb.r - bb.l);
+	}
+	
+	sweep->maxWidth = maxWidth;
+}
+
+// Insertion sort an axis that is nearly sorted already.
+// Every swap of a min and a max endpoint starts or ends an overlap along this axis.
+// Returns false if it gave up after 'limit' swaps. The endpoints are left partially sorted.
+static cpBool
+SortAxis(cpSweep2D *sweep, Endpoint *endpoints, int count, int limit)
+{
+	int swaps = 0;
+	
+	for(int i=1; i<count; i++){
+		Endpoint e = endpoints[i];
+		int j = i;
+		
+		for(; j>0 && EndpointLess(e, endpoints[j - 1]); j--){
+			Endpoint f = endpoints[j - 1];
+			
+			if(e.max != f.max && e.proxy != f.proxy){
+				if(e.max){
+					if(cpBBIntersects(e.proxy->prevBB, f.proxy->prevBB)) PairRemove(sweep, e.proxy, f.proxy);
+				} else if(cpBBIntersects(e.proxy->bb, f.proxy->bb)){
+					PairAdd(sweep, e.proxy, f.proxy);
+				}
+			}
+			
+			endpoints[j] = f;
+			
+			if(++swaps > limit){
+				endpoints[j - 1] = e;
+				return cpFalse;
+			}
+		}
+		
+		endpoints[j] = e;
+	}
+	
+	return cpTrue;
+}
+
+#if CP_USE_DOUBLES
+	typedef uint64_t RadixKey;
+#else
+	typedef uint32_t RadixKey;
+#endif
+
+// Map a float onto an unsigned integer with the same ordering.
+static inline RadixKey
+FloatKey(cpFloat value)
+{
+	union {cpFloat f; RadixKey i;} u;
+	u.f = (value == 0.0f ? 0.0f : value); // -0 sorts with 0
+	
+	RadixKey sign = (RadixKey)1 << (sizeof(RadixKey)*8 - 1);
+	return (u.i & sign ? ~u.i : u.i | sign);
+}
+
+// Sort an axis from scratch using a stable LSD radix sort.
+static void
+RadixSortAxis(cpSweep2D *sweep, Endpoint *endpoints)
+{
+	int count = sweep->num;
+	Endpoint *src = endpoints, *dst = sweep->scratch;
+	
+	// Put the min endpoints first so they stay ahead of max endpoints with the same value.
+	int mins = 0, maxes = 0;
+	for(int i=0; i<count; i++) mins += !src[i].max;
+	for(int i=0; i<count; i++){
+		if(src[i].max) dst[mins + maxes++] = src[i]; else dst[i - maxes] = src[i];
+	}
+	
+	src = dst;
+	dst = endpoints;
+	
+	for(unsigned int shift=0; shift<sizeof(RadixKey)*8; shift+=8){
+		int offsets[256] = {0};
+		for(int i=0; i<count; i++) offsets[FloatKey(src[i].value)>>shift & 0xFF]++;
+		
+		// Skip the digits that are the same for every endpoint.
+		if(offsets[FloatKey(src[0].value)>>shift & 0xFF] == count) continue;
+		
+		for(int i=0, sum=0; i<256; i++){
+			int n = offsets[i];
+			offsets[i] = sum;
+			sum += n;
+		}
+		
+		for(int i=0; i<count; i++) dst[offsets[FloatKey(src[i].value)>>shift & 0xFF]++] = src[i];
+		
+		Endpoint *tmp = src; src = dst; dst = tmp;
+	}
+	
+	if(src != endpoints) memcpy(endpoints, src, count*sizeof(Endpoint));
+}
+
+// Sort both axes from scratch and find the overlapping pairs with a single sweep along the x axis.
+static void
+Rebuild(cpSweep2D *sweep)
+{
+	if(sweep->num == 0){
+		PairsClear(sweep);
+		return;
+	}
+	
+	RadixSortAxis(sweep, sweep->axes[0]);
+	RadixSortAxis(sweep, sweep->axes[1]);
+	PairsClear(sweep);
+	
+	Proxy **active = (Proxy **)cpcalloc(sweep->num/2, sizeof(Proxy *));
+	int activeCount = 0;
+	
+	Endpoint *endpoints = sweep->axes[0];
+	for(int i=0, count=sweep->num; i<count; i++){
+		Proxy *proxy = endpoints[i].proxy;
+		
+		if(endpoints[i].max){
+			Proxy *last = active[--activeCount];
+			active[proxy->active] = last;
+			last->active = proxy->active;
+		} else {
+			// Everything in the active list overlaps along the x axis already.
+			cpBB bb = proxy->bb;
+			for(int j=0; j<activeCount; j++){
+				Proxy *other = active[j];
+				if(bb.b <= other->bb.t && other->bb.b <= bb.t) PairAdd(sweep, proxy, other);
+			}
+			
+			proxy->active = activeCount;
+			active[activeCount++] = proxy;
+		}
+	}
+	
+	cpfree(active);
+}
+
+// Index of the first endpoint in the sorted range with a value of at least 'value'.
+static int
+LowerBound(Endpoint *endpoints, int count, cpFloat value)
+{
+	int lo = 0, hi = count;
+	while(lo < hi){
+		int mid = (lo + hi)/2;
+		if(endpoints[mid].value < value) lo = mid + 1; else hi = mid;
+	}
+	
+	return lo;
+}
+
+// Find the pairs for proxies inserted since the last sort.
+// Sorting them in from the end of the axis would cost a pass over all the endpoints for each one.
+static void
+AddPendingPairs(cpSweep2D *sweep)
+{
+	Endpoint *endpoints = sweep->axes[0];
+	int sorted = sweep->sorted;
+	
+	for(int i=sorted, count=sweep->num; i<count; i++){
+		if(endpoints[i].max) continue;
+		
+		Proxy *proxy = endpoints[i].proxy;
+		cpBB bb = proxy->bb;
+		
+		for(int j=LowerBound(endpoints, sorted, bb.l - sweep->maxWidth); j<sorted && endpoints[j].value <= bb.r; j++){
+			Endpoint e = endpoints[j];
+			if(!e.max && cpBBIntersects(bb, e.proxy->bb)) PairAdd(sweep, proxy, e.proxy);
+		}
+		
+		for(int j=i+1; j<count; j++){
+			Endpoint e = endpoints[j];
+			if(!e.max && cpBBIntersects(bb, e.proxy->bb)) PairAdd(sweep, proxy, e.proxy);
+		}
+	}
+}
+
+// Sort the new endpoints and merge them with the sorted ones.
+static void
+MergePending(cpSweep2D *sweep, Endpoint *endpoints)
+{
+	int sorted = sweep->sorted, count = sweep->num;
+	
+	for(int i=sorted+1; i<count; i++){
+		Endpoint e = endpoints[i];
+		int j = i;
+		
+		for(; j>sorted && EndpointLess(e, endpoints[j - 1]); j--) endpoints[j] = endpoints[j - 1];
+		endpoints[j] = e;
+	}
+	
+	Endpoint *merged = sweep->scratch;
+	int a = 0, b = sorted, n = 0;
+	
+	while(a < sorted && b < count) merged[n++] = (EndpointLess(endpoints[b], endpoints[a]) ? endpoints[b++] : endpoints[a++]);
+	while(a < sorted) merged[n++] = endpoints[a++];
+	while(b < count) merged[n++] = endpoints[b++];
+	
+	memcpy(endpoints, merged, count*sizeof(Endpoint));
+}
+
+static void
+SortEndpoints(cpSweep2D *sweep)
+{
+	Compact(sweep);
+	
+	int count = sweep->num, sorted = sweep->sorted;
+	int limit = REBUILD_SWAP_RATIO*count;
+	
+	if(
+		(count - sorted)*REBUILD_PENDING_RATIO > count ||
+		!SortAxis(sweep, sweep->axes[0], sorted, limit) ||
+		!SortAxis(sweep, sweep->axes[1], sorted, limit)
+	){
+		Rebuild(sweep);
+	} else if(sorted < count){
+		AddPendingPairs(sweep);
+		MergePending(sweep, sweep->axes[0]);
+		MergePending(sweep, sweep->axes[1]);
+	}
+	
+	Endpoint *endpoints = sweep->axes[0];
+	for(int i=0; i<count; i++) endpoints[i].proxy->prevBB = endpoints[i].proxy->bb;
+	
+	sweep->sorted = count;
+}
+
+//MARK: Reindexing Functions
+
+static void
+UpdateBounds(cpSweep2D *sweep)
+{
+	cpSpatialIndexBBFunc bbfunc = sweep->spatialIndex.bbfunc;
+	
+	Endpoint *endpoints = sweep->axes[0];
+	for(int i=0, count=sweep->num; i<count; i++){
+		Proxy *proxy = endpoints[i].proxy;
+		if(!endpoints[i].max && proxy->obj) proxy->bb = bbfunc(proxy->obj);
+	}
+	
+	SetValues(sweep);
+}
+
+static void
+cpSweep2DReindex(cpSweep2D *sweep)
+{
+	UpdateBounds(sweep);
+	SortEndpoints(sweep);
+}
+
+static void
+cpSweep2DReindexObject(cpSweep2D *sweep, void *obj, cpHashValue hashid)
+{
+	Proxy *proxy = (Proxy *)cpHashSetFind(sweep->proxies, hashid, obj);
+	if(!proxy) return;
+	
+	proxy->bb = sweep->spatialIndex.bbfunc(obj);
+	SetValues(sweep);
+	SortEndpoints(sweep);
+}
+
+//MARK: Query Functions
+
+static inline void
+QueryEndpoint(Endpoint e, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	Proxy *proxy = e.proxy;
+	if(!e.max && proxy->obj && proxy->obj != obj && cpBBIntersects(bb, proxy->bb)) func(obj, proxy->obj, 0, data);
+}
+
+static void
+cpSweep2DQuery(cpSweep2D *sweep, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	Endpoint *endpoints = sweep->axes[0];
+	int sorted = sweep->sorted;
+	
+	// Nothing that starts further left than this can reach the query box.
+	for(int i=LowerBound(endpoints, sorted, bb.l - sweep->maxWidth); i<sorted && endpoints[i].value <= bb.r; i++){
+		QueryEndpoint(endpoints[i], obj, bb, func, data);
+	}
+	
+	for(int i=sorted, count=sweep->num; i<count; i++) QueryEndpoint(endpoints[i], obj, bb, func, data);
+}
+
+static inline cpFloat
+SegmentQueryEndpoint(Endpoint e, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
+{
+	Proxy *proxy = e.proxy;
+	if(!e.max && proxy->obj && cpBBSegmentQuery(proxy->bb, a, b) < t_exit){
+		t_exit = cpfmin(t_exit, func(obj, proxy->obj, data));
+	}
+	
+	return t_exit;
+}
+
+static void
+cpSweep2DSegmentQuery(cpSweep2D *sweep, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
+{
+	cpBB bb = cpBBExpand(cpBBNew(a.x, a.y, a.x, a.y), b);
+	Endpoint *endpoints = sweep->axes[0];
+	int sorted = sweep->sorted;
+	
+	for(int i=LowerBound(endpoints, sorted, bb.l - sweep->maxWidth); i<sorted && endpoints[i].value <= bb.r; i++){
+		t_exit = SegmentQueryEndpoint(endpoints[i], obj, a, b, t_exit, func, data);
+	}
+	
+	for(int i=sorted, count=sweep->num; i<count; i++) t_exit = SegmentQueryEndpoint(endpoints[i], obj, a, b, t_exit, func, data);
+}
+
+//MARK: Reindex/Query
+
+static void
+cpSweep2DReindexQuery(cpSweep2D *sweep, cpSpatialIndexQueryFunc func, void *data)
+{
+	UpdateBounds(sweep);
+	SortEndpoints(sweep);
+	
+	Pair *pairs = sweep->pairs;
+	for(int i=0, count=sweep->pairCapacity; i<count; i++){
+		if(pairs[i].key) func(pairs[i].a->obj, pairs[i].b->obj, 0, data);
+	}
+	
+	// Reindex query is also responsible for colliding against the static index.
+	cpSpatialIndexCollideStatic((cpSpatialIndex *)sweep, sweep->spatialIndex.staticIndex, func, data);
+}
+
+static cpSpatialIndexClass klass = {
+	(cpSpatialIndexDestroyImpl)cpSweep2DDestroy,
+	
+	(cpSpatialIndexCountImpl)cpSweep2DCount,
+	(cpSpatialIndexEachImpl)cpSweep2DEach,
+	(cpSpatialIndexContainsImpl)cpSweep2DContains,
+	
+	(cpSpatialIndexInsertImpl)cpSweep2DInsert,
+	(cpSpatialIndexRemoveImpl)cpSweep2DRemove,
+	
+	(cpSpatialIndexReindexImpl)cpSweep2DReindex,
+	(cpSpatialIndexReindexObjectImpl)cpSweep2DReindexObject,
+	(cpSpatialIndexReindexQueryImpl)cpSweep2DReindexQuery,
+	
+	(cpSpatialIndexQueryImpl)cpSweep2DQuery,
+	(cpSpatialIndexSegmentQueryImpl)cpSweep2DSegmentQuery,
+};
+
+static inline cpSpatialIndexClass *Klass(){return &klass;}
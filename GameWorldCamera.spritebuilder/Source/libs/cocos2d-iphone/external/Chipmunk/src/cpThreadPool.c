@@ -0,0 +1,194 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+#define MAX_THREADS 32
+
+struct ThreadContext {
+	pthread_t thread;
+	cpThreadPool *pool;
+	unsigned long worker;
+	unsigned long generation;
+};
+
+struct cpThreadPool {
+	// Number of threads, including the thread calling cpThreadPoolRun().
+	unsigned long num_threads;
+	
+	pthread_mutex_t mutex;
+	pthread_cond_t cond_work, cond_resume, cond_barrier;
+	
+	// The function the workers are running, or NULL when they should exit.
+	cpThreadPoolWorkFunc work;
+	void *data;
+	unsigned long work_generation;
+	unsigned long num_working;
+	
+	unsigned long barrier_count;
+	unsigned long barrier_generation;
+	
+	struct ThreadContext workers[MAX_THREADS - 1];
+};
+
+static void *
+WorkerThreadLoop(struct ThreadContext *context)
+{
+	cpThreadPool *pool = context->pool;
+	unsigned long generation = context->generation;
+	
+	for(;;){
+		cpThreadPoolWorkFunc work;
+		void *data;
+		
+		pthread_mutex_lock(&pool->mutex); {
+			while(pool->work_generation == generation) pthread_cond_wait(&pool->cond_work, &pool->mutex);
+			generation = pool->work_generation;
+			work = pool->work;
+			data = pool->data;
+		} pthread_mutex_unlock(&pool->mutex);
+		
+		if(work == NULL) break;
+		work(data, context->worker);
+		
+		pthread_mutex_lock(&pool->mutex); {
+			if(--pool->num_working == 0) pthread_cond_signal(&pool->cond_resume);
+		} pthread_mutex_unlock(&pool->mutex);
+	}
+	
+	return NULL;
+}
+
+static unsigned long
+ProcessorCount(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count > 0 ? (unsigned long)count : 1);
+#else
+	return 1;
+#endif
+}
+
+cpThreadPool *
+cpThreadPoolNew(unsigned long threads)
+{
+	cpThreadPool *pool = (cpThreadPool *)cpcalloc(1, sizeof(cpThreadPool));
+	
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->cond_work, NULL);
+	pthread_cond_init(&pool->cond_resume, NULL);
+	pthread_cond_init(&pool->cond_barrier, NULL);
+	
+	if(threads == 0) threads = ProcessorCount();
+	threads = (threads < MAX_THREADS ? threads : MAX_THREADS);
+	
+	pool->num_threads = 1;
+	for(unsigned long i=0; i<threads - 1; i++){
+		struct ThreadContext *context = pool->workers + i;
+		context->pool = pool;
+		context->worker = i + 1;
+		context->generation = pool->work_generation;
+		
+		if(pthread_create(&context->thread, NULL, (void *(*)(void *))WorkerThreadLoop, context) != 0){
+			cpAssertWarn(cpFalse, "Failed to create a worker thread. Using %lu threads instead.", pool->num_threads);
+			break;
+		}
+		
+		pool->num_threads++;
+	}
+	
+	return pool;
+}
+
+void
+cpThreadPoolFree(cpThreadPool *pool)
+{
+	if(pool){
+		pthread_mutex_lock(&pool->mutex); {
+			pool->work = NULL;
+			pool->work_generation++;
+			pthread_cond_broadcast(&pool->cond_work);
+		} pthread_mutex_unlock(&pool->mutex);
+		
+		for(unsigned long i=0; i<pool->num_threads - 1; i++){
+			pthread_join(pool->workers[i].thread, NULL);
+		}
+		
+		pthread_mutex_destroy(&pool->mutex);
+		pthread_cond_destroy(&pool->cond_work);
+		pthread_cond_destroy(&pool->cond_resume);
+		pthread_cond_destroy(&pool->cond_barrier);
+		
+		cpfree(pool);
+	}
+}
+
+unsigned long
+cpThreadPoolGetThreads(cpThreadPool *pool)
+{
+	return (pool ? pool->num_threads : 1);
+}
+
+void
+cpThreadPoolRun(cpThreadPool *pool, cpThreadPoolWorkFunc work, void *data)
+{
+	if(pool == NULL || pool->num_threads == 1){
+		work(data, 0);
+		return;
+	}
+	
+	pthread_mutex_lock(&pool->mutex); {
+		pool->work = work;
+		pool->data = data;
+		pool->num_working = pool->num_threads - 1;
+		pool->work_generation++;
+		pthread_cond_broadcast(&pool->cond_work);
+	} pthread_mutex_unlock(&pool->mutex);
+	
+	// The calling thread is worker 0.
+	work(data, 0);
+	
+	pthread_mutex_lock(&pool->mutex); {
+		while(pool->num_working > 0) pthread_cond_wait(&pool->cond_resume, &pool->mutex);
+	} pthread_mutex_unlock(&pool->mutex);
+}
+
+void
+cpThreadPoolBarrier(cpThreadPool *pool)
+{
+	if(pool == NULL || pool->num_threads == 1) return;
+	
+	pthread_mutex_lock(&pool->mutex); {
+		unsigned long generation = pool->barrier_generation;
+		
+		if(++pool->barrier_count == pool->num_threads){
+			pool->barrier_count = 0;
+			pool->barrier_generation++;
+			pthread_cond_broadcast(&pool->cond_barrier);
+		} else {
+			while(pool->barrier_generation == generation) pthread_cond_wait(&pool->cond_barrier, &pool->mutex);
+		}
+	} pthread_mutex_unlock(&pool->mutex);
+}
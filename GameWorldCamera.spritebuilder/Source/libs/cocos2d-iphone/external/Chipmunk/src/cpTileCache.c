@@ -0,0 +1,220 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "chipmunk/chipmunk_private.h"
+#include "chipmunk/cpPolyline.h"
+#include "chipmunk/cpTileCache.h"
+
+typedef struct cpTile {
+	cpBool generated;
+
+	// The shapes this tile added to the space.
+	int count;
+	cpShape **shapes;
+} cpTile;
+
+struct cpTileCache {
+	cpSpace *space;
+
+	cpBB bounds;
+	cpFloat tileSize;
+	unsigned long samples;
+
+	cpMarchSampleFunc sample;
+	void *sampleData;
+
+	cpFloat threshold;
+	cpBool hard;
+	cpFloat simplifyTolerance;
+	cpFloat radius;
+
+	cpTileCacheShapeFunc shapeFunc;
+	void *shapeData;
+
+	int columns, rows;
+	cpTile *tiles;
+};
+
+cpTileCache *
+cpTileCacheNew(cpSpace *space, cpBB bounds, cpFloat tileSize, unsigned long samplesPerTile, cpMarchSampleFunc sample, void *sampleData)
+{
+	cpAssertHard(tileSize > 0.0f, "Tile size must be positive.");
+	cpAssertHard(samplesPerTile >= 2, "At least two samples are needed per tile.");
+
+	cpTileCache *cache = (cpTileCache *)cpcalloc(1, sizeof(cpTileCache));
+	cache->space = space;
+
+	cache->bounds = bounds;
+	cache->tileSize = tileSize;
+	cache->samples = samplesPerTile;
+
+	cache->sample = sample;
+	cache->sampleData = sampleData;
+
+	cache->threshold = 0.5f;
+	cache->hard = cpFalse;
+	cache->simplifyTolerance = 0.0f;
+	cache->radius = 0.0f;
+
+	cache->columns = (int)cpfmax(cpfceil((bounds.r - bounds.l)/tileSize), 1.0f);
+	cache->rows = (int)cpfmax(cpfceil((bounds.t - bounds.b)/tileSize), 1.0f);
+	cache->tiles = (cpTile *)cpcalloc(cache->columns*cache->rows, sizeof(cpTile));
+
+	return cache;
+}
+
+static void
+TileClear(cpTileCache *cache, cpTile *tile)
+{
+	for(int i=0; i<tile->count; i++){
+		cpSpaceRemoveShape(cache->space, tile->shapes[i]);
+		cpShapeFree(tile->shapes[i]);
+	}
+
+	cpfree(tile->shapes);
+	tile->shapes = NULL;
+	tile->count = 0;
+	tile->generated = cpFalse;
+}
+
+void
+cpTileCacheFree(cpTileCache *cache)
+{
+	if(cache){
+		for(int i=0; i<cache->columns*cache->rows; i++) TileClear(cache, cache->tiles + i);
+
+		cpfree(cache->tiles);
+		cpfree(cache);
+	}
+}
+
+cpFloat cpTileCacheGetThreshold(const cpTileCache *cache){return cache->threshold;}
+void cpTileCacheSetThreshold(cpTileCache *cache, cpFloat threshold){cache->threshold = threshold;}
+
+cpBool cpTileCacheGetMarchHard(const cpTileCache *cache){return cache->hard;}
+void cpTileCacheSetMarchHard(cpTileCache *cache, cpBool hard){cache->hard = hard;}
+
+cpFloat cpTileCacheGetSimplifyTolerance(const cpTileCache *cache){return cache->simplifyTolerance;}
+void cpTileCacheSetSimplifyTolerance(cpTileCache *cache, cpFloat tol){cache->simplifyTolerance = tol;}
+
+cpFloat cpTileCacheGetSegmentRadius(const cpTileCache *cache){return cache->radius;}
+void cpTileCacheSetSegmentRadius(cpTileCache *cache, cpFloat radius){cache->radius = radius;}
+
+void
+cpTileCacheSetShapeFunc(cpTileCache *cache, cpTileCacheShapeFunc func, void *data)
+{
+	cache->shapeFunc = func;
+	cache->shapeData = data;
+}
+
+// The range of tiles that overlap bb. Returns false if there are none.
+static cpBool
+TileRange(cpTileCache *cache, cpBB bb, int *i0, int *j0, int *i1, int *j1)
+{
+	cpBB bounds = cache->bounds;
+	cpFloat size = cache->tileSize;
+
+	(*i0) = (int)cpfmax(cpffloor((bb.l - bounds.l)/size), 0.0f);
+	(*j0) = (int)cpfmax(cpffloor((bb.b - bounds.b)/size), 0.0f);
+	(*i1) = (int)cpfmin(cpffloor((bb.r - bounds.l)/size), cache->columns - 1);
+	(*j1) = (int)cpfmin(cpffloor((bb.t - bounds.b)/size), cache->rows - 1);
+
+	return ((*i0) <= (*i1) && (*j0) <= (*j1));
+}
+
+void
+cpTileCacheMarkDirty(cpTileCache *cache, cpBB bb)
+{
+	int i0, j0, i1, j1;
+	if(!TileRange(cache, bb, &i0, &j0, &i1, &j1)) return;
+
+	for(int j=j0; j<=j1; j++){
+		for(int i=i0; i<=i1; i++) TileClear(cache, cache->tiles + j*cache->columns + i);
+	}
+}
+
+static void
+TileGenerate(cpTileCache *cache, cpTile *tile, int i, int j)
+{
+	cpBB bounds = cache->bounds;
+	cpFloat size = cache->tileSize;
+
+	// Calculated the same way for both sides of a tile edge so neighboring tiles sample exactly the same points.
+	cpBB bb = cpBBNew(bounds.l + i*size, bounds.b + j*size, bounds.l + (i + 1)*size, bounds.b + (j + 1)*size);
+
+	cpPolylineSet lines;
+	cpPolylineSetInit(&lines);
+
+	if(cache->hard){
+		cpMarchHard(bb, cache->samples, cache->samples, cache->threshold, (cpMarchSegmentFunc)cpPolylineSetCollectSegment, &lines, cache->sample, cache->sampleData);
+	} else {
+		cpMarchSoft(bb, cache->samples, cache->samples, cache->threshold, (cpMarchSegmentFunc)cpPolylineSetCollectSegment, &lines, cache->sample, cache->sampleData);
+	}
+
+	// Simplifying keeps the ends of open lines, so the outlines still meet at the tile edges.
+	int capacity = 0;
+	for(int k=0; k<lines.count; k++){
+		cpPolyline *simplified = cpPolylineSimplifyCurves(lines.lines[k], cache->simplifyTolerance);
+		cpPolylineFree(lines.lines[k]);
+		lines.lines[k] = simplified;
+
+		capacity += simplified->count - 1;
+	}
+
+	tile->shapes = (cpShape **)cpcalloc(capacity, sizeof(cpShape *));
+	tile->count = 0;
+
+	cpBody *staticBody = cpSpaceGetStaticBody(cache->space);
+	for(int k=0; k<lines.count; k++){
+		cpShape **shapes = tile->shapes + tile->count;
+		int count = cpPolylineSegmentShapes(lines.lines[k], staticBody, cache->radius, shapes);
+
+		for(int l=0; l<count; l++){
+			if(cache->shapeFunc) cache->shapeFunc(cache, shapes[l], cache->shapeData);
+			cpSpaceAddShape(cache->space, shapes[l]);
+		}
+
+		tile->count += count;
+	}
+
+	cpPolylineSetDestroy(&lines, cpTrue);
+	tile->generated = cpTrue;
+}
+
+int
+cpTileCacheEnsure(cpTileCache *cache, cpBB bb)
+{
+	int i0, j0, i1, j1;
+	if(!TileRange(cache, bb, &i0, &j0, &i1, &j1)) return 0;
+
+	int generated = 0;
+	for(int j=j0; j<=j1; j++){
+		for(int i=i0; i<=i1; i++){
+			cpTile *tile = cache->tiles + j*cache->columns + i;
+			if(!tile->generated){
+				TileGenerate(cache, tile, i, j);
+				generated++;
+			}
+		}
+	}
+
+	return generated;
+}